@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include "../include/OrderBook.h"
+
+/**
+    Cost of a call auction uncross. Orders accumulate in an open auction, bids spread over [mid - 400, mid + 100] and asks over
+    [mid - 100, mid + 400] so the two sides overlap on 200 ticks, a tenth of them icebergs. Only the uncross is timed: the price ladder
+    and its cumulative curves, then the execution of the clearing volume in priority order.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_ORDERS = 1000000;
+    const int NUM_REPEATS = 3;
+    const long long MID_PRICE = 100000;
+
+    void fill_auction(OrderBook& orderbook) {
+        std::mt19937 rng(17);
+        orderbook.open_auction();
+
+        for (int i = 0; i < NUM_ORDERS; i++) {
+            bool is_buy = rng() % 2 == 0;
+            long long offset = (long long)(rng() % 500);
+            long long price = is_buy ? MID_PRICE - 400 + offset : MID_PRICE - 100 + offset;
+            int quantity = 1 + (int)(rng() % 100);
+
+            if (rng() % 10 == 0) {
+                orderbook.add_iceberg_order(is_buy, price, quantity * 5, quantity, i);
+            }
+            else {
+                orderbook.add_limit_order(is_buy, price, quantity, i);
+            }
+        }
+    }
+}
+
+int main() {
+    std::cout << "Auction uncross benchmark, " << NUM_ORDERS << " resting orders, best of " << NUM_REPEATS << std::endl;
+
+    double best_seconds = 1e300;
+    OrderBook::UncrossResult result = {-1, 0, 0};
+    std::size_t num_trades = 0;
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        fill_auction(orderbook);
+
+        auto start = Clock::now();
+        result = orderbook.uncross(NUM_ORDERS);
+        best_seconds = std::min(best_seconds, std::chrono::duration<double>(Clock::now() - start).count());
+        num_trades = orderbook.get_trade_log().get_trades().size();
+    }
+
+    std::cout << "  uncross: " << best_seconds * 1e3 << " ms, clearing price " << result.priceTick << ", volume " << result.volume
+              << ", imbalance " << result.imbalance << ", " << num_trades << " trades" << std::endl;
+}
@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "../include/BackgroundFlow.h"
+
+/**
+    Throughput of the background flow into a real book: noise traders, market makers and momentum takers at production-like message rates,
+    advanced in 1ms steps over one simulated second around a reference price that walks a tick at a time. Timed end to end, generation
+    and matching included, and reported per command and against the simulated clock.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_REPEATS = 3;
+    const long long SIMULATED_US = 1000000;
+    const long long STEP_US = 1000;
+    const long long MID_PRICE = 100000;
+
+    struct Result {
+        double seconds;
+        std::size_t num_commands;
+        std::size_t num_trades;
+        std::size_t num_resting;
+    };
+
+    Result run(double noise_rate, double maker_rate, double momentum_rate) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        BackgroundFlow flow(orderbook);
+        flow.add_population(BackgroundFlow::AgentPopulation::noise_traders(noise_rate, 20, 0.1, 0.45));
+        flow.add_population(BackgroundFlow::AgentPopulation::market_makers(maker_rate, 1, 3, 200));
+        flow.add_population(BackgroundFlow::AgentPopulation::momentum_takers(momentum_rate, 2));
+
+        long long reference = MID_PRICE;
+        auto start = Clock::now();
+        for (long long timestamp = 0; timestamp <= SIMULATED_US; timestamp += STEP_US) {
+            reference += (timestamp / STEP_US) % 7 == 0 ? ((timestamp / STEP_US) % 14 == 0 ? 1 : -1) : 0;
+            flow.advance_to(timestamp, reference);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        return {seconds, flow.get_num_commands_sent(), orderbook.get_trade_log().get_trades().size(), orderbook.get_order_lookup().size()};
+    }
+}
+
+int main() {
+    std::cout << "Background flow benchmark, " << SIMULATED_US / 1000000.0 << " simulated second in " << STEP_US << "us steps, best of " << NUM_REPEATS << std::endl;
+
+    for (double noise_rate : {1e5, 1e6, 4e6}) {
+        Result best = {1e300, 0, 0, 0};
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            Result result = run(noise_rate, noise_rate / 10, noise_rate / 20);
+            if (result.seconds < best.seconds) {
+                best = result;
+            }
+        }
+
+        std::cout << "  noise " << noise_rate / 1e6 << "M/s: " << best.num_commands << " commands, " << best.seconds * 1e9 / best.num_commands << " ns/command, "
+                  << (best.num_commands / best.seconds) / 1e6 << " M commands/s, " << (SIMULATED_US / 1e6) / best.seconds << "x real time, "
+                  << best.num_trades << " trades, " << best.num_resting << " resting" << std::endl;
+    }
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/OrderBook.h"
+
+/**
+    Cancel-heavy benchmark on a deep book: 1M resting orders spread over 2000 price levels, then a flow that is ~90% cancels
+    of random resting orders, ~8% new limit orders and ~2% marketable IOCs. Compares cancelling one id at a time with the
+    batched, prefetching cancel_orders(), and apply() per command with apply_batch() on the mixed flow.
+    Variants are run alternately NUM_REPEATS times on a freshly built book and the best run is reported, to damp noise from other tenants.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_RESTING = 1000000;
+    const int NUM_LEVELS_PER_SIDE = 1000;
+    const int NUM_FLOW_COMMANDS = 1000000;
+    const int NUM_REPEATS = 3;
+    const std::size_t BATCH_SIZE = 64;
+    const long long MID_PRICE = 100000;
+
+    // Fills the book with the same orders for every run, returns their ids in a random order
+    std::vector<long long> build_book(OrderBook& orderbook, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<long long> ids;
+        ids.reserve(NUM_RESTING);
+
+        for (int i = 0; i < NUM_RESTING; i++) {
+            bool is_buy = i % 2 == 0;
+            long long level = 1 + (long long)(rng() % NUM_LEVELS_PER_SIDE);
+            ids.push_back(orderbook.add_limit_order(is_buy, is_buy ? MID_PRICE - level : MID_PRICE + level, 1 + (int)(rng() % 10), i));
+        }
+
+        std::shuffle(ids.begin(), ids.end(), rng);
+        return ids;
+    }
+
+    std::vector<OrderCommand> build_flow(const std::vector<long long>& resting_ids, unsigned seed) {
+        std::mt19937 rng(seed);
+        std::vector<OrderCommand> flow;
+        flow.reserve(NUM_FLOW_COMMANDS);
+        std::size_t next_cancel = 0;
+
+        for (int i = 0; i < NUM_FLOW_COMMANDS; i++) {
+            int kind = (int)(rng() % 100);
+            bool is_buy = rng() % 2 == 0;
+
+            if (kind < 90 && next_cancel < resting_ids.size()) {
+                flow.emplace_back(OrderCommand::Type::CANCEL, i, resting_ids[next_cancel++], false, -1, 0);
+            }
+            else if (kind < 98) {
+                long long level = 1 + (long long)(rng() % NUM_LEVELS_PER_SIDE);
+                flow.emplace_back(OrderCommand::Type::ADD_LIMIT, i, -1, is_buy, is_buy ? MID_PRICE - level : MID_PRICE + level, 1 + (int)(rng() % 10));
+            }
+            else {
+                flow.emplace_back(OrderCommand::Type::ADD_IOC, i, -1, is_buy, -1, 1 + (int)(rng() % 20));
+            }
+        }
+
+        return flow;
+    }
+
+    void report(const char* name, std::size_t num_operations, double best_seconds) {
+        std::cout << "  " << name << (best_seconds * 1e9 / num_operations) << " ns/op, " << (num_operations / best_seconds) / 1e6 << " M ops/s" << std::endl;
+    }
+
+    double time_cancel_all(bool batched) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        std::vector<long long> ids = build_book(orderbook, 1);
+
+        auto start = Clock::now();
+        if (batched) {
+            orderbook.cancel_orders(ids.data(), ids.size());
+        }
+        else {
+            for (long long id : ids) {
+                orderbook.cancel_order(id);
+            }
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double time_mixed_flow(bool batched) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        std::vector<OrderCommand> flow = build_flow(build_book(orderbook, 2), 3);
+        OrderResult results[BATCH_SIZE];
+
+        auto start = Clock::now();
+        if (batched) {
+            for (std::size_t i = 0; i < flow.size(); i += BATCH_SIZE) {
+                orderbook.apply_batch(&flow[i], std::min(BATCH_SIZE, flow.size() - i), results, nullptr, 0);
+            }
+        }
+        else {
+            for (const OrderCommand& command : flow) {
+                orderbook.apply(command);
+            }
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main() {
+    double best[4] = {1e300, 1e300, 1e300, 1e300};
+
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        best[0] = std::min(best[0], time_cancel_all(false));
+        best[1] = std::min(best[1], time_cancel_all(true));
+        best[2] = std::min(best[2], time_mixed_flow(false));
+        best[3] = std::min(best[3], time_mixed_flow(true));
+    }
+
+    std::cout << "Cancel all " << NUM_RESTING << " resting orders in random order (best of " << NUM_REPEATS << "):" << std::endl;
+    report("cancel_order one by one:   ", NUM_RESTING, best[0]);
+    report("cancel_orders (prefetch):  ", NUM_RESTING, best[1]);
+
+    std::cout << "Mixed flow of " << NUM_FLOW_COMMANDS << " commands (~90% cancels, ~8% adds, ~2% IOCs) on " << NUM_RESTING << " resting orders (best of " << NUM_REPEATS << "):" << std::endl;
+    report("apply one by one:          ", NUM_FLOW_COMMANDS, best[2]);
+    report("apply_batch (prefetch):    ", NUM_FLOW_COMMANDS, best[3]);
+}
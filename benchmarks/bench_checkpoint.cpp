@@ -0,0 +1,82 @@
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include "../include/OrderBook.h"
+
+/**
+    Cost of checkpointing a deep book. 1M orders rest on 2000 levels a side, a few thousand of them icebergs, and the book is saved to
+    memory, written to a file, read back and loaded into another book, each step timed on its own. The whole round trip is meant to stay
+    under a second.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_ORDERS = 1000000;
+    const int NUM_LEVELS = 2000;
+    const int NUM_REPEATS = 3;
+    const long long MID_PRICE = 100000;
+
+    double seconds_since(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main() {
+    Metrics metrics;
+    OrderBook book(metrics);
+    std::mt19937 rng(17);
+    for (int i = 0; i < NUM_ORDERS; i++) {
+        bool is_buy = i % 2 == 0;
+        long long depth = (long long)(rng() % NUM_LEVELS);
+        long long price = is_buy ? MID_PRICE - 1 - depth : MID_PRICE + 1 + depth;
+        if (i % 500 == 0) {
+            book.add_iceberg_order(is_buy, price, 1000, 100, i);
+        }
+        else {
+            book.add_limit_order(is_buy, price, 1 + (int)(rng() % 100), i);
+        }
+    }
+
+    const std::string path = "bench_checkpoint.bin";
+    std::cout << "Checkpoint benchmark, " << book.get_order_lookup().size() << " resting orders, best of " << NUM_REPEATS << std::endl;
+
+    double best_save = 1e300, best_write = 1e300, best_read = 1e300, best_load = 1e300;
+    std::size_t num_bytes = 0;
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        auto start = Clock::now();
+        CheckpointWriter writer;
+        book.save_state(writer);
+        best_save = std::min(best_save, seconds_since(start));
+        num_bytes = writer.get_buffer().size();
+
+        start = Clock::now();
+        writer.save(path);
+        best_write = std::min(best_write, seconds_since(start));
+
+        start = Clock::now();
+        CheckpointReader reader = CheckpointReader::from_file(path);
+        best_read = std::min(best_read, seconds_since(start));
+
+        Metrics restored_metrics;
+        OrderBook restored(restored_metrics);
+        start = Clock::now();
+        restored.load_state(reader);
+        best_load = std::min(best_load, seconds_since(start));
+
+        if (restored.get_order_lookup().size() != book.get_order_lookup().size()) {
+            std::cout << "Restored book lost orders!" << std::endl;
+            return 1;
+        }
+    }
+    std::remove(path.c_str());
+
+    std::cout << "  " << num_bytes / (1 << 20) << " MiB" << std::endl;
+    std::cout << "  save to memory: " << best_save * 1e3 << " ms" << std::endl;
+    std::cout << "  write file:     " << best_write * 1e3 << " ms" << std::endl;
+    std::cout << "  read file:      " << best_read * 1e3 << " ms" << std::endl;
+    std::cout << "  load:           " << best_load * 1e3 << " ms" << std::endl;
+    std::cout << "  round trip:     " << (best_save + best_write + best_read + best_load) * 1e3 << " ms" << std::endl;
+}
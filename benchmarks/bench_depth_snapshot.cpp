@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "../include/OrderBook.h"
+
+/**
+    Cost of the seqlock-published top of book on the matching thread. The same batches of add + cancel pairs are applied
+    far behind the touch (nothing published) and at the best bid (BBO and depth snapshot republished after every batch),
+    the difference per batch is the publishing overhead. The touch run is repeated with reader threads polling the snapshot.
+    As the end-to-end difference sits within the noise of the book operations, the seqlock publish of one changed level is also timed on its own,
+    next to republishing the whole snapshot.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_LEVELS_PER_SIDE = 1000;
+    const int ORDERS_PER_LEVEL = 4;
+    const int NUM_BATCHES = 1000000;
+    const int PAIRS_PER_BATCH = 1;
+    const int NUM_REPEATS = 5;
+    const long long MID_PRICE = 100000;
+
+    void build_book(OrderBook& orderbook) {
+        for (int level = 1; level <= NUM_LEVELS_PER_SIDE; level++) {
+            for (int i = 0; i < ORDERS_PER_LEVEL; i++) {
+                orderbook.add_limit_order(true, MID_PRICE - level, 5, 0);
+                orderbook.add_limit_order(false, MID_PRICE + level, 5, 0);
+            }
+        }
+    }
+
+    // Each batch adds PAIRS_PER_BATCH orders at price_tick and cancels the ones the previous batch added
+    double time_batches(long long price_tick, int num_readers, long long& reads_done) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        build_book(orderbook);
+
+        std::atomic<bool> done(false);
+        std::atomic<long long> reads(0);
+        std::vector<std::thread> readers;
+        for (int i = 0; i < num_readers; i++) {
+            readers.emplace_back([&orderbook, &done, &reads]() {
+                long long local_reads = 0;
+                while (!done.load(std::memory_order_relaxed)) {
+                    DepthSnapshot snapshot = orderbook.load_depth_snapshot();
+                    local_reads += snapshot.numBids > 0 ? 1 : 0;
+                    if (local_reads % 64 == 0) {
+                        std::this_thread::yield();
+                    }
+                }
+                reads += local_reads;
+            });
+        }
+
+        OrderCommand batch[2 * PAIRS_PER_BATCH];
+        OrderResult results[2 * PAIRS_PER_BATCH];
+        long long previous_ids[PAIRS_PER_BATCH];
+        std::fill(previous_ids, previous_ids + PAIRS_PER_BATCH, -1);
+
+        auto start = Clock::now();
+        for (int b = 0; b < NUM_BATCHES; b++) {
+            for (int i = 0; i < PAIRS_PER_BATCH; i++) {
+                batch[2 * i] = OrderCommand(OrderCommand::Type::ADD_LIMIT, b, -1, true, price_tick, 1);
+                batch[2 * i + 1] = OrderCommand(OrderCommand::Type::CANCEL, b, previous_ids[i], false, -1, 0);
+            }
+            orderbook.apply_batch(batch, 2 * PAIRS_PER_BATCH, results, nullptr, 0);
+            for (int i = 0; i < PAIRS_PER_BATCH; i++) {
+                previous_ids[i] = results[2 * i].orderId;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        done = true;
+        for (std::thread& reader : readers) {
+            reader.join();
+        }
+        reads_done = reads.load();
+
+        return seconds;
+    }
+
+    // Per publish cost of the common case: one level's quantity changed, only its words are rewritten
+    double time_publish(bool whole_snapshot) {
+        const int NUM_PUBLISHES = 10000000;
+        DepthSnapshot depth;
+        SeqLock<DepthSnapshot> snapshot;
+        for (int level = 0; level < DepthSnapshot::MAX_LEVELS; level++) {
+            depth.bids[level] = {MID_PRICE - 1 - level, 5, 1};
+            depth.asks[level] = {MID_PRICE + 1 + level, 5, 1};
+        }
+        depth.numBids = DepthSnapshot::MAX_LEVELS;
+        depth.numAsks = DepthSnapshot::MAX_LEVELS;
+        snapshot.store(depth);
+
+        std::size_t offset = (std::size_t)(reinterpret_cast<const char*>(&depth.bids[0]) - reinterpret_cast<const char*>(&depth));
+
+        auto start = Clock::now();
+        for (int i = 0; i < NUM_PUBLISHES; i++) {
+            depth.bids[0].quantity = 1 + (i & 15);
+            if (whole_snapshot) {
+                snapshot.store(depth);
+            }
+            else {
+                snapshot.store_range(depth, offset, sizeof(L2Level));
+            }
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count() * 1e9 / NUM_PUBLISHES;
+    }
+}
+
+int main() {
+    double best_deep = 1e300;
+    double best_touch = 1e300;
+    double best_touch_with_readers = 1e300;
+    long long reads_done = 0;
+
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        long long unused_reads = 0;
+        best_deep = std::min(best_deep, time_batches(MID_PRICE - NUM_LEVELS_PER_SIDE / 2, 0, unused_reads));
+        best_touch = std::min(best_touch, time_batches(MID_PRICE - 1, 0, unused_reads));
+        best_touch_with_readers = std::min(best_touch_with_readers, time_batches(MID_PRICE - 1, 2, reads_done));
+    }
+
+    double deep_ns = best_deep * 1e9 / NUM_BATCHES;
+    double touch_ns = best_touch * 1e9 / NUM_BATCHES;
+    double readers_ns = best_touch_with_readers * 1e9 / NUM_BATCHES;
+
+    std::cout << "Depth snapshot benchmark, " << NUM_BATCHES << " batches of " << 2 * PAIRS_PER_BATCH << " commands, "
+              << DepthSnapshot::MAX_LEVELS << " published levels per side (best of " << NUM_REPEATS << ")" << std::endl;
+    std::cout << "  behind the touch (no publish):      " << deep_ns << " ns/batch" << std::endl;
+    std::cout << "  at the touch (publish every batch): " << touch_ns << " ns/batch, publishing overhead ~" << (touch_ns - deep_ns) << " ns/batch" << std::endl;
+    std::cout << "  at the touch, 2 reader threads:     " << readers_ns << " ns/batch, " << reads_done << " snapshot reads" << std::endl;
+
+    std::cout << "  seqlock publish of one changed level:  " << time_publish(false) << " ns" << std::endl;
+    std::cout << "  seqlock publish of the whole snapshot: " << time_publish(true) << " ns" << std::endl;
+
+    if (std::thread::hardware_concurrency() < 3) {
+        std::cout << "Note: fewer than 3 hardware threads, readers share cores with the matching thread." << std::endl;
+    }
+}
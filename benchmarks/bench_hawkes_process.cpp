@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "../include/HawkesProcess.h"
+
+/**
+    Event generation rate of the Hawkes process, drawn in batches of 1024 into a reused buffer. One set of parameters shares its decay
+    across the marks (one exp per thinning step), the other gives each mark its own decay (one exp per mark and step). Both run at a
+    branching ratio around 0.6, so candidates do get thinned out.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const std::size_t NUM_EVENTS = 10000000;
+    const std::size_t BATCH_SIZE = 1024;
+    const int NUM_REPEATS = 3;
+
+    struct Result {
+        double seconds;
+        std::size_t num_candidates;
+        double checksum;
+    };
+
+    Result run(const HawkesProcess::Parameters& parameters) {
+        HawkesProcess process(parameters);
+        std::vector<HawkesProcess::Event> events(BATCH_SIZE);
+        double checksum = 0;
+
+        auto start = Clock::now();
+        for (std::size_t generated = 0; generated < NUM_EVENTS; generated += BATCH_SIZE) {
+            process.generate(events.data(), BATCH_SIZE);
+            checksum += events[BATCH_SIZE - 1].timestampUs + events[BATCH_SIZE - 1].mark;
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        return {seconds, process.get_num_candidates(), checksum};
+    }
+
+    void report(const char* name, const HawkesProcess::Parameters& parameters) {
+        Result best = {1e300, 0, 0};
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            Result result = run(parameters);
+            if (result.seconds < best.seconds) {
+                best = result;
+            }
+        }
+
+        std::size_t num_events = (NUM_EVENTS + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+        std::cout << "  " << name << ": " << best.seconds * 1e9 / num_events << " ns/event, " << (num_events / best.seconds) / 1e6 << " M events/s, "
+                  << 100.0 * num_events / best.num_candidates << "% of candidates accepted (checksum " << best.checksum << ")" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "Hawkes process benchmark, " << NUM_EVENTS << " events, " << (int)HawkesProcess::NUM_MARKS << " marks, best of " << NUM_REPEATS << std::endl;
+
+    HawkesProcess::Parameters shared_decay = HawkesProcess::Parameters::uniform(20000, 150, 40, 500);
+    report("shared decay", shared_decay);
+
+    HawkesProcess::Parameters own_decays = shared_decay;
+    own_decays.decayPerSecond = {400, 400, 500, 500, 700, 700};
+    report("decay per mark", own_decays);
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/OrderBook.h"
+
+/**
+    Matching throughput with a growing share of iceberg orders. The same flow of passive adds around the mid and marketable IOCs
+    is replayed with 0%, 50% and 90% of the adds sent as icebergs (display 10 of 50). IOCs take slightly more than the adds bring in,
+    so the book stays shallow and the IOCs keep consuming slices that replenish and requeue inside the matching loop.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_COMMANDS = 1000000;
+    const int NUM_REPEATS = 3;
+    const long long MID_PRICE = 100000;
+    const int ICEBERG_QUANTITY = 50;
+    const int ICEBERG_DISPLAY = 10;
+
+    std::vector<OrderCommand> build_flow(int iceberg_percent) {
+        std::mt19937 rng(17);
+        std::vector<OrderCommand> flow;
+        flow.reserve(NUM_COMMANDS);
+
+        for (int i = 0; i < NUM_COMMANDS; i++) {
+            bool is_buy = rng() % 2 == 0;
+            int kind = (int)(rng() % 100);
+            int share_roll = (int)(rng() % 100);
+
+            if (kind < 70) {
+                long long price = is_buy ? MID_PRICE - 1 - (long long)(rng() % 20) : MID_PRICE + 1 + (long long)(rng() % 20);
+                if (share_roll < iceberg_percent) {
+                    flow.emplace_back(OrderCommand::Type::ADD_ICEBERG, i, -1, is_buy, price, ICEBERG_QUANTITY, ICEBERG_DISPLAY);
+                }
+                else {
+                    flow.emplace_back(OrderCommand::Type::ADD_LIMIT, i, -1, is_buy, price, ICEBERG_QUANTITY);
+                }
+            }
+            else {
+                flow.emplace_back(OrderCommand::Type::ADD_IOC, i, -1, is_buy, -1, 50 + (int)(rng() % 150));
+            }
+        }
+
+        return flow;
+    }
+
+    double time_flow(const std::vector<OrderCommand>& flow, std::size_t& num_trades) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+
+        auto start = Clock::now();
+        for (const OrderCommand& command : flow) {
+            orderbook.apply(command);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        num_trades = orderbook.get_trade_log().get_trades().size();
+        return seconds;
+    }
+}
+
+int main() {
+    std::cout << "Iceberg matching benchmark, " << NUM_COMMANDS << " commands (70% passive adds, 30% IOCs), best of " << NUM_REPEATS << std::endl;
+
+    for (int iceberg_percent : {0, 50, 90}) {
+        std::vector<OrderCommand> flow = build_flow(iceberg_percent);
+        double best_seconds = 1e300;
+        std::size_t num_trades = 0;
+
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            best_seconds = std::min(best_seconds, time_flow(flow, num_trades));
+        }
+
+        std::cout << "  " << iceberg_percent << "% icebergs: " << (best_seconds * 1e9 / NUM_COMMANDS) << " ns/command, "
+                  << (NUM_COMMANDS / best_seconds) / 1e6 << " M commands/s, " << num_trades << " trades" << std::endl;
+    }
+}
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/LatencyQueue.h"
+
+/**
+    Dispatch of typed latency events against std::function callbacks. The same mix of event types is dispatched straight from a vector,
+    once through the compile-time visitor and once through type-erased callbacks doing the same work, then the full schedule and
+    process round trip through the LatencyQueue is timed both ways, and once more under the SESSION latency model with congestion. Last, heavy requoting: every new requote retracts the one still
+    in flight through its handle, and the heap is expected to stay as small as what is pending.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_EVENTS = 1000000;
+    const int NUM_REPEATS = 5;
+
+    struct Totals {
+        long long sent = 0;
+        long long cancelled = 0;
+        long long modified = 0;
+        long long filled = 0;
+        long long market = 0;
+    };
+
+    struct TotalsVisitor {
+        Totals& totals;
+
+        void operator()(const LatencyQueue::OrderSend& order, long long) { totals.sent += order.quantity; }
+        void operator()(const LatencyQueue::Cancel& cancel, long long) { totals.cancelled += cancel.orderId; }
+        void operator()(const LatencyQueue::Modify& modify, long long) { totals.modified += modify.newQuantity; }
+        void operator()(const LatencyQueue::AcknowledgeFill& fill, long long) { totals.filled += fill.quantity; }
+        void operator()(const LatencyQueue::MarketUpdate& update, long long) { totals.market += update.marketPriceTicks; }
+        void operator()(const LatencyQueue::Callback&, long long) {}
+    };
+
+    LatencyQueue::Payload make_payload(int i, std::mt19937& rng) {
+        switch (rng() % 5) {
+            case 0: return LatencyQueue::OrderSend{true, false, i % 100, 10000};
+            case 1: return LatencyQueue::Cancel{i};
+            case 2: return LatencyQueue::Modify{i, i % 10};
+            case 3: return LatencyQueue::AcknowledgeFill{false, true, false, i % 50, i, 10001};
+            default: return LatencyQueue::MarketUpdate{10000 + i % 20};
+        }
+    }
+
+    // The callback doing the work the visitor does for the same payload
+    std::function<void(long long)> make_callback(const LatencyQueue::Payload& payload, Totals& totals) {
+        return [payload, &totals](long long exec_time) { std::visit([&totals, exec_time](const auto& p) { TotalsVisitor{totals}(p, exec_time); }, payload); };
+    }
+
+    double seconds_since(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main() {
+    std::mt19937 rng(7);
+    std::vector<LatencyQueue::Payload> payloads;
+    payloads.reserve(NUM_EVENTS);
+    for (int i = 0; i < NUM_EVENTS; i++) {
+        payloads.push_back(make_payload(i, rng));
+    }
+
+    Totals visited_totals, called_totals;
+    std::vector<std::function<void(long long)>> callbacks;
+    callbacks.reserve(NUM_EVENTS);
+    for (const LatencyQueue::Payload& payload : payloads) {
+        callbacks.push_back(make_callback(payload, called_totals));
+    }
+
+    std::cout << "Latency dispatch benchmark, " << NUM_EVENTS << " events, best of " << NUM_REPEATS << std::endl;
+
+    double best_visit = 1e300, best_call = 1e300, best_queue_typed = 1e300, best_queue_callbacks = 1e300, best_queue_session = 1e300;
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        TotalsVisitor visitor{visited_totals};
+        auto start = Clock::now();
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            std::visit([&visitor, i](const auto& payload) { visitor(payload, i); }, payloads[i]);
+        }
+        best_visit = std::min(best_visit, seconds_since(start));
+
+        start = Clock::now();
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            callbacks[i](i);
+        }
+        best_call = std::min(best_call, seconds_since(start));
+
+        LatencyQueue typed_queue;
+        start = Clock::now();
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            typed_queue.schedule_event(i, payloads[i]);
+        }
+        typed_queue.process_until(NUM_EVENTS + 1000, visitor);
+        best_queue_typed = std::min(best_queue_typed, seconds_since(start));
+
+        LatencyQueue session_queue;
+        session_queue.set_latency_model(LatencyQueue::LatencyModel::SESSION);
+        session_queue.set_session_congestion(500, 200, 1000);
+        start = Clock::now();
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            session_queue.schedule_event(i, payloads[i]);
+        }
+        Totals session_totals;
+        session_queue.process_until(1LL << 40, TotalsVisitor{session_totals});
+        best_queue_session = std::min(best_queue_session, seconds_since(start));
+
+        LatencyQueue callback_queue;
+        start = Clock::now();
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            callback_queue.schedule_event(i, LatencyQueue::type_of(payloads[i]), make_callback(payloads[i], called_totals));
+        }
+        callback_queue.process_until(NUM_EVENTS + 1000);
+        best_queue_callbacks = std::min(best_queue_callbacks, seconds_since(start));
+    }
+
+    double best_requote = 1e300;
+    std::size_t max_heap_size = 0;
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        LatencyQueue requote_queue;
+        TotalsVisitor visitor{visited_totals};
+        LatencyQueue::EventHandle in_flight;
+        auto start = Clock::now();
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            requote_queue.cancel_event(in_flight);
+            in_flight = requote_queue.schedule_event(i, LatencyQueue::Cancel{-1});
+            max_heap_size = std::max(max_heap_size, requote_queue.get_heap_size());
+        }
+        requote_queue.process_until(NUM_EVENTS + 1000, visitor);
+        best_requote = std::min(best_requote, seconds_since(start));
+    }
+
+    if (visited_totals.sent != called_totals.sent || visited_totals.market != called_totals.market) {
+        std::cout << "Visitor and callbacks did different work!" << std::endl;
+        return 1;
+    }
+
+    std::cout << "  dispatch, visitor:           " << best_visit * 1e9 / NUM_EVENTS << " ns/event" << std::endl;
+    std::cout << "  dispatch, std::function:     " << best_call * 1e9 / NUM_EVENTS << " ns/event" << std::endl;
+    std::cout << "  schedule + fire, typed:      " << best_queue_typed * 1e9 / NUM_EVENTS << " ns/event" << std::endl;
+    std::cout << "  schedule + fire, session:    " << best_queue_session * 1e9 / NUM_EVENTS << " ns/event" << std::endl;
+    std::cout << "  schedule + fire, callbacks:  " << best_queue_callbacks * 1e9 / NUM_EVENTS << " ns/event" << std::endl;
+    std::cout << "  requote + retract:           " << best_requote * 1e9 / NUM_EVENTS << " ns/requote, heap never above " << max_heap_size << std::endl;
+}
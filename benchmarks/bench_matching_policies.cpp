@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/OrderBook.h"
+
+/**
+    Matching cost of each allocation rule. The same flow of passive adds around the mid and marketable IOCs is replayed on a FIFO,
+    a PRO_RATA and a FIFO_PRO_RATA book. The FIFO book runs the plain price-time loop, the other two pay for one gather,
+    allocation and fill pass over every level they take from, and print more (smaller) trades since every order of a level gets a share.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_COMMANDS = 1000000;
+    const int NUM_REPEATS = 5;
+    const long long MID_PRICE = 100000;
+
+    std::vector<OrderCommand> build_flow() {
+        std::mt19937 rng(17);
+        std::vector<OrderCommand> flow;
+        flow.reserve(NUM_COMMANDS);
+
+        for (int i = 0; i < NUM_COMMANDS; i++) {
+            bool is_buy = rng() % 2 == 0;
+            int kind = (int)(rng() % 100);
+
+            if (kind < 70) {
+                long long price = is_buy ? MID_PRICE - 1 - (long long)(rng() % 20) : MID_PRICE + 1 + (long long)(rng() % 20);
+                flow.emplace_back(OrderCommand::Type::ADD_LIMIT, i, -1, is_buy, price, 1 + (int)(rng() % 50));
+            }
+            else {
+                flow.emplace_back(OrderCommand::Type::ADD_IOC, i, -1, is_buy, -1, 20 + (int)(rng() % 60));
+            }
+        }
+
+        return flow;
+    }
+
+    double time_flow(const std::vector<OrderCommand>& flow, OrderBook::MatchingAlgorithm algorithm, std::size_t& num_trades) {
+        Metrics metrics;
+        OrderBook orderbook(metrics, algorithm);
+
+        auto start = Clock::now();
+        for (const OrderCommand& command : flow) {
+            orderbook.apply(command);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        num_trades = orderbook.get_trade_log().get_trades().size();
+        return seconds;
+    }
+}
+
+int main() {
+    std::cout << "Matching policies benchmark, " << NUM_COMMANDS << " commands (70% passive adds, 30% IOCs), best of " << NUM_REPEATS << std::endl;
+
+    std::vector<OrderCommand> flow = build_flow();
+
+    const char* names[] = {"FIFO:                        ", "pro-rata:                    ", "FIFO + pro-rata (hybrid):    "};
+    OrderBook::MatchingAlgorithm algorithms[] = {OrderBook::MatchingAlgorithm::FIFO, OrderBook::MatchingAlgorithm::PRO_RATA,
+                                                 OrderBook::MatchingAlgorithm::FIFO_PRO_RATA};
+
+    // Alternating runs so drift on a noisy machine hits every variant alike
+    double best_seconds[3] = {1e300, 1e300, 1e300};
+    std::size_t num_trades[3] = {0, 0, 0};
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        for (int v = 0; v < 3; v++) {
+            best_seconds[v] = std::min(best_seconds[v], time_flow(flow, algorithms[v], num_trades[v]));
+        }
+    }
+
+    for (int v = 0; v < 3; v++) {
+        std::cout << "  " << names[v] << (best_seconds[v] * 1e9 / NUM_COMMANDS) << " ns/command, "
+                  << (NUM_COMMANDS / best_seconds[v]) / 1e6 << " M commands/s, " << num_trades[v] << " trades" << std::endl;
+    }
+}
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/MultiSymbolEngine.h"
+
+/**
+    Throughput of MultiSymbolEngine against the number of shards. The same flow over NUM_SYMBOLS symbols (limit adds around a fixed mid,
+    some of them crossing, and cancels of earlier orders) is queued before the workers start, so the timed part is only the shards
+    draining their inboxes in parallel, up to the barrier.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_SYMBOLS = 16;
+    const int MESSAGES_PER_SYMBOL = 200000;
+
+    OrderCommand make_message(int index) {
+        if (index % 3 == 2) {
+            return OrderCommand(OrderCommand::Type::CANCEL, index, index - 2, false, -1, 0);
+        }
+
+        bool is_buy = index % 2 == 0;
+        long long offset = index % 7 - 1; // a few orders per cycle cross the mid and trade
+        return OrderCommand(OrderCommand::Type::ADD_LIMIT, index, index, is_buy, is_buy ? 10000 - offset : 10000 + offset, 1 + index % 5);
+    }
+
+    double run(int num_shards) {
+        MultiSymbolEngine engine(num_shards);
+        std::vector<int> symbol_ids;
+        for (int i = 0; i < NUM_SYMBOLS; i++) {
+            symbol_ids.push_back(engine.add_symbol("SYM" + std::to_string(i)));
+        }
+
+        for (int i = 0; i < MESSAGES_PER_SYMBOL; i++) {
+            OrderCommand message = make_message(i);
+            for (int symbol_id : symbol_ids) {
+                engine.post(symbol_id, message);
+            }
+        }
+
+        auto start = Clock::now();
+        engine.start();
+        engine.synchronize(MESSAGES_PER_SYMBOL);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        engine.stop();
+
+        return (double)NUM_SYMBOLS * MESSAGES_PER_SYMBOL / seconds;
+    }
+}
+
+int main() {
+    int num_cores = std::max(1, (int)std::thread::hardware_concurrency());
+    std::cout << "Multi symbol engine benchmark, " << NUM_SYMBOLS << " symbols x " << MESSAGES_PER_SYMBOL << " messages, "
+              << num_cores << " hardware threads" << std::endl;
+
+    double single_shard_rate = 0;
+    for (int num_shards = 1; num_shards <= NUM_SYMBOLS; num_shards *= 2) {
+        double rate = run(num_shards);
+        if (num_shards == 1) {
+            single_shard_rate = rate;
+        }
+
+        std::cout << "  " << num_shards << " shard(s): " << rate / 1e6 << " M messages/s, x" << rate / single_shard_rate << std::endl;
+    }
+
+    if (num_cores < NUM_SYMBOLS) {
+        std::cout << "Note: shard counts above " << num_cores << " share cores and cannot scale further." << std::endl;
+    }
+}
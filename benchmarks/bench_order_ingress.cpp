@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../include/OrderIngress.h"
+
+/**
+    Two-thread benchmark of the SPSC order ingress: a producer thread submits limit orders and cancels every order that rests,
+    the matching thread owns the book and drains the rings. Reports throughput and submit-to-result round trip latency,
+    next to the same flow applied with direct calls on one thread.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_ORDERS = 500000;
+
+    OrderCommand make_add(int index) {
+        return OrderCommand(OrderCommand::Type::ADD_LIMIT, index, index, index % 2 == 0, index % 2 == 0 ? 9990 - (index % 20) : 10010 + (index % 20), 1 + index % 5);
+    }
+
+    void run_direct_baseline() {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+
+        auto start = Clock::now();
+        for (int i = 0; i < NUM_ORDERS; i++) {
+            OrderResult result = orderbook.apply(make_add(i));
+            orderbook.apply(OrderCommand(OrderCommand::Type::CANCEL, i, result.orderId, false, -1, 0));
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << "Direct calls (1 thread):  " << (2.0 * NUM_ORDERS / seconds) / 1e6 << " M commands/s" << std::endl;
+    }
+
+    void run_ingress() {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        auto ingress = std::make_unique<OrderIngress>();
+
+        std::vector<Clock::time_point> sent_at(NUM_ORDERS);
+        std::vector<long long> round_trip_ns;
+        round_trip_ns.reserve(NUM_ORDERS);
+        std::atomic<bool> producer_done(false);
+
+        auto start = Clock::now();
+
+        std::thread producer([&]() {
+            int submitted = 0;
+            int results_seen = 0;
+            OrderResult result;
+
+            while (results_seen < 2 * NUM_ORDERS) {
+                bool did_work = false;
+
+                if (submitted < NUM_ORDERS) {
+                    sent_at[submitted] = Clock::now();
+                    if (ingress->submit(make_add(submitted))) {
+                        submitted++;
+                        did_work = true;
+                    }
+                }
+
+                while (ingress->poll_result(result)) {
+                    did_work = true;
+                    results_seen++;
+
+                    if (result.status == OrderResult::Status::RESTING) {
+                        round_trip_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sent_at[result.clientOrderId]).count());
+                        while (!ingress->submit(OrderCommand(OrderCommand::Type::CANCEL, 0, result.orderId, false, -1, 0))) {}
+                    }
+                }
+
+                if (!did_work) {
+                    std::this_thread::yield();
+                }
+            }
+            producer_done = true;
+        });
+
+        while (!producer_done) {
+            if (ingress->process(orderbook) == 0) {
+                std::this_thread::yield();
+            }
+        }
+        producer.join();
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::sort(round_trip_ns.begin(), round_trip_ns.end());
+
+        std::cout << "SPSC ingress (2 threads): " << (2.0 * NUM_ORDERS / seconds) / 1e6 << " M commands/s" << std::endl;
+        if (!round_trip_ns.empty()) {
+            std::cout << "  submit -> result round trip: p50 " << round_trip_ns[round_trip_ns.size() / 2] << " ns, p99 "
+                      << round_trip_ns[round_trip_ns.size() * 99 / 100] << " ns, max " << round_trip_ns.back() << " ns" << std::endl;
+        }
+    }
+}
+
+int main() {
+    std::cout << "Order ingress benchmark, " << NUM_ORDERS << " adds + " << NUM_ORDERS << " cancels" << std::endl;
+
+    run_direct_baseline();
+    run_ingress();
+
+    if (std::thread::hardware_concurrency() < 2) {
+        std::cout << "Note: fewer than 2 hardware threads, producer and matching thread share a core." << std::endl;
+    }
+}
\ No newline at end of file
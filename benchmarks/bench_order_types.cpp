@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/OrderBook.h"
+
+/**
+    Cost of the conditional order types next to the plain limit path. The same flow of passive adds around the mid and marketable orders
+    is replayed as plain limits and IOCs, then with the adds sent post-only (one touch compare each) and the marketable orders sent as FOKs
+    (liquidity pre-check, a share of them killed), and finally as plain limits again while all-or-none orders wait far from the touch,
+    which only costs the release check at the end of each operation. The first and last lines show the plain path is unchanged.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_COMMANDS = 1000000;
+    const int NUM_REPEATS = 5;
+    const long long MID_PRICE = 100000;
+    const int NUM_WAITING_AON = 1000;
+
+    enum class Variant { PLAIN, POST_ONLY_AND_FOK, PLAIN_WITH_WAITING_AON };
+
+    std::vector<OrderCommand> build_flow(Variant variant) {
+        std::mt19937 rng(17);
+        std::vector<OrderCommand> flow;
+        flow.reserve(NUM_COMMANDS);
+
+        for (int i = 0; i < NUM_COMMANDS; i++) {
+            bool is_buy = rng() % 2 == 0;
+            int kind = (int)(rng() % 100);
+
+            if (kind < 70) {
+                long long price = is_buy ? MID_PRICE - 1 - (long long)(rng() % 20) : MID_PRICE + 1 + (long long)(rng() % 20);
+                OrderCommand::Type type = variant == Variant::POST_ONLY_AND_FOK ? OrderCommand::Type::ADD_POST_ONLY : OrderCommand::Type::ADD_LIMIT;
+                flow.emplace_back(type, i, -1, is_buy, price, 1 + (int)(rng() % 50));
+            }
+            else {
+                int quantity = 20 + (int)(rng() % 60);
+                if (variant == Variant::POST_ONLY_AND_FOK) {
+                    flow.emplace_back(OrderCommand::Type::ADD_FOK, i, -1, is_buy, is_buy ? MID_PRICE + 5 : MID_PRICE - 5, quantity);
+                }
+                else {
+                    flow.emplace_back(OrderCommand::Type::ADD_IOC, i, -1, is_buy, -1, quantity);
+                }
+            }
+        }
+
+        return flow;
+    }
+
+    double time_flow(const std::vector<OrderCommand>& flow, bool with_waiting_aon, std::size_t& num_trades) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+
+        if (with_waiting_aon) {
+            for (int i = 0; i < NUM_WAITING_AON; i++) {
+                orderbook.add_AON_order(i % 2 == 0, i % 2 == 0 ? MID_PRICE - 500 - i : MID_PRICE + 500 + i, 1000, 0);
+            }
+        }
+
+        auto start = Clock::now();
+        for (const OrderCommand& command : flow) {
+            orderbook.apply(command);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        num_trades = orderbook.get_trade_log().get_trades().size();
+        return seconds;
+    }
+}
+
+int main() {
+    std::cout << "Order types benchmark, " << NUM_COMMANDS << " commands (70% passive adds, 30% marketable), best of " << NUM_REPEATS << std::endl;
+
+    const char* names[] = {"plain limit + IOC:          ", "post-only + FOK:            ", "plain, 1000 AON waiting:    "};
+    Variant variants[] = {Variant::PLAIN, Variant::POST_ONLY_AND_FOK, Variant::PLAIN_WITH_WAITING_AON};
+    std::vector<std::vector<OrderCommand>> flows;
+    for (Variant variant : variants) {
+        flows.push_back(build_flow(variant));
+    }
+
+    // Alternating runs so drift on a noisy machine hits every variant alike
+    double best_seconds[3] = {1e300, 1e300, 1e300};
+    std::size_t num_trades[3] = {0, 0, 0};
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        for (int v = 0; v < 3; v++) {
+            best_seconds[v] = std::min(best_seconds[v], time_flow(flows[v], variants[v] == Variant::PLAIN_WITH_WAITING_AON, num_trades[v]));
+        }
+    }
+
+    for (int v = 0; v < 3; v++) {
+        std::cout << "  " << names[v] << (best_seconds[v] * 1e9 / NUM_COMMANDS) << " ns/command, "
+                  << (NUM_COMMANDS / best_seconds[v]) / 1e6 << " M commands/s, " << num_trades[v] << " trades" << std::endl;
+    }
+}
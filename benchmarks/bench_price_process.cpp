@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "../include/PriceProcess.h"
+
+/**
+    Steps per second of each price process, generated one step per call (what a per-update scalar implementation pays) and in blocks
+    of 256 (what MarketEngine asks for). The scalar GBM line is the textbook loop the blocks replace: std::normal_distribution and one
+    exp per step, interleaved.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const std::size_t NUM_STEPS = 10000000;
+    const std::size_t BLOCK_SIZES[] = {1, 256};
+    const int NUM_REPEATS = 3;
+
+    std::unique_ptr<PriceProcess> make_process(int kind) {
+        switch (kind) {
+            case 0: return std::make_unique<GbmProcess>(100000, 0, 1e-4);
+            case 1: return std::make_unique<OrnsteinUhlenbeckProcess>(100000, 100000, 0.01, 5.0);
+            case 2: return std::make_unique<GarchProcess>(100000, 1e-9, 0.1, 0.85);
+            default: return std::make_unique<JumpDiffusionProcess>(100000, 0, 1e-4, 0.001, 0, 0.002);
+        }
+    }
+
+    double run(int kind, std::size_t block_size, double& checksum) {
+        std::unique_ptr<PriceProcess> process = make_process(kind);
+        std::vector<double> prices(block_size), volatilities(block_size);
+
+        auto start = Clock::now();
+        for (std::size_t generated = 0; generated < NUM_STEPS; generated += block_size) {
+            process->generate(prices.data(), volatilities.data(), block_size);
+            checksum += prices[block_size - 1] + volatilities[block_size - 1];
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    double run_scalar_gbm(double& checksum) {
+        std::mt19937_64 rand_engine(17);
+        std::normal_distribution<double> normal(0, 1);
+        const double sigma = 1e-4, log_drift = -0.5 * sigma * sigma;
+        double price = 100000;
+
+        auto start = Clock::now();
+        for (std::size_t i = 0; i < NUM_STEPS; i++) {
+            price *= std::exp(log_drift + sigma * normal(rand_engine));
+            checksum += price;
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void report(const char* name, double seconds, double checksum) {
+        std::cout << "  " << name << ": " << seconds * 1e9 / NUM_STEPS << " ns/step, " << (NUM_STEPS / seconds) / 1e6 << " M steps/s (checksum " << checksum << ")" << std::endl;
+    }
+}
+
+int main() {
+    std::cout << "Price process benchmark, " << NUM_STEPS << " steps, best of " << NUM_REPEATS << std::endl;
+
+    double best = 1e300, checksum = 0;
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        best = std::min(best, run_scalar_gbm(checksum));
+    }
+    report("scalar GBM, std::normal_distribution", best, checksum);
+
+    const char* names[] = {"GBM", "Ornstein-Uhlenbeck", "GARCH(1,1)", "jump-diffusion"};
+    for (int kind = 0; kind < 4; kind++) {
+        for (std::size_t block_size : BLOCK_SIZES) {
+            best = 1e300;
+            checksum = 0;
+            for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+                best = std::min(best, run(kind, block_size, checksum));
+            }
+            std::string name = std::string(names[kind]) + ", blocks of " + std::to_string(block_size);
+            report(name.c_str(), best, checksum);
+        }
+    }
+}
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/QueuePositionModel.h"
+
+/**
+    Cost of the queue position model per book event. Our orders rest on the 10 best levels of each side around a mid that stays put,
+    and a flow of trades at the touch, trade-throughs and cancels runs against them. Filled orders are replaced straight away to keep the
+    number of tracked orders constant. The cost per event should grow with the tracked orders at the event's level only, so it is
+    reported both per event and per tracked order visited.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_EVENTS = 1000000;
+    const int NUM_REPEATS = 3;
+    const int NUM_LEVELS = 10;
+    const long long MID_PRICE = 100000;
+
+    struct Event {
+        int kind; // 0 trade, 1 cancel
+        bool isBuy;
+        long long priceTick;
+        int quantity;
+    };
+
+    std::vector<Event> make_events() {
+        std::mt19937 rng(17);
+        std::vector<Event> events;
+        events.reserve(NUM_EVENTS);
+
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            bool is_buy = rng() % 2 == 0;
+            long long depth = (long long)(rng() % NUM_LEVELS);
+            long long price = is_buy ? MID_PRICE - 1 - depth : MID_PRICE + 1 + depth;
+            // 60% trades, mostly at the touch, 40% cancels anywhere on the book
+            if (rng() % 10 < 6) {
+                price = is_buy ? MID_PRICE - 1 - (rng() % 20 == 0) : MID_PRICE + 1 + (rng() % 20 == 0);
+                events.push_back({0, is_buy, price, 1 + (int)(rng() % 200)});
+            }
+            else {
+                events.push_back({1, is_buy, price, 1 + (int)(rng() % 100)});
+            }
+        }
+        return events;
+    }
+
+    struct Result {
+        double seconds;
+        long long visits;
+        long long fills;
+    };
+
+    Result run(const std::vector<Event>& events, int num_tracked) {
+        std::mt19937 rng(29);
+        long long next_id = 0;
+        long long fills = 0;
+        std::vector<std::pair<bool, long long>> refills;
+        QueuePositionModel model([&](long long, bool isBuy, long long priceTick, int) {
+            fills++;
+            refills.push_back({isBuy, priceTick});
+        });
+
+        auto track_one = [&](bool is_buy, long long price) {
+            model.track(next_id++, is_buy, price, 1 + (int)(rng() % 100), 1000 + (long long)(rng() % 4000));
+        };
+        for (int i = 0; i < num_tracked; i++) {
+            bool is_buy = i % 2 == 0;
+            long long depth = (i / 2) % NUM_LEVELS;
+            track_one(is_buy, is_buy ? MID_PRICE - 1 - depth : MID_PRICE + 1 + depth);
+        }
+
+        auto start = Clock::now();
+        for (const Event& event : events) {
+            if (event.kind == 0) {
+                model.on_trade(event.isBuy, event.priceTick, event.quantity);
+            }
+            else {
+                model.on_cancel(event.isBuy, event.priceTick, event.quantity, 5000);
+            }
+            // Fully filled orders left the model, as many new ones join where the fills were
+            for (std::size_t i = 0; model.size() < (std::size_t)num_tracked; i++) {
+                track_one(refills[i].first, refills[i].second);
+            }
+            refills.clear();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // Tracked orders visited per event: the ones at the event's level, plus the traded through ones
+        long long per_level = num_tracked / (2 * NUM_LEVELS);
+        return {seconds, (long long)NUM_EVENTS * per_level, fills};
+    }
+}
+
+int main() {
+    std::vector<Event> events = make_events();
+    std::cout << "Queue position benchmark, " << NUM_EVENTS << " book events, best of " << NUM_REPEATS << std::endl;
+
+    for (int num_tracked : {100, 1000, 10000}) {
+        Result best = {1e300, 0, 0};
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            Result result = run(events, num_tracked);
+            if (result.seconds < best.seconds) {
+                best = result;
+            }
+        }
+
+        std::cout << "  " << num_tracked << " tracked orders: " << best.seconds * 1e9 / NUM_EVENTS << " ns/event, "
+                  << best.seconds * 1e9 / best.visits << " ns per tracked order at the level, " << best.fills << " fills" << std::endl;
+    }
+}
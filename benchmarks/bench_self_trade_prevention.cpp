@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "../include/OrderBook.h"
+
+/**
+    Matching cost of self-trade prevention. The same flow of passive adds around the mid and marketable IOCs is replayed with prevention off,
+    with it on but no order carrying an owner, and with it on while the flow is spread over 4 owners (about a quarter of the matches
+    then hit an own order and are decremented instead of traded). Prevention adds one compare per matched order, the first two lines
+    should be indistinguishable.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_COMMANDS = 1000000;
+    const int NUM_REPEATS = 5;
+    const long long MID_PRICE = 100000;
+    const int NUM_OWNERS = 4;
+
+    std::vector<OrderCommand> build_flow(bool with_owners) {
+        std::mt19937 rng(17);
+        std::vector<OrderCommand> flow;
+        flow.reserve(NUM_COMMANDS);
+
+        for (int i = 0; i < NUM_COMMANDS; i++) {
+            bool is_buy = rng() % 2 == 0;
+            int kind = (int)(rng() % 100);
+
+            if (kind < 70) {
+                long long price = is_buy ? MID_PRICE - 1 - (long long)(rng() % 20) : MID_PRICE + 1 + (long long)(rng() % 20);
+                flow.emplace_back(OrderCommand::Type::ADD_LIMIT, i, -1, is_buy, price, 1 + (int)(rng() % 50));
+            }
+            else {
+                flow.emplace_back(OrderCommand::Type::ADD_IOC, i, -1, is_buy, -1, 20 + (int)(rng() % 60));
+            }
+
+            if (with_owners) {
+                flow.back().ownerId = 1 + i % NUM_OWNERS;
+            }
+        }
+
+        return flow;
+    }
+
+    double time_flow(const std::vector<OrderCommand>& flow, OrderBook::SelfTradePrevention mode, std::size_t& num_trades) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        orderbook.set_self_trade_prevention(mode);
+
+        auto start = Clock::now();
+        for (const OrderCommand& command : flow) {
+            orderbook.apply(command);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        num_trades = orderbook.get_trade_log().get_trades().size();
+        return seconds;
+    }
+}
+
+int main() {
+    std::cout << "Self-trade prevention benchmark, " << NUM_COMMANDS << " commands (70% passive adds, 30% IOCs), best of " << NUM_REPEATS << std::endl;
+
+    std::vector<OrderCommand> anonymous_flow = build_flow(false);
+    std::vector<OrderCommand> owned_flow = build_flow(true);
+
+    const char* names[] = {"prevention off:              ", "on, no owners:               ", "on (decrement), 4 owners:    "};
+    const std::vector<OrderCommand>* flows[] = {&anonymous_flow, &anonymous_flow, &owned_flow};
+    OrderBook::SelfTradePrevention modes[] = {OrderBook::SelfTradePrevention::NONE, OrderBook::SelfTradePrevention::CANCEL_OLDEST,
+                                              OrderBook::SelfTradePrevention::DECREMENT};
+
+    // Alternating runs so drift on a noisy machine hits every variant alike
+    double best_seconds[3] = {1e300, 1e300, 1e300};
+    std::size_t num_trades[3] = {0, 0, 0};
+    for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+        for (int v = 0; v < 3; v++) {
+            best_seconds[v] = std::min(best_seconds[v], time_flow(*flows[v], modes[v], num_trades[v]));
+        }
+    }
+
+    for (int v = 0; v < 3; v++) {
+        std::cout << "  " << names[v] << (best_seconds[v] * 1e9 / NUM_COMMANDS) << " ns/command, "
+                  << (NUM_COMMANDS / best_seconds[v]) / 1e6 << " M commands/s, " << num_trades[v] << " trades" << std::endl;
+    }
+}
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../include/SimulationEngine.h"
+
+/**
+    What-if branching against re-simulating. NUM_VARIANTS strategy variants are evaluated over the last part of a run whose prefix
+    is shared: either every variant simulates the whole run on its own, or the prefix is simulated once and run_branches forks it,
+    on one thread and on every core. Fork cost (save once, restore per branch) is reported on its own.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_VARIANTS = 8;
+    const long long STEP_US = 100;
+    const long long PREFIX_END_US = 2000001;
+    const long long END_US = 2500001;
+
+    std::unique_ptr<SimulationEngine> make_simulation() {
+        auto simulation = std::make_unique<SimulationEngine>(1, END_US, STEP_US, 5, 1, 50, 1, 1000);
+        MarketEngine& engine = simulation->get_market_engine();
+        engine.set_fill_model(MarketEngine::FillModel::ORDER_BOOK);
+        engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::noise_traders(20000));
+        engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::market_makers(5000));
+        engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::momentum_takers(1000));
+        return simulation;
+    }
+
+    std::vector<SimulationEngine::BranchVariant> make_variants() {
+        std::vector<SimulationEngine::BranchVariant> variants;
+        for (int i = 0; i < NUM_VARIANTS; i++) {
+            variants.push_back([i](SimulationEngine& branch) { branch.get_market_engine().get_strategy().set_tick_offset_from_mid(1 + i % 4); });
+        }
+        return variants;
+    }
+
+    double seconds_since(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+}
+
+int main() {
+    std::vector<SimulationEngine::BranchVariant> variants = make_variants();
+    std::cout << "Simulation branches benchmark, " << NUM_VARIANTS << " variants over the last " << (END_US - PREFIX_END_US) / 1000
+              << " ms of a " << END_US / 1000 << " ms run" << std::endl;
+
+    auto start = Clock::now();
+    for (const SimulationEngine::BranchVariant& variant : variants) {
+        std::unique_ptr<SimulationEngine> simulation = make_simulation();
+        simulation->run_until(PREFIX_END_US);
+        variant(*simulation);
+        simulation->run_until(END_US);
+    }
+    double resimulated = seconds_since(start);
+
+    start = Clock::now();
+    std::unique_ptr<SimulationEngine> simulation = make_simulation();
+    simulation->run_until(PREFIX_END_US);
+    double prefix = seconds_since(start);
+
+    start = Clock::now();
+    std::unique_ptr<SimulationEngine> fork = simulation->fork();
+    double fork_seconds = seconds_since(start);
+
+    start = Clock::now();
+    simulation->run_branches(variants, END_US, 1);
+    double one_thread = seconds_since(start);
+
+    int num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    start = Clock::now();
+    simulation->run_branches(variants, END_US, num_threads);
+    double all_threads = seconds_since(start);
+
+    std::cout << "  " << simulation->get_market_engine().get_orderbook().get_order_lookup().size() << " resting orders at the fork, fork: "
+              << fork_seconds * 1e3 << " ms" << std::endl;
+    std::cout << "  re-simulating every variant:      " << resimulated * 1e3 << " ms" << std::endl;
+    std::cout << "  prefix once + branches, 1 thread:  " << (prefix + one_thread) * 1e3 << " ms" << std::endl;
+    std::cout << "  prefix once + branches, " << num_threads << " threads: " << (prefix + all_threads) * 1e3 << " ms" << std::endl;
+}
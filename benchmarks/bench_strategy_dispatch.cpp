@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../include/MarketEngine.h"
+
+/**
+    Cost of calling strategy hooks. The same hook sequence (market update and timer every step, a fill every eighth) is driven into a
+    plain class called directly, as the engine called its strategy before the framework, into a StrategyBase strategy the way
+    BasicMarketEngine<StrategyT> calls it, and into the same strategy behind DynamicStrategy's virtual interface. The static path is
+    expected to cost what the direct calls cost. Last, whole engine updates with ping pong run statically and through the interface.
+*/
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    const int NUM_STEPS = 10000000;
+    const int NUM_ENGINE_UPDATES = 200000;
+    const int NUM_REPEATS = 5;
+
+    // The hooks' work: folding what they are given into a few counters. Same members as the framework strategy, without the base
+    class DirectCounter {
+        private:
+            Metrics& metrics;
+            OrderBook& order_book;
+            LatencyQueue latency_queue;
+        public:
+            long long price_sum = 0;
+            long long last_timer_us = 0;
+            long long filled_qty = 0;
+
+            DirectCounter(Metrics& metrics, OrderBook& order_book) : metrics(metrics), order_book(order_book), latency_queue() {}
+
+            void on_market_update(long long, long long market_price_ticks) { price_sum += market_price_ticks; }
+            void on_timer(long long timestamp_us) { last_timer_us = timestamp_us; }
+            void on_fill(const Trade& trade) { filled_qty += trade.quantity; }
+    };
+
+    class CountingStrategy : public StrategyBase<CountingStrategy> {
+        public:
+            long long price_sum = 0;
+            long long last_timer_us = 0;
+            long long filled_qty = 0;
+
+            CountingStrategy(Metrics& metrics, OrderBook& order_book) : StrategyBase(metrics, order_book) {}
+
+            void on_market_update(long long, long long market_price_ticks) { price_sum += market_price_ticks; }
+            void on_timer(long long timestamp_us) { last_timer_us = timestamp_us; }
+            void on_fill(const Trade& trade) { filled_qty += trade.quantity; }
+    };
+
+    template<typename StrategyT>
+    void drive(StrategyT& strategy, const std::vector<long long>& prices, const Trade& trade) {
+        for (int i = 0; i < NUM_STEPS; i++) {
+            long long timestamp_us = 100LL * i;
+            strategy.on_market_update(timestamp_us, prices[i]);
+            strategy.on_timer(timestamp_us);
+            if (i % 8 == 0) {
+                strategy.on_fill(trade);
+            }
+        }
+    }
+
+    template<typename StrategyT>
+    double best_seconds_per_step(StrategyT& strategy, const std::vector<long long>& prices, const Trade& trade) {
+        double best = 1e300;
+        for (int repeat = 0; repeat < NUM_REPEATS; repeat++) {
+            auto start = Clock::now();
+            drive(strategy, prices, trade);
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        return best / NUM_STEPS;
+    }
+
+    template<typename EngineT>
+    double seconds_per_update(EngineT& engine) {
+        auto start = Clock::now();
+        for (long long i = 1; i <= NUM_ENGINE_UPDATES; i++) {
+            engine.update(100 * i);
+        }
+        return std::chrono::duration<double>(Clock::now() - start).count() / NUM_ENGINE_UPDATES;
+    }
+}
+
+int main() {
+    std::mt19937 rng(7);
+    std::vector<long long> prices(NUM_STEPS);
+    for (long long& price : prices) {
+        price = 10000 + (long long)(rng() % 21) - 10;
+    }
+    Trade trade(1, 2, 10000, 5, 0, false);
+
+    std::cout << "Strategy dispatch benchmark, " << NUM_STEPS << " steps, best of " << NUM_REPEATS << std::endl;
+
+    Metrics metrics;
+    OrderBook book(metrics);
+    DirectCounter direct(metrics, book);
+    double direct_ns = best_seconds_per_step(direct, prices, trade) * 1e9;
+
+    CountingStrategy counting(metrics, book);
+    double static_ns = best_seconds_per_step(counting, prices, trade) * 1e9;
+
+    DynamicStrategy dynamic(metrics, book, 1, 1, 10, 1, 1);
+    auto adapter = std::make_unique<StrategyAdapter<CountingStrategy>>(metrics, book);
+    CountingStrategy& behind_interface = adapter->get();
+    dynamic.set_strategy(std::move(adapter));
+    double virtual_ns = best_seconds_per_step(dynamic, prices, trade) * 1e9;
+
+    if (direct.price_sum != counting.price_sum || counting.price_sum != behind_interface.price_sum || direct.filled_qty != behind_interface.filled_qty) {
+        std::cout << "Paths did not do the same work!" << std::endl;
+        return 1;
+    }
+
+    std::cout << "  hooks, direct calls:        " << direct_ns << " ns/step" << std::endl;
+    std::cout << "  hooks, static (CRTP):       " << static_ns << " ns/step" << std::endl;
+    std::cout << "  hooks, virtual interface:   " << virtual_ns << " ns/step" << std::endl;
+
+    BasicMarketEngine<PingPongStrategy> static_engine(5, 1, 50, 1, 1000);
+    BasicMarketEngine<DynamicStrategy> dynamic_engine(5, 1, 50, 1, 1000);
+    double static_engine_ns = seconds_per_update(static_engine) * 1e9;
+    double dynamic_engine_ns = seconds_per_update(dynamic_engine) * 1e9;
+    std::cout << "  engine update, ping pong static:   " << static_engine_ns << " ns/update" << std::endl;
+    std::cout << "  engine update, ping pong virtual:  " << dynamic_engine_ns << " ns/update" << std::endl;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Checkpoint.h"
+#include "HawkesProcess.h"
+#include "OrderBook.h"
+#include "OrderCommand.h"
+
+/**
+    Order flow of the rest of the market, sent as real limit, market and cancel orders into an OrderBook so that strategy orders
+    resting there face actual queues. The flow comes from agent populations, each arriving as a Poisson process at its own rate.
+    Arrivals are turned into OrderCommands and applied through OrderBook::apply_batch, up to MAX_BATCH_SIZE at a time; the book
+    state agents decide on (mid, their live orders) is refreshed between batches, not between the commands of one batch.
+    A population can instead take its arrivals, and what each one does, from a HawkesProcess, for flow that comes in clusters.
+*/
+class BackgroundFlow {
+    public:
+        static constexpr std::size_t MAX_BATCH_SIZE = 1024;
+
+        enum class AgentType {
+            NOISE_TRADER,   // limit orders scattered around the reference price, market orders and cancels of its own orders, in random proportions
+            MARKET_MAKER,   // replaces its oldest quotes with a fresh bid and ask around the reference price
+            MOMENTUM_TAKER, // sends a market order in the direction the book mid moved since its previous look, if it moved far enough
+            HAWKES_FLOW     // does what the mark of its Hawkes event says: a market order, a limit around the reference price or a cancel
+        };
+
+        struct AgentPopulation {
+            AgentType type;
+            double arrivalsPerSecond;     // Poisson rate, unused by HAWKES_FLOW
+            int minQuantity;
+            int maxQuantity;
+            long long priceRangeTicks;    // noise traders and Hawkes flow: how far from the reference price limit orders go, market makers: how far behind their half spread
+            long long halfSpreadTicks;    // market makers: distance of the closest quotes from the reference price
+            long long thresholdTicks;     // momentum takers: smallest mid move that makes them trade
+            double marketOrderShare;      // noise traders: share of arrivals that are market orders
+            double cancelShare;           // noise traders: share of arrivals that cancel one of the population's live orders
+            std::size_t maxLiveOrders;    // market makers: quotes kept resting, the oldest pair is cancelled past it
+
+            static AgentPopulation noise_traders(double arrivals_per_second, long long price_range_ticks = 10, double market_order_share = 0.1, double cancel_share = 0.4,
+                                                 int min_quantity = 1, int max_quantity = 100) {
+                return {AgentType::NOISE_TRADER, arrivals_per_second, min_quantity, max_quantity, price_range_ticks, 0, 0, market_order_share, cancel_share, 0};
+            }
+            static AgentPopulation market_makers(double arrivals_per_second, long long half_spread_ticks = 1, long long price_range_ticks = 3, std::size_t max_live_orders = 20,
+                                                 int min_quantity = 50, int max_quantity = 200) {
+                return {AgentType::MARKET_MAKER, arrivals_per_second, min_quantity, max_quantity, price_range_ticks, half_spread_ticks, 0, 0, 0, max_live_orders};
+            }
+            static AgentPopulation momentum_takers(double arrivals_per_second, long long threshold_ticks = 2, int min_quantity = 1, int max_quantity = 50) {
+                return {AgentType::MOMENTUM_TAKER, arrivals_per_second, min_quantity, max_quantity, 0, 0, threshold_ticks, 0, 0, 0};
+            }
+        };
+
+    private:
+        struct PopulationState {
+            AgentPopulation population;
+            double next_arrival_us;
+            std::unique_ptr<HawkesProcess> hawkes; // HAWKES_FLOW only, its next event is next_arrival_us with next_mark
+            HawkesProcess::Mark next_mark;
+            std::vector<long long> live_orders; // ids of the resting orders it sent; filled ones stay until cancelled or pruned
+            std::size_t pending_adds;         // orders of the current batch, their ids are only known once it is applied
+            std::size_t live_after_prune;
+            long long last_seen_mid;          // momentum takers, -1 before their first arrival
+        };
+
+        OrderBook& orderbook;
+        std::mt19937_64 rand_engine;
+        std::vector<PopulationState> populations;
+        long long current_timestamp_us; // -1 until the first advance_to
+
+        std::vector<OrderCommand> batch;
+        std::vector<std::size_t> batch_sources; // index of the population that sent each command of the batch
+        std::vector<OrderResult> batch_results;
+        std::size_t num_commands_sent;
+
+        long long book_mid(long long reference_price) const;
+        void start_arrivals(PopulationState& state, long long timestamp_us);
+        void draw_next_arrival(PopulationState& state);
+        void add_arrival(std::size_t population_index, long long timestamp_us, long long reference_price, long long mid);
+        void add_command(std::size_t population_index, const OrderCommand& command);
+        void add_cancel(std::size_t population_index, long long timestamp_us, std::size_t live_index);
+        int draw_quantity(const AgentPopulation& population);
+        void flush_batch();
+        void prune_filled(PopulationState& state);
+    public:
+        BackgroundFlow(OrderBook& orderbook, unsigned long long seed = 17);
+
+        void add_population(const AgentPopulation& population);
+        void add_hawkes_population(const HawkesProcess::Parameters& parameters, long long price_range_ticks = 10, int min_quantity = 1, int max_quantity = 100);
+        void advance_to(long long timestamp_us, long long reference_price);
+        void clear();
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
+
+        std::size_t get_num_populations() const { return populations.size(); }
+        std::size_t get_num_commands_sent() const { return num_commands_sent; }
+        std::size_t get_num_live_orders(std::size_t population_index) const { return populations[population_index].live_orders.size(); }
+        const std::vector<long long>& get_live_orders(std::size_t population_index) const { return populations[population_index].live_orders; }
+        long long get_current_timestamp_us() const { return current_timestamp_us; }
+};
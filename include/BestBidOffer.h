@@ -0,0 +1,18 @@
+#pragma once
+
+/**
+    Top of the book. An empty side has price and quantity 0.
+*/
+struct BestBidOffer {
+    long long bidPriceTick;
+    long long bidQuantity;
+    long long askPriceTick;
+    long long askQuantity;
+
+    BestBidOffer() : bidPriceTick(0), bidQuantity(0), askPriceTick(0), askQuantity(0) {}
+
+    bool operator==(const BestBidOffer& other) const {
+        return bidPriceTick == other.bidPriceTick && bidQuantity == other.bidQuantity && askPriceTick == other.askPriceTick && askQuantity == other.askQuantity;
+    }
+    bool operator!=(const BestBidOffer& other) const { return !(*this == other); }
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+    Byte buffers behind simulation checkpoints. Every stateful class writes its fields with save_state(CheckpointWriter&) and reads them
+    back, in the same order, with load_state(CheckpointReader&). The whole checkpoint is built in memory and written with a single call.
+    Values keep the machine's representation: a checkpoint is meant to be read back by the build that wrote it.
+*/
+class CheckpointWriter {
+    private:
+        std::vector<char> buffer;
+
+        void append(const void* data, std::size_t num_bytes) {
+            const char* bytes = static_cast<const char*>(data);
+            buffer.insert(buffer.end(), bytes, bytes + num_bytes);
+        }
+    public:
+        CheckpointWriter() : buffer() {}
+
+        template<typename T>
+        void write(const T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are written as bytes.");
+            append(&value, sizeof(T));
+        }
+
+        template<typename T>
+        void write_vector(const std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable<T>::value, "Only vectors of trivially copyable values are written as bytes.");
+            write<std::uint64_t>(values.size());
+            append(values.data(), values.size() * sizeof(T));
+        }
+
+        void write_string(const std::string& value) {
+            write<std::uint64_t>(value.size());
+            append(value.data(), value.size());
+        }
+
+        // Random engines and distributions, through their standard text representation which round-trips their full state
+        template<typename Streamable>
+        void write_streamed(const Streamable& value) {
+            std::ostringstream out;
+            out << value;
+            write_string(out.str());
+        }
+
+        void reserve(std::size_t num_bytes) { buffer.reserve(num_bytes); }
+        void save(const std::string& path) const;
+        const std::vector<char>& get_buffer() const { return buffer; }
+};
+
+class CheckpointReader {
+    private:
+        std::vector<char> buffer;
+        std::size_t position;
+
+        const char* consume(std::size_t num_bytes) {
+            if (num_bytes > buffer.size() - position) {
+                throw std::runtime_error("Checkpoint ended unexpectedly.");
+            }
+            const char* data = buffer.data() + position;
+            position += num_bytes;
+            return data;
+        }
+    public:
+        CheckpointReader(std::vector<char> buffer) : buffer(std::move(buffer)), position(0) {}
+
+        static CheckpointReader from_file(const std::string& path);
+
+        template<typename T>
+        T read() {
+            static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read as bytes.");
+            T value;
+            std::memcpy(&value, consume(sizeof(T)), sizeof(T));
+            return value;
+        }
+
+        // In place, for values without a default constructor
+        template<typename T>
+        void read_into(T& value) {
+            static_assert(std::is_trivially_copyable<T>::value, "Only trivially copyable values are read as bytes.");
+            std::memcpy(&value, consume(sizeof(T)), sizeof(T));
+        }
+
+        template<typename T>
+        void read_vector(std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable<T>::value, "Only vectors of trivially copyable values are read as bytes.");
+            std::uint64_t size = read<std::uint64_t>();
+            if (size > (buffer.size() - position) / sizeof(T)) {
+                throw std::runtime_error("Checkpoint ended unexpectedly.");
+            }
+            values.resize(size);
+            if (size > 0) {
+                std::memcpy(values.data(), consume(size * sizeof(T)), size * sizeof(T));
+            }
+        }
+
+        std::string read_string() {
+            std::uint64_t size = read<std::uint64_t>();
+            if (size > buffer.size() - position) {
+                throw std::runtime_error("Checkpoint ended unexpectedly.");
+            }
+            return std::string(consume(size), size);
+        }
+
+        template<typename Streamable>
+        void read_streamed(Streamable& value) {
+            std::istringstream in(read_string());
+            in >> value;
+            if (!in) {
+                throw std::runtime_error("Checkpoint holds an unreadable random state.");
+            }
+        }
+
+        bool at_end() const { return position == buffer.size(); }
+};
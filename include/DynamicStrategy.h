@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include "Checkpoint.h"
+#include "Metrics.h"
+#include "OrderBook.h"
+#include "Trade.h"
+
+/**
+    Virtual side of the strategy framework, for strategies only picked at run time (loaded from a plugin, named in a config...).
+    Such a strategy implements StrategyInterface, or is a static strategy wrapped by StrategyAdapter, and runs in
+    BasicMarketEngine<DynamicStrategy>, which calls every hook through the interface. Each hook then costs a virtual call the static
+    path does not pay.
+*/
+class StrategyInterface {
+    public:
+        virtual ~StrategyInterface() = default;
+
+        virtual void on_market_update(long long timestamp_us, long long market_price_ticks) = 0;
+        virtual void on_fill(const Trade& trade) = 0;
+        virtual void on_timer(long long timestamp_us) = 0;
+
+        virtual long long get_active_buy_order_id() const = 0;
+        virtual long long get_active_sell_order_id() const = 0;
+        virtual bool is_quote_stale(long long market_price_ticks) const = 0;
+
+        virtual void save_state(CheckpointWriter& writer) const = 0;
+        virtual void load_state(CheckpointReader& reader) = 0;
+};
+
+template<typename StrategyT>
+class StrategyAdapter : public StrategyInterface {
+    private:
+        StrategyT strategy;
+    public:
+        template<typename... Args>
+        explicit StrategyAdapter(Args&&... args) : strategy(std::forward<Args>(args)...) {}
+
+        void on_market_update(long long timestamp_us, long long market_price_ticks) override { strategy.on_market_update(timestamp_us, market_price_ticks); }
+        void on_fill(const Trade& trade) override { strategy.on_fill(trade); }
+        void on_timer(long long timestamp_us) override { strategy.on_timer(timestamp_us); }
+
+        long long get_active_buy_order_id() const override { return strategy.get_active_buy_order_id(); }
+        long long get_active_sell_order_id() const override { return strategy.get_active_sell_order_id(); }
+        bool is_quote_stale(long long market_price_ticks) const override { return strategy.is_quote_stale(market_price_ticks); }
+
+        void save_state(CheckpointWriter& writer) const override { strategy.save_state(writer); }
+        void load_state(CheckpointReader& reader) override { strategy.load_state(reader); }
+
+        StrategyT& get() { return strategy; }
+};
+
+/**
+    The strategy an engine runs to call another through StrategyInterface. It starts as the ping pong strategy built from the engine's
+    parameters, set_strategy swaps in any other, built against get_metrics() and get_order_book(). A checkpoint only loads back into
+    the kind of strategy that wrote it.
+*/
+class DynamicStrategy {
+    private:
+        Metrics& metrics;
+        OrderBook& order_book;
+        std::unique_ptr<StrategyInterface> strategy;
+    public:
+        DynamicStrategy(Metrics& metrics, OrderBook& order_book, int quote_size, long long tick_offset, long long max_inv, long long cancel_threshold, long long cooldown_between_requotes);
+
+        void set_strategy(std::unique_ptr<StrategyInterface> value);
+
+        void on_market_update(long long timestamp_us, long long market_price_ticks) { strategy->on_market_update(timestamp_us, market_price_ticks); }
+        void on_fill(const Trade& trade) { strategy->on_fill(trade); }
+        void on_timer(long long timestamp_us) { strategy->on_timer(timestamp_us); }
+
+        long long get_active_buy_order_id() const { return strategy->get_active_buy_order_id(); }
+        long long get_active_sell_order_id() const { return strategy->get_active_sell_order_id(); }
+        bool is_quote_stale(long long market_price_ticks) const { return strategy->is_quote_stale(market_price_ticks); }
+
+        void save_state(CheckpointWriter& writer) const { strategy->save_state(writer); }
+        void load_state(CheckpointReader& reader) { strategy->load_state(reader); }
+
+        StrategyInterface& get_strategy() { return *strategy; }
+        Metrics& get_metrics() { return metrics; }
+        OrderBook& get_order_book() { return order_book; }
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <random>
+#include "Checkpoint.h"
+
+/**
+    Multivariate Hawkes process over the order flow marks, with exponential kernels: every event of mark j raises the intensity of
+    mark i by excitation[i][j], and that excess decays at rate decay[i]. Because the kernels are exponential, the excess of each
+    mark is a single number decayed and bumped in place, so an event costs O(NUM_MARKS) whatever the history.
+    Events are sampled with Ogata's thinning: between events intensities only decay, so the intensity now bounds them until the next one.
+    Times are in microseconds, rates in events per second.
+*/
+class HawkesProcess {
+    public:
+        enum Mark : unsigned char {
+            BUY_MARKET,
+            SELL_MARKET,
+            BUY_LIMIT,
+            SELL_LIMIT,
+            BUY_CANCEL,
+            SELL_CANCEL,
+            NUM_MARKS
+        };
+
+        struct Parameters {
+            std::array<double, NUM_MARKS> baselinePerSecond;
+            std::array<std::array<double, NUM_MARKS>, NUM_MARKS> excitationPerSecond; // [target][source], jump of the target's intensity
+            std::array<double, NUM_MARKS> decayPerSecond;                              // per target mark
+
+            // Same baseline and decay for every mark, self_excitation on the diagonal and cross_excitation elsewhere
+            static Parameters uniform(double baseline_per_second, double self_excitation_per_second, double cross_excitation_per_second, double decay_per_second);
+        };
+
+        struct Event {
+            double timestampUs;
+            Mark mark;
+        };
+
+    private:
+        std::array<double, NUM_MARKS> baseline;    // per microsecond
+        std::array<std::array<double, NUM_MARKS>, NUM_MARKS> excitation_by_source; // [source][target], per microsecond, a row is what one event adds
+        std::array<double, NUM_MARKS> decay;       // per microsecond
+        bool has_uniform_decay;                    // one exp per step instead of one per mark
+
+        std::array<double, NUM_MARKS> excess;      // intensity above the baseline at current_time_us
+        double total_excess;                       // sum of excess, kept alongside it rather than summed every step
+        std::array<double, NUM_MARKS> total_excitation_by_source;
+        std::array<double, NUM_MARKS> cumulative_baseline;
+        double total_baseline;
+        double current_time_us;
+        std::mt19937_64 rand_engine;
+        std::size_t num_candidates;                // thinning proposals, accepted or not
+        Event pending;                             // drawn by generate_until past its end, handed out first next time
+        bool has_pending;
+
+        void decay_by(double elapsed_us);
+        Event draw();
+    public:
+        HawkesProcess(const Parameters& parameters, double start_time_us = 0, unsigned long long seed = 17);
+
+        Event next();
+        std::size_t generate(Event* events, std::size_t num_events);
+        std::size_t generate_until(double end_time_us, Event* events, std::size_t capacity);
+        void reset(double start_time_us);
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
+
+        double intensity(Mark mark) const { return (baseline[mark] + excess[mark]) * 1e6; }
+        double get_current_time_us() const { return current_time_us; }
+        std::size_t get_num_candidates() const { return num_candidates; }
+
+        static double branching_ratio(const Parameters& parameters);
+        static std::array<double, NUM_MARKS> stationary_rates(const Parameters& parameters);
+};
@@ -1,12 +1,48 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 
 class IdGenerator {
+    public:
+        struct Counters {
+            long long next;
+            long long nextTrade;
+        };
+
+        /**
+            While alive, ids drawn on the constructing thread come from counters of its own instead of the process wide ones, so a
+            simulation branch running on a worker thread hands out the same ids whatever the other branches do. Scopes nest.
+        */
+        class Scope {
+            private:
+                Counters counters;
+                Counters* previous;
+            public:
+                Scope(long long next_id, long long next_trade_id);
+                ~Scope();
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+        };
+
     private:
-        static long long current;
-        static long long currentTrade;
+        // Atomic so that books living on different threads (partitioned replay, sharded engines) can draw ids concurrently
+        static std::atomic<long long> current;
+        static std::atomic<long long> currentTrade;
+        static thread_local Counters* scoped; // innermost Scope of the thread, nullptr outside of one
     public:
         static long long getNext();
         static long long getNextTrade();
+
+        // Next ids to be handed out, saved with a simulation checkpoint and put back when it is restored
+        static long long peekNext() { return scoped != nullptr ? scoped->next : current.load(std::memory_order_relaxed); }
+        static long long peekNextTrade() { return scoped != nullptr ? scoped->nextTrade : currentTrade.load(std::memory_order_relaxed); }
+        static void restore(long long next_id, long long next_trade_id) {
+            if (scoped != nullptr) {
+                *scoped = {next_id, next_trade_id};
+                return;
+            }
+            current.store(next_id, std::memory_order_relaxed);
+            currentTrade.store(next_trade_id, std::memory_order_relaxed);
+        }
 };
\ No newline at end of file
@@ -1,22 +1,119 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <queue>
+#include <ostream>
 #include <random>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
+#include "Checkpoint.h"
 
 class LatencyQueue {
-    private:
-        struct Event {
-            long long time_to_execute;
-            
-            std::function<void(long long time_to_execute)> callback;
+    public:
+        enum ActionType {
+            ORDER_SEND,
+            CANCEL,
+            MODIFY,
+            ACKNOWLEDGE_FILL,
+            MARKET_UPDATE
+        };
+        static constexpr std::size_t NUM_ACTION_TYPES = 5;
+
+        enum class LatencyModel {
+            INDEPENDENT, // each event's latency drawn on its own within its type's boundaries, later events can overtake earlier ones. The default
+            SESSION      // as over one connection per channel: same draw plus the channel's congestion, never delivered before the channel's previous event
+        };
+
+        /**
+            The directions events travel in. Each has its own latency model and congestion, its events are merged with the others'
+            in the one heap so the owner sees every direction on a single clock. Under the SESSION model a channel delivers in order.
+        */
+        enum Channel {
+            ORDER_ENTRY,       // order sends, cancels and modifies, strategy to exchange
+            EXECUTION_REPORTS, // fill acknowledgements, exchange to strategy
+            MARKET_DATA        // market updates
+        };
+        static constexpr std::size_t NUM_CHANNELS = 3;
+
+        /**
+            Congestion of a SESSION channel: spikes come as a Poisson process, each adds an exponentially distributed delay that then
+            decays exponentially, so events sent close together are delayed together.
+        */
+        struct SessionCongestion {
+            double spikesPerSecond;
+            double spikeMeanUs;
+            double decayUs;
+        };
 
-            bool operator>(const Event& other) const;
+        /**
+            Typed payloads of the pending events, plain data so they can be inspected, counted, dumped and checkpointed. The latency an
+            event is delayed by comes from its type: an OrderSend is delayed like an ORDER_SEND, and so on.
+        */
+        struct OrderSend {
+            bool isBuy;
+            bool isPong;      // pongs go out as sent, pings are sized and priced by their owner when they arrive
+            int quantity;
+            long long priceTick;
+        };
+
+        struct Cancel {
+            long long orderId; // -1 cancels the active quotes if the market has moved past the owner's threshold by the time it arrives
+        };
+
+        struct Modify {
+            long long orderId;
+            int newQuantity;
+        };
+
+        struct AcknowledgeFill {
+            bool isBuy;
+            bool isPong;
+            bool wasInstant;
+            int quantity;
+            long long orderId;
+            long long priceTick;
+        };
+
+        struct MarketUpdate {
+            long long marketPriceTicks;
+        };
 
-            Event(long long time_to_execute, std::function<void(long long time_to_execute)> callback) : time_to_execute(time_to_execute), callback(callback) {}
+        // An opaque callback scheduled with schedule_event(timestamp_us, type, func), kept in the callback slots
+        struct Callback {
+            ActionType type;
+            std::size_t slot;
+        };
+
+        // Alternatives of the five action types come in ActionType order, so an event's type is its index
+        using Payload = std::variant<OrderSend, Cancel, Modify, AcknowledgeFill, MarketUpdate, Callback>;
+
+        /**
+            Names a scheduled event until it fires or is cancelled. Slots are reused, the generation tells the event a handle was given
+            for apart from later events in the same slot, so a stale handle cancels nothing. Default-constructed handles name no event.
+        */
+        static constexpr std::uint32_t NO_SLOT = 0xFFFFFFFF;
+
+        struct EventHandle {
+            std::uint32_t slot;
+            std::uint32_t generation;
+
+            EventHandle() : slot(NO_SLOT), generation(0) {}
+            EventHandle(std::uint32_t slot, std::uint32_t generation) : slot(slot), generation(generation) {}
+        };
+
+        // A pending event as listed by snapshot()
+        struct Event {
+            long long time_to_execute;
+            EventHandle handle;
+            Payload payload;
         };
 
+    private:
             struct LatencyBoundaries {
             long long order_send_min, order_send_max;
             long long cancel_min, cancel_max;
@@ -25,32 +122,154 @@ class LatencyQueue {
             long long market_update_min, market_update_max;
         };
 
+        // Heap entry. The payload stays in its slot, an entry whose generation no longer matches its slot's is a tombstone
+        struct Entry {
+            long long time_to_execute;
+            std::uint64_t sequence; // order of scheduling, breaks ties so events due at the same time fire first in first out
+            std::uint32_t slot;
+            std::uint32_t generation;
+
+            bool operator>(const Entry& other) const;
+        };
+
+        struct Slot {
+            std::uint32_t generation; // bumped whenever the slot's event fires, is cancelled or is rescheduled
+            bool pending;
+            long long sent_us;        // when it was scheduled, kept across reschedules
+            Payload payload;
+        };
+
+        struct ChannelState {
+            LatencyModel model;
+            SessionCongestion congestion;
+            long long last_delivery_us; // of the channel's latest event, no later event is delivered before it
+            long long last_send_us;     // congestion is decayed up to this time, -1 before the first event
+            double congestion_us;
+        };
+
         std::random_device rd;
         std::mt19937 engine;
 
-        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> event_queue;
+        std::array<ChannelState, NUM_CHANNELS> channels;
+        std::uint64_t next_sequence;
+
+        // Binary min-heap on time_to_execute, kept with the standard heap algorithms so it can be saved and restored as it is
+        std::vector<Entry> event_queue;
+        std::vector<Slot> slots;
+        std::vector<std::uint32_t> free_slots;
+        std::size_t num_pending_events;
         LatencyBoundaries latency_boundaries;
+        std::vector<std::function<void(long long time_to_execute)>> callbacks; // of the pending callback events, by slot
+        std::vector<std::size_t> free_callback_slots;
+        std::array<std::uint64_t, NUM_ACTION_TYPES> num_scheduled; // by ActionType, callbacks counted under the type they were given
+        std::array<std::uint64_t, NUM_ACTION_TYPES> num_fired;
+        std::array<std::uint64_t, NUM_ACTION_TYPES> num_cancelled;
 
-    public:
-        enum ActionType {
-            ORDER_SEND,
-            CANCEL,
-            MODIFY,
-            ACKNOWLEDGE_FILL,
-            MARKET_UPDATE
-        };
+        long long compute_delivery_time(long long timestamp_us, ActionType type);
+        EventHandle push_event(long long sent_us, long long time_to_execute, const Payload& payload);
+        Entry pop_entry();
+        void release_slot(std::uint32_t slot);
+        void compact_if_sparse();
+        void run_callback(const Callback& callback, long long time_to_execute);
 
+    public:
         LatencyQueue();
 
         long long compute_execution_latency(ActionType type);
 
+        static ActionType type_of(const Payload& payload);
+        static Channel channel_of(ActionType type);
+        // The channel of a typed event, resolved at compile time
+        template<typename P>
+        static constexpr Channel channel_of() {
+            if constexpr (std::is_same<P, AcknowledgeFill>::value) {
+                return EXECUTION_REPORTS;
+            }
+            else if constexpr (std::is_same<P, MarketUpdate>::value) {
+                return MARKET_DATA;
+            }
+            else {
+                return ORDER_ENTRY;
+            }
+        }
+        static const char* type_name(ActionType type);
+
+        EventHandle schedule_event(long long timestamp_us, const Payload& payload);
+
+        // Schedules an opaque callback instead of a typed event. Queues holding callbacks cannot be checkpointed
         template<typename F>
-        void schedule_event(long long timestamp_us, ActionType type, F&& func) {
-            long long execution_latency = compute_execution_latency(type);
-            event_queue.emplace(timestamp_us + execution_latency, func);
+        EventHandle schedule_event(long long timestamp_us, ActionType type, F&& func) {
+            std::size_t slot;
+            if (free_callback_slots.empty()) {
+                slot = callbacks.size();
+                callbacks.emplace_back(std::forward<F>(func));
+            }
+            else {
+                slot = free_callback_slots.back();
+                free_callback_slots.pop_back();
+                callbacks[slot] = std::forward<F>(func);
+            }
+            num_scheduled[type]++;
+            return push_event(timestamp_us, compute_delivery_time(timestamp_us, type), Callback{type, slot});
+        }
+
+        bool is_pending(EventHandle handle) const {
+            return handle.slot < slots.size() && slots[handle.slot].pending && slots[handle.slot].generation == handle.generation;
+        }
+
+        bool cancel_event(EventHandle handle);
+        EventHandle reschedule_event(EventHandle handle, long long time_to_execute);
+
+        /**
+         * @brief Fires, in time order, every event due strictly before timestamp_us. Typed events go to visitor(payload, time_to_execute),
+         *        or to visitor(payload, time_to_execute, sent_us) if the visitor takes the time the event was sent too, resolved at
+         *        compile time for each payload type. Callbacks are called directly. Cancelled and rescheduled entries are dropped as
+         *        they come up. Events scheduled while firing are fired too if they are due.
+         */
+        template<typename Visitor>
+        void process_until(long long timestamp_us, Visitor&& visitor) {
+            while (!event_queue.empty() && timestamp_us > event_queue.front().time_to_execute) {
+                Entry entry = pop_entry();
+                if (!is_pending(EventHandle(entry.slot, entry.generation))) {
+                    continue;
+                }
+                // Copied out before firing, the visitor may schedule into a reallocated slot table
+                Payload payload = slots[entry.slot].payload;
+                long long sent_us = slots[entry.slot].sent_us;
+                release_slot(entry.slot);
+                std::visit([this, &visitor, &entry, &payload, sent_us](const auto& event) {
+                    using P = std::decay_t<decltype(event)>;
+                    if constexpr (std::is_same<P, Callback>::value) {
+                        num_fired[event.type]++;
+                        run_callback(event, entry.time_to_execute);
+                    }
+                    else {
+                        num_fired[payload.index()]++;
+                        if constexpr (std::is_invocable<Visitor, const P&, long long, long long>::value) {
+                            visitor(event, entry.time_to_execute, sent_us);
+                        }
+                        else {
+                            visitor(event, entry.time_to_execute);
+                        }
+                    }
+                }, payload);
+            }
         }
 
         void process_until(long long timestamp_us);
+
+        // Of every channel, or of one
+        void set_latency_model(LatencyModel model);
+        void set_latency_model(Channel channel, LatencyModel model);
+        void set_session_congestion(double spikes_per_second, double spike_mean_us, double decay_us);
+        void set_session_congestion(Channel channel, double spikes_per_second, double spike_mean_us, double decay_us);
+
+        // Pending events in the order they will fire
+        std::vector<Event> snapshot() const;
+        void dump(std::ostream& out) const;
+
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
         void reset_latency_profile(long long order_send_min, long long order_send_max, 
                                    long long cancel_min, long long cancel_max, 
                                    long long modify_min, long long modify_max, 
@@ -58,18 +277,30 @@ class LatencyQueue {
                                    long long market_update_min, long long market_update_max);
 
         // Getters
-        const auto& get_event_queue() const {
-            return event_queue;
+        std::vector<Event> get_event_queue() const {
+            return snapshot();
         }
 
         const auto& get_latency_boundaries() const {
             return latency_boundaries;
         }
 
+        LatencyModel get_latency_model(Channel channel) const { return channels[channel].model; }
+        const SessionCongestion& get_session_congestion(Channel channel) const { return channels[channel].congestion; }
+        double get_channel_congestion_us(Channel channel) const { return channels[channel].congestion_us; }
+
         bool is_empty() const {
-            return event_queue.empty();
+            return num_pending_events == 0;
         }
 
+        std::size_t get_num_pending_events() const { return num_pending_events; }
+        std::size_t get_heap_size() const { return event_queue.size(); } // pending events and the tombstones not yet dropped
+
+        std::uint64_t get_num_scheduled(ActionType type) const { return num_scheduled[type]; }
+        std::uint64_t get_num_fired(ActionType type) const { return num_fired[type]; }
+        std::uint64_t get_num_cancelled(ActionType type) const { return num_cancelled[type]; }
+        std::uint64_t get_num_pending(ActionType type) const { return num_scheduled[type] - num_fired[type] - num_cancelled[type]; }
+
         long long get_order_send_min() const { return latency_boundaries.order_send_min; }
         long long get_order_send_max() const { return latency_boundaries.order_send_max; }
         long long get_cancel_min() const { return latency_boundaries.cancel_min; }
@@ -1,19 +1,44 @@
 #pragma once
 
+#include "BackgroundFlow.h"
 #include "OrderBook.h"
 #include "Metrics.h"
+#include "PriceProcess.h"
+#include "QueuePositionModel.h"
 #include "Trade.h"
+#include "DynamicStrategy.h"
 #include "Strategy.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <utility>
 #include <sys/stat.h>
 #include <vector>
 
-class MarketEngine {
+/**
+    Simulated market around one strategy, StrategyT being any strategy of the framework (StrategyBase.h): the engine calls its hooks
+    directly, so a static strategy's hooks inline. BasicMarketEngine<DynamicStrategy> runs strategies picked at run time instead.
+*/
+template<typename StrategyT>
+class BasicMarketEngine {
+    public:
+        // How the resting strategy orders get filled by the simulated market
+        enum class FillModel {
+            PROBABILITY,     // a random draw each update, likelier the closer the order is to the market price. The default
+            QUEUE_POSITION,  // once the synthetic flow at the order's price has traded through the volume queued ahead of it
+            ORDER_BOOK       // only by matching in orderbook, against the background flow
+        };
+
     private:
         Metrics metrics;
         OrderBook orderbook;
-        Strategy strategy;
+        BackgroundFlow background_flow; // rest of the market trading in orderbook, silent until populations are added
+        StrategyT strategy;
 
-        static long long env_order_id;
+        long long env_order_id; // ids of the simulated counterparties, per engine so that branches on other threads do not share it
         static const double tick_size;
 
         std::random_device rng;
@@ -23,22 +48,58 @@ class MarketEngine {
         long long spread;
         double volatility;
         double fill_probability;
+
+        // Replaces the built-in random walk when set, generated price_block.size() steps at a time and consumed one step per update
+        std::unique_ptr<PriceProcess> price_process;
+        std::vector<double> price_block;
+        std::vector<double> volatility_block;
+        std::size_t price_block_index;
+
+        FillModel fill_model;
+        QueuePositionModel queue_model;
+        long long tracked_buy_order_id; // strategy orders currently in queue_model, -1 for none
+        long long tracked_sell_order_id;
+        // Synthetic flow at the touch for QUEUE_POSITION, means of exponential draws: quantity queued ahead of a joining order,
+        // then per update the quantity traded and the quantity cancelled at the order's price
+        long long queue_depth;
+        long long touch_trade_volume;
+        long long touch_cancel_volume;
+        long long fill_timestamp_us; // timestamp of the update whose flow is being fed to queue_model
+
+        void step_random_walk();
+        void step_price_process();
+        void check_queue_fills(long long timestamp_us);
+        void sync_tracked_order(bool isBuy);
+        void feed_touch_flow(bool isBuy, long long order_id);
+        void on_queue_fill(long long order_id, bool isBuy, long long priceTick, int quantity);
+        long long draw_volume(long long mean);
     public:
-        MarketEngine(int strategy_quote_size = 1, long long strategy_tick_offset = 1, long long strategy_max_inv = 10, long long strategy_cancel_threshold = 1, long long strategy_cooldown_between_requotes = 1, long long starting_mid_price = 10000, long long start_spread = 2, double start_vol = 1.0, double start_fill_prob = 0.3);
+        BasicMarketEngine(int strategy_quote_size = 1, long long strategy_tick_offset = 1, long long strategy_max_inv = 10, long long strategy_cancel_threshold = 1, long long strategy_cooldown_between_requotes = 1, long long starting_mid_price = 10000, long long start_spread = 2, double start_vol = 1.0, double start_fill_prob = 0.3);
         
         void update(long long timestamp_us);
 
         void simulate_background_dynamics();
+        void record_quote_state(long long timestamp_us);
         void check_and_trigger_fills(long long timestamp_us);
         void execute_events_until(long long timestamp);
         void notify_metrics_of_market_state(long long timestamp_us);
 
+        void set_price_process(std::unique_ptr<PriceProcess> process, std::size_t block_size = 256);
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
+        void set_fill_model(FillModel model) { fill_model = model; }
+        void set_queue_flow(long long depth, long long trade_volume, long long cancel_volume) {
+            queue_depth = depth;
+            touch_trade_volume = trade_volume;
+            touch_cancel_volume = cancel_volume;
+        }
+
         // Getters
         OrderBook& get_orderbook() {
             return orderbook;
         }
 
-        Strategy& get_strategy() {
+        StrategyT& get_strategy() {
             return strategy;
         }
 
@@ -61,4 +122,369 @@ class MarketEngine {
         double get_fill_probability() {
             return fill_probability;
         }
-};
\ No newline at end of file
+
+        PriceProcess* get_price_process() {
+            return price_process.get();
+        }
+
+        FillModel get_fill_model() const {
+            return fill_model;
+        }
+
+        QueuePositionModel& get_queue_model() {
+            return queue_model;
+        }
+
+        BackgroundFlow& get_background_flow() {
+            return background_flow;
+        }
+};
+
+template<typename StrategyT>
+const double BasicMarketEngine<StrategyT>::tick_size = 0.001;
+    
+template<typename StrategyT>
+BasicMarketEngine<StrategyT>::BasicMarketEngine(int strategy_quote_size, long long strategy_tick_offset, long long strategy_max_inv, long long strategy_cancel_threshold, long long strategy_cooldown_between_requotes, long long starting_mid_price, long long start_spread, double start_vol, double start_fill_prob) : metrics(), orderbook(metrics), background_flow(orderbook),
+                            strategy(metrics, orderbook, strategy_quote_size, strategy_tick_offset, strategy_max_inv, strategy_cancel_threshold, strategy_cooldown_between_requotes), env_order_id(1000000), rng(), rand_engine(rng()), market_price_ticks(starting_mid_price), spread(start_spread), volatility(start_vol), fill_probability(start_fill_prob),
+                            price_process(), price_block(), volatility_block(), price_block_index(0), fill_model(FillModel::PROBABILITY),
+                            queue_model([this](long long order_id, bool isBuy, long long priceTick, int quantity) { on_queue_fill(order_id, isBuy, priceTick, quantity); }),
+                            tracked_buy_order_id(-1), tracked_sell_order_id(-1), queue_depth(500), touch_trade_volume(100), touch_cancel_volume(50), fill_timestamp_us(0) {}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::update(long long timestamp_us) {
+    simulate_background_dynamics();
+
+    record_quote_state(timestamp_us);
+
+    background_flow.advance_to(timestamp_us, market_price_ticks);
+
+    notify_metrics_of_market_state(timestamp_us);
+
+    check_and_trigger_fills(timestamp_us);
+
+    strategy.on_market_update(timestamp_us, market_price_ticks);
+
+    execute_events_until(timestamp_us);
+}
+
+/**
+    The strategy's quotes as the exchange sees them at timestamp_us, stale by the strategy's own measure, exposed until the cancel
+    reaches the book.
+*/
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::record_quote_state(long long timestamp_us) {
+    bool is_stale = strategy.is_quote_stale(market_price_ticks);
+    long long buy_id = strategy.get_active_buy_order_id();
+    long long sell_id = strategy.get_active_sell_order_id();
+    bool buy_quoted = buy_id != -1 && orderbook.is_live(buy_id);
+    bool sell_quoted = sell_id != -1 && orderbook.is_live(sell_id);
+    metrics.on_quote_state(timestamp_us, buy_quoted, is_stale, sell_quoted, is_stale);
+}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::simulate_background_dynamics() {
+    if (price_process) {
+        step_price_process();
+    }
+    else {
+        step_random_walk();
+    }
+
+    double base_fill = 0.002;
+    double k = 0.2;
+    double alpha = 0.1;
+
+    fill_probability = (1 - alpha) * fill_probability + alpha * (base_fill * std::exp(-k * volatility));
+}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::step_random_walk() {
+    std::uniform_int_distribution<int> move(-1, 1);
+    std::uniform_real_distribution<double> jump(0.0, 1.0);
+
+    long long prev_price_ticks = market_price_ticks;
+
+    market_price_ticks += std::llround(move(rand_engine) * volatility);
+
+    // A rare jump in the market simulating news
+    if (jump(rand_engine) < 0.001) {
+        market_price_ticks += std::llround(move(rand_engine) * (5 * volatility));
+    }
+
+    long long price_change = market_price_ticks - prev_price_ticks;
+
+    spread = std::max<long long>(1, (long long)(2 + 0.5 * volatility)); 
+
+    volatility = std::sqrt((0.1 * price_change * price_change) + 0.9 * (volatility * volatility));
+}
+
+/**
+    Takes the next step of the price process, generating a new block once the current one is used up.
+*/
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::step_price_process() {
+    if (price_block_index == price_block.size()) {
+        price_process->generate(price_block.data(), volatility_block.data(), price_block.size());
+        price_block_index = 0;
+    }
+
+    market_price_ticks = std::llround(price_block[price_block_index]);
+    volatility = volatility_block[price_block_index];
+    price_block_index++;
+
+    spread = std::max<long long>(1, (long long)(2 + 0.5 * volatility));
+}
+
+/**
+ * @brief Drives the market price with process from the next update on, block_size steps generated per call. nullptr goes back to the built-in random walk.
+ */
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::set_price_process(std::unique_ptr<PriceProcess> process, std::size_t block_size) {
+    if (block_size == 0) {
+        throw std::runtime_error("Price process blocks need at least one step!");
+    }
+    price_process = std::move(process);
+    price_block.assign(block_size, 0);
+    volatility_block.assign(block_size, 0);
+    price_block_index = block_size;
+}
+
+/**
+ * @brief Writes the whole simulated market: metrics, book, strategy, background flow, queue model, price process and generators, the
+ *        counterparty id counter included. The global order and trade id counters are left to the caller.
+ */
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::save_state(CheckpointWriter& writer) const {
+    metrics.save_state(writer);
+    orderbook.save_state(writer);
+    strategy.save_state(writer);
+    background_flow.save_state(writer);
+    queue_model.save_state(writer);
+
+    writer.write_streamed(rand_engine);
+    writer.write(env_order_id);
+    writer.write(market_price_ticks);
+    writer.write(spread);
+    writer.write(volatility);
+    writer.write(fill_probability);
+
+    writer.write(price_process != nullptr);
+    if (price_process) {
+        price_process->save_state(writer);
+        writer.write_vector(price_block);
+        writer.write_vector(volatility_block);
+        writer.write(price_block_index);
+    }
+
+    writer.write(fill_model);
+    writer.write(tracked_buy_order_id);
+    writer.write(tracked_sell_order_id);
+    writer.write(queue_depth);
+    writer.write(touch_trade_volume);
+    writer.write(touch_cancel_volume);
+    writer.write(fill_timestamp_us);
+}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::load_state(CheckpointReader& reader) {
+    metrics.load_state(reader);
+    orderbook.load_state(reader);
+    strategy.load_state(reader);
+    background_flow.load_state(reader);
+    queue_model.load_state(reader);
+
+    reader.read_streamed(rand_engine);
+    env_order_id = reader.read<long long>();
+    market_price_ticks = reader.read<long long>();
+    spread = reader.read<long long>();
+    volatility = reader.read<double>();
+    fill_probability = reader.read<double>();
+
+    price_process.reset();
+    price_block.clear();
+    volatility_block.clear();
+    price_block_index = 0;
+    if (reader.read<bool>()) {
+        price_process = PriceProcess::load_state(reader);
+        reader.read_vector(price_block);
+        reader.read_vector(volatility_block);
+        price_block_index = reader.read<std::size_t>();
+    }
+
+    fill_model = reader.read<FillModel>();
+    tracked_buy_order_id = reader.read<long long>();
+    tracked_sell_order_id = reader.read<long long>();
+    queue_depth = reader.read<long long>();
+    touch_trade_volume = reader.read<long long>();
+    touch_cancel_volume = reader.read<long long>();
+    fill_timestamp_us = reader.read<long long>();
+}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::check_and_trigger_fills(long long timestamp_us) {
+    if (fill_model == FillModel::QUEUE_POSITION) {
+        check_queue_fills(timestamp_us);
+        return;
+    }
+    if (fill_model == FillModel::ORDER_BOOK) {
+        return;
+    }
+
+    std::uniform_real_distribution<double> probability(0, 1);
+    double k = 0.5; // How fast fill probability decays based on distance from market price
+
+    // -------------- BUY SIDE -------------- //
+    // A quote the book has already filled stays active until its next ping replaces it, it has nothing left to fill
+    if (strategy.get_active_buy_order_id() != -1 && metrics.is_tracking(strategy.get_active_buy_order_id())) {
+        Metrics::OrderCacheData order_data = metrics.order_cache.find(strategy.get_active_buy_order_id())->second;
+        std::uniform_int_distribution<int> filled_quantity(1, order_data.intended_quantity);
+        long long order_price = order_data.arrival_mark_price_ticks;
+        long long dist = market_price_ticks - order_price;
+
+        double fill_prob = fill_probability * std::exp(-k * dist);
+        fill_prob = std::min<double>(1, fill_prob);
+
+        long long low = std::min(order_price, market_price_ticks + spread / 2);
+        long long high = std::max(order_price, market_price_ticks + spread / 2);
+        std::uniform_int_distribution<long long> fill_price(low, high);
+
+        // The strategy only learns of a fill when it is acknowledged, the book holds what the exchange has left of the quote
+        int open_qty = orderbook.get_resting_quantity(strategy.get_active_buy_order_id());
+        if (probability(rand_engine) < fill_prob && open_qty > 0) {
+            Trade trade(strategy.get_active_buy_order_id(), env_order_id++, fill_price(rand_engine), std::min<int>(open_qty, filled_quantity(rand_engine)), timestamp_us, false);
+            orderbook.modify_order(trade.buyOrderId, open_qty - trade.quantity, timestamp_us);
+            strategy.on_fill(trade);
+        }
+    }
+
+    // -------------- SELL SIDE -------------- //
+    if (strategy.get_active_sell_order_id() != -1 && metrics.is_tracking(strategy.get_active_sell_order_id())) {
+        Metrics::OrderCacheData order_data = metrics.order_cache.find(strategy.get_active_sell_order_id())->second;
+        std::uniform_int_distribution<int> filled_quantity(1, order_data.intended_quantity);
+        long long order_price = order_data.arrival_mark_price_ticks;
+        long long dist = order_price - market_price_ticks;
+
+        double fill_prob = fill_probability * std::exp(-k * dist);
+        fill_prob = std::min<double>(1, fill_prob);
+
+        long long low = std::min(market_price_ticks - spread / 2, order_price);
+        long long high = std::max(market_price_ticks - spread / 2, order_price);
+        std::uniform_int_distribution<long long> fill_price(low, high);
+
+        int open_qty = orderbook.get_resting_quantity(strategy.get_active_sell_order_id());
+        if (probability(rand_engine) < fill_prob && open_qty > 0) {
+            Trade trade(env_order_id++, strategy.get_active_sell_order_id(), fill_price(rand_engine), std::min<int>(open_qty, filled_quantity(rand_engine)), timestamp_us, false);
+            orderbook.modify_order(trade.sellOrderId, open_qty - trade.quantity, timestamp_us);
+            strategy.on_fill(trade);
+        }
+    }    
+}
+
+/**
+    QUEUE_POSITION fills. The strategy's live quotes are tracked by queue_model from the moment they show up, behind a drawn queue,
+    then each update runs a synthetic flow at their price through the model, which reports the fills to the strategy.
+*/
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::check_queue_fills(long long timestamp_us) {
+    fill_timestamp_us = timestamp_us;
+
+    sync_tracked_order(true);
+    sync_tracked_order(false);
+
+    // A fully filled quote has left the model but stays active until the strategy handles the fill acknowledgement
+    if (queue_model.find(tracked_buy_order_id) != nullptr) {
+        feed_touch_flow(true, tracked_buy_order_id);
+    }
+    if (queue_model.find(tracked_sell_order_id) != nullptr) {
+        feed_touch_flow(false, tracked_sell_order_id);
+    }
+}
+
+/**
+    Follows the strategy's active quote on one side: a replaced or cancelled quote stops being tracked, a new one joins the back of a queue of queue_depth on average.
+*/
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::sync_tracked_order(bool isBuy) {
+    long long active_id = isBuy ? strategy.get_active_buy_order_id() : strategy.get_active_sell_order_id();
+    long long& tracked_id = isBuy ? tracked_buy_order_id : tracked_sell_order_id;
+    if (active_id == tracked_id) {
+        return;
+    }
+
+    if (tracked_id != -1) {
+        queue_model.untrack(tracked_id);
+    }
+    tracked_id = active_id;
+    if (active_id == -1) {
+        return;
+    }
+
+    // The quote can already be gone from the cache, filled in the order book against the strategy's own orders
+    auto iter_order = metrics.order_cache.find(active_id);
+    if (iter_order == metrics.order_cache.end()) {
+        return;
+    }
+    queue_model.track(active_id, isBuy, iter_order->second.arrival_mark_price_ticks, iter_order->second.remaining_qty, draw_volume(queue_depth));
+}
+
+/**
+    One update of market flow at a quote's price. While the market's touch is at the quote, sells (for a bid) trade against its queue.
+    Once the market has moved through the quote, the trade prints beyond it and fills it. Further back nothing trades there.
+    Cancels come out of a level twice the size of the average queue.
+*/
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::feed_touch_flow(bool isBuy, long long order_id) {
+    long long order_price = queue_model.find(order_id)->priceTick;
+    long long touch = isBuy ? market_price_ticks - spread / 2 : market_price_ticks + spread / 2;
+    bool is_behind_touch = isBuy ? order_price < touch : order_price > touch;
+
+    queue_model.on_cancel(isBuy, order_price, (int)draw_volume(touch_cancel_volume), 2 * queue_depth);
+    if (!is_behind_touch) {
+        queue_model.on_trade(isBuy, touch, (int)draw_volume(touch_trade_volume));
+    }
+}
+
+/**
+    Takes a queue_model fill out of the order book, never for more than the book has left of the order, and reports it to the strategy.
+    As for the PROBABILITY fills, the strategy only learns of it when it is acknowledged, so a cancel in between only finds what is left.
+*/
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::on_queue_fill(long long order_id, bool isBuy, long long priceTick, int quantity) {
+    int open_qty = orderbook.get_resting_quantity(order_id);
+    int filled_quantity = std::min(quantity, open_qty);
+    if (filled_quantity <= 0) {
+        return;
+    }
+
+    orderbook.modify_order(order_id, open_qty - filled_quantity, fill_timestamp_us);
+    long long counterparty_id = env_order_id++;
+    strategy.on_fill(isBuy ? Trade(order_id, counterparty_id, priceTick, filled_quantity, fill_timestamp_us, false)
+                           : Trade(counterparty_id, order_id, priceTick, filled_quantity, fill_timestamp_us, false));
+}
+
+template<typename StrategyT>
+long long BasicMarketEngine<StrategyT>::draw_volume(long long mean) {
+    if (mean <= 0) {
+        return 0;
+    }
+    std::exponential_distribution<double> volume(1.0 / mean);
+    return std::llround(volume(rand_engine));
+}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::execute_events_until(long long timestamp) {
+    strategy.on_timer(timestamp);
+}
+
+template<typename StrategyT>
+void BasicMarketEngine<StrategyT>::notify_metrics_of_market_state(long long timestamp_us) {
+    long long simulated_best_bid = market_price_ticks - spread / 2;
+    long long simulated_best_ask = market_price_ticks + spread / 2;
+    metrics.on_market_price_update(timestamp_us, simulated_best_bid, simulated_best_ask);
+}
+
+// Instantiated once, in MarketEngine.cpp, for the strategies of the repository
+extern template class BasicMarketEngine<PingPongStrategy>;
+extern template class BasicMarketEngine<DynamicStrategy>;
+
+using MarketEngine = BasicMarketEngine<Strategy>;
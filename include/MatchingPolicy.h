@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+    Rules for sharing out what an incoming order takes from one price level. The matching loops of OrderBook are instantiated once per rule,
+    the FIFO instantiation is the plain price-time loop with no allocation pass at all.
+*/
+
+// Price-time priority: the order at the front of the level is filled first
+struct FifoAllocation {
+    static constexpr bool IS_FIFO = true;
+    static constexpr int FIFO_PERCENT = 100;
+};
+
+// Every resting order gets a share proportional to its quantity
+struct ProRataAllocation {
+    static constexpr bool IS_FIFO = false;
+    static constexpr int FIFO_PERCENT = 0;
+};
+
+// The first FifoPercent of what is taken from a level goes out in time priority, the rest pro-rata over what is left
+template<int FifoPercent>
+struct HybridAllocation {
+    static_assert(FifoPercent > 0 && FifoPercent < 100, "Hybrid allocation needs a FIFO share strictly between 0 and 100 percent.");
+    static constexpr bool IS_FIFO = false;
+    static constexpr int FIFO_PERCENT = FifoPercent;
+};
+
+/**
+ * @brief Writes to shares[i] the pro-rata share of take over quantities[0, count), which sum to total (take <= total).
+ *        Shares are truncated in one pass of independent multiplies that the compiler vectorizes. The sum then gets fixed to exactly take:
+ *        rounding overshoot is taken back from the youngest orders, the units lost to truncation go one at a time to the oldest orders with room left.
+ *        The result only depends on the inputs and their order.
+ */
+inline void allocate_pro_rata(const int* quantities, int* shares, std::size_t count, long long total, long long take) {
+    if (take <= 0 || total <= 0) {
+        for (std::size_t i = 0; i < count; i++) {
+            shares[i] = 0;
+        }
+        return;
+    }
+
+    double scale = (double)take / (double)total;
+    long long allocated = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        shares[i] = (int)(quantities[i] * scale);
+        allocated += shares[i];
+    }
+
+    for (std::size_t i = count; i-- > 0 && allocated > take;) {
+        if (shares[i] > 0) {
+            shares[i]--;
+            allocated--;
+        }
+    }
+
+    while (allocated < take) {
+        for (std::size_t i = 0; i < count && allocated < take; i++) {
+            if (shares[i] < quantities[i]) {
+                shares[i]++;
+                allocated++;
+            }
+        }
+    }
+}
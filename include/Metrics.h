@@ -1,7 +1,10 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
+#include "Checkpoint.h"
 
 class Metrics {
     public:
@@ -18,6 +21,14 @@ class Metrics {
             SELLS
         };
 
+        // Directions events travel between the strategy and the exchange, in the order of LatencyQueue::Channel
+        enum Direction {
+            ORDER_ENTRY,
+            ACKNOWLEDGEMENTS,
+            MARKET_DATA
+        };
+        static const int NUM_DIRECTIONS = 3;
+
         struct Config {
             double tick_size;
             long long maker_rebate_per_share_ticks;
@@ -77,6 +88,23 @@ class Metrics {
 
         std::unordered_map<long long, OrderCacheData> order_cache;
 
+        // LATENCY EXPOSURE
+        struct TimeInFlight {
+            std::uint64_t num_events;
+            long long total_us;
+            long long max_us;
+        };
+        std::array<TimeInFlight, NUM_DIRECTIONS> time_in_flight;
+
+        // Each side's quote is timed on the exchange clock, stale while the market has moved past the cancel threshold since it was priced
+        long long quoted_time_us;
+        long long stale_quote_exposure_us;
+        long long last_quote_check_us;
+        bool is_buy_quoted, is_sell_quoted;
+        bool is_buy_quote_stale, is_sell_quote_stale;
+        long quote_filled_qty;
+        long picked_off_qty; // filled while stale
+
         // RESULTS
         double volatility;
         double sharpe_ratio;
@@ -88,13 +116,28 @@ class Metrics {
 
         void set_config(double tick_size, long long maker_rebate_per_share_ticks, long long taker_fee_per_share_ticks, MarkingMethod marking_method, long long return_bucket_interval_us);
         void reset();
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
         void finalize(long long timestamp);
         void on_order_placed(long long order_id, Side side, long long arrival_price_ticks, long long arrival_timestamp_us, int intended_quantity, bool is_instant);
         void on_order_cancelled(long long order_id, long long delete_timestamp_us);
+        void on_order_cancelled(long long order_id, long long delete_timestamp_us, int cancelled_quantity);
         void on_fill(long long order_id_1, long long fill_price_ticks, long long fill_timestamp_us, int filled_quantity, bool was_instant);
+        void on_untracked_fill(Side side, long long fill_price_ticks, long long fill_timestamp_us, int filled_quantity, bool was_instant);
+        void book_fill(Side side, long long fill_price_ticks, int filled_quantity, bool was_instant);
         void on_market_price_update(long long timestamp_us, long long best_bid, long long best_ask);
+        void on_event_delivered(Direction direction, long long sent_us, long long delivered_us);
+        void on_quote_state(long long timestamp_us, bool buy_quoted, bool buy_stale, bool sell_quoted, bool sell_stale);
+        void on_quote_filled(Side side, int filled_quantity);
         void update_last_mark_price();
         void take_screenshot(long long timestamp, bool is_final);
+        void record_series_point(long long timestamp, bool is_final);
+        void aggregate(long long timestamp_us, const std::vector<const Metrics*>& components, bool is_final);
+        void add_latency_exposure(const Metrics& other);
+        void compute_summary_statistics();
+        bool is_tracking(long long order_id) const { return order_cache.find(order_id) != order_cache.end(); }
+
+        static Metrics stitch(const std::vector<Metrics>& windows);
 
         int get_position();
         long long get_avg_entry_price_ticks();
@@ -104,6 +147,10 @@ class Metrics {
         long long get_gross_traded_qty();
         double get_fill_ratio();
         long long get_max_drawdown_ticks();
+        double get_mean_time_in_flight_us(Direction direction) const;
+        long long get_max_time_in_flight_us(Direction direction) const { return time_in_flight[direction].max_us; }
+        double get_stale_quote_ratio() const;
+        double get_pick_off_rate() const;
 
         double get_volatility();
         double get_sharpe_ratio();
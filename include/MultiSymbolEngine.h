@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Metrics.h"
+#include "OrderBook.h"
+#include "OrderCommand.h"
+#include "OrderEntrySession.h"
+
+/**
+    Owns one OrderBook per symbol and shards the symbols over worker threads. Every book is touched by exactly one worker (pinned to its own core),
+    the only way to reach a book is to post a message into its shard's queue, from the caller or from another shard.
+    Per-symbol Metrics are combined into the portfolio Metrics at synchronize() barriers, when every shard is idle.
+*/
+class MultiSymbolEngine {
+    public:
+        struct SymbolMessage {
+            int symbol_id;
+            bool track_in_metrics; // register the order in the symbol's Metrics (our own orders), background flow leaves this off
+            OrderCommand command;
+        };
+
+    private:
+        struct SymbolBook {
+            std::string symbol;
+            Metrics metrics;
+            OrderBook orderbook;
+            OrderEntrySession session; // order ids in messages are client ids
+
+            SymbolBook(const std::string& symbol) : symbol(symbol), metrics(), orderbook(metrics), session(orderbook) {}
+        };
+
+        struct Shard {
+            int core_id;
+            std::mutex inbox_mutex;
+            std::condition_variable inbox_cv;
+            std::vector<SymbolMessage> inbox;
+            std::vector<SymbolMessage> processing; // swapped with inbox so the lock is held only for the swap
+            std::thread worker;
+        };
+
+        std::vector<std::unique_ptr<SymbolBook>> books; // indexed by symbol id
+        std::vector<int> symbol_to_shard;
+        std::unordered_map<std::string, int> symbol_ids;
+        std::vector<std::unique_ptr<Shard>> shards;
+
+        std::atomic<bool> running;
+        std::atomic<long long> pending_messages;
+        std::mutex barrier_mutex;
+        std::condition_variable barrier_cv;
+
+        bool pin_to_cores;
+        Metrics portfolio_metrics;
+
+        void run_shard(Shard& shard);
+        void apply_message(const SymbolMessage& message);
+        void wait_until_drained();
+        void aggregate_portfolio(long long timestamp_us, bool is_final);
+
+    public:
+        MultiSymbolEngine(int num_shards, bool pin_to_cores = true);
+        ~MultiSymbolEngine();
+        MultiSymbolEngine(const MultiSymbolEngine&) = delete;
+        MultiSymbolEngine& operator=(const MultiSymbolEngine&) = delete;
+
+        int add_symbol(const std::string& symbol);
+        void start();
+        void stop();
+
+        void post(int symbol_id, const OrderCommand& command, bool track_in_metrics = false);
+        void post(const std::string& symbol, const OrderCommand& command, bool track_in_metrics = false);
+        void synchronize(long long timestamp_us);
+        void finalize(long long final_timestamp_us);
+
+        // Getters, book and per-symbol metrics accessors are only safe between synchronize() and the next post()
+        int get_symbol_id(const std::string& symbol) const;
+        int get_num_shards() const { return (int)shards.size(); }
+        int get_num_symbols() const { return (int)books.size(); }
+        int get_shard_of(int symbol_id) const { return symbol_to_shard.at(symbol_id); }
+        bool is_running() const { return running.load(); }
+
+        OrderBook& get_orderbook(const std::string& symbol) { return books[get_symbol_id(symbol)]->orderbook; }
+        Metrics& get_metrics(const std::string& symbol) { return books[get_symbol_id(symbol)]->metrics; }
+        Metrics& get_portfolio_metrics() { return portfolio_metrics; }
+};
\ No newline at end of file
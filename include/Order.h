@@ -11,7 +11,10 @@ struct Order {
         bool isBuy;
         bool isActive;
         long long priceTick;
-        int quantity;
+        int quantity;           // resting (visible) quantity, for icebergs the current display slice
+        int hiddenQuantity;     // iceberg reserve behind the slice, 0 for plain orders
+        int displayQuantity;    // iceberg slice size, 0 for plain orders
+        long long ownerId;      // account the order belongs to for self-trade prevention, 0 when it has none
         long long tsCreatedUs;
         long long tsLastUpdateUs;
 
@@ -1,36 +1,253 @@
 #pragma once
 
 #include <unordered_map>
+#include <algorithm>
+#include <climits>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <list>
 #include <queue>
+#include <vector>
+#include "BestBidOffer.h"
+#include "Checkpoint.h"
+#include "MatchingPolicy.h"
 #include "Order.h"
+#include "OrderCommand.h"
+#include "PriceLevel.h"
+#include "SeqLock.h"
+#include "StopOrder.h"
 #include "Trade.h"
 #include "TradeLog.h"
 #include "Metrics.h"
 
 class OrderBook {
+    public:
+        // How many commands (or ids for cancel_orders) ahead the batch APIs start pulling the targeted orders into cache
+        static constexpr std::size_t BATCH_PREFETCH_DISTANCE = 8;
+        // Bound on release rounds per operation: each round fills the resting all-or-none orders that can now complete
+        // and releases every stop crossed by the trades of the previous round
+        static constexpr int MAX_STOP_CASCADE_ROUNDS = 16;
+        // Share of a level's take that FIFO_PRO_RATA books allocate in time priority before the pro-rata pass
+        static constexpr int HYBRID_FIFO_PERCENT = 40;
+
+        // How the quantity taken from a price level is shared among its resting orders, fixed when the book is built
+        enum class MatchingAlgorithm {
+            FIFO,           // price-time priority, the default
+            PRO_RATA,       // proportional to resting quantity
+            FIFO_PRO_RATA   // HYBRID_FIFO_PERCENT in time priority, the rest pro-rata
+        };
+
+        // What happens when an incoming order would trade with a resting order of the same owner
+        enum class SelfTradePrevention {
+            NONE,           // owners are ignored, the default
+            CANCEL_NEWEST,  // the rest of the incoming order is cancelled
+            CANCEL_OLDEST,  // the resting order is cancelled and matching goes on
+            CANCEL_BOTH,
+            DECREMENT       // both are reduced by the smaller quantity without printing a trade
+        };
+
+        // Outcome of a call auction uncross, priceTick is -1 when the book didn't cross and nothing executed
+        struct UncrossResult {
+            long long priceTick;
+            long long volume;
+            long long imbalance; // bid minus ask quantity available at priceTick, positive when buyers are left over
+        };
+
+        using L2Listener = std::function<void(const L2Delta& delta)>;
+        using BboListener = std::function<void(const BestBidOffer& bbo)>;
+
     private:
-        std::map<long long, std::list<Order>> buys;
-        std::map<long long, std::list<Order>> sells;
-        std::unordered_map<long long, std::tuple<long long, std::list<Order>::iterator>> order_lookup;
+        std::map<long long, PriceLevel> buys;
+        std::map<long long, PriceLevel> sells;
+        // order id -> [price, iterator to the order, iterator to its price level]. Map iterators stay valid until the level is erased, which only happens once it is empty
+        std::unordered_map<long long, std::tuple<long long, std::list<Order>::iterator, std::map<long long, PriceLevel>::iterator>> order_lookup;
         TradeLog trade_log;
         Metrics& metrics; // related metrics object from strategy
+        std::vector<L2Listener> l2_listeners;
+
+        BestBidOffer bbo; // cached top of book, refreshed once the outermost mutation finishes
+        std::vector<BboListener> bbo_listeners;
+        SeqLock<BestBidOffer> bbo_snapshot; // bbo published for readers on other threads
+
+        DepthSnapshot depth; // top levels kept in step with the book on every level change, only touched by the matching thread
+        std::size_t depth_dirty_begin; // byte range of depth changed since the last publish, empty when begin >= end
+        std::size_t depth_dirty_end;
+        SeqLock<DepthSnapshot> depth_snapshot;
+
+        // Trigger books, trigger price -> stops in arrival order. Buy stops fire when a trade prints at or above the trigger, sell stops at or below
+        std::map<long long, std::list<StopOrder>> buy_stops;
+        std::map<long long, std::list<StopOrder>> sell_stops;
+        std::unordered_map<long long, std::list<StopOrder>::iterator> stop_lookup;
+        std::vector<StopOrder> released_stops; // reused by every release round
+        long long last_trade_price; // -1 before the first trade
+        long long last_trade_timestamp;
+        long long trade_high; // extremes printed since the stops were last checked
+        long long trade_low;
+
+        // Resting all-or-none orders, price -> orders in arrival order. Kept out of the price levels so the matching loops never have to skip them,
+        // they are not displayed and only execute as a whole, against the opposite side, once it holds enough quantity at their price
+        std::map<long long, std::list<Order>> aon_buys;
+        std::map<long long, std::list<Order>> aon_sells;
+        std::unordered_map<long long, std::list<Order>::iterator> aon_lookup;
+        std::vector<long long> aon_candidates; // reused by every fill pass
+
+        SelfTradePrevention self_trade_prevention;
+
+        MatchingAlgorithm matching_algorithm;
+
+        // Call auction: while open, orders rest without matching and the book may cross until uncross() clears it
+        bool auction_open;
+        std::vector<long long> auction_prices; // price ladder of the crossed range and the quantity of each side at every price, reused by every uncross
+        std::vector<long long> auction_bids;
+        std::vector<long long> auction_asks;
+        // Contiguous per-order quantities and shares of the level being allocated, reused by every pro-rata pass
+        std::vector<int> level_quantities;
+        std::vector<int> level_fifo_shares;
+        std::vector<int> level_shares;
+
+        int mutation_depth;
+
+        /**
+            Opened by every public mutator. Nested operations (a modify re-entering an order, commands of a batch) don't publish,
+            the outermost scope refreshes the top of book once the whole operation is done, so observers never see intermediate states.
+        */
+        struct MutationScope {
+            OrderBook& orderbook;
+            MutationScope(OrderBook& orderbook) : orderbook(orderbook) { orderbook.mutation_depth++; }
+            ~MutationScope() {
+                // Still inside the scope, orders released here enter the book as nested operations
+                if (orderbook.mutation_depth == 1) {
+                    if (orderbook.has_triggered_orders()) {
+                        orderbook.release_triggered_orders();
+                    }
+                    orderbook.forget_traded_range();
+                }
+                if (--orderbook.mutation_depth == 0) {
+                    orderbook.refresh_bbo();
+                    orderbook.publish_depth_snapshot();
+                }
+            }
+        };
+
+        long long add_order(bool isBuy, long long priceTick, int quantity, int displayQuantity, long long timestamp, long long order_id = -1, long long ownerId = 0);
+        long long add_market_order(bool isBuy, int quantity, long long timestamp, long long order_id = -1, long long ownerId = 0);
+        // Matching loops, instantiated once per allocation rule of MatchingPolicy.h
+        template<typename Allocation>
+        long long add_order_with(bool isBuy, long long priceTick, int quantity, int displayQuantity, long long timestamp, long long order_id, long long ownerId);
+        template<typename Allocation>
+        long long add_market_order_with(bool isBuy, int quantity, long long timestamp, long long order_id, long long ownerId);
+        template<typename Allocation>
+        void match_level_pro_rata(PriceLevel& level, Order& incoming, long long priceTick, long long timestamp, long long self_trade_owner, bool was_instant);
+        void prevent_self_trade(PriceLevel& level, std::list<Order>::iterator resting_iter, Order& incoming, long long timestamp);
+        void remove_resting(PriceLevel& level, std::list<Order>::iterator resting_iter, long long timestamp);
+
+        // Owner an incoming order compares resting owners against, -1 (which no order has) when it must never be stopped
+        long long self_trade_key(long long ownerId) const { return self_trade_prevention == SelfTradePrevention::NONE || ownerId == 0 ? -1 : ownerId; }
+        void activate_stop(const StopOrder& stop);
+        void release_triggered_orders();
+        bool release_stop_round();
+        bool fill_crossing_aon(bool isBuy);
+        bool has_liquidity(bool isBuy, long long priceTick, int quantity) const;
+        bool cancel_stop(long long order_id);
+        bool cancel_aon(long long order_id);
+
+        void record_trade(long long priceTick, long long timestamp) {
+            last_trade_price = priceTick;
+            last_trade_timestamp = timestamp;
+            trade_high = std::max(trade_high, priceTick);
+            trade_low = std::min(trade_low, priceTick);
+        }
+        bool has_crossed_stops() const {
+            return (!buy_stops.empty() && buy_stops.begin()->first <= trade_high) || (!sell_stops.empty() && sell_stops.rbegin()->first >= trade_low);
+        }
+        // Once nothing parked is crossed the traded range is dropped, so later stops are only triggered by later trades
+        void forget_traded_range() {
+            if (!has_crossed_stops()) {
+                trade_high = LLONG_MIN;
+                trade_low = LLONG_MAX;
+            }
+        }
+        bool has_crossing_aon() const {
+            return (!aon_buys.empty() && !sells.empty() && aon_buys.rbegin()->first >= sells.begin()->first)
+                || (!aon_sells.empty() && !buys.empty() && aon_sells.begin()->first <= buys.rbegin()->first);
+        }
+        // Nothing is released during a call auction, the uncross trades do it once the auction is closed
+        bool has_triggered_orders() const { return !auction_open && (has_crossed_stops() || has_crossing_aon()); }
+        UncrossResult find_clearing_price();
+        void fill_auction_front(bool isBuy, std::map<long long, PriceLevel>::iterator level_iter, int quantity, long long priceTick, long long timestamp);
+        void replenish_iceberg(PriceLevel& level, std::list<Order>::iterator iceberg_iter, long long timestamp);
+        void refresh_bbo();
+        void publish_depth_snapshot();
+        void update_depth(bool isBuy, long long priceTick, const PriceLevel* level);
+        void mark_depth_bytes(const void* address, std::size_t num_bytes);
+        void publish_level(bool isBuy, long long priceTick, const PriceLevel* level);
+        void notify_l2(bool isBuy, long long priceTick, const PriceLevel* level);
+        void prefetch_target(const OrderCommand& command) const;
+        void prefetch_order(long long order_id) const;
+        void erase_order(std::unordered_map<long long, std::tuple<long long, std::list<Order>::iterator, std::map<long long, PriceLevel>::iterator>>::iterator iter_lookup);
     public:
-        OrderBook(Metrics& metrics);
-        long long add_limit_order(bool isBuy, long long priceTick, int quantity, long long timestamp);
-        std::map<long long, std::list<Order>>::reverse_iterator get_best_bid();
-        std::map<long long, std::list<Order>>::iterator get_best_ask();
-        long long add_IOC_order(bool isBuy, int quantity, long long timestamp);
+        OrderBook(Metrics& metrics, MatchingAlgorithm matching_algorithm = MatchingAlgorithm::FIFO);
+        long long add_limit_order(bool isBuy, long long priceTick, int quantity, long long timestamp, long long ownerId = 0);
+        long long add_iceberg_order(bool isBuy, long long priceTick, int quantity, int displayQuantity, long long timestamp, long long ownerId = 0);
+        long long restore_resting_order(bool isBuy, long long priceTick, int quantity, int hiddenQuantity, int displayQuantity, long long timestamp, long long ownerId = 0);
+        std::map<long long, PriceLevel>::reverse_iterator get_best_bid();
+        std::map<long long, PriceLevel>::iterator get_best_ask();
+        long long add_IOC_order(bool isBuy, int quantity, long long timestamp, long long ownerId = 0);
+        long long add_stop_order(bool isBuy, long long triggerTick, long long limitTick, int quantity, long long timestamp, long long ownerId = 0);
+        long long add_FOK_order(bool isBuy, long long priceTick, int quantity, long long timestamp);
+        long long add_post_only_order(bool isBuy, long long priceTick, int quantity, long long timestamp);
+        long long add_AON_order(bool isBuy, long long priceTick, int quantity, long long timestamp);
         int cancel_order(long long orderId);
-        void modify_order(long long order_id, int new_quantity, long long timestamp);
+        std::size_t cancel_orders(const long long* order_ids, std::size_t num_orders);
+        long long modify_order(long long order_id, int new_quantity, long long timestamp);
+        OrderResult apply(const OrderCommand& command);
+        std::size_t apply_batch(const OrderCommand* commands, std::size_t num_commands, OrderResult* results, Trade* trades, std::size_t trades_capacity);
+        void clear();
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
+        std::size_t get_depth(bool isBuy, L2Level* levels, std::size_t max_levels) const;
+        void subscribe_l2(L2Listener listener) { l2_listeners.push_back(std::move(listener)); }
+        void subscribe_bbo(BboListener listener) { bbo_listeners.push_back(std::move(listener)); }
+        void open_auction() { auction_open = true; }
+        bool is_auction_open() const { return auction_open; }
+        UncrossResult uncross(long long timestamp);
+        void set_self_trade_prevention(SelfTradePrevention mode) { self_trade_prevention = mode; }
+        SelfTradePrevention get_self_trade_prevention() const { return self_trade_prevention; }
+        MatchingAlgorithm get_matching_algorithm() const { return matching_algorithm; }
         void snapshot();
 
-        std::map<long long, std::list<Order>>& get_buys() { return buys; }
-        std::map<long long, std::list<Order>>& get_sells() { return sells; }
-        std::unordered_map<long long, std::tuple<long long, std::list<Order>::iterator>>& get_order_lookup() {
+        std::map<long long, PriceLevel>& get_buys() { return buys; }
+        std::map<long long, PriceLevel>& get_sells() { return sells; }
+        std::unordered_map<long long, std::tuple<long long, std::list<Order>::iterator, std::map<long long, PriceLevel>::iterator>>& get_order_lookup() {
             return order_lookup;
         }
         TradeLog& get_trade_log() { return trade_log; }
+        const std::map<long long, std::list<StopOrder>>& get_buy_stops() const { return buy_stops; }
+        const std::map<long long, std::list<StopOrder>>& get_sell_stops() const { return sell_stops; }
+        const std::map<long long, std::list<Order>>& get_aon_buys() const { return aon_buys; }
+        const std::map<long long, std::list<Order>>& get_aon_sells() const { return aon_sells; }
+        bool is_live(long long order_id) const {
+            return order_lookup.find(order_id) != order_lookup.end() || stop_lookup.find(order_id) != stop_lookup.end() || aon_lookup.find(order_id) != aon_lookup.end();
+        }
+        // Visible and hidden quantity left of a resting order, 0 once it is off the book
+        int get_resting_quantity(long long order_id) const {
+            auto iter = order_lookup.find(order_id);
+            if (iter == order_lookup.end()) {
+                return 0;
+            }
+            const Order& order = *std::get<1>(iter->second);
+            return order.quantity + order.hiddenQuantity;
+        }
+        long long get_last_trade_price() const { return last_trade_price; }
+        // Rebuilding from a checkpoint, so restored stops see the price they were parked against
+        void restore_last_trade_price(long long priceTick) { last_trade_price = priceTick; }
+
+        // Matching thread
+        const BestBidOffer& get_bbo() const { return bbo; }
+        // Any thread, never blocks the matching thread
+        BestBidOffer load_bbo_snapshot() const { return bbo_snapshot.load(); }
+        DepthSnapshot load_depth_snapshot() const { return depth_snapshot.load(); }
+        // Single attempt for readers that would rather skip than spin, sequence grows by 2 per publish
+        bool try_load_depth_snapshot(DepthSnapshot& snapshot, std::uint64_t& sequence) const { return depth_snapshot.try_load(snapshot, sequence); }
 };
\ No newline at end of file
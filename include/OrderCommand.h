@@ -0,0 +1,60 @@
+#pragma once
+
+/**
+    A single order entry instruction addressed to an OrderBook, stored by value so it can be recorded, replayed or queued.
+    orderId is the id the instruction refers to: the id the order was given when it was recorded for adds, the target order for cancels and modifies.
+*/
+struct OrderCommand {
+    enum class Type : unsigned char {
+        ADD_LIMIT,
+        ADD_IOC,
+        CANCEL,
+        MODIFY,
+        ADD_ICEBERG,
+        ADD_STOP,   // stop-limit at priceTick, or stop market when priceTick is -1
+        ADD_FOK,
+        ADD_POST_ONLY,
+        ADD_AON
+    };
+
+    long long timestampUs;
+    long long orderId;
+    long long priceTick;
+    long long triggerTick;  // stop trigger price, unused by the other types
+    long long ownerId;      // account for self-trade prevention, 0 for none
+    int quantity;           // total quantity, for icebergs including the hidden reserve
+    int displayQuantity;    // iceberg slice size, unused by the other types
+    Type type;
+    bool isBuy;
+
+    OrderCommand() : timestampUs(0), orderId(-1), priceTick(-1), triggerTick(-1), ownerId(0), quantity(0), displayQuantity(0), type(Type::ADD_LIMIT), isBuy(false) {}
+    OrderCommand(Type type, long long timestampUs, long long orderId, bool isBuy, long long priceTick, int quantity, int displayQuantity = 0)
+        : timestampUs(timestampUs), orderId(orderId), priceTick(priceTick), triggerTick(-1), ownerId(0), quantity(quantity), displayQuantity(displayQuantity), type(type), isBuy(isBuy) {}
+
+    static OrderCommand stop(long long timestampUs, long long orderId, bool isBuy, long long triggerTick, long long limitTick, int quantity) {
+        OrderCommand command(Type::ADD_STOP, timestampUs, orderId, isBuy, limitTick, quantity);
+        command.triggerTick = triggerTick;
+        return command;
+    }
+};
+
+/**
+    Outcome of applying one OrderCommand, returned in the same order the commands were applied.
+*/
+struct OrderResult {
+    enum class Status : unsigned char {
+        RESTING,   // (remaining) quantity rests in the book
+        FILLED,    // fully executed on arrival
+        CANCELLED, // cancelled, or an IOC whose unfilled remainder was dropped
+        REJECTED,  // targeted order is not resting in the book, or a post-only order would have crossed
+        PENDING    // stop order waiting in its trigger book
+    };
+
+    long long clientOrderId;  // orderId of the command, echoed back
+    long long orderId;        // id in the book: the new order for adds and upsized modifies, the target otherwise
+    int filledQuantity;
+    int remainingQuantity;    // quantity left resting in the book, hidden iceberg reserve included
+    Status status;
+
+    OrderResult() : clientOrderId(-1), orderId(-1), filledQuantity(0), remainingQuantity(0), status(Status::REJECTED) {}
+};
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <unordered_map>
+#include "OrderBook.h"
+#include "OrderCommand.h"
+
+/**
+    A client's view of an OrderBook: applies OrderCommands that carry the client's own order ids and translates them to the ids the book assigns.
+    Used wherever commands are produced without a synchronous answer from the book (replay files, message queues between threads).
+*/
+class OrderEntrySession {
+    private:
+        OrderBook& orderbook;
+        std::unordered_map<long long, long long> client_to_book_ids;
+        std::unordered_map<long long, long long> book_to_client_ids;
+
+    public:
+        OrderEntrySession(OrderBook& orderbook);
+
+        OrderResult apply(const OrderCommand& command);
+        void map_ids(long long client_id, long long book_id);
+        long long find_book_id(long long client_id);
+        long long find_client_id(long long book_id) const;
+        void clear();
+
+        bool is_resting(long long book_id) const {
+            return book_id != -1 && orderbook.is_live(book_id);
+        }
+};
\ No newline at end of file
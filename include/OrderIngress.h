@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include "OrderBook.h"
+#include "OrderCommand.h"
+#include "SpscRing.h"
+
+/**
+    Lock-free order entry in front of an OrderBook owned by a single matching thread.
+    One producer thread (strategy, gateway, replay) submits commands and polls results, the matching thread calls process() in its loop.
+    Books with several producers keep one OrderIngress per producer, so every ring stays single-producer/single-consumer.
+*/
+class OrderIngress {
+    public:
+        static constexpr std::size_t RING_CAPACITY = 4096;
+        static constexpr std::size_t MAX_BATCH = 64;
+
+    private:
+        SpscRing<OrderCommand, RING_CAPACITY> command_ring;
+        SpscRing<OrderResult, RING_CAPACITY> result_ring;
+        OrderCommand batch[MAX_BATCH];
+        OrderResult batch_results[MAX_BATCH];
+
+    public:
+        OrderIngress();
+        OrderIngress(const OrderIngress&) = delete;
+        OrderIngress& operator=(const OrderIngress&) = delete;
+
+        // Producer side
+        bool submit(const OrderCommand& command) { return command_ring.try_push(command); }
+        bool poll_result(OrderResult& result) { return result_ring.try_pop(result); }
+
+        // Matching side
+        std::size_t process(OrderBook& orderbook, std::size_t max_batch = MAX_BATCH);
+
+        bool has_pending_commands() const { return !command_ring.empty(); }
+};
\ No newline at end of file
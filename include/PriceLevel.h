@@ -0,0 +1,61 @@
+#pragma once
+
+#include <list>
+#include "Order.h"
+
+/**
+    Orders resting at one price in time priority, with the level's total quantity kept up to date by the OrderBook on every
+    add, fill, cancel and modify, so depth can be read without walking the queue.
+    The read accessors mirror the std::list<Order> a level used to be.
+*/
+struct PriceLevel {
+    std::list<Order> orders;
+    long long total_quantity;
+    long long hidden_quantity; // iceberg reserve behind the displayed slices, counted by the auction uncross
+
+    PriceLevel() : orders(), total_quantity(0), hidden_quantity(0) {}
+
+    Order& front() { return orders.front(); }
+    const Order& front() const { return orders.front(); }
+    Order& back() { return orders.back(); }
+    const Order& back() const { return orders.back(); }
+    std::list<Order>::iterator begin() { return orders.begin(); }
+    std::list<Order>::const_iterator begin() const { return orders.begin(); }
+    std::list<Order>::iterator end() { return orders.end(); }
+    std::list<Order>::const_iterator end() const { return orders.end(); }
+    std::size_t size() const { return orders.size(); }
+    bool empty() const { return orders.empty(); }
+};
+
+/**
+    One row of the market-by-price (L2) view.
+*/
+struct L2Level {
+    long long priceTick;
+    long long quantity;
+    int numOrders;
+};
+
+/**
+    Incremental L2 update: the new aggregate state of one level. A quantity of 0 means the level was removed.
+*/
+struct L2Delta {
+    bool isBuy;
+    long long priceTick;
+    long long quantity;
+    int numOrders;
+};
+
+/**
+    Top levels of both sides, best price first, as published for readers on other threads.
+*/
+struct DepthSnapshot {
+    static constexpr int MAX_LEVELS = 10;
+
+    int numBids;
+    int numAsks;
+    L2Level bids[MAX_LEVELS];
+    L2Level asks[MAX_LEVELS];
+
+    DepthSnapshot() : numBids(0), numAsks(0), bids(), asks() {}
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+#include "Checkpoint.h"
+
+/**
+    Mid price path of the simulated market, one step per MarketEngine update. A process writes a whole block of steps per call into
+    contiguous buffers: the random draws of the block are made first, turned into normals in one pass, and the price
+    recursion then runs over them, so the RNG and the transcendental calls are not interleaved with the engine's work step by step.
+    Prices are in ticks, volatilities are the standard deviation of the step's price change in ticks.
+    A path only depends on the seed, not on how it is cut into blocks.
+*/
+class PriceProcess {
+    protected:
+        std::mt19937_64 rand_engine;
+        std::mt19937_64 fallback_engine;  // the rare normals that need more than their one draw
+        std::vector<std::uint64_t> draws; // raw bits of the block being generated
+        std::vector<double> normals;      // standard normals of the block being generated
+
+        PriceProcess(unsigned long long seed);
+
+        void draw_normals(std::size_t num_normals);
+        double sample_outside_rectangle(int layer, double position);
+
+        // Where the path is and the parameters driving it, everything of the process but the generators
+        virtual void save_path(CheckpointWriter& writer) const = 0;
+        virtual void load_path(CheckpointReader& reader) = 0;
+    public:
+        enum class Kind {
+            GBM,
+            ORNSTEIN_UHLENBECK,
+            GARCH,
+            JUMP_DIFFUSION
+        };
+
+        virtual ~PriceProcess() = default;
+
+        // Writes the next num_steps prices and the volatility each of them was drawn with
+        virtual void generate(double* prices, double* volatilities, std::size_t num_steps) = 0;
+        virtual Kind get_kind() const = 0;
+
+        // A process read back with load_state generates the same path the saved one would have generated
+        void save_state(CheckpointWriter& writer) const;
+        static std::unique_ptr<PriceProcess> load_state(CheckpointReader& reader);
+};
+
+// Geometric Brownian motion: log price moves by drift - volatility^2 / 2 + volatility * Z every step
+class GbmProcess : public PriceProcess {
+    private:
+        double log_price;
+        double log_drift;  // per step, Ito corrected
+        double volatility; // of the log price, per step
+
+        void save_path(CheckpointWriter& writer) const override;
+        void load_path(CheckpointReader& reader) override;
+    public:
+        GbmProcess(double start_price_ticks, double drift_per_step, double volatility_per_step, unsigned long long seed = 17);
+
+        void generate(double* prices, double* volatilities, std::size_t num_steps) override;
+        Kind get_kind() const override { return Kind::GBM; }
+};
+
+// Ornstein-Uhlenbeck mean reversion towards mean_price_ticks, sampled exactly: the distance to the mean shrinks by exp(-reversion) every step
+class OrnsteinUhlenbeckProcess : public PriceProcess {
+    private:
+        double price;
+        double mean_price;
+        double persistence; // exp(-reversion per step)
+        double step_stddev; // of the price change over one step, in ticks
+
+        void save_path(CheckpointWriter& writer) const override;
+        void load_path(CheckpointReader& reader) override;
+    public:
+        OrnsteinUhlenbeckProcess(double start_price_ticks, double mean_price_ticks, double reversion_per_step, double volatility_ticks_per_step, unsigned long long seed = 17);
+
+        void generate(double* prices, double* volatilities, std::size_t num_steps) override;
+        Kind get_kind() const override { return Kind::ORNSTEIN_UHLENBECK; }
+};
+
+// GARCH(1,1) log returns: return = sqrt(variance) * Z, next variance = omega + alpha * return^2 + beta * variance. Starts at the long run variance
+class GarchProcess : public PriceProcess {
+    private:
+        double log_price;
+        double variance; // of the next step's log return
+        double omega;
+        double alpha;
+        double beta;
+
+        void save_path(CheckpointWriter& writer) const override;
+        void load_path(CheckpointReader& reader) override;
+    public:
+        GarchProcess(double start_price_ticks, double omega, double alpha, double beta, unsigned long long seed = 17);
+
+        double get_long_run_variance() const { return omega / (1 - alpha - beta); }
+        void generate(double* prices, double* volatilities, std::size_t num_steps) override;
+        Kind get_kind() const override { return Kind::GARCH; }
+};
+
+/**
+    Merton jump-diffusion: a GBM whose log price also jumps by a normal(jump_mean, jump_stddev) with probability jump_probability per step.
+    The steps that jump are drawn as geometric gaps from a second generator, so the diffusion's block of normals stays branch-free.
+*/
+class JumpDiffusionProcess : public PriceProcess {
+    private:
+        double log_price;
+        double log_drift;        // per step, Ito corrected and compensated for the mean jump
+        double volatility;       // of the diffusion, per step
+        double total_volatility; // of the log price over one step, jumps included
+        double log_no_jump;      // log(1 - jump_probability)
+        std::mt19937_64 jump_engine;
+        std::normal_distribution<double> jump_size;
+        std::size_t steps_to_jump; // the next jump is on the steps_to_jump-th step still to generate
+
+        std::size_t draw_jump_gap();
+
+        void save_path(CheckpointWriter& writer) const override;
+        void load_path(CheckpointReader& reader) override;
+    public:
+        JumpDiffusionProcess(double start_price_ticks, double drift_per_step, double volatility_per_step, double jump_probability_per_step, double jump_mean, double jump_stddev, unsigned long long seed = 17);
+
+        void generate(double* prices, double* volatilities, std::size_t num_steps) override;
+        Kind get_kind() const override { return Kind::JUMP_DIFFUSION; }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "Checkpoint.h"
+
+/**
+    Fills our own resting orders from where they sit in their level's queue, for markets we only see as trades and level changes
+    (a synthetic flow, or a replayed feed) rather than order by order. Each tracked order keeps the volume resting ahead of it:
+    trades at its price eat that volume before they reach the order, cancels at its price take their share of it, and a trade
+    through its price fills it outright. Orders are grouped by side and price, so an event only visits the tracked orders at its price.
+*/
+class QueuePositionModel {
+    public:
+        // Called once the event that caused the fills has been applied, it may track and untrack orders but must not feed further events
+        using FillListener = std::function<void(long long order_id, bool isBuy, long long priceTick, int quantity)>;
+
+        struct TrackedOrder {
+            long long id;
+            long long priceTick;
+            long long volumeAhead; // resting quantity in front of the order, tracked orders of ours included
+            int quantity;          // not filled yet
+            bool isBuy;
+        };
+
+    private:
+        struct Fill {
+            long long orderId;
+            long long priceTick;
+            int quantity;
+            bool isBuy;
+        };
+
+        struct Location {
+            bool isBuy;
+            long long priceTick;
+        };
+
+        // price -> the tracked orders at that price, in arrival order. Kept inline so an event scans its level contiguously
+        std::map<long long, std::vector<TrackedOrder>> buy_levels;
+        std::map<long long, std::vector<TrackedOrder>> sell_levels;
+        std::unordered_map<long long, Location> order_locations;
+        FillListener fill_listener;
+        std::vector<Fill> fills; // filled during one event, reported once the model is consistent again
+
+        void fill_level(std::vector<TrackedOrder>& level, long long traded_quantity, long long priceTick);
+        void notify_fills();
+    public:
+        QueuePositionModel(FillListener fill_listener);
+
+        void track(long long order_id, bool isBuy, long long priceTick, int quantity, long long volume_ahead);
+        bool untrack(long long order_id);
+        void on_trade(bool isBuy, long long priceTick, int quantity);
+        void on_cancel(bool isBuy, long long priceTick, int quantity, long long level_quantity);
+        void clear();
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
+
+        const TrackedOrder* find(long long order_id) const;
+        std::size_t size() const { return order_locations.size(); }
+};
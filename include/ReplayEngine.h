@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "Metrics.h"
+#include "OrderBook.h"
+#include "OrderEntrySession.h"
+#include "ReplayLog.h"
+
+/**
+    Drives an OrderBook from a ReplayLog. Recorded order ids are translated to the ids the live book assigns,
+    so several engines can replay the same log side by side (see run_partitioned).
+*/
+class ReplayEngine {
+    private:
+        const ReplayLog& replay_log;
+        Metrics metrics;
+        OrderBook orderbook;
+        OrderEntrySession session; // recorded ids are the session's client ids
+
+        std::size_t next_event_index;
+        long long current_timestamp_us;
+        long long sample_interval_us;
+        long long last_sample_us;
+
+        void sample_market_state(long long timestamp_us);
+        void advance_until(long long timestamp_us, bool sample_metrics);
+
+    public:
+        struct WindowResult {
+            long long start_us;
+            long long end_us;
+            std::size_t events_applied;
+            Metrics metrics;
+        };
+
+        ReplayEngine(const ReplayLog& replay_log, long long sample_interval_us = 1000000);
+        ReplayEngine(const ReplayEngine&) = delete;
+        ReplayEngine& operator=(const ReplayEngine&) = delete;
+
+        void seek(long long timestamp_us);
+        void run_until(long long timestamp_us);
+        void apply(const OrderCommand& command);
+        void load_checkpoint(const ReplayLog::Checkpoint& checkpoint);
+        ReplayLog::Checkpoint capture_checkpoint(long long timestamp_us, std::size_t event_index);
+        void finalize(long long final_timestamp_us);
+
+        static std::vector<WindowResult> run_partitioned(const ReplayLog& replay_log, long long start_us, long long end_us, int num_windows, long long sample_interval_us = 1000000);
+
+        // Getters
+        OrderBook& get_orderbook() { return orderbook; }
+        Metrics& get_metrics() { return metrics; }
+        std::size_t get_next_event_index() const { return next_event_index; }
+        long long get_current_timestamp_us() const { return current_timestamp_us; }
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "OrderBook.h"
+#include "OrderCommand.h"
+
+/**
+    Historical order flow for a single book, stored as a time ordered list of OrderCommands plus periodic full-book checkpoints.
+    A checkpoint holds every resting order (in price-time priority), every waiting all-or-none order and every pending stop as it was right before events[event_index] was applied,
+    so a replay can start at any time T by loading the last checkpoint at or before T and replaying forward from there.
+*/
+class ReplayLog {
+    public:
+        struct RestingOrder {
+            long long orderId;
+            long long priceTick;
+            long long tsCreatedUs;
+            long long ownerId;
+            int quantity;
+            int hiddenQuantity;
+            int displayQuantity;
+            bool isBuy;
+        };
+
+        struct PendingStop {
+            long long orderId;
+            long long triggerTick;
+            long long limitTick;
+            long long tsCreatedUs;
+            long long ownerId;
+            int quantity;
+            bool isBuy;
+        };
+
+        struct Checkpoint {
+            long long timestamp_us;
+            std::size_t event_index;
+            std::vector<RestingOrder> orders;
+            std::vector<RestingOrder> aon_orders; // price-time priority per side, buys first
+            std::vector<PendingStop> stops; // in release priority per side, buys first
+            long long last_trade_price; // -1 before the first trade
+        };
+
+    private:
+        std::vector<OrderCommand> events;
+        std::vector<Checkpoint> checkpoints;
+        long long checkpoint_interval_us;
+        OrderBook::SelfTradePrevention self_trade_prevention; // mode of the recorded book, every replay and checkpoint runs with it
+
+    public:
+        ReplayLog();
+
+        void append(const OrderCommand& command);
+        void build_checkpoints(long long interval_us);
+        const Checkpoint* find_checkpoint(long long timestamp_us) const;
+
+        void save(const std::string& path) const;
+        void load(const std::string& path);
+
+        // Getters
+        const std::vector<OrderCommand>& get_events() const { return events; }
+        const std::vector<Checkpoint>& get_checkpoints() const { return checkpoints; }
+        long long get_checkpoint_interval_us() const { return checkpoint_interval_us; }
+        OrderBook::SelfTradePrevention get_self_trade_prevention() const { return self_trade_prevention; }
+        long long get_first_timestamp_us() const { return events.empty() ? 0 : events.front().timestampUs; }
+        long long get_last_timestamp_us() const { return events.empty() ? 0 : events.back().timestampUs; }
+
+        // Setters
+        void set_self_trade_prevention(OrderBook::SelfTradePrevention mode);
+};
\ No newline at end of file
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+    Single-writer sequence lock publishing a trivially copyable value to any number of readers on other threads.
+    The writer never waits, readers never write shared state and retry when they overlap a store (odd or changed sequence).
+    The payload is held in relaxed atomic words so concurrent reads are well defined.
+*/
+template<typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable.");
+
+    private:
+        static constexpr std::size_t CACHE_LINE_SIZE = 64;
+        static constexpr std::size_t NUM_WORDS = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+        alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> sequence;
+        std::atomic<std::uint64_t> words[NUM_WORDS];
+
+    public:
+        SeqLock() : sequence(0) {
+            for (std::size_t i = 0; i < NUM_WORDS; i++) {
+                words[i].store(0, std::memory_order_relaxed);
+            }
+        }
+        SeqLock(const SeqLock&) = delete;
+        SeqLock& operator=(const SeqLock&) = delete;
+
+        // Writer only
+        void store(const T& value) {
+            store_range(value, 0, sizeof(T));
+        }
+
+        /**
+         * @brief Writer only. Publishes value but only rewrites the words covering [byte_offset, byte_offset + byte_count),
+         *        for a writer that knows the rest of value equals what it published last time.
+         */
+        void store_range(const T& value, std::size_t byte_offset, std::size_t byte_count) {
+            if (byte_count == 0) {
+                return;
+            }
+
+            std::size_t first_word = byte_offset / sizeof(std::uint64_t);
+            std::size_t last_word = std::min(NUM_WORDS, (byte_offset + byte_count + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+
+            std::uint64_t current = sequence.load(std::memory_order_relaxed);
+            sequence.store(current + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            for (std::size_t i = first_word; i < last_word; i++) {
+                std::uint64_t word = 0;
+                std::memcpy(&word, bytes + i * sizeof(std::uint64_t), std::min(sizeof(std::uint64_t), sizeof(T) - i * sizeof(std::uint64_t)));
+                words[i].store(word, std::memory_order_relaxed);
+            }
+
+            sequence.store(current + 2, std::memory_order_release);
+        }
+
+        /**
+         * @brief Single attempt, fails when it overlapped a store.
+         * @param sequence_read sequence number of the copy, even and increasing by 2 per store
+         */
+        bool try_load(T& value, std::uint64_t& sequence_read) const {
+            std::uint64_t before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                return false;
+            }
+
+            std::uint64_t buffer[NUM_WORDS];
+            for (std::size_t i = 0; i < NUM_WORDS; i++) {
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) != before) {
+                return false;
+            }
+
+            std::memcpy(&value, buffer, sizeof(T));
+            sequence_read = before;
+            return true;
+        }
+
+        // Retries until it gets a consistent copy
+        T load() const {
+            T value;
+            std::uint64_t sequence_read;
+            while (!try_load(value, sequence_read)) {}
+            return value;
+        }
+
+        std::uint64_t get_sequence() const { return sequence.load(std::memory_order_acquire); }
+};
@@ -1,5 +1,10 @@
+#include "Checkpoint.h"
 #include "MarketEngine.h"
 #include "Strategy.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 
 class SimulationEngine {
     private:
@@ -10,9 +15,39 @@ class SimulationEngine {
         long long ending_timestamp_us;
         long long step_us;
 
+        // run() saves a checkpoint to checkpoint_path every checkpoint_interval_us of simulated time, 0 for never
+        std::string checkpoint_path;
+        long long checkpoint_interval_us;
+        long long next_checkpoint_us;
+
+        void step();
+
     public:
+        // Changes one what-if branch makes to its fork (strategy parameters, fill model...) before it runs on
+        using BranchVariant = std::function<void(SimulationEngine& branch)>;
+
+        struct BranchResult {
+            std::size_t variant;
+            long long end_us;
+            Metrics metrics;
+        };
+
+        static const char CHECKPOINT_MAGIC[4];
+        static const std::uint32_t CHECKPOINT_VERSION;
+
         SimulationEngine(long long starting_timestamp_us, long long ending_timestamp_us, long long step_us, int strategy_quote_size = 1, long long strategy_tick_offset = 1, long long strategy_max_inv = 10, long long strategy_cancel_threshold = 1, long long strategy_cooldown_between_requotes = 1, long long starting_mid_price = 10000, long long start_spread = 2, double start_vol= 1.0, double start_fill_prob = 0.3);
         void run();
+        void run_until(long long timestamp_us);
+
+        // Whole simulation state, ids and generators included: an engine that loads it continues exactly as the saved one would have
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
+        void save_checkpoint(const std::string& path) const;
+        void load_checkpoint(const std::string& path);
+        void set_checkpointing(const std::string& path, long long interval_us);
+
+        std::unique_ptr<SimulationEngine> fork() const;
+        std::vector<BranchResult> run_branches(const std::vector<BranchVariant>& variants, long long end_us, int num_threads = 0) const;
 
         void finalize(long long final_timestamp_us);
 
@@ -20,4 +55,5 @@ class SimulationEngine {
         long long get_current_timestamp_us() { return current_timestamp_us; }
         long long get_ending_timestamp_us() { return ending_timestamp_us; }
         long long get_step_us() {return step_us; }
+        MarketEngine& get_market_engine() { return market_engine; }
 };
\ No newline at end of file
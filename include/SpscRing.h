@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+
+/**
+    Bounded, lock-free single-producer/single-consumer ring buffer of fixed-size elements.
+    Producer and consumer indices live on separate cache lines, each side keeps a cached copy of the other side's index
+    so the shared atomic is only read again when the ring looks full (producer) or empty (consumer).
+*/
+template<typename T, std::size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two.");
+
+    private:
+        static constexpr std::size_t CACHE_LINE_SIZE = 64;
+        static constexpr std::size_t MASK = Capacity - 1;
+
+        // Consumer side
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> head;
+        std::size_t cached_tail;
+
+        // Producer side
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> tail;
+        std::size_t cached_head;
+
+        alignas(CACHE_LINE_SIZE) T slots[Capacity];
+
+    public:
+        SpscRing() : head(0), cached_tail(0), tail(0), cached_head(0), slots() {}
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // Producer only
+        bool try_push(const T& value) {
+            std::size_t current_tail = tail.load(std::memory_order_relaxed);
+
+            if (current_tail - cached_head == Capacity) {
+                cached_head = head.load(std::memory_order_acquire);
+                if (current_tail - cached_head == Capacity) {
+                    return false;
+                }
+            }
+
+            slots[current_tail & MASK] = value;
+            tail.store(current_tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Producer only, slots that can be pushed without failing
+        std::size_t free_slots() {
+            cached_head = head.load(std::memory_order_acquire);
+            return Capacity - (tail.load(std::memory_order_relaxed) - cached_head);
+        }
+
+        // Consumer only
+        bool try_pop(T& value) {
+            std::size_t current_head = head.load(std::memory_order_relaxed);
+
+            if (current_head == cached_tail) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (current_head == cached_tail) {
+                    return false;
+                }
+            }
+
+            value = slots[current_head & MASK];
+            head.store(current_head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Consumer only. Moves up to max_count elements into out and publishes the new head once for the whole batch.
+         * @return number of elements dequeued
+         */
+        std::size_t pop_batch(T* out, std::size_t max_count) {
+            std::size_t current_head = head.load(std::memory_order_relaxed);
+
+            if (cached_tail - current_head < max_count) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (current_head == cached_tail) {
+                    return 0;
+                }
+            }
+
+            std::size_t count = std::min(max_count, cached_tail - current_head);
+            for (std::size_t i = 0; i < count; i++) {
+                out[i] = slots[(current_head + i) & MASK];
+            }
+
+            head.store(current_head + count, std::memory_order_release);
+            return count;
+        }
+
+        bool empty() const {
+            return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+        }
+
+        std::size_t size_approx() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        static constexpr std::size_t capacity() { return Capacity; }
+};
\ No newline at end of file
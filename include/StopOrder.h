@@ -0,0 +1,15 @@
+#pragma once
+
+/**
+    Stop or stop-limit order waiting in a trigger book. It is released when a trade prints at or through triggerTick
+    (at or above for buys, at or below for sells) and then enters the book under the same id.
+*/
+struct StopOrder {
+    long long id;
+    long long triggerTick;
+    long long limitTick; // -1 for a stop market order, released as an IOC
+    long long tsCreatedUs;
+    long long ownerId;
+    int quantity;
+    bool isBuy;
+};
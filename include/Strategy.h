@@ -4,6 +4,7 @@
 #include "Metrics.h"
 #include "Order.h"
 #include "OrderBook.h"
+#include "StrategyBase.h"
 #include <functional>
 #include <queue>
 #include <string>
@@ -13,14 +14,12 @@
 #include <vector>
 
 /**
-    Ping pong strategy is implemented
+    Ping pong strategy is implemented, as one strategy of the framework in StrategyBase.h
 */
-class Strategy {
-    private:
-        Metrics& metrics;
-        OrderBook& order_book;
-        LatencyQueue latency_queue;
+class PingPongStrategy : public StrategyBase<PingPongStrategy> {
+    friend class StrategyBase<PingPongStrategy>;
 
+    private:
         using PongOrderData = std::pair<long long, std::pair<long long, int>>;
         std::priority_queue<PongOrderData> buy_pongs;
         std::priority_queue<PongOrderData, std::vector<PongOrderData>, std::greater<PongOrderData>> sell_pongs;
@@ -41,6 +40,13 @@ class Strategy {
         long long active_sell_order_id;
         long long last_pinged_market_price_ticks;
         long long last_quote_time_us;
+        long long owner_id; // account stamped on every order, lets self-trade prevention keep the ping and pong legs apart. 0 for none
+
+        // In-flight pings, a ping is priced when it arrives so one in flight already stands for any newer one on its side
+        LatencyQueue::EventHandle pending_buy_ping;
+        LatencyQueue::EventHandle pending_sell_ping;
+        // In-flight cancel check, it judges the market the strategy knows when it arrives so one in flight covers every update until then
+        LatencyQueue::EventHandle pending_cancel_check;
 
         enum class State {
             WAITING_TO_BUY,
@@ -48,9 +54,24 @@ class Strategy {
             BALANCED
         };
         State state;
+
+        // Called by StrategyBase for the due events of the latency queue, one per typed event the strategy schedules besides fill acknowledgements
+        void on_event(const LatencyQueue::OrderSend& order, long long exec_time);
+        void on_event(const LatencyQueue::Cancel& cancel, long long exec_time);
+        void on_event(const LatencyQueue::Modify& modify, long long exec_time);
+        void on_event(const LatencyQueue::MarketUpdate& update, long long exec_time);
+
+        void on_market_observed(long long market_price);
+        void on_cancel_check(long long exec_time);
+        void cancel_resting(long long order_id, long long exec_time);
+        void send_ping(bool isBuy, long long exec_time);
+        void on_ping_fill_acknowledged(const LatencyQueue::AcknowledgeFill& fill, long long ack_exec_time);
+        void send_pong(const LatencyQueue::OrderSend& pong, long long exec_time);
+        void fill_pong(bool isBuy, long long order_id, long long price_ticks, long long timestamp_us);
+        void on_pong_fill_acknowledged(const LatencyQueue::AcknowledgeFill& fill, long long exec_time);
     public:
-        Strategy(Metrics& metrics, OrderBook& orderbook, int quote_size, long long tick_offset, long long max_inv, long long cancel_threshold, long long cooldown_between_requotes);
-        ~Strategy();
+        PingPongStrategy(Metrics& metrics, OrderBook& orderbook, int quote_size, long long tick_offset, long long max_inv, long long cancel_threshold, long long cooldown_between_requotes);
+        ~PingPongStrategy();
         
         void observe_the_market(long long timestamp, long long market_price);
         void cancel_mechanism(long long);
@@ -63,16 +84,18 @@ class Strategy {
         long long pong_on_ask_filled(long long);
         void check_and_fill_pongs(long long market_price, long long timestamp_us);
 
+        // Hooks
         void on_market_update(long long timestamp, long long market_price);
         void on_fill(const Trade& trade);
+        void on_ack(const LatencyQueue::AcknowledgeFill& fill, long long exec_time);
+        bool is_quote_stale(long long market_price_ticks) const;
 
-        void execute_latency_queue(long long current_timestamp_us) {
-            latency_queue.process_until(current_timestamp_us);
-        }
+        void save_state(CheckpointWriter& writer) const;
+        void load_state(CheckpointReader& reader);
 
         // Getters
-        long long get_best_bid_ticks() const { return order_book.get_buys().empty() ? 0 : order_book.get_buys().rbegin()->first; }
-        long long get_best_ask_ticks() const { return order_book.get_sells().empty() ? 0 : order_book.get_sells().begin()->first; }
+        long long get_best_bid_ticks() const { return order_book.get_bbo().bidPriceTick; }
+        long long get_best_ask_ticks() const { return order_book.get_bbo().askPriceTick; }
         long long get_mid_price_ticks() const { return (best_bid_ticks + best_ask_ticks) / 2; }
         long long get_current_market_price_ticks() const { return current_market_price_ticks; }
         long long get_current_inventory() const { return metrics.position; }
@@ -88,18 +111,15 @@ class Strategy {
         long long get_active_sell_order_id() const { return active_sell_order_id; }
         long long get_last_pinged_mid_price_ticks() const { return last_pinged_market_price_ticks; }
         long long get_last_quote_time_us() const { return last_quote_time_us; }
+        long long get_owner_id() const { return owner_id; }
         
         State get_state() const { return state; }
 
         Metrics::OrderCacheData& get_active_buy_order_data();
         Metrics::OrderCacheData& get_active_sell_order_data();
 
-        Metrics& get_metrics() { return metrics; }
-
         std::priority_queue<PongOrderData>& get_buy_pongs() { return buy_pongs; }
         std::priority_queue<PongOrderData, std::vector<PongOrderData>, std::greater<PongOrderData>>& get_sell_pongs() { return sell_pongs; }
-        
-        LatencyQueue& get_latency_queue() { return latency_queue; }
 
         // Setters
         void set_quote_size(int value) { 
@@ -134,6 +154,7 @@ class Strategy {
         }
         
         void set_state(State value) { state = value; }
+        void set_owner_id(long long value) { owner_id = value; }
 
         void set_latency_config(long long order_send_min, long long order_send_max, 
                                 long long cancel_min, long long cancel_max, 
@@ -147,4 +168,17 @@ class Strategy {
                                                 acknowledge_fill_min, acknowledge_fill_max, 
                                                 market_update_min, market_update_max);
         }
-};
\ No newline at end of file
+
+        // Per strategy: each strategy has its own queue, so its own sessions. For every direction or for one
+        void set_latency_model(LatencyQueue::LatencyModel model) { latency_queue.set_latency_model(model); }
+        void set_latency_model(LatencyQueue::Channel channel, LatencyQueue::LatencyModel model) { latency_queue.set_latency_model(channel, model); }
+        void set_session_congestion(double spikes_per_second, double spike_mean_us, double decay_us) {
+            latency_queue.set_session_congestion(spikes_per_second, spike_mean_us, decay_us);
+        }
+        void set_session_congestion(LatencyQueue::Channel channel, double spikes_per_second, double spike_mean_us, double decay_us) {
+            latency_queue.set_session_congestion(channel, spikes_per_second, spike_mean_us, decay_us);
+        }
+};
+
+// The engines' default strategy
+using Strategy = PingPongStrategy;
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <type_traits>
+#include "Checkpoint.h"
+#include "LatencyQueue.h"
+#include "Metrics.h"
+#include "OrderBook.h"
+#include "Trade.h"
+
+/**
+    Static (CRTP) side of the strategy framework. A strategy derives from StrategyBase<itself> and defines the hooks it needs under
+    the names below, hiding the defaults: BasicMarketEngine<StrategyT> calls them on StrategyT directly, so they inline like plain
+    member calls. The engine calls:
+
+        on_market_update(timestamp_us, market_price_ticks)  every update, with the exchange's price
+        on_fill(trade)                                      when one of the strategy's quotes trades, at the exchange
+        on_timer(timestamp_us)                              every update, after on_market_update. Fires the events now due
+
+    on_timer hands each due event of the latency queue to the strategy: fill acknowledgements to on_ack(fill, exec_time), every other
+    event to an on_event(event, exec_time) overload, and records the event's time in flight. The fill models ask for the resting quote
+    of each side (get_active_buy_order_id / get_active_sell_order_id, -1 for none) and is_quote_stale(market_price_ticks) measures
+    stale-quote exposure. The engine constructs a strategy from (Metrics&, OrderBook&, quote_size, tick_offset, max_inventory,
+    cancel_threshold, cooldown_between_requotes), a strategy can ignore the parameters it has no use for.
+*/
+template<typename Derived>
+class StrategyBase {
+    protected:
+        Metrics& metrics;
+        OrderBook& order_book;
+        LatencyQueue latency_queue;
+
+        StrategyBase(Metrics& metrics, OrderBook& order_book) : metrics(metrics), order_book(order_book), latency_queue() {}
+
+        Derived& derived() { return static_cast<Derived&>(*this); }
+        const Derived& derived() const { return static_cast<const Derived&>(*this); }
+    public:
+        // Hooks, doing nothing unless the strategy defines them
+        void on_market_update(long long, long long) {}
+        void on_fill(const Trade&) {}
+        void on_ack(const LatencyQueue::AcknowledgeFill&, long long) {}
+        void on_timer(long long timestamp_us) { execute_latency_queue(timestamp_us); }
+        // Events the strategy schedules for itself and has no overload for are dropped
+        template<typename Event>
+        void on_event(const Event&, long long) {}
+
+        long long get_active_buy_order_id() const { return -1; }
+        long long get_active_sell_order_id() const { return -1; }
+        bool is_quote_stale(long long) const { return false; }
+
+        void execute_latency_queue(long long timestamp_us) {
+            latency_queue.process_until(timestamp_us, [this](const auto& event, long long exec_time, long long sent_us) {
+                using Event = std::decay_t<decltype(event)>;
+                constexpr LatencyQueue::Channel channel = LatencyQueue::channel_of<Event>();
+                metrics.on_event_delivered(static_cast<Metrics::Direction>(channel), sent_us, exec_time);
+                if constexpr (std::is_same<Event, LatencyQueue::AcknowledgeFill>::value) {
+                    derived().on_ack(event, exec_time);
+                }
+                else {
+                    derived().on_event(event, exec_time);
+                }
+            });
+        }
+
+        // A strategy with state of its own writes it before the latency queue
+        void save_state(CheckpointWriter& writer) const { latency_queue.save_state(writer); }
+        void load_state(CheckpointReader& reader) { latency_queue.load_state(reader); }
+
+        Metrics& get_metrics() { return metrics; }
+        OrderBook& get_order_book() { return order_book; }
+        LatencyQueue& get_latency_queue() { return latency_queue; }
+};
+
+static_assert(LatencyQueue::NUM_CHANNELS == Metrics::NUM_DIRECTIONS, "Every latency channel is reported as the metrics direction of the same index.");
@@ -8,4 +8,5 @@ class TradeLog {
         long long add_trade(long long buyId, long long sellId, long long priceTick, int quantity, long long timestampUs, bool was_instant);
         void show_trades();
         std::list<Trade>& get_trades() { return trades; }
+        const std::list<Trade>& get_trades() const { return trades; }
 };
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "../include/BackgroundFlow.h"
+
+BackgroundFlow::BackgroundFlow(OrderBook& orderbook, unsigned long long seed) : orderbook(orderbook), rand_engine(seed), populations(), current_timestamp_us(-1),
+                                                                                batch(), batch_sources(), batch_results(), num_commands_sent(0) {
+    batch.reserve(MAX_BATCH_SIZE + 4);
+    batch_sources.reserve(MAX_BATCH_SIZE + 4);
+    batch_results.resize(MAX_BATCH_SIZE + 4);
+}
+
+/**
+ * @brief Adds a population of agents. Its first arrival is drawn from the current time, or from the first advance_to if the flow has not started.
+ */
+void BackgroundFlow::add_population(const AgentPopulation& population) {
+    populations.push_back({population, std::numeric_limits<double>::infinity(), nullptr, HawkesProcess::BUY_MARKET, {}, 0, 0, -1});
+
+    if (current_timestamp_us != -1) {
+        start_arrivals(populations.back(), current_timestamp_us);
+    }
+}
+
+/**
+ * @brief Adds a population whose arrivals and actions are the events of a Hawkes process with the given parameters.
+ *        Its limit orders rest within price_range_ticks of the reference price, its cancels target its own live orders.
+ */
+void BackgroundFlow::add_hawkes_population(const HawkesProcess::Parameters& parameters, long long price_range_ticks, int min_quantity, int max_quantity) {
+    AgentPopulation population = {AgentType::HAWKES_FLOW, 0, min_quantity, max_quantity, price_range_ticks, 0, 0, 0, 0, 0};
+    populations.push_back({population, std::numeric_limits<double>::infinity(), std::make_unique<HawkesProcess>(parameters, 0, rand_engine()), HawkesProcess::BUY_MARKET, {}, 0, 0, -1});
+
+    if (current_timestamp_us != -1) {
+        start_arrivals(populations.back(), current_timestamp_us);
+    }
+}
+
+void BackgroundFlow::start_arrivals(PopulationState& state, long long timestamp_us) {
+    if (state.hawkes) {
+        state.hawkes->reset(timestamp_us);
+        draw_next_arrival(state);
+    }
+    else if (state.population.arrivalsPerSecond > 0) {
+        state.next_arrival_us = timestamp_us;
+        draw_next_arrival(state);
+    }
+}
+
+void BackgroundFlow::draw_next_arrival(PopulationState& state) {
+    if (state.hawkes) {
+        HawkesProcess::Event event = state.hawkes->next();
+        state.next_arrival_us = event.timestampUs;
+        state.next_mark = event.mark;
+        return;
+    }
+
+    std::exponential_distribution<double> gap_us(state.population.arrivalsPerSecond / 1e6);
+    state.next_arrival_us += gap_us(rand_engine);
+}
+
+/**
+ * @brief Sends into the book every arrival of every population up to timestamp_us (excluded), in time order.
+ *        reference_price is the price the market is anchored to (the fundamental of the simulation). Noise traders and market makers
+ *        price around it, momentum takers watch the mid of the book and fall back on it while one side of the book is empty.
+ *        The first call only starts the clock.
+ */
+void BackgroundFlow::advance_to(long long timestamp_us, long long reference_price) {
+    if (current_timestamp_us == -1) {
+        current_timestamp_us = timestamp_us;
+        for (PopulationState& state : populations) {
+            start_arrivals(state, timestamp_us);
+        }
+        return;
+    }
+
+    long long mid = book_mid(reference_price);
+    while (true) {
+        // A handful of populations, a linear scan for the next arrival beats keeping a heap in order
+        std::size_t next = populations.size();
+        for (std::size_t i = 0; i < populations.size(); i++) {
+            if (populations[i].next_arrival_us < timestamp_us && (next == populations.size() || populations[i].next_arrival_us < populations[next].next_arrival_us)) {
+                next = i;
+            }
+        }
+        if (next == populations.size()) {
+            break;
+        }
+
+        add_arrival(next, (long long)populations[next].next_arrival_us, reference_price, mid);
+        draw_next_arrival(populations[next]);
+
+        if (batch.size() >= MAX_BATCH_SIZE) {
+            flush_batch();
+            mid = book_mid(reference_price);
+        }
+    }
+
+    flush_batch();
+    current_timestamp_us = std::max(current_timestamp_us, timestamp_us);
+}
+
+/**
+    What one agent of the population does when it arrives, decided on the state of the book at the start of the batch.
+*/
+void BackgroundFlow::add_arrival(std::size_t population_index, long long timestamp_us, long long reference_price, long long mid) {
+    PopulationState& state = populations[population_index];
+    const AgentPopulation& population = state.population;
+    std::uniform_real_distribution<double> share(0.0, 1.0);
+    std::bernoulli_distribution side(0.5);
+
+    switch (population.type) {
+        case AgentType::NOISE_TRADER: {
+            double action = share(rand_engine);
+            if (action < population.cancelShare) {
+                if (!state.live_orders.empty()) {
+                    std::uniform_int_distribution<std::size_t> target(0, state.live_orders.size() - 1);
+                    add_cancel(population_index, timestamp_us, target(rand_engine));
+                }
+            }
+            else if (action < population.cancelShare + population.marketOrderShare) {
+                add_command(population_index, OrderCommand(OrderCommand::Type::ADD_IOC, timestamp_us, -1, side(rand_engine), -1, draw_quantity(population)));
+            }
+            else {
+                bool is_buy = side(rand_engine);
+                std::uniform_int_distribution<long long> distance(1, std::max<long long>(1, population.priceRangeTicks));
+                long long price = is_buy ? reference_price - distance(rand_engine) : reference_price + distance(rand_engine);
+                add_command(population_index, OrderCommand(OrderCommand::Type::ADD_LIMIT, timestamp_us, -1, is_buy, price, draw_quantity(population)));
+            }
+            break;
+        }
+        case AgentType::MARKET_MAKER: {
+            // Quotes go in as bid/ask pairs, so the two oldest live orders are the oldest pair. When the quotes to replace are still
+            // in the batch, it is applied first to learn their ids
+            if (state.live_orders.size() + state.pending_adds + 2 > population.maxLiveOrders) {
+                if (state.live_orders.size() < 2 && state.pending_adds > 0) {
+                    flush_batch();
+                }
+                if (state.live_orders.size() >= 2) {
+                    add_cancel(population_index, timestamp_us, 0);
+                    add_cancel(population_index, timestamp_us, 0);
+                }
+            }
+            std::uniform_int_distribution<long long> depth(0, std::max<long long>(0, population.priceRangeTicks));
+            add_command(population_index, OrderCommand(OrderCommand::Type::ADD_LIMIT, timestamp_us, -1, true, reference_price - population.halfSpreadTicks - depth(rand_engine), draw_quantity(population)));
+            add_command(population_index, OrderCommand(OrderCommand::Type::ADD_LIMIT, timestamp_us, -1, false, reference_price + population.halfSpreadTicks + depth(rand_engine), draw_quantity(population)));
+            break;
+        }
+        case AgentType::MOMENTUM_TAKER: {
+            long long move = state.last_seen_mid == -1 ? 0 : mid - state.last_seen_mid;
+            state.last_seen_mid = mid;
+            if (move != 0 && std::abs(move) >= population.thresholdTicks) {
+                add_command(population_index, OrderCommand(OrderCommand::Type::ADD_IOC, timestamp_us, -1, move > 0, -1, draw_quantity(population)));
+            }
+            break;
+        }
+        case AgentType::HAWKES_FLOW: {
+            bool is_buy = state.next_mark == HawkesProcess::BUY_MARKET || state.next_mark == HawkesProcess::BUY_LIMIT || state.next_mark == HawkesProcess::BUY_CANCEL;
+            if (state.next_mark == HawkesProcess::BUY_MARKET || state.next_mark == HawkesProcess::SELL_MARKET) {
+                add_command(population_index, OrderCommand(OrderCommand::Type::ADD_IOC, timestamp_us, -1, is_buy, -1, draw_quantity(population)));
+            }
+            else if (state.next_mark == HawkesProcess::BUY_LIMIT || state.next_mark == HawkesProcess::SELL_LIMIT) {
+                std::uniform_int_distribution<long long> distance(1, std::max<long long>(1, population.priceRangeTicks));
+                long long price = is_buy ? reference_price - distance(rand_engine) : reference_price + distance(rand_engine);
+                add_command(population_index, OrderCommand(OrderCommand::Type::ADD_LIMIT, timestamp_us, -1, is_buy, price, draw_quantity(population)));
+            }
+            else if (!state.live_orders.empty()) {
+                // The live list does not keep sides, a few orders from a random start are looked up in the book for one of the mark's side
+                std::uniform_int_distribution<std::size_t> start(0, state.live_orders.size() - 1);
+                std::size_t index = start(rand_engine);
+                for (int probe = 0; probe < 8 && probe < (int)state.live_orders.size(); probe++, index = (index + 1) % state.live_orders.size()) {
+                    auto iter_lookup = orderbook.get_order_lookup().find(state.live_orders[index]);
+                    if (iter_lookup != orderbook.get_order_lookup().end() && std::get<1>(iter_lookup->second)->isBuy == is_buy) {
+                        add_cancel(population_index, timestamp_us, index);
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+    }
+}
+
+void BackgroundFlow::add_command(std::size_t population_index, const OrderCommand& command) {
+    batch.push_back(command);
+    batch_sources.push_back(population_index);
+    if (command.type != OrderCommand::Type::CANCEL) {
+        populations[population_index].pending_adds++;
+    }
+}
+
+/**
+    Cancels the population's live order at live_index. It leaves the live list right away, so no later arrival of the batch targets it again.
+    Noise traders pick at random and take the last order's slot, market makers cancel from the front and keep their quotes oldest first.
+*/
+void BackgroundFlow::add_cancel(std::size_t population_index, long long timestamp_us, std::size_t live_index) {
+    std::vector<long long>& live_orders = populations[population_index].live_orders;
+    add_command(population_index, OrderCommand(OrderCommand::Type::CANCEL, timestamp_us, live_orders[live_index], false, -1, 0));
+
+    if (populations[population_index].population.type == AgentType::MARKET_MAKER) {
+        live_orders.erase(live_orders.begin() + live_index);
+    }
+    else {
+        live_orders[live_index] = live_orders.back();
+        live_orders.pop_back();
+    }
+}
+
+int BackgroundFlow::draw_quantity(const AgentPopulation& population) {
+    std::uniform_int_distribution<int> quantity(std::max(1, population.minQuantity), std::max(std::max(1, population.minQuantity), population.maxQuantity));
+    return quantity(rand_engine);
+}
+
+/**
+    Applies the pending commands to the book in one batch and records the orders that came to rest with the populations that sent them.
+*/
+void BackgroundFlow::flush_batch() {
+    if (batch.empty()) {
+        return;
+    }
+
+    orderbook.apply_batch(batch.data(), batch.size(), batch_results.data(), nullptr, 0);
+    for (std::size_t i = 0; i < batch.size(); i++) {
+        if (batch[i].type != OrderCommand::Type::CANCEL && batch_results[i].status == OrderResult::Status::RESTING) {
+            populations[batch_sources[i]].live_orders.push_back(batch_results[i].orderId);
+        }
+    }
+    num_commands_sent += batch.size();
+    batch.clear();
+    batch_sources.clear();
+
+    for (PopulationState& state : populations) {
+        state.pending_adds = 0;
+        prune_filled(state);
+    }
+}
+
+/**
+    Orders filled by the flow stay in their population's live list until they are picked for a cancel. Once the list doubled since
+    the last prune, the ones no longer in the book are dropped, which keeps the list and the wasted cancels proportional to the resting orders.
+*/
+void BackgroundFlow::prune_filled(PopulationState& state) {
+    if (state.live_orders.size() <= 2 * state.live_after_prune + 64) {
+        return;
+    }
+
+    std::vector<long long>& live_orders = state.live_orders;
+    live_orders.erase(std::remove_if(live_orders.begin(), live_orders.end(), [this](long long order_id) { return !orderbook.is_live(order_id); }), live_orders.end());
+    state.live_after_prune = live_orders.size();
+}
+
+long long BackgroundFlow::book_mid(long long reference_price) const {
+    const BestBidOffer& bbo = orderbook.get_bbo();
+    if (bbo.bidQuantity == 0 || bbo.askQuantity == 0) {
+        return reference_price;
+    }
+    return (bbo.bidPriceTick + bbo.askPriceTick) / 2;
+}
+
+/**
+ * @brief Forgets the populations' live orders and restarts the clock, the populations themselves are kept. Does not touch the book.
+ */
+void BackgroundFlow::clear() {
+    for (PopulationState& state : populations) {
+        if (state.hawkes) {
+            state.hawkes->reset(0);
+        }
+        state.next_arrival_us = std::numeric_limits<double>::infinity();
+        state.live_orders.clear();
+        state.pending_adds = 0;
+        state.live_after_prune = 0;
+        state.last_seen_mid = -1;
+    }
+    batch.clear();
+    batch_sources.clear();
+    current_timestamp_us = -1;
+}
+
+/**
+ * @brief Writes the populations with where each one is in its arrivals and the orders it has resting, and the flow's generator.
+ *        Populations are saved whole, a flow read back needs no populations added beforehand.
+ */
+void BackgroundFlow::save_state(CheckpointWriter& writer) const {
+    writer.write_streamed(rand_engine);
+    writer.write(current_timestamp_us);
+    writer.write(num_commands_sent);
+
+    writer.write<std::uint64_t>(populations.size());
+    for (const PopulationState& state : populations) {
+        writer.write(state.population);
+        writer.write(state.next_arrival_us);
+        writer.write(state.next_mark);
+        writer.write_vector(state.live_orders);
+        writer.write(state.live_after_prune);
+        writer.write(state.last_seen_mid);
+        writer.write(state.hawkes != nullptr);
+        if (state.hawkes) {
+            state.hawkes->save_state(writer);
+        }
+    }
+}
+
+void BackgroundFlow::load_state(CheckpointReader& reader) {
+    reader.read_streamed(rand_engine);
+    current_timestamp_us = reader.read<long long>();
+    num_commands_sent = reader.read<std::size_t>();
+    batch.clear();
+    batch_sources.clear();
+
+    populations.clear();
+    std::uint64_t num_populations = reader.read<std::uint64_t>();
+    for (std::uint64_t i = 0; i < num_populations; i++) {
+        PopulationState state = {reader.read<AgentPopulation>(), 0, nullptr, HawkesProcess::BUY_MARKET, {}, 0, 0, -1};
+        state.next_arrival_us = reader.read<double>();
+        state.next_mark = reader.read<HawkesProcess::Mark>();
+        reader.read_vector(state.live_orders);
+        state.live_after_prune = reader.read<std::size_t>();
+        state.last_seen_mid = reader.read<long long>();
+        if (reader.read<bool>()) {
+            state.hawkes = std::make_unique<HawkesProcess>(HawkesProcess::Parameters::uniform(1, 0, 0, 1));
+            state.hawkes->load_state(reader);
+        }
+        populations.push_back(std::move(state));
+    }
+}
@@ -0,0 +1,42 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "../include/Checkpoint.h"
+
+/**
+ * @brief Writes the checkpoint next to path and renames it over path once complete, so a crash while saving leaves the previous one intact.
+ */
+void CheckpointWriter::save(const std::string& path) const {
+    const std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream out(temporary_path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Could not open checkpoint file for writing: " + temporary_path);
+        }
+
+        out.write(buffer.data(), buffer.size());
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed while writing checkpoint file: " + temporary_path);
+        }
+    }
+
+    if (std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not move checkpoint file into place: " + path);
+    }
+}
+
+CheckpointReader CheckpointReader::from_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Could not open checkpoint file for reading: " + path);
+    }
+
+    std::vector<char> buffer((std::size_t)in.tellg());
+    in.seekg(0);
+    if (!in.read(buffer.data(), buffer.size())) {
+        throw std::runtime_error("Failed while reading checkpoint file: " + path);
+    }
+    return CheckpointReader(std::move(buffer));
+}
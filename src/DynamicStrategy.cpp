@@ -0,0 +1,14 @@
+#include "../include/DynamicStrategy.h"
+#include "../include/Strategy.h"
+#include <stdexcept>
+
+DynamicStrategy::DynamicStrategy(Metrics& metrics, OrderBook& order_book, int quote_size, long long tick_offset, long long max_inv, long long cancel_threshold, long long cooldown_between_requotes)
+                        : metrics(metrics), order_book(order_book),
+                        strategy(std::make_unique<StrategyAdapter<PingPongStrategy>>(metrics, order_book, quote_size, tick_offset, max_inv, cancel_threshold, cooldown_between_requotes)) {}
+
+void DynamicStrategy::set_strategy(std::unique_ptr<StrategyInterface> value) {
+    if (!value) {
+        throw std::runtime_error("Dynamic strategy needs a strategy to run!");
+    }
+    strategy = std::move(value);
+}
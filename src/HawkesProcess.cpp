@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "../include/HawkesProcess.h"
+
+HawkesProcess::Parameters HawkesProcess::Parameters::uniform(double baseline_per_second, double self_excitation_per_second, double cross_excitation_per_second, double decay_per_second) {
+    Parameters parameters;
+    for (int i = 0; i < NUM_MARKS; i++) {
+        parameters.baselinePerSecond[i] = baseline_per_second;
+        parameters.decayPerSecond[i] = decay_per_second;
+        for (int j = 0; j < NUM_MARKS; j++) {
+            parameters.excitationPerSecond[i][j] = i == j ? self_excitation_per_second : cross_excitation_per_second;
+        }
+    }
+    return parameters;
+}
+
+HawkesProcess::HawkesProcess(const Parameters& parameters, double start_time_us, unsigned long long seed) : has_uniform_decay(true), excess(), total_excess(0), total_excitation_by_source(), cumulative_baseline(), total_baseline(0),
+                                                                                                         current_time_us(start_time_us), rand_engine(seed), num_candidates(0), pending(), has_pending(false) {
+    for (int i = 0; i < NUM_MARKS; i++) {
+        if (parameters.baselinePerSecond[i] < 0 || parameters.decayPerSecond[i] <= 0) {
+            throw std::runtime_error("Hawkes baselines must not be negative and decays must be positive!");
+        }
+        for (int j = 0; j < NUM_MARKS; j++) {
+            if (parameters.excitationPerSecond[i][j] < 0) {
+                throw std::runtime_error("Hawkes excitations must not be negative!");
+            }
+        }
+    }
+    if (branching_ratio(parameters) >= 1) {
+        throw std::runtime_error("Hawkes process is not stationary, the branching ratio has to stay below 1!");
+    }
+
+    for (int i = 0; i < NUM_MARKS; i++) {
+        baseline[i] = parameters.baselinePerSecond[i] / 1e6;
+        decay[i] = parameters.decayPerSecond[i] / 1e6;
+        total_baseline += baseline[i];
+        cumulative_baseline[i] = total_baseline;
+        has_uniform_decay = has_uniform_decay && parameters.decayPerSecond[i] == parameters.decayPerSecond[0];
+        for (int j = 0; j < NUM_MARKS; j++) {
+            excitation_by_source[j][i] = parameters.excitationPerSecond[i][j] / 1e6;
+            total_excitation_by_source[j] += excitation_by_source[j][i];
+        }
+    }
+    if (total_baseline <= 0) {
+        throw std::runtime_error("Hawkes process needs a positive baseline on at least one mark!");
+    }
+}
+
+void HawkesProcess::decay_by(double elapsed_us) {
+    if (has_uniform_decay) {
+        double factor = std::exp(-decay[0] * elapsed_us);
+        for (int i = 0; i < NUM_MARKS; i++) {
+            excess[i] *= factor;
+        }
+        total_excess *= factor;
+    }
+    else {
+        total_excess = 0;
+        for (int i = 0; i < NUM_MARKS; i++) {
+            excess[i] *= std::exp(-decay[i] * elapsed_us);
+            total_excess += excess[i];
+        }
+    }
+}
+
+/**
+    Ogata thinning. The total intensity now bounds it until the next event, a candidate is drawn at that rate and accepted with the
+    ratio of the decayed intensity to the bound. The uniform of the acceptance test, once below the decayed intensity, is uniform
+    over it and picks the mark too. Both uniforms of a step come from the two halves of one 64-bit draw, 32 bits is plenty for either.
+*/
+HawkesProcess::Event HawkesProcess::draw() {
+    while (true) {
+        double upper_bound = total_baseline + total_excess;
+
+        // Converted by hand, std::generate_canonical costs more than the rest of the step
+        unsigned long long bits = rand_engine();
+        double gap_uniform = (double)(bits >> 32) * 0x1.0p-32;
+        double mark_uniform = (double)(bits & 0xFFFFFFFFULL) * 0x1.0p-32;
+
+        double elapsed_us = -std::log1p(-gap_uniform) / upper_bound;
+        current_time_us += elapsed_us;
+        decay_by(elapsed_us);
+        num_candidates++;
+
+        // The baselines take the front of [0, upper_bound) and their cumulative sums are fixed, the decayed excesses the back
+        double target = mark_uniform * upper_bound;
+        int mark = NUM_MARKS;
+        if (target < total_baseline) {
+            mark = 0;
+            while (mark < NUM_MARKS - 1 && target >= cumulative_baseline[mark]) {
+                mark++;
+            }
+        }
+        else {
+            double cumulative = total_baseline;
+            for (int i = 0; i < NUM_MARKS; i++) {
+                cumulative += excess[i];
+                if (target < cumulative) {
+                    mark = i;
+                    break;
+                }
+            }
+        }
+        if (mark == NUM_MARKS) {
+            continue; // thinned out
+        }
+
+        for (int j = 0; j < NUM_MARKS; j++) {
+            excess[j] += excitation_by_source[mark][j];
+        }
+        total_excess += total_excitation_by_source[mark];
+        return {current_time_us, (Mark)mark};
+    }
+}
+
+HawkesProcess::Event HawkesProcess::next() {
+    if (has_pending) {
+        has_pending = false;
+        return pending;
+    }
+    return draw();
+}
+
+/**
+ * @brief Writes the next num_events events to events.
+ * @return num_events
+ */
+std::size_t HawkesProcess::generate(Event* events, std::size_t num_events) {
+    std::size_t i = 0;
+    if (has_pending && num_events > 0) {
+        events[i++] = next();
+    }
+    for (; i < num_events; i++) {
+        events[i] = draw();
+    }
+    return num_events;
+}
+
+/**
+ * @brief Writes the events before end_time_us to events, at most capacity of them. The first event past the end is kept for the next call.
+ * @return how many events were written, capacity when there may be more before end_time_us
+ */
+std::size_t HawkesProcess::generate_until(double end_time_us, Event* events, std::size_t capacity) {
+    std::size_t num_events = 0;
+    while (num_events < capacity) {
+        Event event = next();
+        if (event.timestampUs >= end_time_us) {
+            pending = event;
+            has_pending = true;
+            break;
+        }
+        events[num_events++] = event;
+    }
+    return num_events;
+}
+
+/**
+ * @brief Forgets the history: intensities go back to their baselines and the clock to start_time_us.
+ */
+void HawkesProcess::reset(double start_time_us) {
+    excess.fill(0);
+    total_excess = 0;
+    current_time_us = start_time_us;
+    has_pending = false;
+}
+
+/**
+ * @brief Writes the parameters along with the decaying excess and the generator, so a process read back continues the same event stream.
+ */
+void HawkesProcess::save_state(CheckpointWriter& writer) const {
+    writer.write(baseline);
+    writer.write(excitation_by_source);
+    writer.write(decay);
+    writer.write(has_uniform_decay);
+    writer.write(excess);
+    writer.write(total_excess);
+    writer.write(total_excitation_by_source);
+    writer.write(cumulative_baseline);
+    writer.write(total_baseline);
+    writer.write(current_time_us);
+    writer.write_streamed(rand_engine);
+    writer.write(num_candidates);
+    writer.write(pending);
+    writer.write(has_pending);
+}
+
+void HawkesProcess::load_state(CheckpointReader& reader) {
+    reader.read_into(baseline);
+    reader.read_into(excitation_by_source);
+    reader.read_into(decay);
+    has_uniform_decay = reader.read<bool>();
+    reader.read_into(excess);
+    total_excess = reader.read<double>();
+    reader.read_into(total_excitation_by_source);
+    reader.read_into(cumulative_baseline);
+    total_baseline = reader.read<double>();
+    current_time_us = reader.read<double>();
+    reader.read_streamed(rand_engine);
+    num_candidates = reader.read<std::size_t>();
+    reader.read_into(pending);
+    has_pending = reader.read<bool>();
+}
+
+/**
+ * @brief Spectral radius of the mean offspring matrix excitation[i][j] / decay[i], found by power iteration since the matrix is nonnegative.
+ *        The process is stationary when it is below 1.
+ */
+double HawkesProcess::branching_ratio(const Parameters& parameters) {
+    std::array<double, NUM_MARKS> vector;
+    vector.fill(1.0);
+    double ratio = 0;
+
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        std::array<double, NUM_MARKS> product{};
+        double norm = 0;
+        for (int i = 0; i < NUM_MARKS; i++) {
+            for (int j = 0; j < NUM_MARKS; j++) {
+                product[i] += parameters.excitationPerSecond[i][j] / parameters.decayPerSecond[i] * vector[j];
+            }
+            norm = std::max(norm, product[i]);
+        }
+        if (norm == 0) {
+            return 0;
+        }
+        for (int i = 0; i < NUM_MARKS; i++) {
+            vector[i] = product[i] / norm;
+        }
+        if (std::abs(norm - ratio) < 1e-12 * norm) {
+            return norm;
+        }
+        ratio = norm;
+    }
+    return ratio;
+}
+
+/**
+ * @brief Long run event rate of each mark, per second: the solution of rates = baseline + offspring matrix * rates.
+ */
+std::array<double, HawkesProcess::NUM_MARKS> HawkesProcess::stationary_rates(const Parameters& parameters) {
+    // (I - K) rates = baseline, by Gaussian elimination with partial pivoting
+    double system[NUM_MARKS][NUM_MARKS + 1];
+    for (int i = 0; i < NUM_MARKS; i++) {
+        for (int j = 0; j < NUM_MARKS; j++) {
+            system[i][j] = (i == j ? 1.0 : 0.0) - parameters.excitationPerSecond[i][j] / parameters.decayPerSecond[i];
+        }
+        system[i][NUM_MARKS] = parameters.baselinePerSecond[i];
+    }
+
+    for (int column = 0; column < NUM_MARKS; column++) {
+        int pivot = column;
+        for (int row = column + 1; row < NUM_MARKS; row++) {
+            if (std::abs(system[row][column]) > std::abs(system[pivot][column])) {
+                pivot = row;
+            }
+        }
+        for (int k = 0; k <= NUM_MARKS; k++) {
+            std::swap(system[column][k], system[pivot][k]);
+        }
+        for (int row = 0; row < NUM_MARKS; row++) {
+            if (row == column) {
+                continue;
+            }
+            double factor = system[row][column] / system[column][column];
+            for (int k = column; k <= NUM_MARKS; k++) {
+                system[row][k] -= factor * system[column][k];
+            }
+        }
+    }
+
+    std::array<double, NUM_MARKS> rates;
+    for (int i = 0; i < NUM_MARKS; i++) {
+        rates[i] = system[i][NUM_MARKS] / system[i][i];
+    }
+    return rates;
+}
@@ -1,12 +1,27 @@
 #include "../include/IdGenerator.h"
 
-long long IdGenerator::current = 1;
-long long IdGenerator::currentTrade = 1;
+std::atomic<long long> IdGenerator::current(1);
+std::atomic<long long> IdGenerator::currentTrade(1);
+thread_local IdGenerator::Counters* IdGenerator::scoped = nullptr;
+
+IdGenerator::Scope::Scope(long long next_id, long long next_trade_id) : counters{next_id, next_trade_id}, previous(scoped) {
+    scoped = &counters;
+}
+
+IdGenerator::Scope::~Scope() {
+    scoped = previous;
+}
 
 long long IdGenerator::getNext() {
-    return current++;
+    if (scoped != nullptr) {
+        return scoped->next++;
+    }
+    return current.fetch_add(1, std::memory_order_relaxed);
 }
 
 long long IdGenerator::getNextTrade() {
-    return currentTrade++;
+    if (scoped != nullptr) {
+        return scoped->nextTrade++;
+    }
+    return currentTrade.fetch_add(1, std::memory_order_relaxed);
 }
\ No newline at end of file
@@ -1,8 +1,17 @@
 #include "../include/LatencyQueue.h"
+#include <cmath>
 #include <random>
 #include <iostream>
+#include <stdexcept>
 
-LatencyQueue::LatencyQueue() : rd(), engine(rd()), event_queue() {
+static_assert(std::variant_size<LatencyQueue::Payload>::value == LatencyQueue::NUM_ACTION_TYPES + 1, "Every action type needs its payload.");
+static_assert(std::is_same<std::variant_alternative_t<LatencyQueue::MARKET_UPDATE, LatencyQueue::Payload>, LatencyQueue::MarketUpdate>::value,
+              "Payloads must come in ActionType order.");
+
+LatencyQueue::LatencyQueue() : rd(), engine(rd()), channels(), next_sequence(0),
+                               event_queue(), slots(), free_slots(), num_pending_events(0), callbacks(), free_callback_slots(),
+                               num_scheduled(), num_fired(), num_cancelled() {
+    channels.fill({LatencyModel::INDEPENDENT, {0, 0, 1000}, 0, -1, 0});
     // Initialize with defaults
     reset_latency_profile(50, 200,
                           30, 150, 
@@ -11,8 +20,11 @@ LatencyQueue::LatencyQueue() : rd(), engine(rd()), event_queue() {
                           50, 150);
 }
 
-bool LatencyQueue::Event::operator>(const Event& other) const {
-    return this->time_to_execute > other.time_to_execute;
+bool LatencyQueue::Entry::operator>(const Entry& other) const {
+    if (this->time_to_execute != other.time_to_execute) {
+        return this->time_to_execute > other.time_to_execute;
+    }
+    return this->sequence > other.sequence;
 }
 
 long long LatencyQueue::compute_execution_latency(ActionType type) {
@@ -47,12 +59,292 @@ long long LatencyQueue::compute_execution_latency(ActionType type) {
     }
 }
 
+/**
+ * @brief When an event sent at timestamp_us arrives. Under SESSION the channel's congestion is first decayed to timestamp_us and may
+ *        spike, at most once per event, with the probability of a spike in the time since the channel's previous send. O(1) per event.
+ */
+long long LatencyQueue::compute_delivery_time(long long timestamp_us, ActionType type) {
+    long long latency = compute_execution_latency(type);
+    ChannelState& channel = channels[channel_of(type)];
+    if (channel.model == LatencyModel::INDEPENDENT) {
+        return timestamp_us + latency;
+    }
+
+    const SessionCongestion& congestion = channel.congestion;
+    if (channel.last_send_us >= 0 && timestamp_us > channel.last_send_us && congestion.spikesPerSecond > 0) {
+        double elapsed_us = (double)(timestamp_us - channel.last_send_us);
+        channel.congestion_us *= std::exp(-elapsed_us / congestion.decayUs);
+
+        std::uniform_real_distribution<double> uniform(0, 1);
+        if (uniform(engine) < 1 - std::exp(-congestion.spikesPerSecond * 1e-6 * elapsed_us)) {
+            std::exponential_distribution<double> spike(1 / congestion.spikeMeanUs);
+            channel.congestion_us += spike(engine);
+        }
+    }
+    channel.last_send_us = std::max(channel.last_send_us, timestamp_us);
+
+    long long delivery_us = std::max(timestamp_us + latency + (long long)channel.congestion_us, channel.last_delivery_us);
+    channel.last_delivery_us = delivery_us;
+    return delivery_us;
+}
+
+LatencyQueue::ActionType LatencyQueue::type_of(const Payload& payload) {
+    if (const Callback* callback = std::get_if<Callback>(&payload)) {
+        return callback->type;
+    }
+    return static_cast<ActionType>(payload.index());
+}
+
+LatencyQueue::Channel LatencyQueue::channel_of(ActionType type) {
+    switch (type) {
+        case ACKNOWLEDGE_FILL: return EXECUTION_REPORTS;
+        case MARKET_UPDATE: return MARKET_DATA;
+        default: return ORDER_ENTRY;
+    }
+}
+
+const char* LatencyQueue::type_name(ActionType type) {
+    switch (type) {
+        case ORDER_SEND: return "ORDER_SEND";
+        case CANCEL: return "CANCEL";
+        case MODIFY: return "MODIFY";
+        case ACKNOWLEDGE_FILL: return "ACKNOWLEDGE_FILL";
+        case MARKET_UPDATE: return "MARKET_UPDATE";
+        default: return "UNKNOWN";
+    }
+}
+
+LatencyQueue::EventHandle LatencyQueue::schedule_event(long long timestamp_us, const Payload& payload) {
+    if (std::holds_alternative<Callback>(payload)) {
+        throw std::runtime_error("Callbacks are scheduled with their function, not as a payload!");
+    }
+    ActionType type = type_of(payload);
+    num_scheduled[type]++;
+    return push_event(timestamp_us, compute_delivery_time(timestamp_us, type), payload);
+}
+
+LatencyQueue::EventHandle LatencyQueue::push_event(long long sent_us, long long time_to_execute, const Payload& payload) {
+    std::uint32_t slot;
+    if (free_slots.empty()) {
+        slot = (std::uint32_t)slots.size();
+        slots.push_back({0, true, sent_us, payload});
+    }
+    else {
+        slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot].pending = true;
+        slots[slot].sent_us = sent_us;
+        slots[slot].payload = payload;
+    }
+    num_pending_events++;
+
+    event_queue.push_back({time_to_execute, next_sequence++, slot, slots[slot].generation});
+    std::push_heap(event_queue.begin(), event_queue.end(), std::greater<Entry>());
+    return EventHandle(slot, slots[slot].generation);
+}
+
+LatencyQueue::Entry LatencyQueue::pop_entry() {
+    std::pop_heap(event_queue.begin(), event_queue.end(), std::greater<Entry>());
+    Entry entry = event_queue.back();
+    event_queue.pop_back();
+    return entry;
+}
+
+void LatencyQueue::release_slot(std::uint32_t slot) {
+    slots[slot].pending = false;
+    slots[slot].generation++;
+    free_slots.push_back(slot);
+    num_pending_events--;
+}
+
+/**
+ * @brief Drops the tombstones once they make up most of the heap, so a queue under heavy cancelling stays as small as what is pending.
+ */
+void LatencyQueue::compact_if_sparse() {
+    if (event_queue.size() < 64 || event_queue.size() < 2 * num_pending_events) {
+        return;
+    }
+    event_queue.erase(std::remove_if(event_queue.begin(), event_queue.end(),
+                                     [this](const Entry& entry) { return !is_pending(EventHandle(entry.slot, entry.generation)); }),
+                      event_queue.end());
+    std::make_heap(event_queue.begin(), event_queue.end(), std::greater<Entry>());
+}
+
+/**
+ * @brief Retracts a pending event in O(1): its slot is freed at once and its heap entry is left as a tombstone.
+ * @return Whether the handle named a pending event. Handles of events that fired or were cancelled already are ignored.
+ */
+bool LatencyQueue::cancel_event(EventHandle handle) {
+    if (!is_pending(handle)) {
+        return false;
+    }
+    const Payload& payload = slots[handle.slot].payload;
+    if (const Callback* callback = std::get_if<Callback>(&payload)) {
+        callbacks[callback->slot] = nullptr;
+        free_callback_slots.push_back(callback->slot);
+    }
+    num_cancelled[type_of(payload)]++;
+    release_slot(handle.slot);
+    compact_if_sparse();
+    return true;
+}
+
+/**
+ * @brief Moves a pending event to time_to_execute, keeping its payload. The old handle stops naming it.
+ * @return The event's new handle, or a handle naming no event if the given one was not pending.
+ */
+LatencyQueue::EventHandle LatencyQueue::reschedule_event(EventHandle handle, long long time_to_execute) {
+    if (!is_pending(handle)) {
+        return EventHandle();
+    }
+    std::uint32_t generation = ++slots[handle.slot].generation;
+    event_queue.push_back({time_to_execute, next_sequence++, handle.slot, generation});
+    std::push_heap(event_queue.begin(), event_queue.end(), std::greater<Entry>());
+    compact_if_sparse();
+    return EventHandle(handle.slot, generation);
+}
+
+void LatencyQueue::run_callback(const Callback& event, long long time_to_execute) {
+    std::function<void(long long)> callback = std::move(callbacks[event.slot]);
+    callbacks[event.slot] = nullptr;
+    free_callback_slots.push_back(event.slot);
+    callback(time_to_execute);
+}
+
+/**
+ * @brief Switching model keeps what is pending where it is, channels start their ordering from the next event.
+ */
+void LatencyQueue::set_latency_model(LatencyModel model) {
+    for (std::size_t channel = 0; channel < NUM_CHANNELS; channel++) {
+        set_latency_model(static_cast<Channel>(channel), model);
+    }
+}
+
+void LatencyQueue::set_latency_model(Channel channel, LatencyModel model) {
+    ChannelState& state = channels[channel];
+    state.model = model;
+    state.last_delivery_us = 0;
+    state.last_send_us = -1;
+    state.congestion_us = 0;
+}
+
+void LatencyQueue::set_session_congestion(double spikes_per_second, double spike_mean_us, double decay_us) {
+    for (std::size_t channel = 0; channel < NUM_CHANNELS; channel++) {
+        set_session_congestion(static_cast<Channel>(channel), spikes_per_second, spike_mean_us, decay_us);
+    }
+}
+
+void LatencyQueue::set_session_congestion(Channel channel, double spikes_per_second, double spike_mean_us, double decay_us) {
+    if (spikes_per_second < 0 || spike_mean_us < 0 || decay_us <= 0 || (spikes_per_second > 0 && spike_mean_us == 0)) {
+        throw std::runtime_error("Session congestion needs non-negative spike rate and size and a positive decay time!");
+    }
+    channels[channel].congestion = {spikes_per_second, spike_mean_us, decay_us};
+}
+
 void LatencyQueue::process_until(long long timestamp_us) {
-    while (!event_queue.empty() && timestamp_us > event_queue.top().time_to_execute) {
-        long long time_to_exec = event_queue.top().time_to_execute;
-        auto event = event_queue.top();
-        event_queue.pop();
-        event.callback(time_to_exec);
+    process_until(timestamp_us, [](const auto&, long long) {
+        throw std::runtime_error("LatencyQueue holds typed events but was processed without a visitor for them!");
+    });
+}
+
+/**
+ * @brief Pops a copy of the heap, so events due at the same time come in the order they would fire.
+ */
+std::vector<LatencyQueue::Event> LatencyQueue::snapshot() const {
+    std::vector<Entry> heap = event_queue;
+    std::vector<Event> events;
+    events.reserve(num_pending_events);
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        Entry entry = heap.back();
+        heap.pop_back();
+        EventHandle handle(entry.slot, entry.generation);
+        if (is_pending(handle)) {
+            events.push_back({entry.time_to_execute, handle, slots[entry.slot].payload});
+        }
+    }
+    return events;
+}
+
+/**
+ * @brief One line per pending event, in firing order: execution time, type and payload fields.
+ */
+void LatencyQueue::dump(std::ostream& out) const {
+    for (const Event& event : snapshot()) {
+        out << event.time_to_execute << " " << type_name(type_of(event.payload));
+        std::visit([&out](const auto& payload) {
+            using P = std::decay_t<decltype(payload)>;
+            if constexpr (std::is_same<P, OrderSend>::value) {
+                out << (payload.isBuy ? " buy" : " sell") << (payload.isPong ? " pong " : " ping ") << payload.quantity << " @ " << payload.priceTick;
+            }
+            else if constexpr (std::is_same<P, Cancel>::value) {
+                out << " order " << payload.orderId;
+            }
+            else if constexpr (std::is_same<P, Modify>::value) {
+                out << " order " << payload.orderId << " to " << payload.newQuantity;
+            }
+            else if constexpr (std::is_same<P, AcknowledgeFill>::value) {
+                out << (payload.isBuy ? " buy" : " sell") << (payload.isPong ? " pong " : " ping ") << "order " << payload.orderId
+                    << " filled " << payload.quantity << " @ " << payload.priceTick << (payload.wasInstant ? " instantly" : "");
+            }
+            else if constexpr (std::is_same<P, MarketUpdate>::value) {
+                out << " market " << payload.marketPriceTicks;
+            }
+            else {
+                out << " callback " << payload.slot;
+            }
+        }, event.payload);
+        out << "\n";
+    }
+}
+
+/**
+ * @brief Writes the latency random state, the latency boundaries, the latency model with its channels, the heap as it is laid out
+ *        along with the slots its entries point to, so a restored queue fires the same events in the same order, ties included, and
+ *        handles taken before the save still name their events, and the per-type counters.
+ */
+void LatencyQueue::save_state(CheckpointWriter& writer) const {
+    if (callbacks.size() != free_callback_slots.size()) {
+        throw std::runtime_error("LatencyQueue holds pending callbacks, only typed events can be checkpointed!");
+    }
+
+    writer.write_streamed(engine);
+    writer.write(latency_boundaries);
+    writer.write(channels);
+    writer.write(next_sequence);
+    writer.write_vector(event_queue);
+    writer.write_vector(slots);
+    writer.write_vector(free_slots);
+    writer.write<std::uint64_t>(num_pending_events);
+    writer.write(num_scheduled);
+    writer.write(num_fired);
+    writer.write(num_cancelled);
+}
+
+void LatencyQueue::load_state(CheckpointReader& reader) {
+    reader.read_streamed(engine);
+    latency_boundaries = reader.read<LatencyBoundaries>();
+    channels = reader.read<std::array<ChannelState, NUM_CHANNELS>>();
+    next_sequence = reader.read<std::uint64_t>();
+    reader.read_vector(event_queue);
+    reader.read_vector(slots);
+    reader.read_vector(free_slots);
+    num_pending_events = (std::size_t)reader.read<std::uint64_t>();
+    num_scheduled = reader.read<std::array<std::uint64_t, NUM_ACTION_TYPES>>();
+    num_fired = reader.read<std::array<std::uint64_t, NUM_ACTION_TYPES>>();
+    num_cancelled = reader.read<std::array<std::uint64_t, NUM_ACTION_TYPES>>();
+    callbacks.clear();
+    free_callback_slots.clear();
+
+    for (const Entry& entry : event_queue) {
+        if (entry.slot >= slots.size()) {
+            throw std::runtime_error("Checkpoint holds a LatencyQueue entry without its slot!");
+        }
+    }
+    for (const Slot& slot : slots) {
+        if (slot.payload.index() >= std::variant_size<Payload>::value || (slot.pending && std::holds_alternative<Callback>(slot.payload))) {
+            throw std::runtime_error("Checkpoint holds a LatencyQueue callback, only typed events can be restored!");
+        }
     }
 }
 
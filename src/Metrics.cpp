@@ -57,6 +57,17 @@ void Metrics::reset() {
 
     order_cache.clear();
 
+    time_in_flight.fill({0, 0, 0});
+    quoted_time_us = 0;
+    stale_quote_exposure_us = 0;
+    last_quote_check_us = 0;
+    is_buy_quoted = false;
+    is_sell_quoted = false;
+    is_buy_quote_stale = false;
+    is_sell_quote_stale = false;
+    quote_filled_qty = 0;
+    picked_off_qty = 0;
+
     volatility = 0;
     sharpe_ratio = 0;
     gross_profit = 0;
@@ -64,9 +75,137 @@ void Metrics::reset() {
     win_rate = 0;
 }
 
+/**
+ * @brief Writes the configuration, the accumulators, every series and the cached orders. The results are written too, so a checkpoint
+ *        taken after finalize restores them.
+ */
+void Metrics::save_state(CheckpointWriter& writer) const {
+    writer.write(config);
+
+    writer.write(fees_ticks);
+    writer.write(position);
+    writer.write(average_entry_price_ticks);
+    writer.write(realized_pnl_ticks);
+    writer.write(unrealized_pnl_ticks);
+    writer.write(total_pnl_ticks);
+    writer.write_vector(timestamp_series);
+    writer.write_vector(total_pnl_ticks_series);
+    writer.write_vector(realized_pnl_ticks_series);
+    writer.write_vector(unrealized_pnl_ticks_series);
+    writer.write_vector(spread_ticks_series);
+    writer.write_vector(market_price_ticks_series);
+
+    writer.write(gross_traded_qty);
+    writer.write(resting_attempted_qty);
+    writer.write(resting_filled_qty);
+    writer.write(resting_cancelled_qty);
+    writer.write(total_slippage_ticks);
+
+    writer.write(equity_value_peak_ticks);
+    writer.write(max_dropdown_ticks);
+
+    writer.write_vector(returns_series);
+    writer.write(last_return_bucket_start_us);
+    writer.write(last_return_bucket_total_pnl_ticks);
+
+    writer.write(current_best_bid_price_ticks);
+    writer.write(current_best_ask_price_ticks);
+    writer.write(last_trade_price_ticks);
+    writer.write(last_mark_price_ticks);
+
+    writer.write<std::uint64_t>(order_cache.size());
+    for (const auto& [order_id, data] : order_cache) {
+        writer.write(order_id);
+        writer.write(data);
+    }
+
+    writer.write(time_in_flight);
+    writer.write(quoted_time_us);
+    writer.write(stale_quote_exposure_us);
+    writer.write(last_quote_check_us);
+    writer.write(is_buy_quoted);
+    writer.write(is_sell_quoted);
+    writer.write(is_buy_quote_stale);
+    writer.write(is_sell_quote_stale);
+    writer.write(quote_filled_qty);
+    writer.write(picked_off_qty);
+
+    writer.write(volatility);
+    writer.write(sharpe_ratio);
+    writer.write(gross_profit);
+    writer.write(gross_loss);
+    writer.write(win_rate);
+}
+
+void Metrics::load_state(CheckpointReader& reader) {
+    reader.read_into(config);
+
+    fees_ticks = reader.read<long long>();
+    position = reader.read<int>();
+    average_entry_price_ticks = reader.read<long long>();
+    realized_pnl_ticks = reader.read<long long>();
+    unrealized_pnl_ticks = reader.read<long long>();
+    total_pnl_ticks = reader.read<long long>();
+    reader.read_vector(timestamp_series);
+    reader.read_vector(total_pnl_ticks_series);
+    reader.read_vector(realized_pnl_ticks_series);
+    reader.read_vector(unrealized_pnl_ticks_series);
+    reader.read_vector(spread_ticks_series);
+    reader.read_vector(market_price_ticks_series);
+
+    gross_traded_qty = reader.read<long>();
+    resting_attempted_qty = reader.read<long>();
+    resting_filled_qty = reader.read<long>();
+    resting_cancelled_qty = reader.read<long>();
+    total_slippage_ticks = reader.read<long long>();
+
+    equity_value_peak_ticks = reader.read<long long>();
+    max_dropdown_ticks = reader.read<long long>();
+
+    reader.read_vector(returns_series);
+    last_return_bucket_start_us = reader.read<long long>();
+    last_return_bucket_total_pnl_ticks = reader.read<long long>();
+
+    current_best_bid_price_ticks = reader.read<long long>();
+    current_best_ask_price_ticks = reader.read<long long>();
+    last_trade_price_ticks = reader.read<long long>();
+    last_mark_price_ticks = reader.read<long long>();
+
+    order_cache.clear();
+    std::uint64_t num_orders = reader.read<std::uint64_t>();
+    order_cache.reserve(num_orders);
+    OrderCacheData data(Side::BUYS, 0, 0, 0, 0, 0);
+    for (std::uint64_t i = 0; i < num_orders; i++) {
+        long long order_id = reader.read<long long>();
+        reader.read_into(data);
+        order_cache.emplace(order_id, data);
+    }
+
+    reader.read_into(time_in_flight);
+    quoted_time_us = reader.read<long long>();
+    stale_quote_exposure_us = reader.read<long long>();
+    last_quote_check_us = reader.read<long long>();
+    is_buy_quoted = reader.read<bool>();
+    is_sell_quoted = reader.read<bool>();
+    is_buy_quote_stale = reader.read<bool>();
+    is_sell_quote_stale = reader.read<bool>();
+    quote_filled_qty = reader.read<long>();
+    picked_off_qty = reader.read<long>();
+
+    volatility = reader.read<double>();
+    sharpe_ratio = reader.read<double>();
+    gross_profit = reader.read<double>();
+    gross_loss = reader.read<double>();
+    win_rate = reader.read<double>();
+}
+
 void Metrics::finalize(long long timestamp) {
     take_screenshot(timestamp, true);
 
+    compute_summary_statistics();
+}
+
+void Metrics::compute_summary_statistics() {
     // Calculate summary statistics
     double returns_mean = 0;
     double sum_sqrtd_differences = 0;
@@ -116,6 +255,120 @@ void Metrics::finalize(long long timestamp) {
     win_rate = double(num_winning_return_buckets) / returns_series.size();
 }
 
+/**
+ * @brief Portfolio view at a synchronisation barrier: PnL, fee, quantity and slippage figures become the sums over the components
+ *        (one Metrics per instrument, all in ticks), so are the latency exposure counters, and one point is appended to the series. Spread and market price have no
+ *        portfolio-wide meaning and are recorded as 0.
+ */
+void Metrics::aggregate(long long timestamp_us, const std::vector<const Metrics*>& components, bool is_final) {
+    realized_pnl_ticks = 0;
+    unrealized_pnl_ticks = 0;
+    fees_ticks = 0;
+    gross_traded_qty = 0;
+    resting_attempted_qty = 0;
+    resting_filled_qty = 0;
+    resting_cancelled_qty = 0;
+    total_slippage_ticks = 0;
+    time_in_flight.fill({0, 0, 0});
+    quoted_time_us = 0;
+    stale_quote_exposure_us = 0;
+    quote_filled_qty = 0;
+    picked_off_qty = 0;
+
+    for (const Metrics* component : components) {
+        realized_pnl_ticks += component->realized_pnl_ticks;
+        unrealized_pnl_ticks += component->unrealized_pnl_ticks;
+        fees_ticks += component->fees_ticks;
+        gross_traded_qty += component->gross_traded_qty;
+        resting_attempted_qty += component->resting_attempted_qty;
+        resting_filled_qty += component->resting_filled_qty;
+        resting_cancelled_qty += component->resting_cancelled_qty;
+        total_slippage_ticks += component->total_slippage_ticks;
+        add_latency_exposure(*component);
+    }
+    total_pnl_ticks = realized_pnl_ticks + unrealized_pnl_ticks;
+
+    record_series_point(timestamp_us, is_final);
+}
+
+/**
+ * @brief Joins the metrics of consecutive, independently simulated windows (given in time order) into a single run.
+ *
+ *  Stitching rule: every window starts flat, so a window's PnL series are shifted by the total PnL all previous windows ended with
+ *  and a position still open at the end of a window counts as realized at that window's last mark. Quantity, fee, slippage and latency
+ *  exposure counters are summed, series and return buckets are concatenated, drawdown and summary statistics are recomputed on the joined series.
+ *  Position, mark and book state are taken from the last window.
+ */
+Metrics Metrics::stitch(const std::vector<Metrics>& windows) {
+    Metrics stitched;
+    if (windows.empty()) {
+        return stitched;
+    }
+
+    stitched.config = windows.front().config;
+
+    long long pnl_offset_ticks = 0;
+    for (const Metrics& window : windows) {
+        stitched.timestamp_series.insert(stitched.timestamp_series.end(), window.timestamp_series.begin(), window.timestamp_series.end());
+        stitched.unrealized_pnl_ticks_series.insert(stitched.unrealized_pnl_ticks_series.end(), window.unrealized_pnl_ticks_series.begin(), window.unrealized_pnl_ticks_series.end());
+        stitched.spread_ticks_series.insert(stitched.spread_ticks_series.end(), window.spread_ticks_series.begin(), window.spread_ticks_series.end());
+        stitched.market_price_ticks_series.insert(stitched.market_price_ticks_series.end(), window.market_price_ticks_series.begin(), window.market_price_ticks_series.end());
+        stitched.returns_series.insert(stitched.returns_series.end(), window.returns_series.begin(), window.returns_series.end());
+
+        for (long long realized : window.realized_pnl_ticks_series) {
+            stitched.realized_pnl_ticks_series.push_back(realized + pnl_offset_ticks);
+        }
+        for (long long total : window.total_pnl_ticks_series) {
+            stitched.total_pnl_ticks_series.push_back(total + pnl_offset_ticks);
+
+            stitched.equity_value_peak_ticks = std::max(stitched.equity_value_peak_ticks, total + pnl_offset_ticks);
+            stitched.max_dropdown_ticks = std::min(stitched.max_dropdown_ticks, total + pnl_offset_ticks - stitched.equity_value_peak_ticks);
+        }
+
+        stitched.fees_ticks += window.fees_ticks;
+        stitched.gross_traded_qty += window.gross_traded_qty;
+        stitched.resting_attempted_qty += window.resting_attempted_qty;
+        stitched.resting_filled_qty += window.resting_filled_qty;
+        stitched.resting_cancelled_qty += window.resting_cancelled_qty;
+        stitched.total_slippage_ticks += window.total_slippage_ticks;
+        stitched.add_latency_exposure(window);
+
+        pnl_offset_ticks += window.total_pnl_ticks;
+    }
+
+    const Metrics& last_window = windows.back();
+    stitched.position = last_window.position;
+    stitched.average_entry_price_ticks = last_window.average_entry_price_ticks;
+    stitched.unrealized_pnl_ticks = last_window.unrealized_pnl_ticks;
+    stitched.total_pnl_ticks = pnl_offset_ticks;
+    stitched.realized_pnl_ticks = stitched.total_pnl_ticks - stitched.unrealized_pnl_ticks;
+
+    stitched.last_return_bucket_start_us = last_window.last_return_bucket_start_us;
+    stitched.last_return_bucket_total_pnl_ticks = stitched.total_pnl_ticks;
+    stitched.current_best_bid_price_ticks = last_window.current_best_bid_price_ticks;
+    stitched.current_best_ask_price_ticks = last_window.current_best_ask_price_ticks;
+    stitched.last_trade_price_ticks = last_window.last_trade_price_ticks;
+    stitched.last_mark_price_ticks = last_window.last_mark_price_ticks;
+    stitched.order_cache = last_window.order_cache;
+
+    stitched.compute_summary_statistics();
+
+    return stitched;
+}
+
+// Time in flight, quoted and stale time and quote fills of other, summed into these
+void Metrics::add_latency_exposure(const Metrics& other) {
+    for (int direction = 0; direction < NUM_DIRECTIONS; direction++) {
+        time_in_flight[direction].num_events += other.time_in_flight[direction].num_events;
+        time_in_flight[direction].total_us += other.time_in_flight[direction].total_us;
+        time_in_flight[direction].max_us = std::max(time_in_flight[direction].max_us, other.time_in_flight[direction].max_us);
+    }
+    quoted_time_us += other.quoted_time_us;
+    stale_quote_exposure_us += other.stale_quote_exposure_us;
+    quote_filled_qty += other.quote_filled_qty;
+    picked_off_qty += other.picked_off_qty;
+}
+
 void Metrics::on_order_placed(long long order_id, Side side, long long arrival_price_ticks, long long arrival_timestamp_us, int intended_quantity, bool is_instant) {
     order_cache.try_emplace(order_id, side, arrival_price_ticks, arrival_timestamp_us, intended_quantity, intended_quantity, is_instant);
 
@@ -130,13 +383,30 @@ void Metrics::on_order_cancelled(long long order_id, long long delete_timestamp_
         return;
     }
 
+    on_order_cancelled(order_id, delete_timestamp_us, iter->second.remaining_qty);
+}
+
+/**
+ * @brief Cancels cancelled_quantity of an order, what the exchange still had of it. The rest of remaining_qty was filled before the cancel
+ *        got there and its fills are still to be acknowledged, so the order stays in the cache until they are.
+ */
+void Metrics::on_order_cancelled(long long order_id, long long, int cancelled_quantity) {
+    auto iter = order_cache.find(order_id);
+    if (iter == order_cache.end()) {
+        return;
+    }
+
     auto& order = iter->second;
+    cancelled_quantity = std::min(cancelled_quantity, order.remaining_qty);
 
     if (!order.is_ioc) {
-        resting_cancelled_qty += order.remaining_qty;
+        resting_cancelled_qty += cancelled_quantity;
     }
 
-    order_cache.erase(order_id);
+    order.remaining_qty -= cancelled_quantity;
+    if (order.remaining_qty == 0) {
+        order_cache.erase(iter);
+    }
 }
 
 void Metrics::on_fill(long long order_id_1, long long fill_price_per_share_ticks, long long fill_timestamp_us, int filled_quantity, bool was_instant) {
@@ -146,6 +416,39 @@ void Metrics::on_fill(long long order_id_1, long long fill_price_per_share_ticks
         return;
     }
     
+    Side side = iter_order_1->second.side;
+
+    long long arrival_price = iter_order_1->second.arrival_mark_price_ticks;
+    long long slippage_per_share;
+    side == Side::BUYS ? slippage_per_share = fill_price_per_share_ticks - arrival_price : slippage_per_share = arrival_price - fill_price_per_share_ticks;
+    total_slippage_ticks += slippage_per_share * filled_quantity;
+
+    book_fill(side, fill_price_per_share_ticks, filled_quantity, was_instant);
+
+    iter_order_1->second.remaining_qty -= filled_quantity;
+
+    if (iter_order_1->second.remaining_qty == 0) {
+        order_cache.erase(order_id_1);
+    }
+    else if (iter_order_1->second.remaining_qty < 0) {
+        throw std::runtime_error("There is an error in the mechanism of matching trades, quantities shouldn't go below 0");
+    }
+
+    take_screenshot(fill_timestamp_us, false);
+}
+
+/**
+ * @brief A fill acknowledged after its order left the cache: it still moves position and PnL, its arrival price is gone so it adds no slippage.
+ */
+void Metrics::on_untracked_fill(Side side, long long fill_price_ticks, long long fill_timestamp_us, int filled_quantity, bool was_instant) {
+    book_fill(side, fill_price_ticks, filled_quantity, was_instant);
+    take_screenshot(fill_timestamp_us, false);
+}
+
+/**
+ * @brief Books traded quantity, fees, position and realized PnL of a fill.
+ */
+void Metrics::book_fill(Side side, long long fill_price_per_share_ticks, int filled_quantity, bool was_instant) {
     gross_traded_qty += filled_quantity;
     last_trade_price_ticks = fill_price_per_share_ticks;
     
@@ -156,13 +459,6 @@ void Metrics::on_fill(long long order_id_1, long long fill_price_per_share_ticks
     else {
         fees_ticks += config.taker_fee_per_share_ticks * filled_quantity;
     }
-
-    Side side = iter_order_1->second.side;
-
-    long long arrival_price = iter_order_1->second.arrival_mark_price_ticks;
-    long long slippage_per_share;
-    side == Side::BUYS ? slippage_per_share = fill_price_per_share_ticks - arrival_price : slippage_per_share = arrival_price - fill_price_per_share_ticks;
-    total_slippage_ticks += slippage_per_share * filled_quantity;
     
     if (position >= 0) {
         if (side == Side::BUYS) { // Means it is either opening or increasing a position
@@ -192,17 +488,6 @@ void Metrics::on_fill(long long order_id_1, long long fill_price_per_share_ticks
             }
         }
     }
-
-    iter_order_1->second.remaining_qty -= filled_quantity;
-
-    if (iter_order_1->second.remaining_qty == 0) {
-        order_cache.erase(order_id_1);
-    }
-    else if (iter_order_1->second.remaining_qty < 0) {
-        throw std::runtime_error("There is an error in the mechanism of matching trades, quantities shouldn't go below 0");
-    }
-
-    take_screenshot(fill_timestamp_us, false);
 }
 
 void Metrics::on_market_price_update(long long timestamp_us, long long best_bid, long long best_ask) {
@@ -212,12 +497,51 @@ void Metrics::on_market_price_update(long long timestamp_us, long long best_bid,
     take_screenshot(timestamp_us, false);
 }
 
+void Metrics::on_event_delivered(Direction direction, long long sent_us, long long delivered_us) {
+    TimeInFlight& in_flight = time_in_flight[direction];
+    long long elapsed_us = delivered_us - sent_us;
+    in_flight.num_events++;
+    in_flight.total_us += elapsed_us;
+    in_flight.max_us = std::max(in_flight.max_us, elapsed_us);
+}
+
+/**
+ * @brief Books the time since the last check against the quotes as they were then, and keeps the state given for the next interval.
+ *        Called once per step, with the exchange's price, so it costs a few comparisons.
+ */
+void Metrics::on_quote_state(long long timestamp_us, bool buy_quoted, bool buy_stale, bool sell_quoted, bool sell_stale) {
+    long long elapsed_us = timestamp_us - last_quote_check_us;
+    if (elapsed_us > 0) {
+        quoted_time_us += elapsed_us * (is_buy_quoted + is_sell_quoted);
+        stale_quote_exposure_us += elapsed_us * (is_buy_quote_stale + is_sell_quote_stale);
+    }
+    last_quote_check_us = timestamp_us;
+    is_buy_quoted = buy_quoted;
+    is_sell_quoted = sell_quoted;
+    is_buy_quote_stale = buy_quoted && buy_stale;
+    is_sell_quote_stale = sell_quoted && sell_stale;
+}
+
+void Metrics::on_quote_filled(Side side, int filled_quantity) {
+    quote_filled_qty += filled_quantity;
+    if (side == Side::BUYS ? is_buy_quote_stale : is_sell_quote_stale) {
+        picked_off_qty += filled_quantity;
+    }
+}
+
 void Metrics::take_screenshot(long long timestamp, bool is_final) {
     update_last_mark_price();
 
     unrealized_pnl_ticks = position * (last_mark_price_ticks - average_entry_price_ticks);
     total_pnl_ticks = realized_pnl_ticks + unrealized_pnl_ticks;
 
+    record_series_point(timestamp, is_final);
+}
+
+/**
+ * @brief Appends the current PnL state to the series and updates drawdown and return buckets. PnL values must already be up to date.
+ */
+void Metrics::record_series_point(long long timestamp, bool is_final) {
     timestamp_series.push_back(timestamp);
     realized_pnl_ticks_series.push_back(realized_pnl_ticks);
     unrealized_pnl_ticks_series.push_back(unrealized_pnl_ticks);
@@ -272,6 +596,31 @@ long long Metrics::get_max_drawdown_ticks() {
     return max_dropdown_ticks;
 }
 
+double Metrics::get_mean_time_in_flight_us(Direction direction) const {
+    const TimeInFlight& in_flight = time_in_flight[direction];
+    if (in_flight.num_events == 0) {
+        return 0;
+    }
+
+    return double(in_flight.total_us) / in_flight.num_events;
+}
+
+double Metrics::get_stale_quote_ratio() const {
+    if (quoted_time_us == 0) {
+        return 0;
+    }
+
+    return double(stale_quote_exposure_us) / quoted_time_us;
+}
+
+double Metrics::get_pick_off_rate() const {
+    if (quote_filled_qty == 0) {
+        return 0;
+    }
+
+    return double(picked_off_qty) / quote_filled_qty;
+}
+
 double Metrics::get_sharpe_ratio() {
     return sharpe_ratio;
 }
@@ -0,0 +1,234 @@
+#include "../include/MultiSymbolEngine.h"
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+    void pin_thread_to_core(std::thread& thread, int core_id) {
+#ifdef __linux__
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(core_id, &cpu_set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpu_set);
+#else
+        (void)thread;
+        (void)core_id;
+#endif
+    }
+}
+
+MultiSymbolEngine::MultiSymbolEngine(int num_shards, bool pin_to_cores) : books(), symbol_to_shard(), symbol_ids(), shards(), running(false), pending_messages(0),
+                                        barrier_mutex(), barrier_cv(), pin_to_cores(pin_to_cores), portfolio_metrics() {
+    if (num_shards <= 0) {
+        throw std::runtime_error("Multi symbol engine needs at least one shard.");
+    }
+
+    int num_cores = std::max(1, (int)std::thread::hardware_concurrency());
+    for (int i = 0; i < num_shards; i++) {
+        shards.push_back(std::make_unique<Shard>());
+        shards.back()->core_id = i % num_cores;
+    }
+
+    portfolio_metrics.set_config(Order::tick_size, 0, 0, Metrics::MarkingMethod::MID, 1000000);
+}
+
+MultiSymbolEngine::~MultiSymbolEngine() {
+    stop();
+}
+
+/**
+ * @brief Registers a symbol and assigns it to a shard round robin. The registry is fixed once the workers are started.
+ * @return id of the symbol, used to post without a string lookup
+ */
+int MultiSymbolEngine::add_symbol(const std::string& symbol) {
+    if (running) {
+        throw std::runtime_error("Symbols must be added before the engine is started.");
+    }
+
+    auto iter = symbol_ids.find(symbol);
+    if (iter != symbol_ids.end()) {
+        return iter->second;
+    }
+
+    int symbol_id = (int)books.size();
+    books.push_back(std::make_unique<SymbolBook>(symbol));
+    symbol_to_shard.push_back(symbol_id % (int)shards.size());
+    symbol_ids.emplace(symbol, symbol_id);
+
+    return symbol_id;
+}
+
+void MultiSymbolEngine::start() {
+    if (running) {
+        return;
+    }
+
+    running = true;
+    for (auto& shard : shards) {
+        shard->worker = std::thread(&MultiSymbolEngine::run_shard, this, std::ref(*shard));
+
+        if (pin_to_cores) {
+            pin_thread_to_core(shard->worker, shard->core_id);
+        }
+    }
+}
+
+/**
+    Lets every shard drain the messages already posted, then joins the workers.
+*/
+void MultiSymbolEngine::stop() {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    for (auto& shard : shards) {
+        {
+            std::lock_guard<std::mutex> lock(shard->inbox_mutex);
+        }
+        shard->inbox_cv.notify_one();
+    }
+
+    for (auto& shard : shards) {
+        if (shard->worker.joinable()) {
+            shard->worker.join();
+        }
+    }
+}
+
+/**
+    Thread safe, can be called by the driver as well as from inside another shard for cross-symbol interaction.
+    Only limit orders and cancels can be tracked in metrics.
+*/
+void MultiSymbolEngine::post(int symbol_id, const OrderCommand& command, bool track_in_metrics) {
+    if (symbol_id < 0 || symbol_id >= (int)books.size()) {
+        throw std::runtime_error("Unknown symbol id: " + std::to_string(symbol_id));
+    }
+    if (track_in_metrics && command.type != OrderCommand::Type::ADD_LIMIT && command.type != OrderCommand::Type::CANCEL) {
+        throw std::runtime_error("Only limit orders and cancels can be tracked in metrics.");
+    }
+
+    Shard& shard = *shards[symbol_to_shard[symbol_id]];
+    pending_messages.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(shard.inbox_mutex);
+        shard.inbox.push_back({symbol_id, track_in_metrics, command});
+    }
+    shard.inbox_cv.notify_one();
+}
+
+void MultiSymbolEngine::post(const std::string& symbol, const OrderCommand& command, bool track_in_metrics) {
+    post(get_symbol_id(symbol), command, track_in_metrics);
+}
+
+/**
+ * @brief Barrier: waits until every posted message (including the ones shards posted to each other) is applied,
+ *        then combines the per-symbol metrics into the portfolio metrics at timestamp_us.
+ */
+void MultiSymbolEngine::synchronize(long long timestamp_us) {
+    wait_until_drained();
+    aggregate_portfolio(timestamp_us, false);
+}
+
+/**
+    Last barrier of the run, its portfolio point is the final one.
+*/
+void MultiSymbolEngine::finalize(long long final_timestamp_us) {
+    wait_until_drained();
+    aggregate_portfolio(final_timestamp_us, true);
+    portfolio_metrics.compute_summary_statistics();
+}
+
+void MultiSymbolEngine::wait_until_drained() {
+    if (!running && pending_messages.load() > 0) {
+        throw std::runtime_error("Cannot synchronize while messages are pending and the engine is not started.");
+    }
+
+    std::unique_lock<std::mutex> lock(barrier_mutex);
+    barrier_cv.wait(lock, [this]() { return pending_messages.load() == 0; });
+}
+
+void MultiSymbolEngine::aggregate_portfolio(long long timestamp_us, bool is_final) {
+    std::vector<const Metrics*> components;
+    components.reserve(books.size());
+    for (const auto& book : books) {
+        components.push_back(&book->metrics);
+    }
+
+    portfolio_metrics.aggregate(timestamp_us, components, is_final);
+}
+
+int MultiSymbolEngine::get_symbol_id(const std::string& symbol) const {
+    auto iter = symbol_ids.find(symbol);
+    if (iter == symbol_ids.end()) {
+        throw std::runtime_error("Unknown symbol: " + symbol);
+    }
+
+    return iter->second;
+}
+
+void MultiSymbolEngine::run_shard(Shard& shard) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(shard.inbox_mutex);
+            shard.inbox_cv.wait(lock, [this, &shard]() { return !shard.inbox.empty() || !running; });
+
+            if (shard.inbox.empty()) {
+                return; // Stopped and drained
+            }
+            shard.processing.swap(shard.inbox);
+        }
+
+        for (const SymbolMessage& message : shard.processing) {
+            apply_message(message);
+        }
+
+        long long num_processed = (long long)shard.processing.size();
+        shard.processing.clear();
+
+        if (pending_messages.fetch_sub(num_processed) == num_processed) {
+            std::lock_guard<std::mutex> lock(barrier_mutex);
+            barrier_cv.notify_all();
+        }
+    }
+}
+
+void MultiSymbolEngine::apply_message(const SymbolMessage& message) {
+    SymbolBook& book = *books[message.symbol_id];
+    const OrderCommand& command = message.command;
+
+    const std::list<Trade>& trades = book.orderbook.get_trade_log().get_trades();
+    std::size_t num_trades_before = trades.size();
+
+    OrderResult result = book.session.apply(command);
+
+    if (!message.track_in_metrics || result.orderId == -1) {
+        return;
+    }
+
+    if (command.type == OrderCommand::Type::ADD_LIMIT) {
+        Metrics::Side side = command.isBuy ? Metrics::Side::BUYS : Metrics::Side::SELLS;
+
+        // The order is not in the cache yet while it trades on arrival, its trades are booked from the log, as the taker's
+        if (result.filledQuantity > 0) {
+            for (auto iter = std::prev(trades.end(), trades.size() - num_trades_before); iter != trades.end(); ++iter) {
+                if ((command.isBuy ? iter->buyOrderId : iter->sellOrderId) == result.orderId) {
+                    book.metrics.on_untracked_fill(side, iter->priceTick, iter->timestampUs, iter->quantity, true);
+                }
+            }
+        }
+        if (result.status == OrderResult::Status::RESTING) {
+            book.metrics.on_order_placed(result.orderId, side, command.priceTick, command.timestampUs, result.remainingQuantity, false);
+        }
+    }
+    else if (command.type == OrderCommand::Type::CANCEL && result.status == OrderResult::Status::CANCELLED) {
+        book.metrics.on_order_cancelled(result.orderId, command.timestampUs);
+    }
+}
\ No newline at end of file
@@ -9,6 +9,9 @@ Order::Order(bool isBuy, long long priceTick, int quantity, long long timestamp)
     this->isActive = true;
     this->priceTick = priceTick;
     this->quantity = quantity;
+    this->hiddenQuantity = 0;
+    this->displayQuantity = 0;
+    this->ownerId = 0;
     this->tsCreatedUs = timestamp;
     this->tsLastUpdateUs = timestamp;
 }
@@ -19,6 +22,9 @@ Order::Order(bool isBuy, int quantity, long long timestamp) {
     this->isActive = true;
     this->priceTick = -1; // Indicating this is a market or cancel (IOC) order
     this->quantity = quantity;
+    this->hiddenQuantity = 0;
+    this->displayQuantity = 0;
+    this->ownerId = 0;
     this->tsCreatedUs = timestamp;
     this->tsLastUpdateUs = timestamp;
 }
\ No newline at end of file
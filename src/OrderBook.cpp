@@ -1,9 +1,25 @@
 #include <algorithm>
+#include <cstdlib>
+#include <iterator>
+#include <stdexcept>
 
+#include "../include/IdGenerator.h"
 #include "../include/Order.h"
 #include "../include/OrderBook.h"
 
-OrderBook::OrderBook(Metrics& metrics) : buys(), sells(), order_lookup(), trade_log(), metrics(metrics) {}
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(address) __builtin_prefetch(address)
+#else
+#define PREFETCH(address) ((void)(address))
+#endif
+
+OrderBook::OrderBook(Metrics& metrics, MatchingAlgorithm matching_algorithm) : buys(), sells(), order_lookup(), trade_log(), metrics(metrics), l2_listeners(), bbo(), bbo_listeners(), bbo_snapshot(),
+                                            depth(), depth_dirty_begin(sizeof(DepthSnapshot)), depth_dirty_end(0), depth_snapshot(),
+                                            buy_stops(), sell_stops(), stop_lookup(), released_stops(), last_trade_price(-1), last_trade_timestamp(0),
+                                            trade_high(LLONG_MIN), trade_low(LLONG_MAX), aon_buys(), aon_sells(), aon_lookup(), aon_candidates(),
+                                            self_trade_prevention(SelfTradePrevention::NONE), matching_algorithm(matching_algorithm), auction_open(false),
+                                            auction_prices(), auction_bids(), auction_asks(), level_quantities(), level_fifo_shares(), level_shares(),
+                                            mutation_depth(0) {}
 
 /**
  *   Check if given price has a match in the current market (if its a buy >= best_ask | if its a sell <= best_bid) 
@@ -14,176 +30,1124 @@ OrderBook::OrderBook(Metrics& metrics) : buys(), sells(), order_lookup(), trade_
 
  * if no: put the object directly in the data holders    
  */
-long long OrderBook::add_limit_order(bool isBuy, long long priceTick, int quantity, long long timestamp) {
+long long OrderBook::add_limit_order(bool isBuy, long long priceTick, int quantity, long long timestamp, long long ownerId) {
+    return add_order(isBuy, priceTick, quantity, 0, timestamp, -1, ownerId);
+}
+
+/**
+ * @brief Adds an iceberg: it matches with its full quantity like a limit order, but whatever rests shows only displayQuantity at a time.
+ *        Each time the slice is filled, the next one is taken from the hidden reserve and requeued at the back of the level.
+ *        A displayQuantity <= 0 or >= quantity gives a plain limit order.
+ * @return id of the order
+ */
+long long OrderBook::add_iceberg_order(bool isBuy, long long priceTick, int quantity, int displayQuantity, long long timestamp, long long ownerId) {
+    return add_order(isBuy, priceTick, quantity, displayQuantity, timestamp, -1, ownerId);
+}
+
+/**
+    order_id is given when a released stop enters the book, it keeps the id it was parked under.
+    ownerId is only looked at when self-trade prevention is on.
+    The allocation rule is picked once per incoming order, the matching loop of each rule is its own instantiation.
+*/
+long long OrderBook::add_order(bool isBuy, long long priceTick, int quantity, int displayQuantity, long long timestamp, long long order_id, long long ownerId) {
+    switch (matching_algorithm) {
+        case MatchingAlgorithm::PRO_RATA:
+            return add_order_with<ProRataAllocation>(isBuy, priceTick, quantity, displayQuantity, timestamp, order_id, ownerId);
+        case MatchingAlgorithm::FIFO_PRO_RATA:
+            return add_order_with<HybridAllocation<HYBRID_FIFO_PERCENT>>(isBuy, priceTick, quantity, displayQuantity, timestamp, order_id, ownerId);
+        default:
+            return add_order_with<FifoAllocation>(isBuy, priceTick, quantity, displayQuantity, timestamp, order_id, ownerId);
+    }
+}
+
+template<typename Allocation>
+long long OrderBook::add_order_with(bool isBuy, long long priceTick, int quantity, int displayQuantity, long long timestamp, long long order_id, long long ownerId) {
+    MutationScope scope(*this);
     Order new_order(isBuy, priceTick, quantity, timestamp);
+    if (order_id != -1) {
+        new_order.id = order_id;
+    }
+    new_order.ownerId = ownerId;
+    long long self_trade_owner = self_trade_key(ownerId);
     long long new_order_id = new_order.id;
     auto& side = isBuy ? buys : sells;
     auto& opposite_side = isBuy ? sells : buys;
 
     long long opposite_best_price;
-    // Has matches in the market     
-    while (!opposite_side.empty()) {
+    // Has matches in the market, during a call auction everything rests
+    while (!auction_open && !opposite_side.empty()) {
         opposite_best_price= isBuy ? get_best_ask()->first : get_best_bid()->first;
 
         if (!(isBuy ? priceTick >= opposite_best_price : priceTick <= opposite_best_price)) {
             break;
         }
 
-        std::list<Order>& orders_at_price = isBuy ? get_best_ask()->second : get_best_bid()->second;
+        PriceLevel& orders_at_price = isBuy ? get_best_ask()->second : get_best_bid()->second;
+
+        if constexpr (!Allocation::IS_FIFO) {
+            // Comes back with the order done or the level emptied, an emptied level falls through the loop below and is erased
+            match_level_pro_rata<Allocation>(orders_at_price, new_order, opposite_best_price, timestamp, self_trade_owner, false);
+            if (new_order.quantity == 0) {
+                if (orders_at_price.empty()) {
+                    opposite_side.erase(opposite_best_price);
+                    publish_level(!isBuy, opposite_best_price, nullptr);
+                }
+                else {
+                    publish_level(!isBuy, opposite_best_price, &orders_at_price);
+                }
+                return new_order_id;
+            }
+        }
 
         while (!orders_at_price.empty()) {
             Order& matched_order = orders_at_price.front();
 
-            int matched_quantity = std::min(new_order.quantity, matched_order.quantity);
-            new_order.quantity -= matched_quantity;
-            new_order.tsLastUpdateUs = timestamp;
-            matched_order.quantity -= matched_quantity;
-            matched_order.tsLastUpdateUs = timestamp;
-
-            if (isBuy) {
-                trade_log.add_trade(new_order.id, matched_order.id, opposite_best_price, matched_quantity, timestamp, false);
+            // One compare per matched order, the key never matches while prevention is off or the incoming order has no owner
+            if (matched_order.ownerId == self_trade_owner) {
+                prevent_self_trade(orders_at_price, orders_at_price.begin(), new_order, timestamp);
             }
             else {
-                trade_log.add_trade(matched_order.id, new_order.id, opposite_best_price, matched_quantity, timestamp, false);
-            }
+                int matched_quantity = std::min(new_order.quantity, matched_order.quantity);
+                new_order.quantity -= matched_quantity;
+                new_order.tsLastUpdateUs = timestamp;
+                matched_order.quantity -= matched_quantity;
+                matched_order.tsLastUpdateUs = timestamp;
+                orders_at_price.total_quantity -= matched_quantity;
+
+                if (isBuy) {
+                    trade_log.add_trade(new_order.id, matched_order.id, opposite_best_price, matched_quantity, timestamp, false);
+                }
+                else {
+                    trade_log.add_trade(matched_order.id, new_order.id, opposite_best_price, matched_quantity, timestamp, false);
+                }
+                record_trade(opposite_best_price, timestamp);
             
-            if (matched_order.quantity == 0) {
-                order_lookup.erase(matched_order.id);
-                metrics.on_fill(matched_order.id, opposite_best_price, timestamp, matched_quantity, false);
-                orders_at_price.pop_front();
+                if (matched_order.quantity == 0) {
+                    if (matched_order.hiddenQuantity > 0) {
+                        replenish_iceberg(orders_at_price, orders_at_price.begin(), timestamp);
+                    }
+                    else {
+                        order_lookup.erase(matched_order.id);
+                        if (metrics.is_tracking(matched_order.id)) {
+                            metrics.on_fill(matched_order.id, opposite_best_price, timestamp, matched_quantity, false);
+                        }
+                        orders_at_price.orders.pop_front();
+                    }
+                }
             }
             if (new_order.quantity == 0) {
                 if (orders_at_price.empty()) {
                     opposite_side.erase(opposite_best_price);
+                    publish_level(!isBuy, opposite_best_price, nullptr);
+                }
+                else {
+                    publish_level(!isBuy, opposite_best_price, &orders_at_price);
                 }
                 return new_order_id;
             }
         }
 
         opposite_side.erase(opposite_best_price);
+        publish_level(!isBuy, opposite_best_price, nullptr);
     }
 
     // Has no match to trade OR exhausted the whole market, just hold in the market.
-    auto& level = side[priceTick];
-    auto iter = level.insert(level.end(), new_order); // insert() returns an iterator directly to the newOrder inserted
+    if (displayQuantity > 0 && new_order.quantity > displayQuantity) {
+        new_order.hiddenQuantity = new_order.quantity - displayQuantity;
+        new_order.quantity = displayQuantity;
+        new_order.displayQuantity = displayQuantity;
+    }
+
+    auto iter_level = side.try_emplace(priceTick).first;
+    auto& level = iter_level->second;
+    auto iter = level.orders.insert(level.orders.end(), new_order); // insert() returns an iterator directly to the newOrder inserted
+    level.total_quantity += new_order.quantity;
+    level.hidden_quantity += new_order.hiddenQuantity;
 
-    order_lookup[new_order_id] = std::make_tuple(priceTick, iter);
+    order_lookup[new_order_id] = std::make_tuple(priceTick, iter, iter_level);
+    publish_level(isBuy, priceTick, &level);
 
     return new_order_id;
 }
 
+/**
+    The resting order (the front of level under FIFO) belongs to the owner of the incoming order: applies the book's prevention mode instead of trading them.
+*/
+void OrderBook::prevent_self_trade(PriceLevel& level, std::list<Order>::iterator resting_iter, Order& incoming, long long timestamp) {
+    Order& resting = *resting_iter;
+
+    switch (self_trade_prevention) {
+        case SelfTradePrevention::CANCEL_NEWEST:
+            incoming.quantity = 0;
+            break;
+        case SelfTradePrevention::CANCEL_OLDEST:
+            remove_resting(level, resting_iter, timestamp);
+            break;
+        case SelfTradePrevention::CANCEL_BOTH:
+            incoming.quantity = 0;
+            remove_resting(level, resting_iter, timestamp);
+            break;
+        case SelfTradePrevention::DECREMENT: {
+            int decrement = std::min(incoming.quantity, resting.quantity);
+            incoming.quantity -= decrement;
+            resting.quantity -= decrement;
+            resting.tsLastUpdateUs = timestamp;
+            level.total_quantity -= decrement;
+
+            if (resting.quantity == 0) {
+                if (resting.hiddenQuantity > 0) {
+                    replenish_iceberg(level, resting_iter, timestamp);
+                }
+                else {
+                    remove_resting(level, resting_iter, timestamp);
+                }
+            }
+            break;
+        }
+        case SelfTradePrevention::NONE:
+            break; // Not reached, the owner key never matches while prevention is off
+    }
+}
+
+/**
+    Cancels a resting order from inside a matching loop, the caller publishes the level once it is done with it.
+*/
+void OrderBook::remove_resting(PriceLevel& level, std::list<Order>::iterator resting_iter, long long timestamp) {
+    Order& order = *resting_iter;
+    level.total_quantity -= order.quantity;
+    level.hidden_quantity -= order.hiddenQuantity;
+    order_lookup.erase(order.id);
+    if (metrics.is_tracking(order.id)) {
+        metrics.on_order_cancelled(order.id, timestamp);
+    }
+    level.orders.erase(resting_iter);
+}
+
+/**
+    An iceberg of level (the front one under FIFO) has just had its slice filled: the next slice comes out of the reserve and the order moves
+    to the back of the level with a splice, so there is no allocation and its lookup iterators stay valid.
+*/
+void OrderBook::replenish_iceberg(PriceLevel& level, std::list<Order>::iterator iceberg_iter, long long timestamp) {
+    Order& iceberg = *iceberg_iter;
+    iceberg.quantity = std::min(iceberg.displayQuantity, iceberg.hiddenQuantity);
+    iceberg.hiddenQuantity -= iceberg.quantity;
+    iceberg.tsLastUpdateUs = timestamp;
+    level.total_quantity += iceberg.quantity;
+    level.hidden_quantity -= iceberg.quantity;
+
+    level.orders.splice(level.orders.end(), level.orders, iceberg_iter);
+}
+
+/**
+    Shares what the incoming order takes from level among the resting orders, in rounds: a round takes min(incoming, what the level shows),
+    gives the FIFO part of the rule out in time priority and the rest pro-rata (MatchingPolicy.h), then fills every order its share,
+    in time priority. Icebergs whose slice ran out replenish at the back and take part in the next round.
+    Returns once the incoming order is done or the level is empty, the caller publishes the level.
+*/
+template<typename Allocation>
+void OrderBook::match_level_pro_rata(PriceLevel& level, Order& incoming, long long priceTick, long long timestamp, long long self_trade_owner, bool was_instant) {
+    while (incoming.quantity > 0 && !level.empty()) {
+        // Own orders get the prevention mode before anything is shared out. Walking a fixed count keeps replenished icebergs,
+        // spliced to the back, out of this pass
+        if (self_trade_owner != -1) {
+            std::size_t count = level.size();
+            auto iter = level.begin();
+            for (std::size_t i = 0; i < count && incoming.quantity > 0; i++) {
+                auto next = std::next(iter);
+                if (iter->ownerId == self_trade_owner) {
+                    prevent_self_trade(level, iter, incoming, timestamp);
+                }
+                iter = next;
+            }
+            if (incoming.quantity == 0 || level.empty()) {
+                return;
+            }
+        }
+
+        // Contiguous copy of the quantities in time priority. Own icebergs replenished by DECREMENT sit this round out, the next pass reaches them
+        level_quantities.clear();
+        long long available = 0;
+        for (const Order& order : level.orders) {
+            int quantity = order.ownerId == self_trade_owner ? 0 : order.quantity;
+            level_quantities.push_back(quantity);
+            available += quantity;
+        }
+        if (available == 0) {
+            continue;
+        }
+
+        std::size_t count = level_quantities.size();
+        long long take = std::min<long long>(incoming.quantity, available);
+        long long fifo_take = take * Allocation::FIFO_PERCENT / 100;
+        if constexpr (Allocation::FIFO_PERCENT > 0) {
+            level_fifo_shares.assign(count, 0);
+            long long fifo_left = fifo_take;
+            for (std::size_t i = 0; i < count && fifo_left > 0; i++) {
+                int share = (int)std::min<long long>(level_quantities[i], fifo_left);
+                level_fifo_shares[i] = share;
+                level_quantities[i] -= share;
+                fifo_left -= share;
+            }
+        }
+        level_shares.resize(count);
+        allocate_pro_rata(level_quantities.data(), level_shares.data(), count, available - fifo_take, take - fifo_take);
+
+        auto iter = level.begin();
+        for (std::size_t i = 0; i < count; i++) {
+            auto next = std::next(iter);
+            int fill = level_shares[i];
+            if constexpr (Allocation::FIFO_PERCENT > 0) {
+                fill += level_fifo_shares[i];
+            }
+            if (fill > 0) {
+                Order& matched_order = *iter;
+                incoming.quantity -= fill;
+                incoming.tsLastUpdateUs = timestamp;
+                matched_order.quantity -= fill;
+                matched_order.tsLastUpdateUs = timestamp;
+                level.total_quantity -= fill;
+
+                if (incoming.isBuy) {
+                    trade_log.add_trade(incoming.id, matched_order.id, priceTick, fill, timestamp, was_instant);
+                }
+                else {
+                    trade_log.add_trade(matched_order.id, incoming.id, priceTick, fill, timestamp, was_instant);
+                }
+                record_trade(priceTick, timestamp);
+
+                if (matched_order.quantity == 0) {
+                    if (matched_order.hiddenQuantity > 0) {
+                        replenish_iceberg(level, iter, timestamp);
+                    }
+                    else {
+                        order_lookup.erase(matched_order.id);
+                        if (metrics.is_tracking(matched_order.id)) {
+                            metrics.on_fill(matched_order.id, priceTick, timestamp, fill, was_instant);
+                        }
+                        level.orders.erase(iter);
+                    }
+                }
+            }
+            iter = next;
+        }
+    }
+}
+
+/**
+ * @brief Puts an order back into an uncrossed book exactly as it was captured (slice and reserve included), at the back of its level,
+ *        without matching. Used to rebuild a book from a checkpoint.
+ * @return new id of the order
+ */
+long long OrderBook::restore_resting_order(bool isBuy, long long priceTick, int quantity, int hiddenQuantity, int displayQuantity, long long timestamp, long long ownerId) {
+    MutationScope scope(*this);
+    Order order(isBuy, priceTick, quantity, timestamp);
+    order.hiddenQuantity = hiddenQuantity;
+    order.displayQuantity = displayQuantity;
+    order.ownerId = ownerId;
+
+    auto iter_level = (isBuy ? buys : sells).try_emplace(priceTick).first;
+    auto& level = iter_level->second;
+    auto iter = level.orders.insert(level.orders.end(), order);
+    level.total_quantity += quantity;
+    level.hidden_quantity += hiddenQuantity;
+
+    order_lookup[order.id] = std::make_tuple(priceTick, iter, iter_level);
+    publish_level(isBuy, priceTick, &level);
+
+    return order.id;
+}
+
 /**
     First check if orders exists at the best price level, then exhaust all the orders until IOC is satisfied, when its satisfied: return
         if its not satisfied & orders.empty(): remove this price level from the matching side and reset the loop
 
     @return  order id of the IOC order
 */
-long long OrderBook::add_IOC_order(bool isBuy, int quantity, long long timestamp) {
+long long OrderBook::add_IOC_order(bool isBuy, int quantity, long long timestamp, long long ownerId) {
+    return add_market_order(isBuy, quantity, timestamp, -1, ownerId);
+}
+
+long long OrderBook::add_market_order(bool isBuy, int quantity, long long timestamp, long long order_id, long long ownerId) {
+    switch (matching_algorithm) {
+        case MatchingAlgorithm::PRO_RATA:
+            return add_market_order_with<ProRataAllocation>(isBuy, quantity, timestamp, order_id, ownerId);
+        case MatchingAlgorithm::FIFO_PRO_RATA:
+            return add_market_order_with<HybridAllocation<HYBRID_FIFO_PERCENT>>(isBuy, quantity, timestamp, order_id, ownerId);
+        default:
+            return add_market_order_with<FifoAllocation>(isBuy, quantity, timestamp, order_id, ownerId);
+    }
+}
+
+template<typename Allocation>
+long long OrderBook::add_market_order_with(bool isBuy, int quantity, long long timestamp, long long order_id, long long ownerId) {
+    MutationScope scope(*this);
     Order new_market_order(isBuy, quantity, timestamp);
+    if (order_id != -1) {
+        new_market_order.id = order_id;
+    }
+    new_market_order.ownerId = ownerId;
+    long long self_trade_owner = self_trade_key(ownerId);
     auto& opposite_side = isBuy ? sells : buys;
     
-    while (!opposite_side.empty()) {
+    while (!auction_open && !opposite_side.empty()) {
         long long current_best_price = isBuy ? get_best_ask()->first : get_best_bid()->first;
-        std::list<Order>& orders_at_best_price = isBuy ? get_best_ask()->second : get_best_bid()->second;
-        
+        PriceLevel& orders_at_best_price = isBuy ? get_best_ask()->second : get_best_bid()->second;
+
+        if constexpr (!Allocation::IS_FIFO) {
+            match_level_pro_rata<Allocation>(orders_at_best_price, new_market_order, current_best_price, timestamp, self_trade_owner, true);
+            if (new_market_order.quantity == 0) {
+                if (orders_at_best_price.empty()) {
+                    opposite_side.erase(current_best_price);
+                    publish_level(!isBuy, current_best_price, nullptr);
+                }
+                else {
+                    publish_level(!isBuy, current_best_price, &orders_at_best_price);
+                }
+                return new_market_order.id;
+            }
+        }
+
         while (!orders_at_best_price.empty()) {
             Order& matched_order = orders_at_best_price.front();
-            int matched_quantity = std::min(new_market_order.quantity, matched_order.quantity);
-            new_market_order.quantity -= matched_quantity;
-            matched_order.quantity -= matched_quantity;
-            matched_order.tsLastUpdateUs = timestamp;
-
-            if (isBuy) {
-                trade_log.add_trade(new_market_order.id, matched_order.id, matched_order.priceTick, matched_quantity, timestamp, true);
+            if (matched_order.ownerId == self_trade_owner) {
+                prevent_self_trade(orders_at_best_price, orders_at_best_price.begin(), new_market_order, timestamp);
             }
             else {
-                trade_log.add_trade(matched_order.id, new_market_order.id, matched_order.priceTick, matched_quantity, timestamp, true);
-            }
+                int matched_quantity = std::min(new_market_order.quantity, matched_order.quantity);
+                new_market_order.quantity -= matched_quantity;
+                matched_order.quantity -= matched_quantity;
+                matched_order.tsLastUpdateUs = timestamp;
+                orders_at_best_price.total_quantity -= matched_quantity;
+
+                if (isBuy) {
+                    trade_log.add_trade(new_market_order.id, matched_order.id, matched_order.priceTick, matched_quantity, timestamp, true);
+                }
+                else {
+                    trade_log.add_trade(matched_order.id, new_market_order.id, matched_order.priceTick, matched_quantity, timestamp, true);
+                }
+                record_trade(current_best_price, timestamp);
 
-            if (matched_order.quantity == 0) {
-                order_lookup.erase(matched_order.id);
-                metrics.on_fill(matched_order.id, matched_order.priceTick, matched_quantity, matched_quantity, true);
-                orders_at_best_price.pop_front();
+                if (matched_order.quantity == 0) {
+                    if (matched_order.hiddenQuantity > 0) {
+                        replenish_iceberg(orders_at_best_price, orders_at_best_price.begin(), timestamp);
+                    }
+                    else {
+                        order_lookup.erase(matched_order.id);
+                        if (metrics.is_tracking(matched_order.id)) {
+                            metrics.on_fill(matched_order.id, matched_order.priceTick, matched_quantity, matched_quantity, true);
+                        }
+                        orders_at_best_price.orders.pop_front();
+                    }
+                }
             }
             if (new_market_order.quantity == 0) {
                 if (orders_at_best_price.empty()) {
                     opposite_side.erase(current_best_price);
+                    publish_level(!isBuy, current_best_price, nullptr);
+                }
+                else {
+                    publish_level(!isBuy, current_best_price, &orders_at_best_price);
                 }
                 return new_market_order.id;
             }
         }
 
         opposite_side.erase(current_best_price);
+        publish_level(!isBuy, current_best_price, nullptr);
     }
 
     return new_market_order.id;
 }
 
+/**
+ * @brief Parks a stop order in its side's trigger book until a trade prints at or through triggerTick (at or above for a buy, at or below for a sell).
+ *        It is then entered as a limit order at limitTick, or as an IOC when limitTick is -1, under the id returned here.
+ *        A stop whose trigger the last trade has already crossed enters immediately, unless a call auction is open.
+ * @return id of the order
+ */
+long long OrderBook::add_stop_order(bool isBuy, long long triggerTick, long long limitTick, int quantity, long long timestamp, long long ownerId) {
+    MutationScope scope(*this);
+    StopOrder stop = {IdGenerator::getNext(), triggerTick, limitTick, timestamp, ownerId, quantity, isBuy};
+
+    bool is_crossed = !auction_open && last_trade_price != -1 && (isBuy ? last_trade_price >= triggerTick : last_trade_price <= triggerTick);
+    if (is_crossed) {
+        activate_stop(stop);
+        return stop.id;
+    }
+
+    auto& stops_at_trigger = (isBuy ? buy_stops : sell_stops)[triggerTick];
+    stop_lookup[stop.id] = stops_at_trigger.insert(stops_at_trigger.end(), stop);
+
+    return stop.id;
+}
+
+void OrderBook::activate_stop(const StopOrder& stop) {
+    if (stop.limitTick == -1) {
+        add_market_order(stop.isBuy, stop.quantity, std::max(stop.tsCreatedUs, last_trade_timestamp), stop.id, stop.ownerId);
+    }
+    else {
+        add_order(stop.isBuy, stop.limitTick, stop.quantity, 0, std::max(stop.tsCreatedUs, last_trade_timestamp), stop.id, stop.ownerId);
+    }
+}
+
+/**
+    Runs when the outermost operation finishes. Each round first fills the resting all-or-none orders that the book can now complete,
+    then releases the stops crossed by the prices traded since the last round. Their trades can complete or cross further orders,
+    which the next round picks up. After MAX_STOP_CASCADE_ROUNDS rounds whatever is still triggered stays parked (the traded range is kept)
+    and is released by the next operation on the book.
+*/
+void OrderBook::release_triggered_orders() {
+    for (int round = 0; round < MAX_STOP_CASCADE_ROUNDS; round++) {
+        bool released_any = false;
+        if (has_crossing_aon()) {
+            released_any |= fill_crossing_aon(true);
+            released_any |= fill_crossing_aon(false);
+        }
+        released_any |= release_stop_round();
+
+        if (!released_any) {
+            return;
+        }
+    }
+}
+
+/**
+    Takes out, as whole ranges of the trigger books, the stops crossed by the traded prices: buys by ascending trigger,
+    then sells by descending trigger, each trigger in arrival order, and enters them.
+    @return whether any stop was released
+*/
+bool OrderBook::release_stop_round() {
+    released_stops.clear();
+
+    auto buys_end = buy_stops.upper_bound(trade_high);
+    for (auto iter = buy_stops.begin(); iter != buys_end; ++iter) {
+        for (const StopOrder& stop : iter->second) {
+            released_stops.push_back(stop);
+            stop_lookup.erase(stop.id);
+        }
+    }
+    buy_stops.erase(buy_stops.begin(), buys_end);
+
+    auto sells_begin = sell_stops.lower_bound(trade_low);
+    for (auto iter = sell_stops.rbegin(); iter != std::make_reverse_iterator(sells_begin); ++iter) {
+        for (const StopOrder& stop : iter->second) {
+            released_stops.push_back(stop);
+            stop_lookup.erase(stop.id);
+        }
+    }
+    sell_stops.erase(sells_begin, sell_stops.end());
+
+    trade_high = LLONG_MIN;
+    trade_low = LLONG_MAX;
+
+    // Activations run below the outermost scope, so they never come back in here while released_stops is walked
+    for (const StopOrder& stop : released_stops) {
+        activate_stop(stop);
+    }
+
+    return !released_stops.empty();
+}
+
+/**
+    Executes, best price first and in arrival order within a price, the resting all-or-none orders of one side that cross the opposite touch
+    and can be filled completely. An order that can't is left where it is, the ones behind it are still tried.
+    @return whether any order was filled
+*/
+bool OrderBook::fill_crossing_aon(bool isBuy) {
+    auto& aon_side = isBuy ? aon_buys : aon_sells;
+    auto& opposite_side = isBuy ? sells : buys;
+    if (aon_side.empty() || opposite_side.empty()) {
+        return false;
+    }
+
+    // Filling one erases it from aon_side, so the candidates are listed up front
+    aon_candidates.clear();
+    long long opposite_best_price = isBuy ? sells.begin()->first : buys.rbegin()->first;
+    if (isBuy) {
+        for (auto iter = aon_buys.rbegin(); iter != aon_buys.rend() && iter->first >= opposite_best_price; ++iter) {
+            for (const Order& order : iter->second) {
+                aon_candidates.push_back(order.id);
+            }
+        }
+    }
+    else {
+        for (auto iter = aon_sells.begin(); iter != aon_sells.end() && iter->first <= opposite_best_price; ++iter) {
+            for (const Order& order : iter->second) {
+                aon_candidates.push_back(order.id);
+            }
+        }
+    }
+
+    bool filled_any = false;
+    for (long long order_id : aon_candidates) {
+        const Order& candidate = *aon_lookup.find(order_id)->second;
+        if (!has_liquidity(isBuy, candidate.priceTick, candidate.quantity)) {
+            continue;
+        }
+
+        long long price = candidate.priceTick;
+        int quantity = candidate.quantity;
+        long long timestamp = std::max(candidate.tsLastUpdateUs, last_trade_timestamp);
+        cancel_aon(order_id);
+        add_order(isBuy, price, quantity, 0, timestamp, order_id);
+        filled_any = true;
+    }
+
+    return filled_any;
+}
+
+/**
+ * @brief Fill-or-kill: executes the whole quantity at priceTick or better right away, or does nothing at all.
+ *        The opposite side is checked from the level aggregates before anything is touched, so a killed order leaves no trace.
+ *        Hidden iceberg reserve is not counted, an order only the reserve could complete is killed. Nothing executes during a call auction, so it is killed.
+ * @return id of the order, -1 if it was killed
+ */
+long long OrderBook::add_FOK_order(bool isBuy, long long priceTick, int quantity, long long timestamp) {
+    if (auction_open || !has_liquidity(isBuy, priceTick, quantity)) {
+        return -1;
+    }
+
+    return add_order(isBuy, priceTick, quantity, 0, timestamp);
+}
+
+/**
+ * @brief Adds a limit order that may only provide liquidity: it is rejected, without touching the book, if it would cross the opposite touch.
+ *        The touch is read from the first node of the opposite map, which stays current inside batches where the cached bbo is not refreshed.
+ * @return id of the order, -1 if it was rejected
+ */
+long long OrderBook::add_post_only_order(bool isBuy, long long priceTick, int quantity, long long timestamp) {
+    bool crosses = isBuy ? !sells.empty() && priceTick >= sells.begin()->first : !buys.empty() && priceTick <= buys.rbegin()->first;
+    if (crosses) {
+        return -1;
+    }
+
+    return add_order(isBuy, priceTick, quantity, 0, timestamp);
+}
+
+/**
+ * @brief All-or-none: executes the whole quantity at priceTick or better right away if the opposite side holds it. Otherwise the order waits,
+ *        undisplayed and outside the price levels, until a later operation leaves enough quantity at its price to fill it in one go.
+ *        Resting all-or-none orders only take liquidity, they never trade with each other. During a call auction it always waits.
+ * @return id of the order
+ */
+long long OrderBook::add_AON_order(bool isBuy, long long priceTick, int quantity, long long timestamp) {
+    if (!auction_open && has_liquidity(isBuy, priceTick, quantity)) {
+        return add_order(isBuy, priceTick, quantity, 0, timestamp);
+    }
+
+    Order order(isBuy, priceTick, quantity, timestamp);
+    auto& orders_at_price = (isBuy ? aon_buys : aon_sells)[priceTick];
+    aon_lookup[order.id] = orders_at_price.insert(orders_at_price.end(), order);
+
+    return order.id;
+}
+
+/**
+    Whether the opposite side holds at least quantity at priceTick or better. Reads one aggregate per level and stops as soon as it has enough.
+*/
+bool OrderBook::has_liquidity(bool isBuy, long long priceTick, int quantity) const {
+    long long available = 0;
+
+    if (isBuy) {
+        for (auto iter = sells.begin(); iter != sells.end() && iter->first <= priceTick && available < quantity; ++iter) {
+            available += iter->second.total_quantity;
+        }
+    }
+    else {
+        for (auto iter = buys.rbegin(); iter != buys.rend() && iter->first >= priceTick && available < quantity; ++iter) {
+            available += iter->second.total_quantity;
+        }
+    }
+
+    return available >= quantity;
+}
+
+/**
+ * @brief Closes the call auction: every bid at or above the clearing price executes against every ask at or below it, all at that price,
+ *        in price-time priority until the clearing volume is done. Continuous matching then resumes, and the stops and all-or-none
+ *        orders triggered by the auction trades are released. Hidden iceberg reserve takes part, owners are not looked at.
+ * @return clearing price, executed volume and imbalance, priceTick -1 when the book didn't cross
+ */
+OrderBook::UncrossResult OrderBook::uncross(long long timestamp) {
+    MutationScope scope(*this);
+    auction_open = false;
+
+    UncrossResult result = find_clearing_price();
+    long long remaining = result.volume;
+    long long last_bid_price = -1;
+    long long last_ask_price = -1;
+    while (remaining > 0) {
+        auto bid_level = std::prev(buys.end());
+        auto ask_level = sells.begin();
+        last_bid_price = bid_level->first;
+        last_ask_price = ask_level->first;
+        const Order& buy = bid_level->second.front();
+        const Order& sell = ask_level->second.front();
+        int quantity = (int)std::min<long long>(remaining, std::min(buy.quantity, sell.quantity));
+
+        trade_log.add_trade(buy.id, sell.id, result.priceTick, quantity, timestamp, false);
+        record_trade(result.priceTick, timestamp);
+        remaining -= quantity;
+
+        fill_auction_front(true, bid_level, quantity, result.priceTick, timestamp);
+        fill_auction_front(false, ask_level, quantity, result.priceTick, timestamp);
+    }
+
+    // Emptied levels were published on the way, the last level taken from on each side is published once here if it survived
+    auto bid_level = buys.find(last_bid_price);
+    if (bid_level != buys.end()) {
+        publish_level(true, last_bid_price, &bid_level->second);
+    }
+    auto ask_level = sells.find(last_ask_price);
+    if (ask_level != sells.end()) {
+        publish_level(false, last_ask_price, &ask_level->second);
+    }
+
+    return result;
+}
+
+/**
+    Lays the crossed range [best ask, best bid] out as a price ladder, one merge pass over the two sides into contiguous per-price quantities,
+    then runs the cumulative curves over it as running sums: bids at or above each price, asks at or below it.
+    The clearing price maximises the executable volume min(bids, asks), then minimises the imbalance, then is the closest to the last trade.
+    Remaining ties go to the lowest price.
+*/
+OrderBook::UncrossResult OrderBook::find_clearing_price() {
+    UncrossResult result = {-1, 0, 0};
+    if (buys.empty() || sells.empty() || buys.rbegin()->first < sells.begin()->first) {
+        return result;
+    }
+
+    auction_prices.clear();
+    auction_bids.clear();
+    auction_asks.clear();
+    auto bid_iter = buys.lower_bound(sells.begin()->first);
+    auto ask_iter = sells.begin();
+    auto asks_end = sells.upper_bound(buys.rbegin()->first);
+    while (bid_iter != buys.end() || ask_iter != asks_end) {
+        long long price = bid_iter == buys.end() ? ask_iter->first
+                        : ask_iter == asks_end ? bid_iter->first
+                        : std::min(bid_iter->first, ask_iter->first);
+        long long bid_quantity = 0;
+        long long ask_quantity = 0;
+        if (bid_iter != buys.end() && bid_iter->first == price) {
+            bid_quantity = bid_iter->second.total_quantity + bid_iter->second.hidden_quantity;
+            ++bid_iter;
+        }
+        if (ask_iter != asks_end && ask_iter->first == price) {
+            ask_quantity = ask_iter->second.total_quantity + ask_iter->second.hidden_quantity;
+            ++ask_iter;
+        }
+        auction_prices.push_back(price);
+        auction_bids.push_back(bid_quantity);
+        auction_asks.push_back(ask_quantity);
+    }
+
+    long long total_bids = 0;
+    for (long long quantity : auction_bids) {
+        total_bids += quantity;
+    }
+
+    long long bids_below = 0;
+    long long asks_at_or_below = 0;
+    for (std::size_t i = 0; i < auction_prices.size(); i++) {
+        long long bids_at_or_above = total_bids - bids_below;
+        bids_below += auction_bids[i];
+        asks_at_or_below += auction_asks[i];
+
+        long long volume = std::min(bids_at_or_above, asks_at_or_below);
+        long long imbalance = bids_at_or_above - asks_at_or_below;
+        bool is_better = volume > result.volume;
+        if (volume == result.volume) {
+            long long imbalance_gap = std::abs(imbalance) - std::abs(result.imbalance);
+            bool is_closer = last_trade_price != -1 && std::abs(auction_prices[i] - last_trade_price) < std::abs(result.priceTick - last_trade_price);
+            is_better = imbalance_gap < 0 || (imbalance_gap == 0 && is_closer);
+        }
+
+        if (is_better) {
+            result = {auction_prices[i], volume, imbalance};
+        }
+    }
+
+    return result;
+}
+
+/**
+    Takes quantity off the front order of a level during the uncross. A filled iceberg slice is replenished, any other filled order leaves
+    the book, and a level left empty is erased and published.
+*/
+void OrderBook::fill_auction_front(bool isBuy, std::map<long long, PriceLevel>::iterator level_iter, int quantity, long long priceTick, long long timestamp) {
+    PriceLevel& level = level_iter->second;
+    Order& order = level.front();
+    order.quantity -= quantity;
+    order.tsLastUpdateUs = timestamp;
+    level.total_quantity -= quantity;
+    if (order.quantity > 0) {
+        return;
+    }
+
+    if (order.hiddenQuantity > 0) {
+        replenish_iceberg(level, level.begin(), timestamp);
+        return;
+    }
+
+    order_lookup.erase(order.id);
+    if (metrics.is_tracking(order.id)) {
+        metrics.on_fill(order.id, priceTick, timestamp, quantity, false);
+    }
+    level.orders.pop_front();
+    if (level.empty()) {
+        long long level_price = level_iter->first;
+        (isBuy ? buys : sells).erase(level_iter);
+        publish_level(isBuy, level_price, nullptr);
+    }
+}
+
+/**
+    Removes a stop that is still waiting for its trigger.
+*/
+bool OrderBook::cancel_stop(long long order_id) {
+    auto iter_stop = stop_lookup.find(order_id);
+    if (iter_stop == stop_lookup.end()) {
+        return false;
+    }
+
+    auto& trigger_book = iter_stop->second->isBuy ? buy_stops : sell_stops;
+    auto iter_trigger = trigger_book.find(iter_stop->second->triggerTick);
+    iter_trigger->second.erase(iter_stop->second);
+    if (iter_trigger->second.empty()) {
+        trigger_book.erase(iter_trigger);
+    }
+    stop_lookup.erase(iter_stop);
+
+    return true;
+}
+
+bool OrderBook::cancel_aon(long long order_id) {
+    auto iter_aon = aon_lookup.find(order_id);
+    if (iter_aon == aon_lookup.end()) {
+        return false;
+    }
+
+    auto& aon_side = iter_aon->second->isBuy ? aon_buys : aon_sells;
+    auto iter_price = aon_side.find(iter_aon->second->priceTick);
+    iter_price->second.erase(iter_aon->second);
+    if (iter_price->second.empty()) {
+        aon_side.erase(iter_price);
+    }
+    aon_lookup.erase(iter_aon);
+
+    return true;
+}
+
 int OrderBook::cancel_order(long long orderId) {
+    MutationScope scope(*this);
     auto iter_lookup = order_lookup.find(orderId); // .find(key) returns a temp iterator to the corresponding <key, value> std::pair
     if (iter_lookup == order_lookup.end()){
+        if (cancel_stop(orderId) || cancel_aon(orderId)) {
+            return 0;
+        }
         std::cout << "This order doesn't exist.";
         return 1;
     }
 
-    auto& iter_to_order = std::get<1>(iter_lookup->second);
+    erase_order(iter_lookup);
 
-    Order& order_to_delete = *iter_to_order;
-    long long order_price = order_to_delete.priceTick;
+    return 0;
+}
 
-    auto& side = order_to_delete.isBuy ? buys : sells;
+/**
+ * @brief Cancels a batch of orders in the given order, prefetching the order and price level of the id
+ *        BATCH_PREFETCH_DISTANCE positions ahead so those misses overlap with the current cancel. Unknown ids are skipped silently.
+ * @return number of orders that were resting and got cancelled
+ */
+std::size_t OrderBook::cancel_orders(const long long* order_ids, std::size_t num_orders) {
+    MutationScope scope(*this);
+    std::size_t num_cancelled = 0;
 
-    auto price_level = side.find(order_price);
-    if (price_level == side.end()){
-        std::cout << "Error occured finding the price level or order to modify.";
-        return 1;
+    for (std::size_t i = 0; i < num_orders && i < BATCH_PREFETCH_DISTANCE; i++) {
+        prefetch_order(order_ids[i]);
     }
-    auto& price_level_list = price_level->second;
 
-    price_level_list.erase(iter_to_order);
-    if (price_level_list.empty()) {
-        side.erase(order_price);
+    for (std::size_t i = 0; i < num_orders; i++) {
+        if (i + BATCH_PREFETCH_DISTANCE < num_orders) {
+            prefetch_order(order_ids[i + BATCH_PREFETCH_DISTANCE]);
+        }
+
+        auto iter_lookup = order_lookup.find(order_ids[i]);
+        if (iter_lookup != order_lookup.end()) {
+            erase_order(iter_lookup);
+            num_cancelled++;
+        }
+        else if ((!stop_lookup.empty() && cancel_stop(order_ids[i])) || (!aon_lookup.empty() && cancel_aon(order_ids[i]))) {
+            num_cancelled++;
+        }
     }
-    order_lookup.erase(iter_lookup);
 
-    return 0;
+    return num_cancelled;
+}
+
+/**
+    Removes a resting order through its stored handles, the price level is reached from the lookup entry without searching the side.
+*/
+void OrderBook::erase_order(std::unordered_map<long long, std::tuple<long long, std::list<Order>::iterator, std::map<long long, PriceLevel>::iterator>>::iterator iter_lookup) {
+    auto iter_to_order = std::get<1>(iter_lookup->second);
+    auto price_level = std::get<2>(iter_lookup->second);
+    bool is_order_buy = iter_to_order->isBuy;
+    long long order_price = price_level->first;
+    auto& side = is_order_buy ? buys : sells;
+
+    price_level->second.total_quantity -= iter_to_order->quantity;
+    price_level->second.hidden_quantity -= iter_to_order->hiddenQuantity;
+    price_level->second.orders.erase(iter_to_order);
+    if (price_level->second.empty()) {
+        side.erase(price_level);
+        publish_level(is_order_buy, order_price, nullptr);
+    }
+    else {
+        publish_level(is_order_buy, order_price, &price_level->second);
+    }
+    order_lookup.erase(iter_lookup);
 }
 
-void OrderBook::modify_order(long long order_id, int new_quantity, long long timestamp) {
+/**
+ * @brief Reduces the quantity in place (keeping priority), or re-enters the order at the back of its level when the quantity grows.
+ *        For icebergs new_quantity is the total, visible slice plus hidden reserve. Pending stops and resting all-or-none orders just take the new quantity.
+ * @return id of the order after the modification (a new id if it was re-entered), -1 if it was cancelled or didn't exist
+ */
+long long OrderBook::modify_order(long long order_id, int new_quantity, long long timestamp) {
+    MutationScope scope(*this);
     if (new_quantity <= 0) {
         cancel_order(order_id);
+        return -1;
     }
 
-    // get the iterator pointing to the [price, iter_to_order] tuple
+    // get the iterator pointing to the [price, iter_to_order, iter_to_level] tuple
     auto iter_lookup = order_lookup.find(order_id);
     if (iter_lookup == order_lookup.end()) {
-        return; // Meaning it didn't exist
+        // Pending stops and all-or-none orders are not in a level queue, they only take the new size
+        auto iter_stop = stop_lookup.find(order_id);
+        auto iter_aon = aon_lookup.find(order_id);
+        if (iter_stop != stop_lookup.end()) {
+            iter_stop->second->quantity = new_quantity;
+        }
+        else if (iter_aon != aon_lookup.end()) {
+            iter_aon->second->quantity = new_quantity;
+            iter_aon->second->tsLastUpdateUs = timestamp;
+        }
+        else {
+            return -1; // Meaning it didn't exist
+        }
+        return order_id;
     }
 
     auto& iterator_to_order = std::get<1>(iter_lookup->second);
     Order& order_to_modify = *iterator_to_order;
 
-    if (new_quantity >= order_to_modify.quantity) {
-        auto& side = order_to_modify.isBuy ? buys : sells;
-
-        auto price_level = side.find(order_to_modify.priceTick);
-        if (price_level == side.end()) {
-            std::cout << "Error occured finding the price level or order to modify.";
-            return;
-        }
-        auto& price_level_list = price_level->second;
-
+    if (new_quantity >= order_to_modify.quantity + order_to_modify.hiddenQuantity) {
         bool is_order_buy = order_to_modify.isBuy;
         long long order_price = order_to_modify.priceTick;
+        int display_quantity = order_to_modify.displayQuantity;
+        long long owner_id = order_to_modify.ownerId;
 
-        price_level_list.erase(iterator_to_order); // this is the iterator pointing to the order itself 
-        order_lookup.erase(iter_lookup); // this is the iterator to the tuple [price, iter] stored in the unordered map
+        // Removing the order may drop its level, add_order re-creates it at the back of the queue
+        erase_order(iter_lookup);
 
-        add_limit_order(is_order_buy, order_price, new_quantity, timestamp);
+        return add_order(is_order_buy, order_price, new_quantity, display_quantity, timestamp, -1, owner_id);
     }
     else {
-        order_to_modify.quantity = new_quantity;
+        // Icebergs give up hidden reserve first, the visible slice only shrinks once the reserve is gone
+        int reduction = order_to_modify.quantity + order_to_modify.hiddenQuantity - new_quantity;
+        int hidden_reduction = std::min(reduction, order_to_modify.hiddenQuantity);
+        order_to_modify.hiddenQuantity -= hidden_reduction;
+
+        PriceLevel& level = std::get<2>(iter_lookup->second)->second;
+        level.total_quantity -= reduction - hidden_reduction;
+        level.hidden_quantity -= hidden_reduction;
+        order_to_modify.quantity -= reduction - hidden_reduction;
         order_to_modify.tsLastUpdateUs = timestamp;
+        publish_level(order_to_modify.isBuy, order_to_modify.priceTick, &level);
+    }
+
+    return order_id;
+}
+
+/**
+ * @brief Applies one queued command. Cancels and modifies address orders by their id in this book.
+ * @return what happened to the order, with the quantity it executed and the quantity left resting
+ */
+OrderResult OrderBook::apply(const OrderCommand& command) {
+    MutationScope scope(*this);
+    OrderResult result;
+    result.clientOrderId = command.orderId;
+
+    std::size_t num_trades_before = trade_log.get_trades().size();
+
+    switch (command.type) {
+        case OrderCommand::Type::ADD_LIMIT:
+            result.orderId = add_limit_order(command.isBuy, command.priceTick, command.quantity, command.timestampUs, command.ownerId);
+            break;
+        case OrderCommand::Type::ADD_ICEBERG:
+            result.orderId = add_iceberg_order(command.isBuy, command.priceTick, command.quantity, command.displayQuantity, command.timestampUs, command.ownerId);
+            break;
+        case OrderCommand::Type::ADD_IOC:
+            result.orderId = add_IOC_order(command.isBuy, command.quantity, command.timestampUs, command.ownerId);
+            break;
+        case OrderCommand::Type::ADD_STOP:
+            result.orderId = add_stop_order(command.isBuy, command.triggerTick, command.priceTick, command.quantity, command.timestampUs, command.ownerId);
+            if (stop_lookup.find(result.orderId) != stop_lookup.end()) {
+                result.remainingQuantity = command.quantity;
+                result.status = OrderResult::Status::PENDING;
+                return result;
+            }
+            break;
+        case OrderCommand::Type::ADD_FOK:
+            result.orderId = add_FOK_order(command.isBuy, command.priceTick, command.quantity, command.timestampUs);
+            if (result.orderId == -1) {
+                result.status = OrderResult::Status::CANCELLED;
+                return result;
+            }
+            break;
+        case OrderCommand::Type::ADD_POST_ONLY:
+            result.orderId = add_post_only_order(command.isBuy, command.priceTick, command.quantity, command.timestampUs);
+            if (result.orderId == -1) {
+                return result;
+            }
+            break;
+        case OrderCommand::Type::ADD_AON:
+            result.orderId = add_AON_order(command.isBuy, command.priceTick, command.quantity, command.timestampUs);
+            break;
+        case OrderCommand::Type::CANCEL: {
+            auto iter_lookup = order_lookup.find(command.orderId);
+            if (iter_lookup == order_lookup.end()) {
+                if (!cancel_stop(command.orderId) && !cancel_aon(command.orderId)) {
+                    return result;
+                }
+                result.orderId = command.orderId;
+                result.status = OrderResult::Status::CANCELLED;
+                return result;
+            }
+            erase_order(iter_lookup);
+            result.orderId = command.orderId;
+            result.status = OrderResult::Status::CANCELLED;
+            return result;
+        }
+        case OrderCommand::Type::MODIFY:
+            if (order_lookup.find(command.orderId) == order_lookup.end()) {
+                bool is_stop = stop_lookup.find(command.orderId) != stop_lookup.end();
+                if (!is_stop && aon_lookup.find(command.orderId) == aon_lookup.end()) {
+                    return result;
+                }
+                result.orderId = modify_order(command.orderId, command.quantity, command.timestampUs);
+                if (result.orderId == -1) {
+                    result.orderId = command.orderId;
+                    result.status = OrderResult::Status::CANCELLED;
+                }
+                else {
+                    result.remainingQuantity = command.quantity;
+                    result.status = is_stop ? OrderResult::Status::PENDING : OrderResult::Status::RESTING;
+                }
+                return result;
+            }
+            result.orderId = modify_order(command.orderId, command.quantity, command.timestampUs);
+            if (result.orderId == -1) {
+                result.orderId = command.orderId;
+                result.status = OrderResult::Status::CANCELLED;
+                return result;
+            }
+            break;
+    }
+
+    // Every trade printed while applying an add involves the new order
+    auto iter_trade = trade_log.get_trades().rbegin();
+    for (std::size_t i = num_trades_before; i < trade_log.get_trades().size(); i++, ++iter_trade) {
+        result.filledQuantity += iter_trade->quantity;
+    }
+
+    auto iter_lookup = order_lookup.find(result.orderId);
+    if (iter_lookup != order_lookup.end()) {
+        result.remainingQuantity = std::get<1>(iter_lookup->second)->quantity + std::get<1>(iter_lookup->second)->hiddenQuantity;
+        result.status = OrderResult::Status::RESTING;
+    }
+    else if (command.type == OrderCommand::Type::ADD_AON && aon_lookup.find(result.orderId) != aon_lookup.end()) {
+        result.remainingQuantity = command.quantity;
+        result.status = OrderResult::Status::RESTING;
+    }
+    else if (result.filledQuantity < command.quantity) {
+        // Unfilled rest of an IOC or stop market order, or dropped by self-trade prevention
+        result.status = OrderResult::Status::CANCELLED;
+    }
+    else {
+        result.status = OrderResult::Status::FILLED;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Applies commands in order with exactly the semantics of calling apply() on each, while prefetching the orders
+ *        that cancels and modifies BATCH_PREFETCH_DISTANCE commands ahead will touch, so their cache misses overlap with the current work.
+ *        The top of book is refreshed and published once, after the last command. Stops and all-or-none orders a command triggers are released right after it,
+ *        as apply() would, and their trades are counted with that command's.
+ *        Trades are still recorded in the trade log and are also copied, in execution order, into the caller's buffer.
+ *
+ * @param results must have room for num_commands results
+ * @param trades may be nullptr when trades_capacity is 0
+ * @return number of trades the batch produced, only the first trades_capacity of them are copied when it is larger
+ */
+std::size_t OrderBook::apply_batch(const OrderCommand* commands, std::size_t num_commands, OrderResult* results, Trade* trades, std::size_t trades_capacity) {
+    MutationScope scope(*this);
+    std::size_t num_trades = 0;
+
+    for (std::size_t i = 0; i < num_commands && i < BATCH_PREFETCH_DISTANCE; i++) {
+        prefetch_target(commands[i]);
+    }
+
+    for (std::size_t i = 0; i < num_commands; i++) {
+        if (i + BATCH_PREFETCH_DISTANCE < num_commands) {
+            prefetch_target(commands[i + BATCH_PREFETCH_DISTANCE]);
+        }
+
+        std::size_t num_trades_before = trade_log.get_trades().size();
+        results[i] = apply(commands[i]);
+        if (has_triggered_orders()) {
+            release_triggered_orders();
+        }
+        forget_traded_range();
+        std::size_t num_new_trades = trade_log.get_trades().size() - num_trades_before;
+
+        if (num_new_trades > 0 && num_trades < trades_capacity) {
+            auto iter_trade = std::prev(trade_log.get_trades().end(), num_new_trades);
+            for (std::size_t j = 0; j < num_new_trades && num_trades + j < trades_capacity; j++, ++iter_trade) {
+                trades[num_trades + j] = *iter_trade;
+            }
+        }
+        num_trades += num_new_trades;
+    }
+
+    return num_trades;
+}
+
+/**
+    Issues prefetches for the order a cancel or modify will touch. The hash lookup itself is done here, ahead of time;
+    the nodes behind it, which are the dependent misses, are only requested and not waited for.
+*/
+void OrderBook::prefetch_target(const OrderCommand& command) const {
+    if (command.type != OrderCommand::Type::CANCEL && command.type != OrderCommand::Type::MODIFY) {
+        return;
+    }
+
+    prefetch_order(command.orderId);
+}
+
+/**
+    Looks the id up ahead of time and requests the order node and its price level node, which a cancel touches right after the lookup.
+*/
+void OrderBook::prefetch_order(long long order_id) const {
+    auto iter_lookup = order_lookup.find(order_id);
+    if (iter_lookup != order_lookup.end()) {
+        PREFETCH(&*std::get<1>(iter_lookup->second));
+        PREFETCH(&*std::get<2>(iter_lookup->second));
     }
 }
 
@@ -191,7 +1155,7 @@ void OrderBook::modify_order(long long order_id, int new_quantity, long long tim
  * @brief Gets the best bid (highest buy price in the market along with the list of orders in that price)
  * @return returns an iterator pointing to the highest bid in the market as a <price, list<Order>> pair
  */
- std::map<long long, std::list<Order>>::reverse_iterator OrderBook::get_best_bid() {
+ std::map<long long, PriceLevel>::reverse_iterator OrderBook::get_best_bid() {
     auto bestBuy = buys.rbegin(); 
     return bestBuy;
 }
@@ -200,11 +1164,339 @@ void OrderBook::modify_order(long long order_id, int new_quantity, long long tim
  * @brief Gets the best ask (lowest sell price in the market along with the list of orders in that price)
  * @return returns an iterator pointing to the lowest ask in the market as a <price, list<Order>> pair
  */
- std::map<long long, std::list<Order>>::iterator OrderBook::get_best_ask() {
+ std::map<long long, PriceLevel>::iterator OrderBook::get_best_ask() {
     auto bestSell = sells.begin();
     return bestSell;
 }
 
+/**
+ * @brief Drops every resting order, all-or-none and pending stop included, used when a book is rebuilt from a checkpoint. The trade log is kept.
+ */
+void OrderBook::clear() {
+    MutationScope scope(*this);
+    for (const auto& level : buys) {
+        notify_l2(true, level.first, nullptr);
+    }
+    for (const auto& level : sells) {
+        notify_l2(false, level.first, nullptr);
+    }
+
+    buys.clear();
+    sells.clear();
+    order_lookup.clear();
+    buy_stops.clear();
+    sell_stops.clear();
+    stop_lookup.clear();
+    aon_buys.clear();
+    aon_sells.clear();
+    aon_lookup.clear();
+    last_trade_price = -1;
+    trade_high = LLONG_MIN;
+    trade_low = LLONG_MAX;
+    auction_open = false;
+
+    depth = DepthSnapshot();
+    mark_depth_bytes(&depth, sizeof(DepthSnapshot));
+}
+
+/**
+ * @brief Writes the resting orders level by level in price-time priority, the trigger books, the resting all-or-none orders, the trade
+ *        log and the last trade. Listeners and the published snapshots are not part of the state, they are rebuilt on load.
+ */
+void OrderBook::save_state(CheckpointWriter& writer) const {
+    std::size_t num_stops = stop_lookup.size(), num_aon = aon_lookup.size(), num_trades = trade_log.get_trades().size();
+    writer.reserve(writer.get_buffer().size() + order_lookup.size() * sizeof(Order) + (buys.size() + sells.size()) * 3 * sizeof(long long)
+                   + num_stops * sizeof(StopOrder) + num_aon * sizeof(Order) + num_trades * sizeof(Trade) + 256);
+
+    writer.write(matching_algorithm);
+    writer.write(self_trade_prevention);
+    writer.write(auction_open);
+    writer.write(last_trade_price);
+    writer.write(last_trade_timestamp);
+    writer.write(trade_high);
+    writer.write(trade_low);
+
+    writer.write<std::uint64_t>(order_lookup.size());
+    for (const std::map<long long, PriceLevel>* side : {&buys, &sells}) {
+        writer.write<std::uint64_t>(side->size());
+        for (const auto& [price_tick, level] : *side) {
+            writer.write(price_tick);
+            writer.write<std::uint64_t>(level.size());
+            for (const Order& order : level) {
+                writer.write(order);
+            }
+        }
+    }
+
+    for (const std::map<long long, std::list<StopOrder>>* stops : {&buy_stops, &sell_stops}) {
+        writer.write<std::uint64_t>(stops->size());
+        for (const auto& [trigger_tick, stops_at_trigger] : *stops) {
+            writer.write(trigger_tick);
+            writer.write<std::uint64_t>(stops_at_trigger.size());
+            for (const StopOrder& stop : stops_at_trigger) {
+                writer.write(stop);
+            }
+        }
+    }
+
+    for (const std::map<long long, std::list<Order>>* aon_side : {&aon_buys, &aon_sells}) {
+        writer.write<std::uint64_t>(aon_side->size());
+        for (const auto& [price_tick, orders] : *aon_side) {
+            writer.write(price_tick);
+            writer.write<std::uint64_t>(orders.size());
+            for (const Order& order : orders) {
+                writer.write(order);
+            }
+        }
+    }
+
+    writer.write<std::uint64_t>(num_trades);
+    for (const Trade& trade : trade_log.get_trades()) {
+        writer.write(trade);
+    }
+}
+
+/**
+ * @brief Replaces the book with a saved one, ids and timestamps as they were. The lookups are rebuilt from the levels, subscribers see
+ *        the old levels removed and the restored ones added, then the top of book and the depth snapshot are published once.
+ */
+void OrderBook::load_state(CheckpointReader& reader) {
+    MutationScope scope(*this);
+    clear();
+
+    if (reader.read<MatchingAlgorithm>() != matching_algorithm) {
+        throw std::runtime_error("Checkpoint was taken from a book with another matching algorithm!");
+    }
+    self_trade_prevention = reader.read<SelfTradePrevention>();
+    auction_open = reader.read<bool>();
+    last_trade_price = reader.read<long long>();
+    last_trade_timestamp = reader.read<long long>();
+    trade_high = reader.read<long long>();
+    trade_low = reader.read<long long>();
+
+    // Read into copies of one order, Order has no default constructor and a new one would draw an id
+    Order restored(false, 0, 0, 0);
+    order_lookup.reserve(reader.read<std::uint64_t>());
+    for (bool isBuy : {true, false}) {
+        std::map<long long, PriceLevel>& side = isBuy ? buys : sells;
+        std::uint64_t num_levels = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; i < num_levels; i++) {
+            long long price_tick = reader.read<long long>();
+            auto iter_level = side.emplace_hint(side.end(), price_tick, PriceLevel());
+            PriceLevel& level = iter_level->second;
+
+            std::uint64_t num_orders = reader.read<std::uint64_t>();
+            for (std::uint64_t j = 0; j < num_orders; j++) {
+                reader.read_into(restored);
+                auto iter = level.orders.insert(level.orders.end(), restored);
+                level.total_quantity += restored.quantity;
+                level.hidden_quantity += restored.hiddenQuantity;
+                order_lookup.emplace(restored.id, std::make_tuple(price_tick, iter, iter_level));
+            }
+            publish_level(isBuy, price_tick, &level);
+        }
+    }
+
+    StopOrder stop;
+    for (std::map<long long, std::list<StopOrder>>* stops : {&buy_stops, &sell_stops}) {
+        std::uint64_t num_triggers = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; i < num_triggers; i++) {
+            std::list<StopOrder>& stops_at_trigger = stops->emplace_hint(stops->end(), reader.read<long long>(), std::list<StopOrder>())->second;
+            std::uint64_t num_stops = reader.read<std::uint64_t>();
+            for (std::uint64_t j = 0; j < num_stops; j++) {
+                reader.read_into(stop);
+                stop_lookup[stop.id] = stops_at_trigger.insert(stops_at_trigger.end(), stop);
+            }
+        }
+    }
+
+    for (std::map<long long, std::list<Order>>* aon_side : {&aon_buys, &aon_sells}) {
+        std::uint64_t num_prices = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; i < num_prices; i++) {
+            std::list<Order>& orders = aon_side->emplace_hint(aon_side->end(), reader.read<long long>(), std::list<Order>())->second;
+            std::uint64_t num_orders = reader.read<std::uint64_t>();
+            for (std::uint64_t j = 0; j < num_orders; j++) {
+                reader.read_into(restored);
+                aon_lookup[restored.id] = orders.insert(orders.end(), restored);
+            }
+        }
+    }
+
+    std::list<Trade>& trades = trade_log.get_trades();
+    trades.clear();
+    std::uint64_t num_trades = reader.read<std::uint64_t>();
+    if (num_trades > 0) {
+        Trade trade;
+        for (std::uint64_t i = 0; i < num_trades; i++) {
+            reader.read_into(trade);
+            trades.push_back(trade);
+        }
+    }
+}
+
+/**
+ * @brief Copies the aggregated top of one side into levels, best price first. Each level costs one map step, the orders are not visited.
+ * @return number of levels written, less than max_levels when the side is shallower
+ */
+std::size_t OrderBook::get_depth(bool isBuy, L2Level* levels, std::size_t max_levels) const {
+    std::size_t num_levels = 0;
+
+    if (isBuy) {
+        for (auto iter = buys.rbegin(); iter != buys.rend() && num_levels < max_levels; ++iter, ++num_levels) {
+            levels[num_levels] = {iter->first, iter->second.total_quantity, (int)iter->second.size()};
+        }
+    }
+    else {
+        for (auto iter = sells.begin(); iter != sells.end() && num_levels < max_levels; ++iter, ++num_levels) {
+            levels[num_levels] = {iter->first, iter->second.total_quantity, (int)iter->second.size()};
+        }
+    }
+
+    return num_levels;
+}
+
+/**
+    Re-reads the touch from the level maps and notifies observers only when it actually moved (price or quantity at either side).
+*/
+void OrderBook::refresh_bbo() {
+    BestBidOffer current;
+    if (!buys.empty()) {
+        current.bidPriceTick = buys.rbegin()->first;
+        current.bidQuantity = buys.rbegin()->second.total_quantity;
+    }
+    if (!sells.empty()) {
+        current.askPriceTick = sells.begin()->first;
+        current.askQuantity = sells.begin()->second.total_quantity;
+    }
+
+    if (current == bbo) {
+        return;
+    }
+
+    bbo = current;
+    bbo_snapshot.store(bbo);
+    for (const BboListener& listener : bbo_listeners) {
+        listener(bbo);
+    }
+}
+
+/**
+    Keeps the top levels in step with one level change. Changes behind the published levels cost one short scan,
+    a quantity change in place rewrites one entry; only a removed top level that leaves room for the next one goes back to the map.
+*/
+void OrderBook::update_depth(bool isBuy, long long priceTick, const PriceLevel* level) {
+    L2Level* levels = isBuy ? depth.bids : depth.asks;
+    int& num_levels = isBuy ? depth.numBids : depth.numAsks;
+
+    int index = 0;
+    while (index < num_levels && (isBuy ? levels[index].priceTick > priceTick : levels[index].priceTick < priceTick)) {
+        index++;
+    }
+    bool is_published = index < num_levels && levels[index].priceTick == priceTick;
+
+    if (level != nullptr) {
+        if (is_published) {
+            levels[index].quantity = level->total_quantity;
+            levels[index].numOrders = (int)level->size();
+            mark_depth_bytes(&levels[index], sizeof(L2Level));
+            return;
+        }
+        if (index == DepthSnapshot::MAX_LEVELS) {
+            return; // New level behind the published ones
+        }
+
+        // New level inside the published range, the worse ones move down and the last falls off when full
+        int last = std::min(num_levels, DepthSnapshot::MAX_LEVELS - 1);
+        for (int i = last; i > index; i--) {
+            levels[i] = levels[i - 1];
+        }
+        levels[index] = {priceTick, level->total_quantity, (int)level->size()};
+        num_levels = last + 1;
+
+        mark_depth_bytes(&levels[index], (last + 1 - index) * sizeof(L2Level));
+        mark_depth_bytes(&num_levels, sizeof(int));
+        return;
+    }
+
+    if (!is_published) {
+        return; // Removed level was behind the published ones
+    }
+
+    int old_num_levels = num_levels;
+    for (int i = index; i < num_levels - 1; i++) {
+        levels[i] = levels[i + 1];
+    }
+    num_levels--;
+    levels[num_levels] = L2Level();
+
+    // The side was cut at MAX_LEVELS, pull the next level up into the freed slot
+    auto& side = isBuy ? buys : sells;
+    if (old_num_levels == DepthSnapshot::MAX_LEVELS && side.size() > (std::size_t)num_levels) {
+        const PriceLevel* next_level = nullptr;
+        long long next_price = 0;
+
+        if (num_levels == 0) {
+            next_price = isBuy ? buys.rbegin()->first : sells.begin()->first;
+            next_level = isBuy ? &buys.rbegin()->second : &sells.begin()->second;
+        }
+        else if (isBuy) {
+            auto iter = std::prev(buys.lower_bound(levels[num_levels - 1].priceTick));
+            next_price = iter->first;
+            next_level = &iter->second;
+        }
+        else {
+            auto iter = sells.upper_bound(levels[num_levels - 1].priceTick);
+            next_price = iter->first;
+            next_level = &iter->second;
+        }
+
+        levels[num_levels] = {next_price, next_level->total_quantity, (int)next_level->size()};
+        num_levels++;
+    }
+
+    mark_depth_bytes(&levels[index], (old_num_levels - index) * sizeof(L2Level));
+    mark_depth_bytes(&num_levels, sizeof(int));
+}
+
+void OrderBook::mark_depth_bytes(const void* address, std::size_t num_bytes) {
+    std::size_t offset = (std::size_t)(reinterpret_cast<const char*>(address) - reinterpret_cast<const char*>(&depth));
+    depth_dirty_begin = std::min(depth_dirty_begin, offset);
+    depth_dirty_end = std::max(depth_dirty_end, offset + num_bytes);
+}
+
+/**
+    Publishes the top levels through the seqlock once per outermost mutation, rewriting only the bytes that changed.
+*/
+void OrderBook::publish_depth_snapshot() {
+    if (depth_dirty_begin >= depth_dirty_end) {
+        return;
+    }
+
+    depth_snapshot.store_range(depth, depth_dirty_begin, depth_dirty_end - depth_dirty_begin);
+    depth_dirty_begin = sizeof(DepthSnapshot);
+    depth_dirty_end = 0;
+}
+
+/**
+    Sends the new aggregate state of a level to the L2 subscribers, level is nullptr when it was removed.
+    Listeners run inside the book operation and must not call back into the book.
+*/
+void OrderBook::publish_level(bool isBuy, long long priceTick, const PriceLevel* level) {
+    update_depth(isBuy, priceTick, level);
+    notify_l2(isBuy, priceTick, level);
+}
+
+void OrderBook::notify_l2(bool isBuy, long long priceTick, const PriceLevel* level) {
+    if (l2_listeners.empty()) {
+        return;
+    }
+
+    L2Delta delta = {isBuy, priceTick, level == nullptr ? 0 : level->total_quantity, level == nullptr ? 0 : (int)level->size()};
+    for (const L2Listener& listener : l2_listeners) {
+        listener(delta);
+    }
+}
+
 void OrderBook::snapshot() {
     std::cout << "**************************" << std::endl;
 
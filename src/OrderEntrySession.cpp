@@ -0,0 +1,67 @@
+#include "../include/OrderEntrySession.h"
+
+OrderEntrySession::OrderEntrySession(OrderBook& orderbook) : orderbook(orderbook), client_to_book_ids(), book_to_client_ids() {}
+
+/**
+ * @brief Applies a command addressed by client ids. Orders that end up resting (or parked as stops) are remembered under the client's id so later cancels and modifies can find them.
+ * @return the book's result, clientOrderId is the client id and orderId the book id the command resolved to
+ */
+OrderResult OrderEntrySession::apply(const OrderCommand& command) {
+    OrderCommand book_command = command;
+    bool targets_existing_order = command.type == OrderCommand::Type::CANCEL || command.type == OrderCommand::Type::MODIFY;
+
+    if (targets_existing_order) {
+        book_command.orderId = find_book_id(command.orderId);
+        if (book_command.orderId == -1) {
+            OrderResult rejected;
+            rejected.clientOrderId = command.orderId;
+            return rejected;
+        }
+
+        client_to_book_ids.erase(command.orderId);
+        book_to_client_ids.erase(book_command.orderId);
+    }
+
+    OrderResult result = orderbook.apply(book_command);
+    result.clientOrderId = command.orderId;
+
+    if (result.status == OrderResult::Status::RESTING || result.status == OrderResult::Status::PENDING) {
+        map_ids(command.orderId, result.orderId);
+    }
+
+    return result;
+}
+
+void OrderEntrySession::map_ids(long long client_id, long long book_id) {
+    client_to_book_ids[client_id] = book_id;
+    book_to_client_ids[book_id] = client_id;
+}
+
+/**
+ * @return the book id of a client order that is still resting or waiting as a stop, -1 otherwise. Mappings of orders that were filled in the meantime are dropped here.
+ */
+long long OrderEntrySession::find_book_id(long long client_id) {
+    auto iter = client_to_book_ids.find(client_id);
+    if (iter == client_to_book_ids.end()) {
+        return -1;
+    }
+
+    long long book_id = iter->second;
+    if (!is_resting(book_id)) {
+        client_to_book_ids.erase(iter);
+        book_to_client_ids.erase(book_id);
+        return -1;
+    }
+
+    return book_id;
+}
+
+long long OrderEntrySession::find_client_id(long long book_id) const {
+    auto iter = book_to_client_ids.find(book_id);
+    return iter == book_to_client_ids.end() ? -1 : iter->second;
+}
+
+void OrderEntrySession::clear() {
+    client_to_book_ids.clear();
+    book_to_client_ids.clear();
+}
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "../include/OrderIngress.h"
+#include <algorithm>
+
+OrderIngress::OrderIngress() : command_ring(), result_ring(), batch(), batch_results() {}
+
+/**
+ * @brief Dequeues up to max_batch commands in one go, applies them in order and publishes one result per command.
+ *        Never takes more commands than there is room for results, so the matching thread never blocks on a slow producer.
+ * @return number of commands applied
+ */
+std::size_t OrderIngress::process(OrderBook& orderbook, std::size_t max_batch) {
+    std::size_t batch_size = std::min({max_batch, MAX_BATCH, result_ring.free_slots()});
+    std::size_t num_commands = command_ring.pop_batch(batch, batch_size);
+
+    orderbook.apply_batch(batch, num_commands, batch_results, nullptr, 0);
+
+    for (std::size_t i = 0; i < num_commands; i++) {
+        result_ring.try_push(batch_results[i]);
+    }
+
+    return num_commands;
+}
\ No newline at end of file
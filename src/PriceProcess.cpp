@@ -0,0 +1,333 @@
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/PriceProcess.h"
+
+namespace {
+    // Ziggurat of 128 layers for the standard normal (Marsaglia and Tsang, with Doornik's layout): the x edges of the layers,
+    // layer 0 being the base strip with the tail, and the ratio of each layer's width to the next one's
+    const int ZIGGURAT_LAYERS = 128;
+    const double ZIGGURAT_R = 3.442619855899;        // start of the tail
+    const double ZIGGURAT_AREA = 9.91256303526217e-3; // of each layer
+
+    struct ZigguratTables {
+        double edges[ZIGGURAT_LAYERS + 1];
+        double ratios[ZIGGURAT_LAYERS];
+
+        ZigguratTables() {
+            double density = std::exp(-0.5 * ZIGGURAT_R * ZIGGURAT_R);
+            edges[0] = ZIGGURAT_AREA / density;
+            edges[1] = ZIGGURAT_R;
+            for (int i = 2; i < ZIGGURAT_LAYERS; i++) {
+                edges[i] = std::sqrt(-2 * std::log(ZIGGURAT_AREA / edges[i - 1] + density));
+                density = std::exp(-0.5 * edges[i] * edges[i]);
+            }
+            edges[ZIGGURAT_LAYERS] = 0;
+            for (int i = 0; i < ZIGGURAT_LAYERS; i++) {
+                ratios[i] = edges[i + 1] / edges[i];
+            }
+        }
+    };
+
+    const ZigguratTables ZIGGURAT;
+
+    double to_uniform(std::uint64_t bits) {
+        return (double)(bits >> 11) * 0x1.0p-53; // [0, 1)
+    }
+}
+
+PriceProcess::PriceProcess(unsigned long long seed) : rand_engine(seed), fallback_engine(seed ^ 0x9E3779B97F4A7C15ULL), draws(), normals() {}
+
+/**
+    Fills normals[0, num_normals) with standard normals. All the raw draws of the block come first, then one pass turns each draw into a
+    normal with the ziggurat: the low 7 bits pick a layer and the top 53 a signed position in it, which falls inside the layer's rectangle,
+    and is the normal, about 99% of the time. The rest go to sample_outside_rectangle, whose extra draws come from fallback_engine in
+    step order, so the stream does not depend on the block sizes.
+*/
+void PriceProcess::draw_normals(std::size_t num_normals) {
+    draws.resize(num_normals);
+    normals.resize(num_normals);
+
+    for (std::size_t i = 0; i < num_normals; i++) {
+        draws[i] = rand_engine();
+    }
+
+    for (std::size_t i = 0; i < num_normals; i++) {
+        int layer = (int)(draws[i] & (ZIGGURAT_LAYERS - 1));
+        double position = 2 * to_uniform(draws[i]) - 1;
+        if (std::abs(position) < ZIGGURAT.ratios[layer]) {
+            normals[i] = position * ZIGGURAT.edges[layer];
+        }
+        else {
+            normals[i] = sample_outside_rectangle(layer, position);
+        }
+    }
+}
+
+/**
+    A ziggurat draw that missed its layer's rectangle: from the base layer it is a tail draw beyond ZIGGURAT_R, otherwise it is kept if it
+    falls under the density in the wedge between the two edges. Misses start over from a new layer, all with fallback_engine.
+*/
+double PriceProcess::sample_outside_rectangle(int layer, double position) {
+    while (true) {
+        if (layer == 0) {
+            double x, y;
+            do {
+                x = -std::log1p(-to_uniform(fallback_engine())) / ZIGGURAT_R;
+                y = -std::log1p(-to_uniform(fallback_engine()));
+            } while (y + y < x * x);
+            return position > 0 ? ZIGGURAT_R + x : -ZIGGURAT_R - x;
+        }
+
+        double x = position * ZIGGURAT.edges[layer];
+        double density_outer = std::exp(-0.5 * (ZIGGURAT.edges[layer] * ZIGGURAT.edges[layer] - x * x));
+        double density_inner = std::exp(-0.5 * (ZIGGURAT.edges[layer + 1] * ZIGGURAT.edges[layer + 1] - x * x));
+        if (density_inner + to_uniform(fallback_engine()) * (density_outer - density_inner) < 1) {
+            return x;
+        }
+
+        std::uint64_t bits = fallback_engine();
+        layer = (int)(bits & (ZIGGURAT_LAYERS - 1));
+        position = 2 * to_uniform(bits) - 1;
+        if (std::abs(position) < ZIGGURAT.ratios[layer]) {
+            return position * ZIGGURAT.edges[layer];
+        }
+    }
+}
+
+void PriceProcess::save_state(CheckpointWriter& writer) const {
+    writer.write(get_kind());
+    writer.write_streamed(rand_engine);
+    writer.write_streamed(fallback_engine);
+    save_path(writer);
+}
+
+/**
+ * @brief Builds a process of the saved kind with placeholder parameters, then overwrites all of its state with the saved one.
+ */
+std::unique_ptr<PriceProcess> PriceProcess::load_state(CheckpointReader& reader) {
+    std::unique_ptr<PriceProcess> process;
+    switch (reader.read<Kind>()) {
+        case Kind::GBM:
+            process = std::make_unique<GbmProcess>(1, 0, 0);
+            break;
+        case Kind::ORNSTEIN_UHLENBECK:
+            process = std::make_unique<OrnsteinUhlenbeckProcess>(1, 1, 1, 0);
+            break;
+        case Kind::GARCH:
+            process = std::make_unique<GarchProcess>(1, 1, 0, 0);
+            break;
+        case Kind::JUMP_DIFFUSION:
+            process = std::make_unique<JumpDiffusionProcess>(1, 0, 0, 0, 0, 0);
+            break;
+        default:
+            throw std::runtime_error("Checkpoint holds an unknown kind of price process!");
+    }
+
+    reader.read_streamed(process->rand_engine);
+    reader.read_streamed(process->fallback_engine);
+    process->load_path(reader);
+    return process;
+}
+
+GbmProcess::GbmProcess(double start_price_ticks, double drift_per_step, double volatility_per_step, unsigned long long seed) : PriceProcess(seed),
+                                                                                                                              log_price(0), log_drift(drift_per_step - 0.5 * volatility_per_step * volatility_per_step), volatility(volatility_per_step) {
+    if (start_price_ticks <= 0 || volatility_per_step < 0) {
+        throw std::runtime_error("GBM needs a positive start price and a non negative volatility!");
+    }
+    log_price = std::log(start_price_ticks);
+}
+
+/**
+ * @brief Log increments of the block, then their running sum, then one exp per step. Only the running sum is sequential.
+ */
+void GbmProcess::generate(double* prices, double* volatilities, std::size_t num_steps) {
+    draw_normals(num_steps);
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        log_price += log_drift + volatility * normals[i];
+        prices[i] = log_price;
+    }
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        prices[i] = std::exp(prices[i]);
+        volatilities[i] = volatility * prices[i];
+    }
+}
+
+void GbmProcess::save_path(CheckpointWriter& writer) const {
+    writer.write(log_price);
+    writer.write(log_drift);
+    writer.write(volatility);
+}
+
+void GbmProcess::load_path(CheckpointReader& reader) {
+    log_price = reader.read<double>();
+    log_drift = reader.read<double>();
+    volatility = reader.read<double>();
+}
+
+OrnsteinUhlenbeckProcess::OrnsteinUhlenbeckProcess(double start_price_ticks, double mean_price_ticks, double reversion_per_step, double volatility_ticks_per_step, unsigned long long seed) : PriceProcess(seed),
+                                                                                                                                                                                                 price(start_price_ticks), mean_price(mean_price_ticks), persistence(std::exp(-reversion_per_step)), step_stddev(0) {
+    if (reversion_per_step <= 0 || volatility_ticks_per_step < 0) {
+        throw std::runtime_error("Ornstein-Uhlenbeck needs a positive reversion speed and a non negative volatility!");
+    }
+    // Exact transition: the variance accumulated over one step is volatility^2 * (1 - exp(-2 reversion)) / (2 reversion)
+    step_stddev = volatility_ticks_per_step * std::sqrt(-std::expm1(-2 * reversion_per_step) / (2 * reversion_per_step));
+}
+
+void OrnsteinUhlenbeckProcess::generate(double* prices, double* volatilities, std::size_t num_steps) {
+    draw_normals(num_steps);
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        price = mean_price + persistence * (price - mean_price) + step_stddev * normals[i];
+        prices[i] = price;
+        volatilities[i] = step_stddev;
+    }
+}
+
+void OrnsteinUhlenbeckProcess::save_path(CheckpointWriter& writer) const {
+    writer.write(price);
+    writer.write(mean_price);
+    writer.write(persistence);
+    writer.write(step_stddev);
+}
+
+void OrnsteinUhlenbeckProcess::load_path(CheckpointReader& reader) {
+    price = reader.read<double>();
+    mean_price = reader.read<double>();
+    persistence = reader.read<double>();
+    step_stddev = reader.read<double>();
+}
+
+GarchProcess::GarchProcess(double start_price_ticks, double omega, double alpha, double beta, unsigned long long seed) : PriceProcess(seed),
+                                                                                                                        log_price(0), variance(0), omega(omega), alpha(alpha), beta(beta) {
+    if (start_price_ticks <= 0 || omega <= 0 || alpha < 0 || beta < 0 || alpha + beta >= 1) {
+        throw std::runtime_error("GARCH(1,1) needs a positive start price and omega, non negative alpha and beta, and alpha + beta below 1!");
+    }
+    log_price = std::log(start_price_ticks);
+    variance = get_long_run_variance();
+}
+
+/**
+ * @brief Only the variance recursion is sequential, and it needs no square root: return^2 = variance * Z^2. The variances of the block
+ *        are kept in volatilities, the log prices in prices, until the last pass turns both into ticks.
+ */
+void GarchProcess::generate(double* prices, double* volatilities, std::size_t num_steps) {
+    draw_normals(num_steps);
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        volatilities[i] = variance;
+        variance = omega + (alpha * normals[i] * normals[i] + beta) * variance;
+    }
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        volatilities[i] = std::sqrt(volatilities[i]);
+        log_price += volatilities[i] * normals[i];
+        prices[i] = log_price;
+    }
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        prices[i] = std::exp(prices[i]);
+        volatilities[i] *= prices[i];
+    }
+}
+
+void GarchProcess::save_path(CheckpointWriter& writer) const {
+    writer.write(log_price);
+    writer.write(variance);
+    writer.write(omega);
+    writer.write(alpha);
+    writer.write(beta);
+}
+
+void GarchProcess::load_path(CheckpointReader& reader) {
+    log_price = reader.read<double>();
+    variance = reader.read<double>();
+    omega = reader.read<double>();
+    alpha = reader.read<double>();
+    beta = reader.read<double>();
+}
+
+JumpDiffusionProcess::JumpDiffusionProcess(double start_price_ticks, double drift_per_step, double volatility_per_step, double jump_probability_per_step, double jump_mean, double jump_stddev,
+                                           unsigned long long seed) : PriceProcess(seed), log_price(0), log_drift(0), volatility(volatility_per_step), total_volatility(0),
+                                                                      log_no_jump(std::log1p(-jump_probability_per_step)), jump_engine(seed + 1), jump_size(jump_mean, jump_stddev), steps_to_jump(0) {
+    if (start_price_ticks <= 0 || volatility_per_step < 0 || jump_probability_per_step < 0 || jump_probability_per_step > 1 || jump_stddev < 0) {
+        throw std::runtime_error("Jump-diffusion needs a positive start price, non negative volatilities and a jump probability within [0, 1]!");
+    }
+    log_price = std::log(start_price_ticks);
+
+    // Compensated so that jumps do not move the expected price: a jump multiplies it by exp(jump_mean + jump_stddev^2 / 2) on average
+    double mean_jump_factor = std::exp(jump_mean + 0.5 * jump_stddev * jump_stddev) - 1;
+    log_drift = drift_per_step - 0.5 * volatility_per_step * volatility_per_step - jump_probability_per_step * mean_jump_factor;
+
+    double jump_variance = jump_probability_per_step * (jump_stddev * jump_stddev + jump_mean * jump_mean) - std::pow(jump_probability_per_step * jump_mean, 2);
+    total_volatility = std::sqrt(volatility_per_step * volatility_per_step + jump_variance);
+
+    steps_to_jump = draw_jump_gap();
+}
+
+/**
+ * @brief Steps until the next jump, that one included: geometric with success probability jump_probability, by inversion.
+ */
+std::size_t JumpDiffusionProcess::draw_jump_gap() {
+    const std::size_t never = std::numeric_limits<std::size_t>::max() / 2;
+    if (log_no_jump == 0) {
+        return never;
+    }
+
+    double uniform = (double)((jump_engine() >> 11) + 1) * 0x1.0p-53; // (0, 1]
+    double gap = std::floor(std::log(uniform) / log_no_jump);
+    return gap >= (double)never ? never : (std::size_t)gap + 1;
+}
+
+/**
+ * @brief The diffusion is a GBM block, the few jumps of the block are then added to their steps' increments before the running sum.
+ */
+void JumpDiffusionProcess::generate(double* prices, double* volatilities, std::size_t num_steps) {
+    draw_normals(num_steps);
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        normals[i] = log_drift + volatility * normals[i];
+    }
+
+    std::size_t jump_step = steps_to_jump - 1;
+    while (jump_step < num_steps) {
+        normals[jump_step] += jump_size(jump_engine);
+        jump_step += draw_jump_gap();
+    }
+    steps_to_jump = jump_step - num_steps + 1;
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        log_price += normals[i];
+        prices[i] = log_price;
+    }
+
+    for (std::size_t i = 0; i < num_steps; i++) {
+        prices[i] = std::exp(prices[i]);
+        volatilities[i] = total_volatility * prices[i];
+    }
+}
+
+void JumpDiffusionProcess::save_path(CheckpointWriter& writer) const {
+    writer.write(log_price);
+    writer.write(log_drift);
+    writer.write(volatility);
+    writer.write(total_volatility);
+    writer.write(log_no_jump);
+    writer.write_streamed(jump_engine);
+    writer.write_streamed(jump_size);
+    writer.write(steps_to_jump);
+}
+
+void JumpDiffusionProcess::load_path(CheckpointReader& reader) {
+    log_price = reader.read<double>();
+    log_drift = reader.read<double>();
+    volatility = reader.read<double>();
+    total_volatility = reader.read<double>();
+    log_no_jump = reader.read<double>();
+    reader.read_streamed(jump_engine);
+    reader.read_streamed(jump_size);
+    steps_to_jump = reader.read<std::size_t>();
+}
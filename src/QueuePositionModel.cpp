@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "../include/QueuePositionModel.h"
+
+QueuePositionModel::QueuePositionModel(FillListener fill_listener) : buy_levels(), sell_levels(), order_locations(), fill_listener(std::move(fill_listener)), fills() {}
+
+/**
+ * @brief Starts tracking an order of ours that joined the back of its level, behind volume_ahead of resting quantity.
+ */
+void QueuePositionModel::track(long long order_id, bool isBuy, long long priceTick, int quantity, long long volume_ahead) {
+    if (quantity <= 0 || order_locations.count(order_id)) {
+        return;
+    }
+
+    order_locations[order_id] = {isBuy, priceTick};
+    (isBuy ? buy_levels : sell_levels)[priceTick].push_back({order_id, priceTick, std::max(0LL, volume_ahead), quantity, isBuy});
+}
+
+/**
+ * @brief Stops tracking an order (cancelled, or filled elsewhere). The tracked orders behind it at its price move up by what it had left.
+ * @return whether the order was tracked
+ */
+bool QueuePositionModel::untrack(long long order_id) {
+    auto iter_location = order_locations.find(order_id);
+    if (iter_location == order_locations.end()) {
+        return false;
+    }
+
+    auto& levels = iter_location->second.isBuy ? buy_levels : sell_levels;
+    auto iter_level = levels.find(iter_location->second.priceTick);
+    order_locations.erase(iter_location);
+
+    std::vector<TrackedOrder>& level = iter_level->second;
+    auto position = std::find_if(level.begin(), level.end(), [order_id](const TrackedOrder& order) { return order.id == order_id; });
+    for (auto iter = std::next(position); iter != level.end(); ++iter) {
+        iter->volumeAhead = std::max(0LL, iter->volumeAhead - position->quantity);
+    }
+    level.erase(position);
+    if (level.empty()) {
+        levels.erase(iter_level);
+    }
+
+    return true;
+}
+
+/**
+ * @brief A trade of quantity took resting liquidity of side isBuy at priceTick. Tracked orders at a better price were traded through and fill
+ *        completely, the ones at priceTick fill with whatever is left of the trade once the volume ahead of them is used up.
+ */
+void QueuePositionModel::on_trade(bool isBuy, long long priceTick, int quantity) {
+    auto& levels = isBuy ? buy_levels : sell_levels;
+
+    // Better priced levels: bids above a traded bid, asks below a traded ask
+    auto through_begin = isBuy ? levels.upper_bound(priceTick) : levels.begin();
+    auto through_end = isBuy ? levels.end() : levels.lower_bound(priceTick);
+    for (auto iter = through_begin; iter != through_end; ++iter) {
+        for (const TrackedOrder& order : iter->second) {
+            fills.push_back({order.id, order.priceTick, order.quantity, isBuy});
+            order_locations.erase(order.id);
+        }
+    }
+    levels.erase(through_begin, through_end);
+
+    auto iter_level = levels.find(priceTick);
+    if (iter_level != levels.end()) {
+        fill_level(iter_level->second, quantity, priceTick);
+        if (iter_level->second.empty()) {
+            levels.erase(iter_level);
+        }
+    }
+
+    notify_fills();
+}
+
+/**
+    One trade against the queue of a level: each tracked order's volume ahead shrinks by the traded quantity, the part of the trade
+    that reaches past it fills the order. Fully filled orders leave the level.
+*/
+void QueuePositionModel::fill_level(std::vector<TrackedOrder>& level, long long traded_quantity, long long priceTick) {
+    std::size_t kept = 0;
+    for (TrackedOrder& order : level) {
+        long long reaching = traded_quantity - order.volumeAhead;
+        order.volumeAhead = std::max(0LL, order.volumeAhead - traded_quantity);
+
+        if (reaching > 0) {
+            int filled = (int)std::min<long long>(reaching, order.quantity);
+            order.quantity -= filled;
+            fills.push_back({order.id, priceTick, filled, order.isBuy});
+        }
+        if (order.quantity == 0) {
+            order_locations.erase(order.id);
+        }
+        else {
+            level[kept++] = order;
+        }
+    }
+    level.resize(kept);
+}
+
+/**
+ * @brief quantity was cancelled at priceTick out of level_quantity resting there before the cancel. Where in the queue it sat is unknown,
+ *        so every tracked order loses the share of it that was ahead of it: quantity * volume ahead / level_quantity.
+ */
+void QueuePositionModel::on_cancel(bool isBuy, long long priceTick, int quantity, long long level_quantity) {
+    auto& levels = isBuy ? buy_levels : sell_levels;
+    auto iter_level = levels.find(priceTick);
+    if (iter_level == levels.end() || level_quantity <= 0) {
+        return;
+    }
+
+    long long cancelled = std::min<long long>(quantity, level_quantity);
+    for (TrackedOrder& order : iter_level->second) {
+        order.volumeAhead -= cancelled * order.volumeAhead / level_quantity;
+    }
+}
+
+void QueuePositionModel::notify_fills() {
+    for (const Fill& fill : fills) {
+        fill_listener(fill.orderId, fill.isBuy, fill.priceTick, fill.quantity);
+    }
+    fills.clear();
+}
+
+void QueuePositionModel::clear() {
+    buy_levels.clear();
+    sell_levels.clear();
+    order_locations.clear();
+}
+
+/**
+ * @brief Writes the tracked orders level by level, their locations are rebuilt from them on load. The fill listener stays the model's own.
+ */
+void QueuePositionModel::save_state(CheckpointWriter& writer) const {
+    for (const std::map<long long, std::vector<TrackedOrder>>* levels : {&buy_levels, &sell_levels}) {
+        writer.write<std::uint64_t>(levels->size());
+        for (const auto& [price_tick, level] : *levels) {
+            writer.write(price_tick);
+            writer.write_vector(level);
+        }
+    }
+}
+
+void QueuePositionModel::load_state(CheckpointReader& reader) {
+    clear();
+    for (bool isBuy : {true, false}) {
+        std::map<long long, std::vector<TrackedOrder>>& levels = isBuy ? buy_levels : sell_levels;
+        std::uint64_t num_levels = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; i < num_levels; i++) {
+            long long price_tick = reader.read<long long>();
+            std::vector<TrackedOrder>& level = levels[price_tick];
+            reader.read_vector(level);
+            for (const TrackedOrder& order : level) {
+                order_locations[order.id] = {isBuy, price_tick};
+            }
+        }
+    }
+}
+
+/**
+ * @brief The tracked order with order_id, nullptr once it is filled or untracked. The pointer is good until the next change to the model.
+ */
+const QueuePositionModel::TrackedOrder* QueuePositionModel::find(long long order_id) const {
+    auto iter_location = order_locations.find(order_id);
+    if (iter_location == order_locations.end()) {
+        return nullptr;
+    }
+
+    const auto& level = (iter_location->second.isBuy ? buy_levels : sell_levels).at(iter_location->second.priceTick);
+    auto position = std::find_if(level.begin(), level.end(), [order_id](const TrackedOrder& order) { return order.id == order_id; });
+    return &*position;
+}
@@ -0,0 +1,209 @@
+#include "../include/ReplayEngine.h"
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+ReplayEngine::ReplayEngine(const ReplayLog& replay_log, long long sample_interval_us) : replay_log(replay_log), metrics(), orderbook(metrics), session(orderbook),
+                                next_event_index(0), current_timestamp_us(replay_log.get_first_timestamp_us()), sample_interval_us(sample_interval_us), last_sample_us(replay_log.get_first_timestamp_us()) {
+    metrics.set_config(Order::tick_size, 0, 0, Metrics::MarkingMethod::MID, sample_interval_us);
+    orderbook.set_self_trade_prevention(replay_log.get_self_trade_prevention());
+}
+
+/**
+    Moves the replay clock to timestamp_us. Jumps through the nearest checkpoint when that skips events (or when seeking backwards),
+    otherwise simply replays forward from the current position.
+*/
+void ReplayEngine::seek(long long timestamp_us) {
+    const ReplayLog::Checkpoint* checkpoint = replay_log.find_checkpoint(timestamp_us);
+
+    if (timestamp_us < current_timestamp_us || (checkpoint != nullptr && checkpoint->event_index > next_event_index)) {
+        if (checkpoint != nullptr) {
+            load_checkpoint(*checkpoint);
+        }
+        else {
+            orderbook.clear();
+            session.clear();
+            next_event_index = 0;
+            current_timestamp_us = replay_log.get_first_timestamp_us();
+        }
+    }
+
+    // Warming up to the seek target is not part of the measured run, so nothing is sampled into metrics
+    advance_until(timestamp_us, false);
+    last_sample_us = timestamp_us;
+}
+
+/**
+    Applies every event with a timestamp strictly before timestamp_us, sampling the market state into metrics every sample_interval_us.
+*/
+void ReplayEngine::run_until(long long timestamp_us) {
+    advance_until(timestamp_us, true);
+}
+
+void ReplayEngine::advance_until(long long timestamp_us, bool sample_metrics) {
+    const std::vector<OrderCommand>& events = replay_log.get_events();
+
+    while (next_event_index < events.size() && events[next_event_index].timestampUs < timestamp_us) {
+        const OrderCommand& command = events[next_event_index];
+        apply(command);
+        next_event_index++;
+
+        if (sample_metrics && command.timestampUs - last_sample_us >= sample_interval_us) {
+            sample_market_state(command.timestampUs);
+        }
+    }
+
+    if (timestamp_us > current_timestamp_us) {
+        current_timestamp_us = timestamp_us;
+    }
+}
+
+void ReplayEngine::apply(const OrderCommand& command) {
+    session.apply(command);
+    current_timestamp_us = command.timestampUs;
+}
+
+/**
+    Rebuilds the book from a checkpoint. The book is uncrossed at a checkpoint, so the orders are put back level by level without matching,
+    which preserves time priority inside each level and the exact slice and reserve of icebergs.
+    All-or-none orders and pending stops are parked again in their priority order, none of them can execute against the restored book.
+*/
+void ReplayEngine::load_checkpoint(const ReplayLog::Checkpoint& checkpoint) {
+    orderbook.clear();
+    session.clear();
+
+    for (const ReplayLog::RestingOrder& order : checkpoint.orders) {
+        long long live_id = orderbook.restore_resting_order(order.isBuy, order.priceTick, order.quantity, order.hiddenQuantity, order.displayQuantity, order.tsCreatedUs, order.ownerId);
+        session.map_ids(order.orderId, live_id);
+    }
+
+    for (const ReplayLog::RestingOrder& order : checkpoint.aon_orders) {
+        long long live_id = orderbook.add_AON_order(order.isBuy, order.priceTick, order.quantity, order.tsCreatedUs);
+        session.map_ids(order.orderId, live_id);
+    }
+
+    orderbook.restore_last_trade_price(checkpoint.last_trade_price);
+    for (const ReplayLog::PendingStop& stop : checkpoint.stops) {
+        long long live_id = orderbook.add_stop_order(stop.isBuy, stop.triggerTick, stop.limitTick, stop.quantity, stop.tsCreatedUs, stop.ownerId);
+        session.map_ids(stop.orderId, live_id);
+    }
+
+    next_event_index = checkpoint.event_index;
+    current_timestamp_us = checkpoint.timestamp_us;
+}
+
+ReplayLog::Checkpoint ReplayEngine::capture_checkpoint(long long timestamp_us, std::size_t event_index) {
+    ReplayLog::Checkpoint checkpoint;
+    checkpoint.timestamp_us = timestamp_us;
+    checkpoint.event_index = event_index;
+    checkpoint.orders.reserve(orderbook.get_order_lookup().size());
+
+    auto capture_level = [this](const auto& orders_at_price, std::vector<ReplayLog::RestingOrder>& captured) {
+        for (const Order& order : orders_at_price) {
+            long long recorded_id = session.find_client_id(order.id);
+            if (recorded_id == -1) {
+                throw std::runtime_error("Resting order has no recorded id, the replay id mapping is out of sync.");
+            }
+            captured.push_back({recorded_id, order.priceTick, order.tsCreatedUs, order.ownerId, order.quantity, order.hiddenQuantity, order.displayQuantity, order.isBuy});
+        }
+    };
+
+    for (auto iter = orderbook.get_buys().rbegin(); iter != orderbook.get_buys().rend(); ++iter) {
+        capture_level(iter->second, checkpoint.orders);
+    }
+    for (auto iter = orderbook.get_sells().begin(); iter != orderbook.get_sells().end(); ++iter) {
+        capture_level(iter->second, checkpoint.orders);
+    }
+
+    for (auto iter = orderbook.get_aon_buys().rbegin(); iter != orderbook.get_aon_buys().rend(); ++iter) {
+        capture_level(iter->second, checkpoint.aon_orders);
+    }
+    for (auto iter = orderbook.get_aon_sells().begin(); iter != orderbook.get_aon_sells().end(); ++iter) {
+        capture_level(iter->second, checkpoint.aon_orders);
+    }
+
+    checkpoint.last_trade_price = orderbook.get_last_trade_price();
+    auto capture_stops = [this, &checkpoint](const std::list<StopOrder>& stops_at_trigger) {
+        for (const StopOrder& stop : stops_at_trigger) {
+            long long recorded_id = session.find_client_id(stop.id);
+            if (recorded_id == -1) {
+                throw std::runtime_error("Pending stop has no recorded id, the replay id mapping is out of sync.");
+            }
+            checkpoint.stops.push_back({recorded_id, stop.triggerTick, stop.limitTick, stop.tsCreatedUs, stop.ownerId, stop.quantity, stop.isBuy});
+        }
+    };
+
+    for (const auto& trigger : orderbook.get_buy_stops()) {
+        capture_stops(trigger.second);
+    }
+    for (auto iter = orderbook.get_sell_stops().rbegin(); iter != orderbook.get_sell_stops().rend(); ++iter) {
+        capture_stops(iter->second);
+    }
+
+    return checkpoint;
+}
+
+void ReplayEngine::finalize(long long final_timestamp_us) {
+    metrics.current_best_bid_price_ticks = orderbook.get_bbo().bidPriceTick;
+    metrics.current_best_ask_price_ticks = orderbook.get_bbo().askPriceTick;
+    metrics.finalize(final_timestamp_us);
+}
+
+/**
+ * @brief Splits [start_us, end_us) into num_windows equal windows and replays each one on its own thread, warmed from its nearest checkpoint.
+ * @return one result per window in time order, ready to be joined with Metrics::stitch
+ */
+std::vector<ReplayEngine::WindowResult> ReplayEngine::run_partitioned(const ReplayLog& replay_log, long long start_us, long long end_us, int num_windows, long long sample_interval_us) {
+    if (num_windows <= 0 || end_us <= start_us) {
+        throw std::runtime_error("Partitioned replay needs at least one window and end_us > start_us.");
+    }
+
+    std::vector<WindowResult> results(num_windows);
+    std::vector<std::exception_ptr> errors(num_windows);
+    std::vector<std::thread> workers;
+    workers.reserve(num_windows);
+
+    for (int i = 0; i < num_windows; i++) {
+        long long window_start_us = start_us + (end_us - start_us) * i / num_windows;
+        long long window_end_us = start_us + (end_us - start_us) * (i + 1) / num_windows;
+
+        workers.emplace_back([&replay_log, &results, &errors, i, window_start_us, window_end_us, sample_interval_us]() {
+            try {
+                ReplayEngine engine(replay_log, sample_interval_us);
+                engine.seek(window_start_us);
+
+                std::size_t first_event_index = engine.get_next_event_index();
+                engine.run_until(window_end_us);
+                engine.finalize(window_end_us);
+
+                results[i].start_us = window_start_us;
+                results[i].end_us = window_end_us;
+                results[i].events_applied = engine.get_next_event_index() - first_event_index;
+                results[i].metrics = engine.get_metrics();
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return results;
+}
+
+void ReplayEngine::sample_market_state(long long timestamp_us) {
+    long long best_bid = orderbook.get_bbo().bidPriceTick;
+    long long best_ask = orderbook.get_bbo().askPriceTick;
+
+    metrics.on_market_price_update(timestamp_us, best_bid, best_ask);
+    last_sample_us = timestamp_us;
+}
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "../include/ReplayLog.h"
+#include "../include/ReplayEngine.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    const char REPLAY_MAGIC[4] = {'O', 'B', 'R', 'L'};
+    const std::uint32_t REPLAY_VERSION = 5; // 2 added iceberg display and hidden quantities, 3 stop triggers and pending stops, 4 all-or-none orders,
+                                            // 5 order owners and the self-trade prevention mode. Older files are still read, without owners
+
+    template<typename T>
+    void write_value(std::ofstream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T read_value(std::ifstream& in) {
+        T value;
+        if (!in.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+            throw std::runtime_error("Replay file ended unexpectedly.");
+        }
+        return value;
+    }
+}
+
+ReplayLog::ReplayLog() : events(), checkpoints(), checkpoint_interval_us(0), self_trade_prevention(OrderBook::SelfTradePrevention::NONE) {}
+
+void ReplayLog::append(const OrderCommand& command) {
+    if (!events.empty() && command.timestampUs < events.back().timestampUs) {
+        throw std::runtime_error("Replay events must be appended in non-decreasing timestamp order.");
+    }
+
+    events.push_back(command);
+}
+
+/**
+ * @brief Replays the whole log once in a scratch book and captures the resting orders every interval_us.
+ *        Quiet periods longer than one interval get a single checkpoint, seeking into them replays no events anyway.
+ */
+void ReplayLog::build_checkpoints(long long interval_us) {
+    if (interval_us <= 0) {
+        throw std::runtime_error("Checkpoint interval must be positive.");
+    }
+
+    checkpoints.clear();
+    checkpoint_interval_us = interval_us;
+
+    if (events.empty()) {
+        return;
+    }
+
+    ReplayEngine scratch_engine(*this, interval_us);
+    long long next_checkpoint_us = events.front().timestampUs + interval_us;
+
+    for (std::size_t i = 0; i < events.size(); i++) {
+        if (events[i].timestampUs >= next_checkpoint_us) {
+            checkpoints.push_back(scratch_engine.capture_checkpoint(next_checkpoint_us, i));
+
+            long long skipped_intervals = (events[i].timestampUs - next_checkpoint_us) / interval_us;
+            next_checkpoint_us += (skipped_intervals + 1) * interval_us;
+        }
+
+        scratch_engine.apply(events[i]);
+    }
+}
+
+/**
+ * @brief Checkpoints hold books built under the mode they were taken with, so existing ones are rebuilt under the new mode.
+ */
+void ReplayLog::set_self_trade_prevention(OrderBook::SelfTradePrevention mode) {
+    if (mode == self_trade_prevention) {
+        return;
+    }
+
+    self_trade_prevention = mode;
+    if (checkpoint_interval_us > 0) {
+        build_checkpoints(checkpoint_interval_us);
+    }
+}
+
+/**
+ * @return the last checkpoint taken at or before timestamp_us, nullptr if the replay has to start from an empty book
+ */
+const ReplayLog::Checkpoint* ReplayLog::find_checkpoint(long long timestamp_us) const {
+    auto iter = std::upper_bound(checkpoints.begin(), checkpoints.end(), timestamp_us, [](long long timestamp, const Checkpoint& checkpoint) {
+        return timestamp < checkpoint.timestamp_us;
+    });
+
+    if (iter == checkpoints.begin()) {
+        return nullptr;
+    }
+
+    return &*(iter - 1);
+}
+
+void ReplayLog::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Could not open replay file for writing: " + path);
+    }
+
+    out.write(REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+    write_value(out, REPLAY_VERSION);
+    write_value(out, checkpoint_interval_us);
+    write_value(out, static_cast<std::uint8_t>(self_trade_prevention));
+
+    write_value<std::uint64_t>(out, events.size());
+    for (const OrderCommand& command : events) {
+        write_value(out, command.timestampUs);
+        write_value(out, command.orderId);
+        write_value(out, command.priceTick);
+        write_value(out, command.quantity);
+        write_value(out, command.displayQuantity);
+        write_value(out, command.triggerTick);
+        write_value(out, command.ownerId);
+        write_value(out, static_cast<std::uint8_t>(command.type));
+        write_value<std::uint8_t>(out, command.isBuy);
+    }
+
+    write_value<std::uint64_t>(out, checkpoints.size());
+    for (const Checkpoint& checkpoint : checkpoints) {
+        write_value(out, checkpoint.timestamp_us);
+        write_value<std::uint64_t>(out, checkpoint.event_index);
+        write_value<std::uint64_t>(out, checkpoint.orders.size());
+
+        for (const RestingOrder& order : checkpoint.orders) {
+            write_value(out, order.orderId);
+            write_value(out, order.priceTick);
+            write_value(out, order.tsCreatedUs);
+            write_value(out, order.ownerId);
+            write_value(out, order.quantity);
+            write_value(out, order.hiddenQuantity);
+            write_value(out, order.displayQuantity);
+            write_value<std::uint8_t>(out, order.isBuy);
+        }
+
+        write_value(out, checkpoint.last_trade_price);
+        write_value<std::uint64_t>(out, checkpoint.stops.size());
+        for (const PendingStop& stop : checkpoint.stops) {
+            write_value(out, stop.orderId);
+            write_value(out, stop.triggerTick);
+            write_value(out, stop.limitTick);
+            write_value(out, stop.tsCreatedUs);
+            write_value(out, stop.ownerId);
+            write_value(out, stop.quantity);
+            write_value<std::uint8_t>(out, stop.isBuy);
+        }
+
+        write_value<std::uint64_t>(out, checkpoint.aon_orders.size());
+        for (const RestingOrder& order : checkpoint.aon_orders) {
+            write_value(out, order.orderId);
+            write_value(out, order.priceTick);
+            write_value(out, order.tsCreatedUs);
+            write_value(out, order.quantity);
+            write_value<std::uint8_t>(out, order.isBuy);
+        }
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed while writing replay file: " + path);
+    }
+}
+
+void ReplayLog::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Could not open replay file for reading: " + path);
+    }
+
+    char magic[sizeof(REPLAY_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), REPLAY_MAGIC)) {
+        throw std::runtime_error("Not a replay file: " + path);
+    }
+    std::uint32_t version = read_value<std::uint32_t>(in);
+    if (version < 1 || version > REPLAY_VERSION) {
+        throw std::runtime_error("Unsupported replay file version: " + path);
+    }
+
+    std::vector<OrderCommand> loaded_events;
+    std::vector<Checkpoint> loaded_checkpoints;
+    long long loaded_interval_us = read_value<long long>(in);
+    OrderBook::SelfTradePrevention loaded_self_trade_prevention = OrderBook::SelfTradePrevention::NONE;
+    if (version >= 5) {
+        loaded_self_trade_prevention = static_cast<OrderBook::SelfTradePrevention>(read_value<std::uint8_t>(in));
+    }
+
+    std::uint64_t num_events = read_value<std::uint64_t>(in);
+    loaded_events.reserve(num_events);
+    for (std::uint64_t i = 0; i < num_events; i++) {
+        OrderCommand command;
+        command.timestampUs = read_value<long long>(in);
+        command.orderId = read_value<long long>(in);
+        command.priceTick = read_value<long long>(in);
+        command.quantity = read_value<int>(in);
+        command.displayQuantity = version >= 2 ? read_value<int>(in) : 0;
+        command.triggerTick = version >= 3 ? read_value<long long>(in) : -1;
+        command.ownerId = version >= 5 ? read_value<long long>(in) : 0;
+        command.type = static_cast<OrderCommand::Type>(read_value<std::uint8_t>(in));
+        command.isBuy = read_value<std::uint8_t>(in) != 0;
+        loaded_events.push_back(command);
+    }
+
+    std::uint64_t num_checkpoints = read_value<std::uint64_t>(in);
+    loaded_checkpoints.reserve(num_checkpoints);
+    for (std::uint64_t i = 0; i < num_checkpoints; i++) {
+        Checkpoint checkpoint;
+        checkpoint.timestamp_us = read_value<long long>(in);
+        checkpoint.event_index = read_value<std::uint64_t>(in);
+
+        std::uint64_t num_orders = read_value<std::uint64_t>(in);
+        checkpoint.orders.reserve(num_orders);
+        for (std::uint64_t j = 0; j < num_orders; j++) {
+            RestingOrder order;
+            order.orderId = read_value<long long>(in);
+            order.priceTick = read_value<long long>(in);
+            order.tsCreatedUs = read_value<long long>(in);
+            order.ownerId = version >= 5 ? read_value<long long>(in) : 0;
+            order.quantity = read_value<int>(in);
+            order.hiddenQuantity = version >= 2 ? read_value<int>(in) : 0;
+            order.displayQuantity = version >= 2 ? read_value<int>(in) : 0;
+            order.isBuy = read_value<std::uint8_t>(in) != 0;
+            checkpoint.orders.push_back(order);
+        }
+
+        checkpoint.last_trade_price = -1;
+        if (version >= 3) {
+            checkpoint.last_trade_price = read_value<long long>(in);
+
+            std::uint64_t num_stops = read_value<std::uint64_t>(in);
+            checkpoint.stops.reserve(num_stops);
+            for (std::uint64_t j = 0; j < num_stops; j++) {
+                PendingStop stop;
+                stop.orderId = read_value<long long>(in);
+                stop.triggerTick = read_value<long long>(in);
+                stop.limitTick = read_value<long long>(in);
+                stop.tsCreatedUs = read_value<long long>(in);
+                stop.ownerId = version >= 5 ? read_value<long long>(in) : 0;
+                stop.quantity = read_value<int>(in);
+                stop.isBuy = read_value<std::uint8_t>(in) != 0;
+                checkpoint.stops.push_back(stop);
+            }
+        }
+
+        if (version >= 4) {
+            std::uint64_t num_aon_orders = read_value<std::uint64_t>(in);
+            checkpoint.aon_orders.reserve(num_aon_orders);
+            for (std::uint64_t j = 0; j < num_aon_orders; j++) {
+                RestingOrder order;
+                order.orderId = read_value<long long>(in);
+                order.priceTick = read_value<long long>(in);
+                order.tsCreatedUs = read_value<long long>(in);
+                order.ownerId = 0; // all-or-none orders take no owner
+                order.quantity = read_value<int>(in);
+                order.hiddenQuantity = 0;
+                order.displayQuantity = 0;
+                order.isBuy = read_value<std::uint8_t>(in) != 0;
+                checkpoint.aon_orders.push_back(order);
+            }
+        }
+
+        if (checkpoint.event_index > loaded_events.size()) {
+            throw std::runtime_error("Replay checkpoint points past the end of the event stream: " + path);
+        }
+        loaded_checkpoints.push_back(std::move(checkpoint));
+    }
+
+    events = std::move(loaded_events);
+    checkpoints = std::move(loaded_checkpoints);
+    checkpoint_interval_us = loaded_interval_us;
+    self_trade_prevention = loaded_self_trade_prevention;
+}
\ No newline at end of file
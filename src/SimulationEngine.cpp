@@ -1,8 +1,18 @@
+#include "../include/IdGenerator.h"
 #include "../include/SimulationEngine.h"
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+
+const char SimulationEngine::CHECKPOINT_MAGIC[4] = {'O', 'B', 'S', 'C'};
+const std::uint32_t SimulationEngine::CHECKPOINT_VERSION = 7;
 
 SimulationEngine::SimulationEngine(long long starting_timestamp_us, long long ending_timestamp_us, long long step_us, int strategy_quote_size, long long strategy_tick_offset, long long strategy_max_inv, long long strategy_cancel_threshold, long long strategy_cooldown_between_requotes, long long starting_mid_price, long long start_spread, double start_vol, double start_fill_prob)
-                                    : starting_timestamp_us(starting_timestamp_us), current_timestamp_us(starting_timestamp_us), ending_timestamp_us(ending_timestamp_us), step_us(step_us), market_engine(strategy_quote_size, strategy_tick_offset, strategy_max_inv, strategy_cancel_threshold, strategy_cooldown_between_requotes, starting_mid_price, start_spread, start_vol, start_fill_prob) {}
+                                    : starting_timestamp_us(starting_timestamp_us), current_timestamp_us(starting_timestamp_us), ending_timestamp_us(ending_timestamp_us), step_us(step_us), market_engine(strategy_quote_size, strategy_tick_offset, strategy_max_inv, strategy_cancel_threshold, strategy_cooldown_between_requotes, starting_mid_price, start_spread, start_vol, start_fill_prob),
+                                      checkpoint_path(), checkpoint_interval_us(0), next_checkpoint_us(0) {}
 
 void SimulationEngine::run() {
     if (current_timestamp_us <= 0 || ending_timestamp_us <= 0) {
@@ -17,6 +27,11 @@ void SimulationEngine::run() {
     std::cout << std::endl << std::endl;
     
     while (current_timestamp_us < ending_timestamp_us) {
+        if (checkpoint_interval_us > 0 && current_timestamp_us >= next_checkpoint_us) {
+            save_checkpoint(checkpoint_path);
+            next_checkpoint_us = current_timestamp_us + checkpoint_interval_us;
+        }
+
         market_engine.update(current_timestamp_us);
 
         long long completed = current_timestamp_us - starting_timestamp_us;
@@ -49,6 +64,164 @@ void SimulationEngine::run() {
     finalize(ending_timestamp_us);
 }
 
+/**
+ * @brief Steps the simulation up to timestamp_us (excluded) or its end, without finalizing it, so it can be checkpointed and continued.
+ */
+void SimulationEngine::run_until(long long timestamp_us) {
+    long long end_us = std::min(timestamp_us, ending_timestamp_us);
+    while (current_timestamp_us < end_us) {
+        step();
+    }
+}
+
+void SimulationEngine::step() {
+    market_engine.update(current_timestamp_us);
+    current_timestamp_us += step_us;
+}
+
+void SimulationEngine::save_state(CheckpointWriter& writer) const {
+    writer.write(CHECKPOINT_MAGIC);
+    writer.write(CHECKPOINT_VERSION);
+    writer.write(starting_timestamp_us);
+    writer.write(current_timestamp_us);
+    writer.write(ending_timestamp_us);
+    writer.write(step_us);
+
+    market_engine.save_state(writer);
+
+    writer.write(IdGenerator::peekNext());
+    writer.write(IdGenerator::peekNextTrade());
+}
+
+/**
+ * @brief Restores a state written by save_state. The id counters come last and are put back last: rebuilding orders and trades on the
+ *        way draws ids, which would otherwise move them past the saved ones.
+ */
+void SimulationEngine::load_state(CheckpointReader& reader) {
+    char magic[4];
+    reader.read_into(magic);
+    if (std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0) {
+        throw std::runtime_error("Not a simulation checkpoint!");
+    }
+    if (reader.read<std::uint32_t>() != CHECKPOINT_VERSION) {
+        throw std::runtime_error("Unsupported simulation checkpoint version!");
+    }
+    starting_timestamp_us = reader.read<long long>();
+    current_timestamp_us = reader.read<long long>();
+    ending_timestamp_us = reader.read<long long>();
+    step_us = reader.read<long long>();
+
+    market_engine.load_state(reader);
+
+    long long next_id = reader.read<long long>();
+    long long next_trade_id = reader.read<long long>();
+    if (!reader.at_end()) {
+        throw std::runtime_error("Simulation checkpoint has trailing data!");
+    }
+    IdGenerator::restore(next_id, next_trade_id);
+}
+
+void SimulationEngine::save_checkpoint(const std::string& path) const {
+    CheckpointWriter writer;
+    save_state(writer);
+    writer.save(path);
+}
+
+void SimulationEngine::load_checkpoint(const std::string& path) {
+    CheckpointReader reader = CheckpointReader::from_file(path);
+    load_state(reader);
+}
+
+/**
+ * @brief Makes run() save a checkpoint to path every interval_us of simulated time, starting with the first step. The file is
+ *        overwritten each time, an interval of 0 turns it off.
+ */
+void SimulationEngine::set_checkpointing(const std::string& path, long long interval_us) {
+    checkpoint_path = path;
+    checkpoint_interval_us = std::max<long long>(0, interval_us);
+    next_checkpoint_us = current_timestamp_us;
+}
+
 void SimulationEngine::finalize(long long final_timestamp_us) {
     market_engine.get_strategy().get_metrics().finalize(final_timestamp_us);
+}
+
+/**
+ * @brief Deep copy of the simulation as it is now, through an in-memory checkpoint. The copy draws its ids from the same counters as the
+ *        original unless it runs inside an IdGenerator::Scope, as run_branches does.
+ */
+std::unique_ptr<SimulationEngine> SimulationEngine::fork() const {
+    CheckpointWriter writer;
+    save_state(writer);
+
+    auto branch = std::make_unique<SimulationEngine>(starting_timestamp_us, ending_timestamp_us, step_us);
+    CheckpointReader reader(writer.get_buffer());
+    branch->load_state(reader);
+    return branch;
+}
+
+/**
+ * @brief Runs one branch per variant from the current state up to end_us, on num_threads workers (one per core by default) taking the
+ *        variants in turn. The state is saved once, each branch restores its own copy of it, applies its variant and runs on with ids
+ *        of its own, so a branch's result does not depend on the others or on the scheduling. This engine is left untouched.
+ * @return one result per variant, in the order of variants, with the branch's finalized Metrics
+ */
+std::vector<SimulationEngine::BranchResult> SimulationEngine::run_branches(const std::vector<BranchVariant>& variants, long long end_us, int num_threads) const {
+    if (end_us < current_timestamp_us) {
+        throw std::runtime_error("Branches can only run forward from the current time!");
+    }
+
+    CheckpointWriter snapshot;
+    save_state(snapshot);
+    long long next_id = IdGenerator::peekNext(), next_trade_id = IdGenerator::peekNextTrade();
+
+    std::vector<BranchResult> results(variants.size());
+    std::vector<std::exception_ptr> errors(variants.size());
+    std::atomic<std::size_t> next_variant(0);
+
+    auto run_variants = [&]() {
+        for (std::size_t i = next_variant++; i < variants.size(); i = next_variant++) {
+            try {
+                IdGenerator::Scope ids(next_id, next_trade_id);
+                SimulationEngine branch(starting_timestamp_us, ending_timestamp_us, step_us);
+                CheckpointReader reader(snapshot.get_buffer());
+                branch.load_state(reader);
+
+                if (variants[i]) {
+                    variants[i](branch);
+                }
+                branch.run_until(end_us);
+                branch.finalize(end_us);
+
+                results[i].variant = i;
+                results[i].end_us = end_us;
+                results[i].metrics = branch.get_market_engine().get_metrics();
+            }
+            catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    if (num_threads <= 0) {
+        num_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    num_threads = (int)std::min<std::size_t>(num_threads, variants.size());
+
+    std::vector<std::thread> workers;
+    workers.reserve(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        workers.emplace_back(run_variants);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return results;
 }
\ No newline at end of file
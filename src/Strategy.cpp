@@ -5,90 +5,104 @@
 #include <stdexcept>
 #include <utility>
 
-Strategy::Strategy(Metrics& metrics, OrderBook& orderbook, int quote_size, long long tick_offset, long long max_inv, long long cancel_threshold, long long cooldown_between_requotes) 
-                        : metrics(metrics), order_book(orderbook), buy_pongs(), sell_pongs(), latency_queue(), best_bid_ticks(0), best_ask_ticks(0), mid_price_ticks(0), current_market_price_ticks(0), spread_ticks(0),
+PingPongStrategy::PingPongStrategy(Metrics& metrics, OrderBook& orderbook, int quote_size, long long tick_offset, long long max_inv, long long cancel_threshold, long long cooldown_between_requotes) 
+                        : StrategyBase(metrics, orderbook), buy_pongs(), sell_pongs(), best_bid_ticks(0), best_ask_ticks(0), mid_price_ticks(0), current_market_price_ticks(0), spread_ticks(0),
                         quote_size(quote_size), tick_offset_from_mid(tick_offset), max_inventory(max_inv), cancel_threshold_ticks(cancel_threshold), cooldown_between_requotes(cooldown_between_requotes), 
-                        active_buy_order_id(-1), active_sell_order_id(-1), last_pinged_market_price_ticks(0), last_quote_time_us(0) {}
-
-Strategy::~Strategy() {}
-
-void Strategy::observe_the_market(long long timestamp_us, long long market_price) {
-    latency_queue.schedule_event(timestamp_us, LatencyQueue::ActionType::MARKET_UPDATE, [this, market_price](long long exec_time) {
-        best_bid_ticks = get_best_bid_ticks();
-        best_ask_ticks = get_best_ask_ticks();
-        mid_price_ticks = get_mid_price_ticks();
-        spread_ticks = get_spread_ticks();
-
-        // Since the system now uses a dynamic market generating engine, these are commented. Uncomment when system uses a full-order-book as market.
-        // if (metrics.config.marking_method == Metrics::MarkingMethod::MID) {
-        //     current_market_price_ticks = mid_price_ticks;
-        // }
-        // else {
-        //     current_market_price_ticks = metrics.last_trade_price_ticks;
-        // }
-
-        current_market_price_ticks = market_price;
-    });
-}
-
-void Strategy::cancel_mechanism(long long timestamp_us) {
-    if ((active_buy_order_id != -1 || active_sell_order_id != -1) && last_pinged_market_price_ticks != 0) {
-        latency_queue.schedule_event(timestamp_us, LatencyQueue::ActionType::CANCEL, [this, timestamp_us](long long exec_time) {
-            if (std::abs(current_market_price_ticks - last_pinged_market_price_ticks) > cancel_threshold_ticks) {
-                if (active_buy_order_id != -1) {
-                    order_book.cancel_order(active_buy_order_id);
-                    metrics.on_order_cancelled(active_buy_order_id, exec_time);
-                    active_buy_order_id = -1;
-                }
-                if (active_sell_order_id != -1) {
-                    order_book.cancel_order(active_sell_order_id);
-                    metrics.on_order_cancelled(active_sell_order_id, exec_time);
-                    active_sell_order_id = -1;
-                }
-            }
-        });
+                        active_buy_order_id(-1), active_sell_order_id(-1), last_pinged_market_price_ticks(0), last_quote_time_us(0), owner_id(0),
+                        pending_buy_ping(), pending_sell_ping(), pending_cancel_check() {}
+
+PingPongStrategy::~PingPongStrategy() {}
+
+void PingPongStrategy::observe_the_market(long long timestamp_us, long long market_price) {
+    latency_queue.schedule_event(timestamp_us, LatencyQueue::MarketUpdate{market_price});
+}
+
+void PingPongStrategy::on_market_observed(long long market_price) {
+    best_bid_ticks = get_best_bid_ticks();
+    best_ask_ticks = get_best_ask_ticks();
+    mid_price_ticks = get_mid_price_ticks();
+    spread_ticks = get_spread_ticks();
+
+    // Since the system now uses a dynamic market generating engine, these are commented. Uncomment when system uses a full-order-book as market.
+    // if (metrics.config.marking_method == Metrics::MarkingMethod::MID) {
+    //     current_market_price_ticks = mid_price_ticks;
+    // }
+    // else {
+    //     current_market_price_ticks = metrics.last_trade_price_ticks;
+    // }
+
+    current_market_price_ticks = market_price;
+}
+
+void PingPongStrategy::cancel_mechanism(long long timestamp_us) {
+    if ((active_buy_order_id != -1 || active_sell_order_id != -1) && last_pinged_market_price_ticks != 0 && !latency_queue.is_pending(pending_cancel_check)) {
+        pending_cancel_check = latency_queue.schedule_event(timestamp_us, LatencyQueue::Cancel{-1});
     }
 }
 
-void Strategy::update_last_used_mark_price() {
+void PingPongStrategy::on_cancel_check(long long exec_time) {
+    if (std::abs(current_market_price_ticks - last_pinged_market_price_ticks) > cancel_threshold_ticks) {
+        if (active_buy_order_id != -1) {
+            cancel_resting(active_buy_order_id, exec_time);
+            active_buy_order_id = -1;
+        }
+        if (active_sell_order_id != -1) {
+            cancel_resting(active_sell_order_id, exec_time);
+            active_sell_order_id = -1;
+        }
+    }
+}
+
+/**
+    A cancel only takes off what the book still has of the order. Fills that happened before it got there stand, their acknowledgements
+    are still in flight and book them when they come up.
+*/
+void PingPongStrategy::cancel_resting(long long order_id, long long exec_time) {
+    int open_qty = order_book.get_resting_quantity(order_id);
+    if (open_qty > 0) {
+        order_book.cancel_order(order_id);
+        metrics.on_order_cancelled(order_id, exec_time, open_qty);
+    }
+}
+
+void PingPongStrategy::update_last_used_mark_price() {
     last_pinged_market_price_ticks = current_market_price_ticks;
 }
 
-void Strategy::place_ping_buy(long long timestamp_us) {
-    if (timestamp_us - last_quote_time_us > cooldown_between_requotes && metrics.position + quote_size <= max_inventory) {
-        latency_queue.schedule_event(timestamp_us, LatencyQueue::ActionType::ORDER_SEND, [this, timestamp_us](long long exec_time) {
-            long long order_id = order_book.add_limit_order(true, current_market_price_ticks - tick_offset_from_mid, quote_size, exec_time);
-            metrics.on_order_placed(order_id, Metrics::Side::BUYS, current_market_price_ticks - tick_offset_from_mid, exec_time, quote_size, false);
-            last_quote_time_us = exec_time;
-            active_buy_order_id = order_id;
+void PingPongStrategy::place_ping_buy(long long timestamp_us) {
+    if (timestamp_us - last_quote_time_us > cooldown_between_requotes && metrics.position + quote_size <= max_inventory && !latency_queue.is_pending(pending_buy_ping)) {
+        pending_buy_ping = latency_queue.schedule_event(timestamp_us, LatencyQueue::OrderSend{true, false, 0, 0});
+    }
+}
 
-            update_last_used_mark_price();
-        });
+void PingPongStrategy::place_ping_ask(long long timestamp_us) {
+    if (timestamp_us - last_quote_time_us > cooldown_between_requotes && metrics.position - quote_size >= -max_inventory && !latency_queue.is_pending(pending_sell_ping)) {
+        pending_sell_ping = latency_queue.schedule_event(timestamp_us, LatencyQueue::OrderSend{false, false, 0, 0});
     }
 }
 
-void Strategy::place_ping_ask(long long timestamp_us) {
-    if (timestamp_us - last_quote_time_us > cooldown_between_requotes && metrics.position - quote_size >= -max_inventory) {
-        latency_queue.schedule_event(timestamp_us, LatencyQueue::ActionType::ORDER_SEND, [this, timestamp_us](long long exec_time) {
-            long long order_id = order_book.add_limit_order(false, current_market_price_ticks + tick_offset_from_mid, quote_size, exec_time);
-            metrics.on_order_placed(order_id, Metrics::Side::SELLS, current_market_price_ticks + tick_offset_from_mid, exec_time, quote_size, false);
-            last_quote_time_us = exec_time;
-            active_sell_order_id = order_id;
+/**
+    A ping reaching the book, priced off the market price the strategy knows when it arrives.
+*/
+void PingPongStrategy::send_ping(bool isBuy, long long exec_time) {
+    long long price_ticks = isBuy ? current_market_price_ticks - tick_offset_from_mid : current_market_price_ticks + tick_offset_from_mid;
+    long long order_id = order_book.add_limit_order(isBuy, price_ticks, quote_size, exec_time, owner_id);
+    metrics.on_order_placed(order_id, isBuy ? Metrics::Side::BUYS : Metrics::Side::SELLS, price_ticks, exec_time, quote_size, false);
+    last_quote_time_us = exec_time;
+    (isBuy ? active_buy_order_id : active_sell_order_id) = order_id;
 
-            update_last_used_mark_price();
-        });
-    }
+    update_last_used_mark_price();
 }
 
-bool Strategy::is_bid_ping_filled(long long order_id) {
+bool PingPongStrategy::is_bid_ping_filled(long long order_id) {
     return metrics.order_cache.find(order_id) == metrics.order_cache.end();
 }
 
-bool Strategy::is_ask_ping_filled(long long order_id) {
+bool PingPongStrategy::is_ask_ping_filled(long long order_id) {
     return metrics.order_cache.find(order_id) == metrics.order_cache.end();
 }
 
-void Strategy::on_market_update(long long timestamp, long long market_price) {
+void PingPongStrategy::on_market_update(long long timestamp, long long market_price) {
     observe_the_market(timestamp, market_price);
     cancel_mechanism(timestamp);
 
@@ -111,50 +125,14 @@ void Strategy::on_market_update(long long timestamp, long long market_price) {
     */
 }
 
-void Strategy::on_fill(const Trade& trade) {
+void PingPongStrategy::on_fill(const Trade& trade) {
     if (trade.buyOrderId == active_buy_order_id) {
-        latency_queue.schedule_event(trade.timestampUs, LatencyQueue::ActionType::ACKNOWLEDGE_FILL, [this, trade](long long ack_exec_time) {
-            auto it = metrics.order_cache.find(trade.buyOrderId);
-            if (it == metrics.order_cache.end()) {
-                return;
-            }
-            int remaining_qty = metrics.order_cache.find(trade.buyOrderId)->second.remaining_qty - trade.quantity;
-            metrics.on_fill(trade.buyOrderId, trade.priceTick, ack_exec_time, trade.quantity, trade.was_instant);
-            if (remaining_qty == 0 && active_buy_order_id == trade.buyOrderId) {
-                active_buy_order_id = -1;
-                order_book.cancel_order(trade.buyOrderId);
-            }
-
-            latency_queue.schedule_event(ack_exec_time, LatencyQueue::ActionType::ORDER_SEND, [this, trade](long long exec_time) {
-                long long pong_order_id = order_book.add_limit_order(false, trade.priceTick + 1, trade.quantity, exec_time);
-                if (order_book.get_order_lookup().find(pong_order_id) != order_book.get_order_lookup().end()) {
-                    sell_pongs.emplace(trade.priceTick + 1, std::pair<long long, int>(pong_order_id, trade.quantity));
-                    metrics.on_order_placed(pong_order_id, Metrics::Side::SELLS, trade.priceTick + 1, exec_time, trade.quantity, false);
-                }
-            });
-        });        
+        metrics.on_quote_filled(Metrics::Side::BUYS, trade.quantity);
+        latency_queue.schedule_event(trade.timestampUs, LatencyQueue::AcknowledgeFill{true, false, trade.was_instant, trade.quantity, trade.buyOrderId, trade.priceTick});
     }
     else if (trade.sellOrderId == active_sell_order_id) {
-        latency_queue.schedule_event(trade.timestampUs, LatencyQueue::ActionType::ACKNOWLEDGE_FILL, [this, trade](long long ack_exec_time) {
-            auto it = metrics.order_cache.find(trade.sellOrderId);
-            if (it == metrics.order_cache.end()) {
-                return;
-            }
-            int remaining_qty = metrics.order_cache.find(trade.sellOrderId)->second.remaining_qty - trade.quantity;
-            metrics.on_fill(trade.sellOrderId, trade.priceTick, ack_exec_time, trade.quantity, trade.was_instant);
-            if (remaining_qty == 0 && active_sell_order_id == trade.sellOrderId) {
-                active_sell_order_id = -1;
-                order_book.cancel_order(trade.sellOrderId);
-            }
-
-            latency_queue.schedule_event(ack_exec_time, LatencyQueue::ActionType::ORDER_SEND, [this, trade](long long exec_time) {
-                long long pong_order_id = order_book.add_limit_order(true, trade.priceTick - 1, trade.quantity, exec_time);
-                if (order_book.get_order_lookup().find(pong_order_id) != order_book.get_order_lookup().end()) {
-                    buy_pongs.emplace(trade.priceTick - 1, std::pair<long long, int>(pong_order_id, trade.quantity));
-                    metrics.on_order_placed(pong_order_id, Metrics::Side::BUYS, trade.priceTick - 1, exec_time, trade.quantity, false);    
-                }
-            });
-        });
+        metrics.on_quote_filled(Metrics::Side::SELLS, trade.quantity);
+        latency_queue.schedule_event(trade.timestampUs, LatencyQueue::AcknowledgeFill{false, false, trade.was_instant, trade.quantity, trade.sellOrderId, trade.priceTick});
     }
 
     /*
@@ -163,35 +141,206 @@ void Strategy::on_fill(const Trade& trade) {
 
     /*
         Problem: I needed to somehow pass the randomized latency into the lambda passed to schedule_event - solved, I passed the actual execution time to the lambdas, so they can use this information internally whenever they are executed.
+        The events are typed data now (LatencyQueue::Payload), the execution time still comes with them to on_event.
     */
 }
 
-void Strategy::check_and_fill_pongs(long long market_price, long long timestamp_us) {
+/**
+    The fill of a ping acknowledged: books it, retires the ping once it is done and sends the pong one tick behind the fill price.
+    The fill happened at the exchange, so it is booked even when the ping has left the order cache since.
+*/
+void PingPongStrategy::on_ping_fill_acknowledged(const LatencyQueue::AcknowledgeFill& fill, long long ack_exec_time) {
+    auto it = metrics.order_cache.find(fill.orderId);
+    if (it == metrics.order_cache.end()) {
+        metrics.on_untracked_fill(fill.isBuy ? Metrics::Side::BUYS : Metrics::Side::SELLS, fill.priceTick, ack_exec_time, fill.quantity, fill.wasInstant);
+    }
+    else {
+        int remaining_qty = it->second.remaining_qty - fill.quantity;
+        metrics.on_fill(fill.orderId, fill.priceTick, ack_exec_time, fill.quantity, fill.wasInstant);
+
+        // The exchange may already have taken the filled quote off the book (the probabilistic fill model does)
+        long long& active_order_id = fill.isBuy ? active_buy_order_id : active_sell_order_id;
+        if (remaining_qty == 0 && active_order_id == fill.orderId) {
+            active_order_id = -1;
+            if (order_book.is_live(fill.orderId)) {
+                order_book.cancel_order(fill.orderId);
+            }
+        }
+    }
+
+    long long pong_price_ticks = fill.isBuy ? fill.priceTick + 1 : fill.priceTick - 1;
+    latency_queue.schedule_event(ack_exec_time, LatencyQueue::OrderSend{!fill.isBuy, true, fill.quantity, pong_price_ticks});
+}
+
+void PingPongStrategy::send_pong(const LatencyQueue::OrderSend& pong, long long exec_time) {
+    long long pong_order_id = order_book.add_limit_order(pong.isBuy, pong.priceTick, pong.quantity, exec_time, owner_id);
+    if (order_book.get_order_lookup().find(pong_order_id) != order_book.get_order_lookup().end()) {
+        if (pong.isBuy) {
+            buy_pongs.emplace(pong.priceTick, std::pair<long long, int>(pong_order_id, pong.quantity));
+        }
+        else {
+            sell_pongs.emplace(pong.priceTick, std::pair<long long, int>(pong_order_id, pong.quantity));
+        }
+        metrics.on_order_placed(pong_order_id, pong.isBuy ? Metrics::Side::BUYS : Metrics::Side::SELLS, pong.priceTick, exec_time, pong.quantity, false);
+    }
+}
+
+void PingPongStrategy::check_and_fill_pongs(long long market_price, long long timestamp_us) {
     // Check for pong bids, if market price is below them consider them filled.
+    // The exchange fills what the book has left of a pong and takes it off right away, the strategy hears of it with the acknowledgement
     while (!buy_pongs.empty() && market_price <= buy_pongs.top().first) {
         PongOrderData highest_bid_pong_order_data = buy_pongs.top();
-            
-        latency_queue.schedule_event(timestamp_us, LatencyQueue::ActionType::ACKNOWLEDGE_FILL, [this, highest_bid_pong_order_data](long long exec_time) {
-            metrics.on_fill(highest_bid_pong_order_data.second.first, highest_bid_pong_order_data.first, exec_time, highest_bid_pong_order_data.second.second, false);
-            order_book.cancel_order(highest_bid_pong_order_data.second.first);
-        });
-    
+
+        fill_pong(true, highest_bid_pong_order_data.second.first, highest_bid_pong_order_data.first, timestamp_us);
+
         buy_pongs.pop();
     }    
 
     while (!sell_pongs.empty() && market_price >= sell_pongs.top().first) {
         PongOrderData lowest_sell_pong_order_data = sell_pongs.top();
-    
-        latency_queue.schedule_event(timestamp_us, LatencyQueue::ActionType::ACKNOWLEDGE_FILL, [this, lowest_sell_pong_order_data](long long exec_time) {
-            metrics.on_fill(lowest_sell_pong_order_data.second.first, lowest_sell_pong_order_data.first, exec_time, lowest_sell_pong_order_data.second.second, false);
-            order_book.cancel_order(lowest_sell_pong_order_data.second.first);
-        });
+
+        fill_pong(false, lowest_sell_pong_order_data.second.first, lowest_sell_pong_order_data.first, timestamp_us);
 
         sell_pongs.pop();
     }
 }
 
-Metrics::OrderCacheData& Strategy::get_active_buy_order_data() {
+void PingPongStrategy::fill_pong(bool isBuy, long long order_id, long long price_ticks, long long timestamp_us) {
+    int open_qty = order_book.get_resting_quantity(order_id);
+    if (open_qty == 0) {
+        return;
+    }
+    order_book.cancel_order(order_id);
+    latency_queue.schedule_event(timestamp_us, LatencyQueue::AcknowledgeFill{isBuy, true, false, open_qty, order_id, price_ticks});
+}
+
+void PingPongStrategy::on_pong_fill_acknowledged(const LatencyQueue::AcknowledgeFill& fill, long long exec_time) {
+    metrics.on_fill(fill.orderId, fill.priceTick, exec_time, fill.quantity, false);
+}
+
+/**
+    Strategy events whose latency has passed, one overload per payload type. Fill acknowledgements come to the on_ack hook.
+*/
+void PingPongStrategy::on_event(const LatencyQueue::OrderSend& order, long long exec_time) {
+    if (order.isPong) {
+        send_pong(order, exec_time);
+    }
+    else {
+        send_ping(order.isBuy, exec_time);
+    }
+}
+
+void PingPongStrategy::on_event(const LatencyQueue::Cancel& cancel, long long exec_time) {
+    if (cancel.orderId == -1) {
+        on_cancel_check(exec_time);
+    }
+    else {
+        cancel_resting(cancel.orderId, exec_time);
+    }
+}
+
+void PingPongStrategy::on_event(const LatencyQueue::Modify& modify, long long exec_time) {
+    order_book.modify_order(modify.orderId, modify.newQuantity, exec_time);
+}
+
+void PingPongStrategy::on_ack(const LatencyQueue::AcknowledgeFill& fill, long long exec_time) {
+    if (fill.isPong) {
+        on_pong_fill_acknowledged(fill, exec_time);
+    }
+    else {
+        on_ping_fill_acknowledged(fill, exec_time);
+    }
+}
+
+void PingPongStrategy::on_event(const LatencyQueue::MarketUpdate& update, long long) {
+    on_market_observed(update.marketPriceTicks);
+}
+
+/**
+    A live quote is stale once the price has moved past the cancel threshold since it was priced, the strategy just has not seen it yet.
+*/
+bool PingPongStrategy::is_quote_stale(long long market_price_ticks) const {
+    return std::abs(market_price_ticks - last_pinged_market_price_ticks) > cancel_threshold_ticks;
+}
+
+/**
+ * @brief Writes the strategy's own state: quoting state, parameters, pong heaps and its latency queue. The book and metrics it trades
+ *        through are saved by their owner.
+ */
+void PingPongStrategy::save_state(CheckpointWriter& writer) const {
+    writer.write(best_bid_ticks);
+    writer.write(best_ask_ticks);
+    writer.write(mid_price_ticks);
+    writer.write(current_market_price_ticks);
+    writer.write(spread_ticks);
+    writer.write(quote_size);
+    writer.write(tick_offset_from_mid);
+    writer.write(max_inventory);
+    writer.write(cancel_threshold_ticks);
+    writer.write(cooldown_between_requotes);
+    writer.write(active_buy_order_id);
+    writer.write(active_sell_order_id);
+    writer.write(last_pinged_market_price_ticks);
+    writer.write(last_quote_time_us);
+    writer.write(owner_id);
+    writer.write(state);
+    writer.write(pending_buy_ping);
+    writer.write(pending_sell_ping);
+    writer.write(pending_cancel_check);
+
+    // Heaps in pop order. Pong ids are unique, so any heap rebuilt from them pops in that same order
+    auto write_pongs = [&writer](auto pongs) {
+        writer.write<std::uint64_t>(pongs.size());
+        for (; !pongs.empty(); pongs.pop()) {
+            writer.write(pongs.top().first);
+            writer.write(pongs.top().second.first);
+            writer.write(pongs.top().second.second);
+        }
+    };
+    write_pongs(buy_pongs);
+    write_pongs(sell_pongs);
+
+    latency_queue.save_state(writer);
+}
+
+void PingPongStrategy::load_state(CheckpointReader& reader) {
+    best_bid_ticks = reader.read<long long>();
+    best_ask_ticks = reader.read<long long>();
+    mid_price_ticks = reader.read<long long>();
+    current_market_price_ticks = reader.read<long long>();
+    spread_ticks = reader.read<long long>();
+    quote_size = reader.read<int>();
+    tick_offset_from_mid = reader.read<long long>();
+    max_inventory = reader.read<long long>();
+    cancel_threshold_ticks = reader.read<long long>();
+    cooldown_between_requotes = reader.read<long long>();
+    active_buy_order_id = reader.read<long long>();
+    active_sell_order_id = reader.read<long long>();
+    last_pinged_market_price_ticks = reader.read<long long>();
+    last_quote_time_us = reader.read<long long>();
+    owner_id = reader.read<long long>();
+    state = reader.read<State>();
+    pending_buy_ping = reader.read<LatencyQueue::EventHandle>();
+    pending_sell_ping = reader.read<LatencyQueue::EventHandle>();
+    pending_cancel_check = reader.read<LatencyQueue::EventHandle>();
+
+    auto read_pongs = [&reader](auto& pongs) {
+        pongs = {};
+        std::uint64_t num_pongs = reader.read<std::uint64_t>();
+        for (std::uint64_t i = 0; i < num_pongs; i++) {
+            long long price_ticks = reader.read<long long>();
+            long long order_id = reader.read<long long>();
+            int quantity = reader.read<int>();
+            pongs.emplace(price_ticks, std::pair<long long, int>(order_id, quantity));
+        }
+    };
+    read_pongs(buy_pongs);
+    read_pongs(sell_pongs);
+
+    latency_queue.load_state(reader);
+}
+
+Metrics::OrderCacheData& PingPongStrategy::get_active_buy_order_data() {
     if (active_buy_order_id != -1) {
         return metrics.order_cache.find(active_buy_order_id)->second;
     }
@@ -200,7 +349,7 @@ Metrics::OrderCacheData& Strategy::get_active_buy_order_data() {
     }
 }
 
-Metrics::OrderCacheData& Strategy::get_active_sell_order_data() {
+Metrics::OrderCacheData& PingPongStrategy::get_active_sell_order_data() {
     if (active_sell_order_id != -1) {
         return metrics.order_cache.find(active_sell_order_id)->second;
     }
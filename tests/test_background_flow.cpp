@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../include/BackgroundFlow.h"
+#include "../include/MarketEngine.h"
+
+namespace {
+    std::vector<L2Level> depth_of(const OrderBook& orderbook, bool isBuy) {
+        std::vector<L2Level> levels(64);
+        levels.resize(orderbook.get_depth(isBuy, levels.data(), levels.size()));
+        return levels;
+    }
+}
+
+/**
+    ============================================================
+    TEST 1: NoiseTradersBuildBookAroundReference
+    ============================================================
+    PURPOSE: Verify noise traders arrive at their Poisson rate and rest bids below and asks above the reference price, within their range
+    ============================================================
+*/
+TEST(BackgroundFlowTest, NoiseTradersBuildBookAroundReference) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    BackgroundFlow flow(orderbook);
+    flow.add_population(BackgroundFlow::AgentPopulation::noise_traders(10000, 5, 0.0, 0.0));
+
+    flow.advance_to(0, 1000);
+    EXPECT_EQ(flow.get_num_commands_sent(), 0)
+        << "The first advance only starts the clock.";
+    flow.advance_to(1000000, 1000);
+
+    // 10000 arrivals expected in one second, the standard deviation is 100
+    EXPECT_GT(flow.get_num_commands_sent(), 9500);
+    EXPECT_LT(flow.get_num_commands_sent(), 10500);
+    EXPECT_EQ(orderbook.get_order_lookup().size(), flow.get_num_commands_sent())
+        << "Without market orders and cancels every order should rest.";
+
+    for (const L2Level& level : depth_of(orderbook, true)) {
+        EXPECT_GE(level.priceTick, 995);
+        EXPECT_LE(level.priceTick, 999);
+    }
+    for (const L2Level& level : depth_of(orderbook, false)) {
+        EXPECT_GE(level.priceTick, 1001);
+        EXPECT_LE(level.priceTick, 1005);
+    }
+    EXPECT_EQ(orderbook.get_trade_log().get_trades().size(), 0)
+        << "Passive noise orders never cross.";
+}
+
+/**
+    ============================================================
+    TEST 2: SameSeedSameFlow
+    ============================================================
+    PURPOSE: Verify the flow is reproducible: two flows with the same seed and populations leave identical books and trades
+    ============================================================
+*/
+TEST(BackgroundFlowTest, SameSeedSameFlow) {
+    Metrics metrics_1, metrics_2;
+    OrderBook orderbook_1(metrics_1), orderbook_2(metrics_2);
+    BackgroundFlow flow_1(orderbook_1, 5), flow_2(orderbook_2, 5);
+
+    for (BackgroundFlow* flow : {&flow_1, &flow_2}) {
+        flow->add_population(BackgroundFlow::AgentPopulation::noise_traders(50000));
+        flow->add_population(BackgroundFlow::AgentPopulation::market_makers(5000));
+        flow->add_population(BackgroundFlow::AgentPopulation::momentum_takers(2000, 1));
+    }
+
+    long long reference = 1000;
+    for (long long timestamp = 0; timestamp <= 500000; timestamp += 10000) {
+        reference += (timestamp / 10000) % 3 - 1;
+        flow_1.advance_to(timestamp, reference);
+        flow_2.advance_to(timestamp, reference);
+    }
+
+    EXPECT_EQ(flow_1.get_num_commands_sent(), flow_2.get_num_commands_sent());
+    EXPECT_EQ(orderbook_1.get_trade_log().get_trades().size(), orderbook_2.get_trade_log().get_trades().size());
+    EXPECT_GT(orderbook_1.get_trade_log().get_trades().size(), 0)
+        << "Market and momentum orders should have traded.";
+
+    std::vector<L2Level> bids_1 = depth_of(orderbook_1, true), bids_2 = depth_of(orderbook_2, true);
+    std::vector<L2Level> asks_1 = depth_of(orderbook_1, false), asks_2 = depth_of(orderbook_2, false);
+    ASSERT_EQ(bids_1.size(), bids_2.size());
+    ASSERT_EQ(asks_1.size(), asks_2.size());
+    for (std::size_t i = 0; i < bids_1.size(); i++) {
+        EXPECT_EQ(bids_1[i].priceTick, bids_2[i].priceTick);
+        EXPECT_EQ(bids_1[i].quantity, bids_2[i].quantity);
+    }
+    for (std::size_t i = 0; i < asks_1.size(); i++) {
+        EXPECT_EQ(asks_1[i].priceTick, asks_2[i].priceTick);
+        EXPECT_EQ(asks_1[i].quantity, asks_2[i].quantity);
+    }
+}
+
+/**
+    ============================================================
+    TEST 3: MarketMakersKeepBoundedQuotes
+    ============================================================
+    PURPOSE: Verify market makers quote both sides around the reference and cancel their oldest pair to stay within their live order limit
+    ============================================================
+*/
+TEST(BackgroundFlowTest, MarketMakersKeepBoundedQuotes) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    BackgroundFlow flow(orderbook);
+    flow.add_population(BackgroundFlow::AgentPopulation::market_makers(1000, 2, 0, 10));
+
+    flow.advance_to(0, 500);
+    flow.advance_to(1000000, 500);
+
+    EXPECT_EQ(flow.get_num_live_orders(0), 10)
+        << "The makers should hold exactly their limit of 10 quotes. Live quotes: " << flow.get_num_live_orders(0) << ".";
+    EXPECT_EQ(orderbook.get_order_lookup().size(), 10)
+        << "Every replaced quote should have been cancelled from the book. Resting orders: " << orderbook.get_order_lookup().size() << ".";
+    EXPECT_EQ(orderbook.get_bbo().bidPriceTick, 498);
+    EXPECT_EQ(orderbook.get_bbo().askPriceTick, 502);
+    EXPECT_EQ(orderbook.get_buys().begin()->second.orders.size(), 5)
+        << "Half the quotes should be bids.";
+}
+
+/**
+    ============================================================
+    TEST 4: MomentumTakersFollowTheMid
+    ============================================================
+    PURPOSE: Verify momentum takers stay out while the mid is still and buy once it has risen by their threshold
+    ============================================================
+*/
+TEST(BackgroundFlowTest, MomentumTakersFollowTheMid) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    orderbook.add_limit_order(true, 99, 100000, 0);
+    orderbook.add_limit_order(false, 104, 100000, 0);
+
+    BackgroundFlow flow(orderbook);
+    flow.add_population(BackgroundFlow::AgentPopulation::momentum_takers(1000, 2));
+    flow.advance_to(0, 100);
+    flow.advance_to(100000, 100);
+    EXPECT_EQ(orderbook.get_trade_log().get_trades().size(), 0)
+        << "A still mid should not trigger momentum orders.";
+
+    // The bid moves up to 103, the mid from 101 to 103
+    orderbook.add_limit_order(true, 103, 100000, 0);
+    flow.advance_to(200000, 100);
+
+    ASSERT_GT(orderbook.get_trade_log().get_trades().size(), 0)
+        << "The rise of the mid should have triggered a momentum buy.";
+    const Trade& trade = orderbook.get_trade_log().get_trades().front();
+    EXPECT_EQ(trade.priceTick, 104)
+        << "The momentum taker should have bought from the ask. Trade price: " << trade.priceTick << ".";
+}
+
+/**
+    ============================================================
+    TEST 5: MarketEngineRunsBackgroundFlow
+    ============================================================
+    PURPOSE: Verify populations added to the MarketEngine's flow trade in its order book on every update, around the engine's market price,
+             with the strategy filled by the book only
+    ============================================================
+*/
+TEST(BackgroundFlowTest, MarketEngineRunsBackgroundFlow) {
+    MarketEngine marketengine(100, 2, 1000, 3, 0, 1000, 2, 0.0, 0.3);
+    marketengine.set_fill_model(MarketEngine::FillModel::ORDER_BOOK);
+    marketengine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::noise_traders(100000, 10, 0.2, 0.3));
+    marketengine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::market_makers(20000));
+
+    for (long long timestamp = 1000; timestamp <= 100000; timestamp += 1000) {
+        marketengine.update(timestamp);
+    }
+
+    EXPECT_GT(marketengine.get_background_flow().get_num_commands_sent(), 10000)
+        << "About 12000 arrivals were expected over 0.1s. Commands sent: " << marketengine.get_background_flow().get_num_commands_sent() << ".";
+    EXPECT_GT(marketengine.get_orderbook().get_order_lookup().size(), 100);
+    EXPECT_GT(marketengine.get_orderbook().get_trade_log().get_trades().size(), 0);
+    EXPECT_LT(marketengine.get_orderbook().get_bbo().bidPriceTick, 1000);
+    EXPECT_GT(marketengine.get_orderbook().get_bbo().askPriceTick, 1000);
+}
+
+/**
+    ============================================================
+    TEST 6: HawkesPopulationSendsItsMarks
+    ============================================================
+    PURPOSE: Verify a Hawkes population sends as many commands as its process has events, with limits around the reference price
+    ============================================================
+*/
+TEST(BackgroundFlowTest, HawkesPopulationSendsItsMarks) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    BackgroundFlow flow(orderbook);
+    HawkesProcess::Parameters parameters = HawkesProcess::Parameters::uniform(2000, 100, 20, 1000);
+    parameters.baselinePerSecond[HawkesProcess::BUY_LIMIT] = 20000;
+    parameters.baselinePerSecond[HawkesProcess::SELL_LIMIT] = 20000;
+    flow.add_hawkes_population(parameters, 5);
+
+    flow.advance_to(0, 1000);
+    for (long long timestamp = 10000; timestamp <= 1000000; timestamp += 10000) {
+        flow.advance_to(timestamp, 1000);
+    }
+
+    double expected = 0;
+    for (double rate : HawkesProcess::stationary_rates(parameters)) {
+        expected += rate;
+    }
+    // Cancels with no order of their side to find send nothing, and there are few of those once the book has filled
+    EXPECT_NEAR((double)flow.get_num_commands_sent(), expected, 0.1 * expected);
+    EXPECT_GT(orderbook.get_trade_log().get_trades().size(), 0);
+    for (const L2Level& level : depth_of(orderbook, true)) {
+        EXPECT_GE(level.priceTick, 995);
+        EXPECT_LE(level.priceTick, 999);
+    }
+}
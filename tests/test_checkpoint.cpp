@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../include/IdGenerator.h"
+#include "../include/SimulationEngine.h"
+
+namespace {
+    // Resting orders of one side as (id, price, quantity) in price-time priority
+    std::vector<long long> side_contents(const std::map<long long, PriceLevel>& side) {
+        std::vector<long long> contents;
+        for (const auto& [price_tick, level] : side) {
+            for (const Order& order : level) {
+                contents.insert(contents.end(), {order.id, price_tick, order.quantity, order.hiddenQuantity, order.tsCreatedUs});
+            }
+        }
+        return contents;
+    }
+
+    void expect_same_simulation(SimulationEngine& expected, SimulationEngine& restored) {
+        Metrics& expected_metrics = expected.get_market_engine().get_metrics();
+        Metrics& restored_metrics = restored.get_market_engine().get_metrics();
+        EXPECT_EQ(restored.get_current_timestamp_us(), expected.get_current_timestamp_us()) << "Both runs should stop at the same time." << std::endl;
+        EXPECT_EQ(restored_metrics.timestamp_series, expected_metrics.timestamp_series) << "Restored run should record the same timestamps." << std::endl;
+        EXPECT_EQ(restored_metrics.total_pnl_ticks_series, expected_metrics.total_pnl_ticks_series) << "Restored run should make the same PnL." << std::endl;
+        EXPECT_EQ(restored_metrics.market_price_ticks_series, expected_metrics.market_price_ticks_series) << "Restored run should see the same prices." << std::endl;
+        EXPECT_EQ(restored_metrics.position, expected_metrics.position) << "Restored run should end with the same position." << std::endl;
+        EXPECT_EQ(restored_metrics.gross_traded_qty, expected_metrics.gross_traded_qty) << "Restored run should trade the same quantity." << std::endl;
+
+        OrderBook& expected_book = expected.get_market_engine().get_orderbook();
+        OrderBook& restored_book = restored.get_market_engine().get_orderbook();
+        EXPECT_EQ(side_contents(restored_book.get_buys()), side_contents(expected_book.get_buys())) << "Restored book should hold the same bids." << std::endl;
+        EXPECT_EQ(side_contents(restored_book.get_sells()), side_contents(expected_book.get_sells())) << "Restored book should hold the same asks." << std::endl;
+        EXPECT_EQ(restored_book.get_trade_log().get_trades().size(), expected_book.get_trade_log().get_trades().size())
+            << "Restored book should have printed the same trades." << std::endl;
+        EXPECT_EQ(restored.get_market_engine().get_strategy().get_active_buy_order_id(), expected.get_market_engine().get_strategy().get_active_buy_order_id())
+            << "Restored strategy should quote the same bid." << std::endl;
+        EXPECT_EQ(restored.get_market_engine().get_strategy().get_active_sell_order_id(), expected.get_market_engine().get_strategy().get_active_sell_order_id())
+            << "Restored strategy should quote the same ask." << std::endl;
+    }
+}
+
+/**
+    ============================================================
+    TEST 1: ResumesBitIdenticallyFromAFile
+    ============================================================
+    PURPOSE: Verify a simulation checkpointed to a file and loaded into another engine, built with different parameters, continues
+             exactly like the original: same series, same book, same strategy orders and the same ids handed out
+    ============================================================
+*/
+TEST(CheckpointTest, ResumesBitIdenticallyFromAFile) {
+    const std::string path = "test_checkpoint_resume.bin";
+    SimulationEngine original(1, 400001, 100);
+    original.run_until(200001);
+    original.save_checkpoint(path);
+
+    original.run_until(400001);
+    long long next_id = IdGenerator::peekNext(), next_trade_id = IdGenerator::peekNextTrade();
+
+    SimulationEngine restored(5, 10, 1, 3, 4);
+    restored.load_checkpoint(path);
+    std::remove(path.c_str());
+    EXPECT_EQ(restored.get_current_timestamp_us(), 200001) << "Restored run should start where the checkpoint was taken." << std::endl;
+
+    restored.run_until(400001);
+    expect_same_simulation(original, restored);
+    EXPECT_EQ(IdGenerator::peekNext(), next_id) << "Restored run should hand out the same order ids." << std::endl;
+    EXPECT_EQ(IdGenerator::peekNextTrade(), next_trade_id) << "Restored run should hand out the same trade ids." << std::endl;
+    EXPECT_GT(original.get_market_engine().get_metrics().gross_traded_qty, 0) << "The strategy should have traded for the test to mean something." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 2: ResumesEveryComponentBitIdentically
+    ============================================================
+    PURPOSE: Verify the checkpoint carries the background flow (Hawkes population included) and a price process in the middle of a block,
+             so a run filling the strategy in the book against that flow still continues exactly from memory
+    ============================================================
+*/
+TEST(CheckpointTest, ResumesEveryComponentBitIdentically) {
+    SimulationEngine original(1, 300001, 100, 5, 1, 50, 1, 1000);
+    MarketEngine& engine = original.get_market_engine();
+    engine.set_price_process(std::make_unique<JumpDiffusionProcess>(10000, 0, 2e-4, 0.01, 0, 2e-3, 3), 64);
+    engine.set_fill_model(MarketEngine::FillModel::ORDER_BOOK);
+    engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::noise_traders(2000));
+    engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::market_makers(500));
+    engine.get_background_flow().add_hawkes_population(HawkesProcess::Parameters::uniform(200, 300, 50, 2000));
+
+    original.run_until(150001);
+    CheckpointWriter writer;
+    original.save_state(writer);
+    std::vector<char> checkpoint = writer.get_buffer();
+
+    original.run_until(300001);
+    long long next_id = IdGenerator::peekNext();
+
+    SimulationEngine restored(1, 2, 1);
+    CheckpointReader reader(checkpoint);
+    restored.load_state(reader);
+    restored.run_until(300001);
+
+    expect_same_simulation(original, restored);
+    EXPECT_EQ(IdGenerator::peekNext(), next_id) << "Restored run should hand out the same order ids." << std::endl;
+    EXPECT_EQ(restored.get_market_engine().get_background_flow().get_num_commands_sent(), engine.get_background_flow().get_num_commands_sent())
+        << "Restored background flow should send the same commands." << std::endl;
+    EXPECT_EQ(restored.get_market_engine().get_price_process()->get_kind(), PriceProcess::Kind::JUMP_DIFFUSION) << "Price process should be restored with its kind." << std::endl;
+    EXPECT_GT(engine.get_orderbook().get_order_lookup().size(), 0) << "The background flow should have left orders resting." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 3: RestoredBookKeepsItsLookups
+    ============================================================
+    PURPOSE: Verify a restored book can cancel, match and trigger its restored orders by their saved ids, stops and all-or-none
+             orders included, and that its top of book is published once, as a single mutation
+    ============================================================
+*/
+TEST(CheckpointTest, RestoredBookKeepsItsLookups) {
+    Metrics metrics;
+    OrderBook book(metrics);
+    long long bid_id = book.add_limit_order(true, 99, 10, 1);
+    book.add_iceberg_order(true, 98, 30, 10, 2);
+    long long ask_id = book.add_limit_order(false, 101, 5, 3);
+    long long stop_id = book.add_stop_order(false, 98, -1, 4, 4);
+    long long aon_id = book.add_AON_order(false, 102, 50, 5);
+
+    CheckpointWriter writer;
+    book.save_state(writer);
+
+    Metrics restored_metrics;
+    OrderBook restored(restored_metrics);
+    restored.add_limit_order(true, 50, 1, 1);
+    std::vector<BestBidOffer> bbo_events;
+    restored.subscribe_bbo([&bbo_events](const BestBidOffer& bbo) { bbo_events.push_back(bbo); });
+    CheckpointReader reader(writer.get_buffer());
+    restored.load_state(reader);
+
+    EXPECT_TRUE(reader.at_end()) << "The whole book should have been read back." << std::endl;
+    EXPECT_EQ(restored.get_bbo().bidPriceTick, 99) << "Restored book should publish its best bid." << std::endl;
+    ASSERT_EQ(bbo_events.size(), 1) << "Restore should publish the top of book once, never the cleared book." << std::endl;
+    EXPECT_EQ(bbo_events[0].bidPriceTick, 99) << "The one update should carry the restored best bid." << std::endl;
+    EXPECT_EQ(restored.load_depth_snapshot().numBids, 2) << "Restored book should publish its depth." << std::endl;
+    EXPECT_EQ(restored.get_buys().at(98).hidden_quantity, 20) << "Iceberg reserve should be restored with its level." << std::endl;
+    EXPECT_TRUE(restored.is_live(stop_id)) << "Stop should be restored under its id." << std::endl;
+    EXPECT_TRUE(restored.is_live(aon_id)) << "All-or-none order should be restored under its id." << std::endl;
+
+    EXPECT_EQ(restored.cancel_order(ask_id), 0) << "Restored ask should be cancellable by its saved id." << std::endl;
+    restored.add_limit_order(false, 95, 15, 6);
+    EXPECT_FALSE(restored.is_live(bid_id)) << "Restored bid should have been matched." << std::endl;
+    EXPECT_FALSE(restored.is_live(stop_id)) << "Restored stop should trigger on the trade through its price." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 4: RejectsWhatItCannotRestore
+    ============================================================
+    PURPOSE: Verify a truncated checkpoint or another file is refused, and that a latency queue holding opaque callbacks refuses to be saved
+    ============================================================
+*/
+TEST(CheckpointTest, RejectsWhatItCannotRestore) {
+    SimulationEngine simulation(1, 10001, 100);
+    simulation.run_until(5001);
+    CheckpointWriter writer;
+    simulation.save_state(writer);
+
+    std::vector<char> truncated(writer.get_buffer().begin(), writer.get_buffer().end() - 8);
+    CheckpointReader truncated_reader(truncated);
+    EXPECT_THROW(simulation.load_state(truncated_reader), std::runtime_error);
+
+    std::vector<char> other = writer.get_buffer();
+    other[0] = 'X';
+    CheckpointReader other_reader(other);
+    EXPECT_THROW(simulation.load_state(other_reader), std::runtime_error);
+
+    LatencyQueue latency_queue;
+    latency_queue.schedule_event(0, LatencyQueue::ActionType::ORDER_SEND, [](long long) {});
+    CheckpointWriter queue_writer;
+    EXPECT_THROW(latency_queue.save_state(queue_writer), std::runtime_error);
+}
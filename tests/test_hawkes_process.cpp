@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "../include/HawkesProcess.h"
+
+namespace {
+    HawkesProcess::Parameters clustered_parameters() {
+        // Market orders excite themselves and the limits that refill the book, cancels follow the limits
+        HawkesProcess::Parameters parameters = HawkesProcess::Parameters::uniform(1000, 0, 0, 500);
+        parameters.decayPerSecond = {400, 400, 800, 800, 1500, 1500};
+        parameters.excitationPerSecond[HawkesProcess::BUY_MARKET][HawkesProcess::BUY_MARKET] = 150;
+        parameters.excitationPerSecond[HawkesProcess::SELL_MARKET][HawkesProcess::SELL_MARKET] = 150;
+        parameters.excitationPerSecond[HawkesProcess::BUY_LIMIT][HawkesProcess::SELL_MARKET] = 200;
+        parameters.excitationPerSecond[HawkesProcess::SELL_LIMIT][HawkesProcess::BUY_MARKET] = 200;
+        parameters.excitationPerSecond[HawkesProcess::BUY_CANCEL][HawkesProcess::BUY_LIMIT] = 500;
+        parameters.excitationPerSecond[HawkesProcess::SELL_CANCEL][HawkesProcess::SELL_LIMIT] = 500;
+        return parameters;
+    }
+}
+
+/**
+    ============================================================
+    TEST 1: WithoutExcitationIsPoisson
+    ============================================================
+    PURPOSE: Verify that with no excitation the process is a Poisson process: the count over a horizon matches the baselines, marks follow
+             their baseline shares and no candidate is ever thinned out
+    ============================================================
+*/
+TEST(HawkesProcessTest, WithoutExcitationIsPoisson) {
+    HawkesProcess::Parameters parameters = HawkesProcess::Parameters::uniform(10000, 0, 0, 100);
+    parameters.baselinePerSecond[HawkesProcess::BUY_LIMIT] = 40000;
+    HawkesProcess process(parameters);
+
+    std::vector<HawkesProcess::Event> events(200000);
+    std::size_t num_events = process.generate_until(1e6, events.data(), events.size());
+
+    // 90000 expected in one second, the standard deviation is 300
+    EXPECT_NEAR((double)num_events, 90000, 1500);
+    EXPECT_EQ(process.get_num_candidates(), num_events + 1)
+        << "Constant intensities should accept every candidate, the one past the end included.";
+
+    std::size_t num_buy_limits = 0;
+    for (std::size_t i = 0; i < num_events; i++) {
+        EXPECT_LT(events[i].timestampUs, 1e6);
+        if (i > 0) {
+            ASSERT_GE(events[i].timestampUs, events[i - 1].timestampUs);
+        }
+        num_buy_limits += events[i].mark == HawkesProcess::BUY_LIMIT;
+    }
+    EXPECT_NEAR((double)num_buy_limits / num_events, 4.0 / 9.0, 0.01);
+}
+
+/**
+    ============================================================
+    TEST 2: RecursiveIntensityMatchesHistory
+    ============================================================
+    PURPOSE: Verify the in-place intensities equal the intensities summed over the whole history, baseline plus every past event's decayed kernel
+    ============================================================
+*/
+TEST(HawkesProcessTest, RecursiveIntensityMatchesHistory) {
+    HawkesProcess::Parameters parameters = clustered_parameters();
+    HawkesProcess process(parameters, 0, 3);
+
+    std::vector<HawkesProcess::Event> events(5000);
+    process.generate(events.data(), events.size());
+    double now = events.back().timestampUs;
+    EXPECT_DOUBLE_EQ(process.get_current_time_us(), now);
+
+    for (int i = 0; i < HawkesProcess::NUM_MARKS; i++) {
+        double expected = parameters.baselinePerSecond[i];
+        for (const HawkesProcess::Event& event : events) {
+            expected += parameters.excitationPerSecond[i][event.mark] * std::exp(-parameters.decayPerSecond[i] * (now - event.timestampUs) / 1e6);
+        }
+        EXPECT_NEAR(process.intensity((HawkesProcess::Mark)i), expected, 1e-6 * expected)
+            << "Intensity of mark " << i << " drifted from its history.";
+    }
+}
+
+/**
+    ============================================================
+    TEST 3: LongRunRatesAndClustering
+    ============================================================
+    PURPOSE: Verify the long run rate of each mark matches the stationary rates, and that counts over short windows are overdispersed
+             compared to a Poisson process of the same rate, which is the clustering excitation adds
+    ============================================================
+*/
+TEST(HawkesProcessTest, LongRunRatesAndClustering) {
+    HawkesProcess::Parameters parameters = clustered_parameters();
+    std::array<double, HawkesProcess::NUM_MARKS> rates = HawkesProcess::stationary_rates(parameters);
+    HawkesProcess process(parameters, 0, 11);
+
+    const double horizon_us = 50e6;
+    const double window_us = 10000;
+    std::array<std::size_t, HawkesProcess::NUM_MARKS> counts{};
+    std::vector<double> window_counts((std::size_t)(horizon_us / window_us), 0);
+
+    HawkesProcess::Event event = process.next();
+    while (event.timestampUs < horizon_us) {
+        counts[event.mark]++;
+        window_counts[(std::size_t)(event.timestampUs / window_us)]++;
+        event = process.next();
+    }
+
+    for (int i = 0; i < HawkesProcess::NUM_MARKS; i++) {
+        double rate = counts[i] / (horizon_us / 1e6);
+        EXPECT_NEAR(rate, rates[i], 0.05 * rates[i])
+            << "Mark " << i << " ran at " << rate << "/s, the stationary rate is " << rates[i] << "/s.";
+        EXPECT_GT(rates[i], parameters.baselinePerSecond[i])
+            << "Excitation should add to every mark's rate.";
+    }
+
+    double mean = 0, variance = 0;
+    for (double count : window_counts) {
+        mean += count;
+    }
+    mean /= window_counts.size();
+    for (double count : window_counts) {
+        variance += (count - mean) * (count - mean);
+    }
+    variance /= window_counts.size();
+    EXPECT_GT(variance / mean, 1.5)
+        << "Counts should be overdispersed, Poisson would give 1. Variance over mean: " << variance / mean << ".";
+}
+
+/**
+    ============================================================
+    TEST 4: RejectsExplosiveParameters
+    ============================================================
+    PURPOSE: Verify parameters whose branching ratio reaches 1 are refused, and the branching ratio is the spectral radius of excitation over decay
+    ============================================================
+*/
+TEST(HawkesProcessTest, RejectsExplosiveParameters) {
+    HawkesProcess::Parameters parameters = HawkesProcess::Parameters::uniform(1000, 100, 10, 500);
+    EXPECT_NEAR(HawkesProcess::branching_ratio(parameters), (100 + 5 * 10) / 500.0, 1e-9);
+    EXPECT_NO_THROW(HawkesProcess process(parameters));
+
+    parameters = HawkesProcess::Parameters::uniform(1000, 300, 50, 500);
+    EXPECT_THROW(HawkesProcess process(parameters), std::runtime_error)
+        << "A branching ratio of 1.1 should be refused.";
+
+    parameters = HawkesProcess::Parameters::uniform(1000, 0, 0, 0);
+    EXPECT_THROW(HawkesProcess process(parameters), std::runtime_error)
+        << "Decays have to be positive.";
+}
+
+/**
+    ============================================================
+    TEST 5: GenerateUntilKeepsTheEventPastTheEnd
+    ============================================================
+    PURPOSE: Verify windows drawn with generate_until chain into the same sequence as drawing event by event
+    ============================================================
+*/
+TEST(HawkesProcessTest, GenerateUntilKeepsTheEventPastTheEnd) {
+    HawkesProcess windowed(clustered_parameters(), 0, 5);
+    HawkesProcess single(clustered_parameters(), 0, 5);
+
+    std::vector<HawkesProcess::Event> events(100000);
+    std::vector<HawkesProcess::Event> all_events;
+    for (double end = 1000; end <= 200000; end += 1000) {
+        std::size_t num_events = windowed.generate_until(end, events.data(), events.size());
+        all_events.insert(all_events.end(), events.begin(), events.begin() + num_events);
+    }
+
+    ASSERT_GT(all_events.size(), 100);
+    for (const HawkesProcess::Event& event : all_events) {
+        HawkesProcess::Event expected = single.next();
+        ASSERT_EQ(event.timestampUs, expected.timestampUs);
+        ASSERT_EQ(event.mark, expected.mark);
+    }
+}
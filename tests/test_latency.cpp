@@ -1,9 +1,35 @@
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <iostream>
 #include <list>
+#include <sstream>
+#include <stdexcept>
 #include <stack>
+#include <string>
+#include <vector>
 #include "../include/LatencyQueue.h"
 
+namespace {
+    // Records the typed events it is handed, one overload per payload type
+    struct RecordingVisitor {
+        std::vector<LatencyQueue::ActionType> types;
+        std::vector<long long> exec_times;
+        long long pong_price_tick = 0;
+        long long market_price_ticks = 0;
+        long long filled_order_id = 0;
+
+        void record(LatencyQueue::ActionType type, long long exec_time) {
+            types.push_back(type);
+            exec_times.push_back(exec_time);
+        }
+        void operator()(const LatencyQueue::OrderSend& order, long long exec_time) { pong_price_tick = order.priceTick; record(LatencyQueue::ORDER_SEND, exec_time); }
+        void operator()(const LatencyQueue::Cancel&, long long exec_time) { record(LatencyQueue::CANCEL, exec_time); }
+        void operator()(const LatencyQueue::Modify&, long long exec_time) { record(LatencyQueue::MODIFY, exec_time); }
+        void operator()(const LatencyQueue::AcknowledgeFill& fill, long long exec_time) { filled_order_id = fill.orderId; record(LatencyQueue::ACKNOWLEDGE_FILL, exec_time); }
+        void operator()(const LatencyQueue::MarketUpdate& update, long long exec_time) { market_price_ticks = update.marketPriceTicks; record(LatencyQueue::MARKET_UPDATE, exec_time); }
+    };
+}
+
 /**
     ============================================================
     TEST 1: DefaultInitialization
@@ -343,4 +369,271 @@ TEST(LatencyQueueTest, IsEmptyWorks) {
         << "Latency queue should be empty after processing all 5 events.";
     EXPECT_EQ(latency_queue.get_event_queue().size(), 0)
         << "Event queue should have 0 events after processing all 5 events.";
+}
+
+/**
+    ============================================================
+    TEST 8: TypedEventsReachTheirOverload
+    ============================================================
+    PURPOSE: Verify every typed event is handed, payload intact and in time order, to the visitor overload of its type, is delayed by
+             the latency of its type and is counted by type, callbacks included
+    ============================================================
+*/
+TEST(LatencyQueueTest, TypedEventsReachTheirOverload) {
+    LatencyQueue latency_queue;
+    latency_queue.reset_latency_profile(10, 10, 20, 20, 30, 30, 40, 40, 50, 50);
+
+    latency_queue.schedule_event(1000, LatencyQueue::MarketUpdate{10050});
+    latency_queue.schedule_event(1000, LatencyQueue::AcknowledgeFill{true, false, false, 5, 42, 10000});
+    latency_queue.schedule_event(1000, LatencyQueue::Modify{42, 3});
+    latency_queue.schedule_event(1000, LatencyQueue::Cancel{42});
+    latency_queue.schedule_event(1000, LatencyQueue::OrderSend{false, true, 5, 10001});
+    bool callback_fired = false;
+    latency_queue.schedule_event(1000, LatencyQueue::ActionType::MARKET_UPDATE, [&callback_fired](long long) { callback_fired = true; });
+
+    EXPECT_EQ(latency_queue.get_num_pending(LatencyQueue::MARKET_UPDATE), 2) << "Market update and callback should both be pending as market updates." << std::endl;
+
+    RecordingVisitor visitor;
+    latency_queue.process_until(2000, visitor);
+
+    std::vector<LatencyQueue::ActionType> expected_types = {LatencyQueue::ORDER_SEND, LatencyQueue::CANCEL, LatencyQueue::MODIFY,
+                                                            LatencyQueue::ACKNOWLEDGE_FILL, LatencyQueue::MARKET_UPDATE};
+    EXPECT_EQ(visitor.types, expected_types) << "Typed events should fire in the order of their latencies." << std::endl;
+    EXPECT_EQ(visitor.exec_times, std::vector<long long>({1010, 1020, 1030, 1040, 1050})) << "Each event should be delayed by the latency of its type." << std::endl;
+    EXPECT_EQ(visitor.pong_price_tick, 10001) << "Order send payload should arrive intact." << std::endl;
+    EXPECT_EQ(visitor.filled_order_id, 42) << "Fill payload should arrive intact." << std::endl;
+    EXPECT_EQ(visitor.market_price_ticks, 10050) << "Market update payload should arrive intact." << std::endl;
+    EXPECT_TRUE(callback_fired) << "Callbacks should still be called directly." << std::endl;
+
+    EXPECT_EQ(latency_queue.get_num_scheduled(LatencyQueue::MARKET_UPDATE), 2) << "Market updates scheduled should count the callback." << std::endl;
+    EXPECT_EQ(latency_queue.get_num_fired(LatencyQueue::ORDER_SEND), 1) << "One order send should have fired." << std::endl;
+    EXPECT_EQ(latency_queue.get_num_pending(LatencyQueue::MARKET_UPDATE), 0) << "No market update should be left pending." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 9: SnapshotAndDumpListPendingEvents
+    ============================================================
+    PURPOSE: Verify a snapshot lists the pending events in firing order without firing them, the dump prints one line per event, and
+             pending events and counters survive a checkpoint
+    ============================================================
+*/
+TEST(LatencyQueueTest, SnapshotAndDumpListPendingEvents) {
+    LatencyQueue latency_queue;
+    for (int i = 0; i < 20; i++) {
+        latency_queue.schedule_event(1000 + i * 7, LatencyQueue::OrderSend{i % 2 == 0, false, 0, 0});
+        latency_queue.schedule_event(1000 + i * 7, LatencyQueue::MarketUpdate{10000 + i});
+    }
+
+    std::vector<LatencyQueue::Event> snapshot = latency_queue.snapshot();
+    ASSERT_EQ(snapshot.size(), 40) << "Snapshot should hold every pending event." << std::endl;
+    for (std::size_t i = 1; i < snapshot.size(); i++) {
+        EXPECT_LE(snapshot[i - 1].time_to_execute, snapshot[i].time_to_execute) << "Snapshot should come in firing order." << std::endl;
+    }
+    EXPECT_EQ(latency_queue.get_event_queue().size(), 40) << "Taking a snapshot should not fire anything." << std::endl;
+
+    std::ostringstream dump;
+    latency_queue.dump(dump);
+    std::string lines = dump.str();
+    std::string first_line = lines.substr(0, lines.find('\n'));
+    EXPECT_EQ(std::count(lines.begin(), lines.end(), '\n'), 40) << "Dump should print one line per event." << std::endl;
+    EXPECT_EQ(first_line.find(std::to_string(snapshot[0].time_to_execute) + " "), 0) << "Dump should start with the first event to fire." << std::endl;
+    EXPECT_NE(lines.find("MARKET_UPDATE market 10019"), std::string::npos) << "Dump should print the payload fields." << std::endl;
+
+    CheckpointWriter writer;
+    latency_queue.save_state(writer);
+    LatencyQueue restored;
+    CheckpointReader reader(writer.get_buffer());
+    restored.load_state(reader);
+
+    std::vector<LatencyQueue::Event> restored_snapshot = restored.snapshot();
+    ASSERT_EQ(restored_snapshot.size(), snapshot.size()) << "Restored queue should hold the same events." << std::endl;
+    for (std::size_t i = 0; i < snapshot.size(); i++) {
+        EXPECT_EQ(restored_snapshot[i].time_to_execute, snapshot[i].time_to_execute) << "Restored events should fire at the same times." << std::endl;
+        EXPECT_EQ(restored_snapshot[i].payload.index(), snapshot[i].payload.index()) << "Restored events should keep their types." << std::endl;
+    }
+    EXPECT_EQ(restored.get_num_pending(LatencyQueue::ORDER_SEND), 20) << "Restored queue should keep its counters." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 10: HandlesCancelAndRescheduleEvents
+    ============================================================
+    PURPOSE: Verify a handle cancels or moves its event and nothing else, stale handles are ignored, heavy cancelling does not grow the
+             heap, and handles still name their events after a checkpoint
+    ============================================================
+*/
+TEST(LatencyQueueTest, HandlesCancelAndRescheduleEvents) {
+    LatencyQueue latency_queue;
+    latency_queue.reset_latency_profile(10, 10, 20, 20, 30, 30, 40, 40, 50, 50);
+
+    LatencyQueue::EventHandle cancelled = latency_queue.schedule_event(1000, LatencyQueue::Cancel{1});
+    LatencyQueue::EventHandle moved = latency_queue.schedule_event(1000, LatencyQueue::Cancel{2});
+    latency_queue.schedule_event(1000, LatencyQueue::Cancel{3});
+
+    EXPECT_TRUE(latency_queue.cancel_event(cancelled)) << "Pending event should be cancelled." << std::endl;
+    EXPECT_FALSE(latency_queue.cancel_event(cancelled)) << "Cancelling twice should do nothing." << std::endl;
+    EXPECT_FALSE(latency_queue.cancel_event(LatencyQueue::EventHandle())) << "An empty handle should cancel nothing." << std::endl;
+    LatencyQueue::EventHandle reused = latency_queue.schedule_event(1000, LatencyQueue::Cancel{4});
+    EXPECT_FALSE(latency_queue.is_pending(cancelled)) << "Stale handle should not name the event reusing its slot." << std::endl;
+    EXPECT_TRUE(latency_queue.is_pending(reused)) << "New event should be pending." << std::endl;
+
+    LatencyQueue::EventHandle moved_again = latency_queue.reschedule_event(moved, 900);
+    EXPECT_FALSE(latency_queue.is_pending(moved)) << "Rescheduled event should drop its old handle." << std::endl;
+    EXPECT_TRUE(latency_queue.is_pending(moved_again)) << "Rescheduled event should be named by its new handle." << std::endl;
+    EXPECT_EQ(latency_queue.get_num_pending_events(), 3) << "Three events should be pending." << std::endl;
+
+    CheckpointWriter writer;
+    latency_queue.save_state(writer);
+    LatencyQueue restored;
+    CheckpointReader reader(writer.get_buffer());
+    restored.load_state(reader);
+    EXPECT_TRUE(restored.cancel_event(reused)) << "Handles should still name their events after a checkpoint." << std::endl;
+
+    std::vector<long long> cancelled_ids;
+    std::vector<long long> exec_times;
+    restored.process_until(2000, [&](const auto& event, long long exec_time) {
+        if constexpr (std::is_same<std::decay_t<decltype(event)>, LatencyQueue::Cancel>::value) {
+            cancelled_ids.push_back(event.orderId);
+            exec_times.push_back(exec_time);
+        }
+    });
+    EXPECT_EQ(cancelled_ids, std::vector<long long>({2, 3})) << "Only the live events should fire, the moved one first." << std::endl;
+    EXPECT_EQ(exec_times, std::vector<long long>({900, 1020})) << "Moved event should fire at its new time." << std::endl;
+    EXPECT_EQ(restored.get_num_cancelled(LatencyQueue::CANCEL), 2) << "Both cancellations should be counted." << std::endl;
+    EXPECT_TRUE(restored.is_empty()) << "Queue should be empty once the live events fired." << std::endl;
+
+    for (int i = 0; i < 10000; i++) {
+        LatencyQueue::EventHandle requote = latency_queue.schedule_event(2000 + i, LatencyQueue::Cancel{-1});
+        latency_queue.cancel_event(requote);
+    }
+    EXPECT_LE(latency_queue.get_heap_size(), 128) << "Cancelled events should not pile up in the heap." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 11: SessionModelDeliversEachChannelInOrder
+    ============================================================
+    PURPOSE: Verify independent latencies let a later order entry event overtake an earlier one, while under the SESSION model every
+             channel delivers in the order it was sent, equal delivery times included
+    ============================================================
+*/
+TEST(LatencyQueueTest, SessionModelDeliversEachChannelInOrder) {
+    auto count_overtakes = [](LatencyQueue& latency_queue) {
+        for (int i = 0; i < 2000; i++) {
+            latency_queue.schedule_event(1000 + i, LatencyQueue::Cancel{i});
+            latency_queue.schedule_event(1000 + i, LatencyQueue::MarketUpdate{i});
+        }
+        int overtakes = 0;
+        long long last_cancel = -1, last_market = -1;
+        latency_queue.process_until(100000, [&](const auto& event, long long) {
+            using P = std::decay_t<decltype(event)>;
+            if constexpr (std::is_same<P, LatencyQueue::Cancel>::value) {
+                overtakes += event.orderId < last_cancel;
+                last_cancel = std::max(last_cancel, event.orderId);
+            }
+            else if constexpr (std::is_same<P, LatencyQueue::MarketUpdate>::value) {
+                overtakes += event.marketPriceTicks < last_market;
+                last_market = std::max(last_market, event.marketPriceTicks);
+            }
+        });
+        return overtakes;
+    };
+
+    LatencyQueue independent;
+    EXPECT_GT(count_overtakes(independent), 0) << "Independent latencies should let later events overtake earlier ones." << std::endl;
+
+    LatencyQueue session;
+    session.set_latency_model(LatencyQueue::LatencyModel::SESSION);
+    session.set_session_congestion(2000, 300, 500);
+    EXPECT_EQ(count_overtakes(session), 0) << "No event should overtake an earlier one of its channel." << std::endl;
+    EXPECT_EQ(LatencyQueue::channel_of(LatencyQueue::MODIFY), LatencyQueue::ORDER_ENTRY) << "Modifies should share the order entry session." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 12: SessionCongestionSpikesAndDecays
+    ============================================================
+    PURPOSE: Verify congestion spikes delay events beyond their latency boundaries, decay away once the channel is quiet, and that
+             invalid congestion settings are refused
+    ============================================================
+*/
+TEST(LatencyQueueTest, SessionCongestionSpikesAndDecays) {
+    LatencyQueue latency_queue;
+    latency_queue.reset_latency_profile(100, 100, 100, 100, 100, 100, 100, 100, 100, 100);
+    latency_queue.set_latency_model(LatencyQueue::LatencyModel::SESSION);
+    latency_queue.set_session_congestion(5000, 200, 1000);
+
+    long long max_latency = 0;
+    double peak_congestion = 0;
+    for (int i = 0; i < 5000; i++) {
+        long long sent_us = 1000 + i * 10;
+        LatencyQueue::EventHandle handle = latency_queue.schedule_event(sent_us, LatencyQueue::OrderSend{true, false, 0, 0});
+        max_latency = std::max(max_latency, latency_queue.snapshot().back().time_to_execute - sent_us);
+        peak_congestion = std::max(peak_congestion, latency_queue.get_channel_congestion_us(LatencyQueue::ORDER_ENTRY));
+        latency_queue.cancel_event(handle);
+    }
+    EXPECT_GT(max_latency, 100) << "Congestion should delay events beyond their latency boundaries." << std::endl;
+    EXPECT_GT(peak_congestion, 200) << "Spikes sent close together should pile up. Peak: " << peak_congestion << std::endl;
+
+    latency_queue.set_session_congestion(1e-9, 200, 1000);
+    latency_queue.schedule_event(1000 + 5000 * 10 + 100000, LatencyQueue::OrderSend{true, false, 0, 0});
+    EXPECT_LT(latency_queue.get_channel_congestion_us(LatencyQueue::ORDER_ENTRY), 1) << "Congestion should decay once the channel is quiet." << std::endl;
+
+    EXPECT_THROW(latency_queue.set_session_congestion(-1, 200, 1000), std::runtime_error);
+    EXPECT_THROW(latency_queue.set_session_congestion(100, 200, 0), std::runtime_error);
+}
+
+/**
+    ============================================================
+    TEST 13: EachChannelHasItsOwnModel
+    ============================================================
+    PURPOSE: Verify a channel can run the session model while the others stay independent, their events still firing in one time
+             order, and that visitors taking the send time get it, kept across a reschedule
+    ============================================================
+*/
+TEST(LatencyQueueTest, EachChannelHasItsOwnModel) {
+    LatencyQueue latency_queue;
+    latency_queue.set_latency_model(LatencyQueue::EXECUTION_REPORTS, LatencyQueue::LatencyModel::SESSION);
+    latency_queue.set_session_congestion(LatencyQueue::EXECUTION_REPORTS, 1000, 300, 500);
+    EXPECT_EQ(latency_queue.get_latency_model(LatencyQueue::EXECUTION_REPORTS), LatencyQueue::LatencyModel::SESSION) << "Acknowledgements should run the session model." << std::endl;
+    EXPECT_EQ(latency_queue.get_latency_model(LatencyQueue::ORDER_ENTRY), LatencyQueue::LatencyModel::INDEPENDENT) << "Order entry should keep its own model." << std::endl;
+    EXPECT_EQ(latency_queue.get_session_congestion(LatencyQueue::MARKET_DATA).spikesPerSecond, 0) << "Market data should keep its own congestion." << std::endl;
+
+    for (int i = 0; i < 1000; i++) {
+        latency_queue.schedule_event(1000 + i, LatencyQueue::AcknowledgeFill{true, false, false, 1, i, 100});
+        latency_queue.schedule_event(1000 + i, LatencyQueue::Cancel{i});
+    }
+    LatencyQueue::EventHandle late = latency_queue.schedule_event(1500, LatencyQueue::MarketUpdate{1});
+    latency_queue.reschedule_event(late, 50000);
+
+    int ack_overtakes = 0, cancel_overtakes = 0;
+    long long last_ack = -1, last_cancel = -1, last_time = 0;
+    bool in_time_order = true, sent_before_fired = true;
+    long long late_sent_us = -1;
+    latency_queue.process_until(100000, [&](const auto& event, long long time, long long sent_us) {
+        using P = std::decay_t<decltype(event)>;
+        in_time_order &= time >= last_time;
+        sent_before_fired &= sent_us <= time;
+        last_time = time;
+        if constexpr (std::is_same<P, LatencyQueue::AcknowledgeFill>::value) {
+            ack_overtakes += event.orderId < last_ack;
+            last_ack = std::max(last_ack, event.orderId);
+        }
+        else if constexpr (std::is_same<P, LatencyQueue::Cancel>::value) {
+            cancel_overtakes += event.orderId < last_cancel;
+            last_cancel = std::max(last_cancel, event.orderId);
+        }
+        else if constexpr (std::is_same<P, LatencyQueue::MarketUpdate>::value) {
+            late_sent_us = sent_us;
+        }
+    });
+
+    EXPECT_TRUE(in_time_order) << "Every channel's events should fire in one time order." << std::endl;
+    EXPECT_EQ(ack_overtakes, 0) << "Acknowledgements should arrive in order on their session." << std::endl;
+    EXPECT_GT(cancel_overtakes, 0) << "Independent cancels should still overtake each other." << std::endl;
+    EXPECT_TRUE(sent_before_fired) << "No event should fire before it was sent." << std::endl;
+    EXPECT_EQ(late_sent_us, 1500) << "A rescheduled event should keep the time it was sent." << std::endl;
+    EXPECT_EQ(LatencyQueue::channel_of<LatencyQueue::AcknowledgeFill>(), LatencyQueue::channel_of(LatencyQueue::ACKNOWLEDGE_FILL))
+        << "Typed and runtime channel lookups should agree." << std::endl;
 }
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+#include <cmath>
+#include <memory>
+#include <string>
 #include "../include/MarketEngine.h"
 
 /**
@@ -149,3 +152,151 @@ TEST(MarketEngineTest, MarketPriceAndSpreadStableWithZeroVolatility) {
     EXPECT_EQ(marketengine.get_spread(), 2)
         << "Spread should not have changed. Current spread: " << marketengine.get_spread() << "." << std::endl;
 }
+
+/**
+============================================================
+TEST 6: QueuePositionFillsWaitForTheQueue
+============================================================
+PURPOSE: With the QUEUE_POSITION fill model, verify the strategy's quotes at the touch are tracked behind the synthetic queue and do not fill while it is deep,
+         and do fill once there is no queue ahead of them.
+============================================================
+*/
+TEST(MarketEngineTest, QueuePositionFillsWaitForTheQueue) {
+    MarketEngine deep_queue(100, 1, 1000, 3, 0, 1000, 2, 0.0, 0.3);
+    deep_queue.set_fill_model(MarketEngine::FillModel::QUEUE_POSITION);
+    // The first market update has to reach the strategy before its quotes go out, for them to be priced at the touch
+    deep_queue.get_strategy().get_latency_queue().reset_latency_profile(200, 200, 100, 100, 100, 100, 100, 100, 50, 50);
+    deep_queue.set_queue_flow(1000000000, 100, 0);
+    deep_queue.update(1000);
+    deep_queue.execute_events_until(3000);
+    for (long long timestamp = 4000; timestamp <= 50000; timestamp += 1000) {
+        deep_queue.update(timestamp);
+    }
+    EXPECT_EQ(deep_queue.get_queue_model().size(), 2)
+        << "Both quotes should be tracked. Tracked orders: " << deep_queue.get_queue_model().size() << "." << std::endl;
+    EXPECT_EQ(deep_queue.get_strategy().get_current_inventory(), 0)
+        << "No quote should fill behind a deep queue. Current inventory: " << deep_queue.get_strategy().get_current_inventory() << "." << std::endl;
+    EXPECT_EQ(deep_queue.get_strategy().get_metrics().gross_traded_qty, 0)
+        << "Nothing should have traded. Traded quantity: " << deep_queue.get_strategy().get_metrics().gross_traded_qty << "." << std::endl;
+
+    MarketEngine empty_queue(100, 1, 1000, 3, 0, 1000, 2, 0.0, 0.3);
+    empty_queue.set_fill_model(MarketEngine::FillModel::QUEUE_POSITION);
+    // The first market update has to reach the strategy before its quotes go out, for them to be priced at the touch
+    empty_queue.get_strategy().get_latency_queue().reset_latency_profile(200, 200, 100, 100, 100, 100, 100, 100, 50, 50);
+    empty_queue.set_queue_flow(0, 1000, 0);
+    empty_queue.update(1000);
+    empty_queue.execute_events_until(3000);
+    empty_queue.update(4000);
+    // Fill acknowledgements are processed, the pongs they send are not out yet
+    empty_queue.execute_events_until(4200);
+    EXPECT_GT(empty_queue.get_strategy().get_metrics().gross_traded_qty, 0)
+        << "Quotes with no queue ahead of them should have been filled." << std::endl;
+}
+
+/**
+============================================================
+TEST 7: PriceProcessDrivesTheMarketPrice
+============================================================
+PURPOSE: Verify that with a price process set, each update takes the next step of the process as the market price, across the blocks the
+         engine generates, and derives the spread from the step's volatility.
+============================================================
+*/
+TEST(MarketEngineTest, PriceProcessDrivesTheMarketPrice) {
+    MarketEngine marketengine(100, 2, 1000, 3, 500000, 10000, 2, 1.0, 0.3);
+    marketengine.set_price_process(std::make_unique<OrnsteinUhlenbeckProcess>(10000, 10000, 0.05, 3.0, 11), 16);
+
+    OrnsteinUhlenbeckProcess reference(10000, 10000, 0.05, 3.0, 11);
+    std::vector<double> prices(100), volatilities(100);
+    reference.generate(prices.data(), volatilities.data(), prices.size());
+
+    for (std::size_t i = 0; i < prices.size(); i++) {
+        marketengine.update(1000 * (i + 1));
+        ASSERT_EQ(marketengine.get_market_price_ticks(), std::llround(prices[i]))
+            << "Market price of update " << i << " should be the process's step." << std::endl;
+    }
+    EXPECT_DOUBLE_EQ(marketengine.get_volatility(), volatilities.back())
+        << "Volatility should be the process's. Current volatility: " << marketengine.get_volatility() << "." << std::endl;
+    EXPECT_EQ(marketengine.get_spread(), (long long)(2 + 0.5 * volatilities.back()))
+        << "Spread should follow the process's volatility. Current spread: " << marketengine.get_spread() << "." << std::endl;
+}
+
+/**
+============================================================
+TEST 8: LatencyExposureIsReported
+============================================================
+PURPOSE: Verify a run with slow market data reports every direction's time in flight within its latency boundaries, and that quotes
+         left stale by the delayed view of the market show up as exposure on the exchange clock.
+============================================================
+*/
+TEST(MarketEngineTest, LatencyExposureIsReported) {
+    MarketEngine marketengine(10, 1, 1000, 2, 1000, 10000, 2, 3.0, 0.3);
+    Strategy& strategy = marketengine.get_strategy();
+    strategy.set_latency_config(100, 200, 100, 200, 100, 200, 100, 200, 2000, 3000);
+
+    for (long long timestamp_us = 100; timestamp_us <= 500000; timestamp_us += 100) {
+        marketengine.update(timestamp_us);
+    }
+
+    const Metrics& metrics = marketengine.get_metrics();
+    EXPECT_GT(metrics.time_in_flight[Metrics::ORDER_ENTRY].num_events, 0) << "Orders should have been sent." << std::endl;
+    EXPECT_GE(metrics.get_mean_time_in_flight_us(Metrics::MARKET_DATA), 2000) << "Market data should take its latency to arrive." << std::endl;
+    EXPECT_LE(metrics.get_max_time_in_flight_us(Metrics::MARKET_DATA), 3000) << "Market data should arrive within its latency." << std::endl;
+    EXPECT_LE(metrics.get_max_time_in_flight_us(Metrics::ORDER_ENTRY), 200) << "Orders should arrive within their latency." << std::endl;
+    EXPECT_GT(metrics.quoted_time_us, 0) << "The strategy should have quoted." << std::endl;
+    EXPECT_GT(metrics.stale_quote_exposure_us, 0) << "Slow market data should leave quotes stale." << std::endl;
+    EXPECT_LE(metrics.stale_quote_exposure_us, metrics.quoted_time_us) << "Quotes can only be stale while they are quoted." << std::endl;
+    EXPECT_LE(metrics.picked_off_qty, metrics.quote_filled_qty) << "Only quote fills can be picked off." << std::endl;
+}
+
+/**
+============================================================
+TEST 9: FilledQuotesAreNotCancelledTwice
+============================================================
+PURPOSE: Verify the probabilistic fill model, which takes filled quantity off the book itself, never leaves the strategy cancelling
+         a quote the book no longer has, neither when the fill is acknowledged nor when the quote goes stale.
+============================================================
+*/
+TEST(MarketEngineTest, FilledQuotesAreNotCancelledTwice) {
+    MarketEngine marketengine(1, 1, 1000, 2, 1000, 10000, 2, 3.0, 1.0); // quotes of 1 lot, every fill fills the quote
+    Strategy& strategy = marketengine.get_strategy();
+    strategy.set_latency_config(100, 200, 100, 200, 100, 200, 100, 200, 2000, 3000);
+
+    testing::internal::CaptureStdout();
+    for (long long timestamp_us = 100; timestamp_us <= 500000; timestamp_us += 100) {
+        marketengine.update(timestamp_us);
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_GT(marketengine.get_metrics().gross_traded_qty, 0) << "Quotes should have been filled for the test to mean something." << std::endl;
+    EXPECT_EQ(output.find("doesn't exist"), std::string::npos) << "No cancel should reach the book for a quote it no longer has." << std::endl;
+}
+
+/**
+============================================================
+TEST 10: QueueFillsAreNotCancelledAgain
+============================================================
+PURPOSE: Verify the QUEUE_POSITION fill model takes its fills off the book, so a stale quote cancelled before its fills are acknowledged
+         only cancels what is left of it, and filled plus cancelled quantity never exceeds what the strategy quoted.
+============================================================
+*/
+TEST(MarketEngineTest, QueueFillsAreNotCancelledAgain) {
+    MarketEngine marketengine(5, 1, 1000, 2, 1000, 10000, 2, 3.0, 0.3);
+    marketengine.set_fill_model(MarketEngine::FillModel::QUEUE_POSITION);
+    marketengine.set_queue_flow(0, 2, 0); // no queue ahead, a couple of lots trade at the touch per update
+    Strategy& strategy = marketengine.get_strategy();
+    strategy.set_latency_config(100, 200, 100, 200, 100, 200, 2000, 3000, 100, 200); // fills are acknowledged after the stale cancels
+
+    testing::internal::CaptureStdout();
+    for (long long timestamp_us = 100; timestamp_us <= 500000; timestamp_us += 100) {
+        marketengine.update(timestamp_us);
+    }
+    std::string output = testing::internal::GetCapturedStdout();
+
+    const Metrics& metrics = marketengine.get_metrics();
+    EXPECT_GT(metrics.resting_filled_qty, 0) << "Quotes should have been filled for the test to mean something." << std::endl;
+    EXPECT_GT(metrics.resting_cancelled_qty, 0) << "Quotes should have been cancelled for the test to mean something." << std::endl;
+    EXPECT_LE(metrics.resting_filled_qty + metrics.resting_cancelled_qty, metrics.resting_attempted_qty)
+        << "Filled and cancelled quantity should not exceed the quoted quantity. Filled: " << metrics.resting_filled_qty
+        << ", cancelled: " << metrics.resting_cancelled_qty << ", quoted: " << metrics.resting_attempted_qty << "." << std::endl;
+    EXPECT_EQ(output.find("doesn't exist"), std::string::npos) << "No cancel should reach the book for a quote it no longer has." << std::endl;
+}
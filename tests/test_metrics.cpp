@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "../include/Metrics.h"
+#include <cmath>
 
 /**
     ============================================================
@@ -1021,4 +1022,49 @@ TEST(MetricsTest, OnFillOnNonExistentOrder) {
         << "Total PnL should still be 0 after an on_fill call on a non-existent order.";
     EXPECT_EQ(metrics.get_gross_traded_qty(), 0)
         << "Gross traded quantity should still be 0 after an on_fill call on a non-existent order.";
+}
+
+/**
+    ============================================================
+    TEST 12: LatencyExposure
+    ============================================================
+    PURPOSE: Verify time in flight is averaged per direction, that quoted and stale time are booked against the quotes of the
+             previous check, that only fills of stale quotes count as picked off, and that stitching sums the exposure
+    ============================================================
+*/
+TEST(MetricsTest, LatencyExposure) {
+    Metrics metrics;
+    metrics.on_event_delivered(Metrics::ORDER_ENTRY, 1000, 1100);
+    metrics.on_event_delivered(Metrics::ORDER_ENTRY, 2000, 2300);
+    metrics.on_event_delivered(Metrics::MARKET_DATA, 1000, 1050);
+    EXPECT_DOUBLE_EQ(metrics.get_mean_time_in_flight_us(Metrics::ORDER_ENTRY), 200)
+        << "Mean time in flight should be averaged over the direction's events.";
+    EXPECT_EQ(metrics.get_max_time_in_flight_us(Metrics::ORDER_ENTRY), 300)
+        << "Longest time in flight should be kept.";
+    EXPECT_EQ(metrics.get_mean_time_in_flight_us(Metrics::ACKNOWLEDGEMENTS), 0)
+        << "A direction without events should report 0.";
+
+    metrics.on_quote_state(1000, true, false, true, false);
+    metrics.on_quote_filled(Metrics::Side::BUYS, 10);
+    metrics.on_quote_state(2000, true, true, false, true);
+    metrics.on_quote_filled(Metrics::Side::BUYS, 30);
+    metrics.on_quote_filled(Metrics::Side::SELLS, 60);
+    metrics.on_quote_state(3000, false, false, false, false);
+
+    EXPECT_EQ(metrics.quoted_time_us, 3000)
+        << "Both sides quoted for 1000 us, then the bid alone for 1000 us.";
+    EXPECT_EQ(metrics.stale_quote_exposure_us, 1000)
+        << "Only the live bid should have been stale, for 1000 us.";
+    EXPECT_DOUBLE_EQ(metrics.get_stale_quote_ratio(), 1.0 / 3)
+        << "A third of the quoted time should have been stale.";
+    EXPECT_DOUBLE_EQ(metrics.get_pick_off_rate(), 0.3)
+        << "Only the fill of the stale bid should count as picked off.";
+
+    Metrics stitched = Metrics::stitch({metrics, metrics});
+    EXPECT_EQ(stitched.time_in_flight[Metrics::ORDER_ENTRY].num_events, 4)
+        << "Stitching should sum the events in flight.";
+    EXPECT_EQ(stitched.picked_off_qty, 60)
+        << "Stitching should sum the picked off quantity.";
+    EXPECT_DOUBLE_EQ(stitched.get_stale_quote_ratio(), metrics.get_stale_quote_ratio())
+        << "Stitching identical windows should keep the stale ratio.";
 }
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include <string>
+#include "../include/MultiSymbolEngine.h"
+
+/**
+    ============================================================
+    TEST 1: RoutesCommandsToOwnBooks
+    ============================================================
+    PURPOSE: Verify symbols are sharded round robin and every command only reaches the book of its own symbol
+    ============================================================
+*/
+TEST(MultiSymbolEngineTest, RoutesCommandsToOwnBooks) {
+    MultiSymbolEngine engine(2, false);
+    int aapl = engine.add_symbol("AAPL");
+    int msft = engine.add_symbol("MSFT");
+    int tsla = engine.add_symbol("TSLA");
+
+    EXPECT_EQ(engine.add_symbol("AAPL"), aapl)
+        << "Adding an existing symbol should return its id instead of creating a second book.";
+    EXPECT_EQ(engine.get_shard_of(aapl), 0);
+    EXPECT_EQ(engine.get_shard_of(msft), 1);
+    EXPECT_EQ(engine.get_shard_of(tsla), 0);
+
+    engine.start();
+    EXPECT_THROW(engine.add_symbol("NVDA"), std::runtime_error)
+        << "Registry should be fixed once the engine is running.";
+
+    for (int i = 0; i < 100; i++) {
+        engine.post(aapl, OrderCommand(OrderCommand::Type::ADD_LIMIT, i, i, true, 1000 - (i % 5), 10));
+        engine.post("MSFT", OrderCommand(OrderCommand::Type::ADD_LIMIT, i, i, false, 2000 + (i % 3), 10));
+    }
+    engine.synchronize(100);
+
+    EXPECT_EQ(engine.get_orderbook("AAPL").get_order_lookup().size(), 100)
+        << "AAPL book should hold the 100 buys posted to it.";
+    EXPECT_EQ(engine.get_orderbook("AAPL").get_buys().size(), 5);
+    EXPECT_EQ(engine.get_orderbook("MSFT").get_order_lookup().size(), 100)
+        << "MSFT book should hold the 100 sells posted to it.";
+    EXPECT_EQ(engine.get_orderbook("MSFT").get_sells().size(), 3);
+    EXPECT_TRUE(engine.get_orderbook("TSLA").get_order_lookup().empty())
+        << "TSLA book should not have received any order.";
+
+    EXPECT_THROW(engine.post("GOOG", OrderCommand()), std::runtime_error)
+        << "Posting to an unknown symbol should throw.";
+}
+
+/**
+    ============================================================
+    TEST 2: ClientIdsAddressOrdersAcrossMessages
+    ============================================================
+    PURPOSE: Cancels and modifies posted later refer to orders by the client id used when adding them
+    ============================================================
+*/
+TEST(MultiSymbolEngineTest, ClientIdsAddressOrdersAcrossMessages) {
+    MultiSymbolEngine engine(3, false);
+    engine.add_symbol("ES");
+    engine.add_symbol("NQ");
+    engine.start();
+
+    engine.post("ES", OrderCommand(OrderCommand::Type::ADD_LIMIT, 1, 42, true, 5000, 10));
+    engine.post("ES", OrderCommand(OrderCommand::Type::ADD_LIMIT, 2, 43, true, 5000, 7));
+    engine.post("NQ", OrderCommand(OrderCommand::Type::ADD_LIMIT, 3, 42, false, 18000, 4)); // Same client id on another symbol is a different order
+    engine.post("ES", OrderCommand(OrderCommand::Type::CANCEL, 4, 42, false, -1, 0));
+    engine.post("ES", OrderCommand(OrderCommand::Type::MODIFY, 5, 43, false, -1, 3));
+    engine.synchronize(10);
+
+    OrderBook& es_book = engine.get_orderbook("ES");
+    ASSERT_EQ(es_book.get_order_lookup().size(), 1)
+        << "Only client order 43 should remain in the ES book.";
+    EXPECT_EQ(es_book.get_best_bid()->second.front().quantity, 3)
+        << "Client order 43 should have been reduced to 3.";
+    EXPECT_EQ(engine.get_orderbook("NQ").get_order_lookup().size(), 1)
+        << "Cancelling client id 42 on ES must not touch client id 42 on NQ.";
+}
+
+/**
+    ============================================================
+    TEST 3: PortfolioMetricsCombineAtBarrier
+    ============================================================
+    PURPOSE: Tracked orders update their symbol's metrics, also for what they trade on arrival, and the portfolio metrics are the sum
+             over symbols at each barrier. Order types the metrics cannot follow are refused for tracking
+    ============================================================
+*/
+TEST(MultiSymbolEngineTest, PortfolioMetricsCombineAtBarrier) {
+    MultiSymbolEngine engine(2, false);
+    engine.add_symbol("A");
+    engine.add_symbol("B");
+    engine.start();
+
+    // Our own resting buys, tracked in metrics
+    engine.post("A", OrderCommand(OrderCommand::Type::ADD_LIMIT, 1, 1, true, 100, 5), true);
+    engine.post("B", OrderCommand(OrderCommand::Type::ADD_LIMIT, 1, 1, true, 200, 8), true);
+    engine.synchronize(10);
+
+    EXPECT_EQ(engine.get_portfolio_metrics().resting_attempted_qty, 13)
+        << "Portfolio attempted quantity should be the sum over symbols.";
+    EXPECT_EQ(engine.get_portfolio_metrics().timestamp_series.size(), 1)
+        << "Each barrier should add one portfolio point.";
+
+    // Background sellers hit both of our buys
+    engine.post("A", OrderCommand(OrderCommand::Type::ADD_LIMIT, 20, 100, false, 100, 5));
+    engine.post("B", OrderCommand(OrderCommand::Type::ADD_LIMIT, 20, 100, false, 200, 8));
+    // Our own buy lifts a background offer on arrival, 4 trade at 101 and 2 rest at 102
+    engine.post("A", OrderCommand(OrderCommand::Type::ADD_LIMIT, 21, 101, false, 101, 4));
+    engine.post("A", OrderCommand(OrderCommand::Type::ADD_LIMIT, 22, 2, true, 102, 6), true);
+    EXPECT_THROW(engine.post("A", OrderCommand(OrderCommand::Type::ADD_IOC, 23, 3, true, 102, 1), true), std::runtime_error)
+        << "An IOC cannot be tracked in metrics.";
+    engine.synchronize(30);
+
+    EXPECT_EQ(engine.get_metrics("A").get_gross_traded_qty(), 9)
+        << "The 4 our buy took on arrival should be booked with the 5 filled while resting.";
+    EXPECT_EQ(engine.get_metrics("A").position, 9);
+    EXPECT_EQ(engine.get_metrics("A").resting_attempted_qty, 7)
+        << "Only the 2 left of the crossing buy should count as resting.";
+    EXPECT_TRUE(engine.get_metrics("A").is_tracking(engine.get_orderbook("A").get_best_bid()->second.front().id))
+        << "What is left of the crossing buy should be tracked.";
+    EXPECT_EQ(engine.get_metrics("B").get_gross_traded_qty(), 8);
+    EXPECT_EQ(engine.get_portfolio_metrics().get_gross_traded_qty(), 17)
+        << "Portfolio traded quantity should be the sum over symbols.";
+    EXPECT_EQ(engine.get_portfolio_metrics().timestamp_series.back(), 30)
+        << "Portfolio point should be stamped with the barrier time.";
+
+    engine.finalize(40);
+    EXPECT_EQ(engine.get_portfolio_metrics().timestamp_series.size(), 3)
+        << "Finalize should synchronize once more and record a single final point.";
+    EXPECT_EQ(engine.get_portfolio_metrics().timestamp_series.back(), 40)
+        << "Final point should be stamped with the final time.";
+}
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../include/OrderIngress.h"
+#include "../include/SpscRing.h"
+
+/**
+    ============================================================
+    TEST 1: SpscRingFifoAndCapacity
+    ============================================================
+    PURPOSE: Verify the ring keeps FIFO order, refuses pushes when full and dequeues batches
+    ============================================================
+*/
+TEST(OrderIngressTest, SpscRingFifoAndCapacity) {
+    SpscRing<int, 8> ring;
+    int value = 0;
+
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.try_pop(value))
+        << "Popping an empty ring should fail.";
+
+    for (int i = 0; i < 8; i++) {
+        EXPECT_TRUE(ring.try_push(i))
+            << "Push " << i << " should fit into a ring of capacity 8.";
+    }
+    EXPECT_FALSE(ring.try_push(8))
+        << "Pushing into a full ring should fail.";
+    EXPECT_EQ(ring.size_approx(), 8);
+
+    ASSERT_TRUE(ring.try_pop(value));
+    EXPECT_EQ(value, 0)
+        << "Ring should hand elements out in FIFO order.";
+    EXPECT_TRUE(ring.try_push(8))
+        << "Popping one element should free one slot.";
+
+    int batch[16];
+    std::size_t count = ring.pop_batch(batch, 16);
+    ASSERT_EQ(count, 8)
+        << "Batch pop should return every element available.";
+    for (std::size_t i = 0; i < count; i++) {
+        EXPECT_EQ(batch[i], (int)i + 1)
+            << "Batch element " << i << " is out of order.";
+    }
+    EXPECT_TRUE(ring.empty());
+}
+
+/**
+    ============================================================
+    TEST 2: SpscRingAcrossThreads
+    ============================================================
+    PURPOSE: A producer and a consumer thread exchange a long sequence with wrap-arounds, nothing is lost or reordered
+    ============================================================
+*/
+TEST(OrderIngressTest, SpscRingAcrossThreads) {
+    auto ring = std::make_unique<SpscRing<long long, 1024>>();
+    const long long num_values = 1000000;
+
+    std::thread producer([&ring, num_values]() {
+        for (long long i = 0; i < num_values; i++) {
+            while (!ring->try_push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    long long expected = 0;
+    bool in_order = true;
+    long long batch[32];
+    while (expected < num_values) {
+        std::size_t count = ring->pop_batch(batch, 32);
+        if (count == 0) {
+            std::this_thread::yield();
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            in_order = in_order && batch[i] == expected;
+            expected++;
+        }
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order)
+        << "Consumer received values out of order.";
+    EXPECT_TRUE(ring->empty());
+}
+
+/**
+    ============================================================
+    TEST 3: IngressAppliesCommandsAndReturnsResults
+    ============================================================
+    PURPOSE: Commands are applied in order and every command gets a result with the book id, fills and remaining quantity
+    ============================================================
+*/
+TEST(OrderIngressTest, IngressAppliesCommandsAndReturnsResults) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    auto ingress = std::make_unique<OrderIngress>();
+
+    ASSERT_TRUE(ingress->submit(OrderCommand(OrderCommand::Type::ADD_LIMIT, 1, 101, true, 1000, 10)));
+    ASSERT_TRUE(ingress->submit(OrderCommand(OrderCommand::Type::ADD_LIMIT, 2, 102, false, 1000, 4)));
+    ASSERT_TRUE(ingress->submit(OrderCommand(OrderCommand::Type::ADD_IOC, 3, 103, false, -1, 10)));
+    EXPECT_EQ(ingress->process(orderbook), 3);
+
+    OrderResult resting_buy, matched_sell, ioc_sell;
+    ASSERT_TRUE(ingress->poll_result(resting_buy));
+    ASSERT_TRUE(ingress->poll_result(matched_sell));
+    ASSERT_TRUE(ingress->poll_result(ioc_sell));
+    EXPECT_FALSE(ingress->poll_result(ioc_sell))
+        << "There should be exactly one result per command.";
+
+    EXPECT_EQ(resting_buy.clientOrderId, 101);
+    EXPECT_EQ(resting_buy.status, OrderResult::Status::RESTING);
+    EXPECT_EQ(resting_buy.remainingQuantity, 10);
+
+    EXPECT_EQ(matched_sell.status, OrderResult::Status::FILLED);
+    EXPECT_EQ(matched_sell.filledQuantity, 4);
+
+    EXPECT_EQ(ioc_sell.status, OrderResult::Status::CANCELLED)
+        << "IOC larger than the remaining liquidity should report its remainder as cancelled.";
+    EXPECT_EQ(ioc_sell.filledQuantity, 6);
+    EXPECT_TRUE(orderbook.get_buys().empty());
+
+    // Cancels address orders by the book id returned in the results
+    ASSERT_TRUE(ingress->submit(OrderCommand(OrderCommand::Type::CANCEL, 4, resting_buy.orderId, false, -1, 0)));
+    EXPECT_EQ(ingress->process(orderbook), 1);
+
+    OrderResult cancel_result;
+    ASSERT_TRUE(ingress->poll_result(cancel_result));
+    EXPECT_EQ(cancel_result.status, OrderResult::Status::REJECTED)
+        << "Cancelling an order that was already filled should be rejected.";
+}
+
+/**
+    ============================================================
+    TEST 4: IngressAcrossThreads
+    ============================================================
+    PURPOSE: A producer thread adds and cancels orders through the rings while the matching thread owns the book
+    ============================================================
+*/
+TEST(OrderIngressTest, IngressAcrossThreads) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    auto ingress = std::make_unique<OrderIngress>();
+    const int num_orders = 20000;
+
+    std::atomic<bool> producer_done(false);
+    int num_cancelled = 0;
+
+    std::thread producer([&]() {
+        int submitted = 0;
+        int results_seen = 0;
+        OrderResult result;
+
+        while (results_seen < 2 * num_orders) {
+            if (submitted < num_orders && ingress->submit(OrderCommand(OrderCommand::Type::ADD_LIMIT, submitted, submitted, true, 1000 - (submitted % 50), 1))) {
+                submitted++;
+            }
+            else {
+                std::this_thread::yield();
+            }
+
+            while (ingress->poll_result(result)) {
+                results_seen++;
+                if (result.status == OrderResult::Status::RESTING) {
+                    while (!ingress->submit(OrderCommand(OrderCommand::Type::CANCEL, 0, result.orderId, false, -1, 0))) {}
+                }
+                else if (result.status == OrderResult::Status::CANCELLED) {
+                    num_cancelled++;
+                }
+            }
+        }
+        producer_done = true;
+    });
+
+    while (!producer_done) {
+        if (ingress->process(orderbook) == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+
+    EXPECT_EQ(num_cancelled, num_orders)
+        << "Every order should have been added and then cancelled.";
+    EXPECT_TRUE(orderbook.get_order_lookup().empty())
+        << "Book should be empty after every order was cancelled.";
+}
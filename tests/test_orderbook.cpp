@@ -1,4 +1,9 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../include/IdGenerator.h"
 #include "../include/OrderBook.h"
 
 /**
@@ -907,3 +912,1313 @@ TEST(OrderBookTest, CancelNonExistentOrder) {
     EXPECT_NE(orderbook.cancel_order(-1), 0)
         << "Cancelling an order should return 0 only if the order was successfully found and deleted.";
 }
+
+/**
+    ============================================================
+    TEST 15: ApplyBatchMatchesSequentialApply
+    ============================================================
+    PURPOSE: A random stream of adds (limit, FOK, post-only, AON), IOCs, stops, cancels and modifies applied with apply_batch gives the same results, trades and book as applying it one by one.
+             Order ids of the two runs differ by a constant, since both runs draw the same number of ids from the same generator.
+    ============================================================
+ */
+TEST(OrderBookTest, ApplyBatchMatchesSequentialApply) {
+    const int NUM_COMMANDS = 2000;
+    std::mt19937 rng(7);
+
+    Metrics metrics_sequential;
+    OrderBook sequential(metrics_sequential);
+    std::vector<OrderCommand> commands;
+    std::vector<OrderResult> sequential_results;
+    std::vector<long long> resting_ids;
+
+    for (int i = 0; i < NUM_COMMANDS; i++) {
+        int kind = (i == 0) ? 0 : (int)(rng() % 11);
+        bool is_buy = rng() % 2 == 0;
+        OrderCommand command;
+
+        if (kind < 5 || resting_ids.empty()) {
+            long long price = is_buy ? 995 + (long long)(rng() % 8) : 998 + (long long)(rng() % 8);
+            OrderCommand::Type add_types[] = {OrderCommand::Type::ADD_LIMIT, OrderCommand::Type::ADD_LIMIT, OrderCommand::Type::ADD_FOK,
+                                              OrderCommand::Type::ADD_POST_ONLY, OrderCommand::Type::ADD_AON};
+            command = OrderCommand(add_types[kind < 5 ? kind : 0], i, -1, is_buy, price, 1 + (int)(rng() % 10));
+        }
+        else if (kind == 5) {
+            command = OrderCommand(OrderCommand::Type::ADD_IOC, i, -1, is_buy, -1, 1 + (int)(rng() % 10));
+        }
+        else if (kind < 9) {
+            command = OrderCommand(OrderCommand::Type::CANCEL, i, resting_ids[rng() % resting_ids.size()], false, -1, 0);
+        }
+        else if (kind == 9) {
+            command = OrderCommand(OrderCommand::Type::MODIFY, i, resting_ids[rng() % resting_ids.size()], false, -1, 1 + (int)(rng() % 10));
+        }
+        else {
+            long long trigger = 996 + (long long)(rng() % 10);
+            long long limit = rng() % 2 == 0 ? -1 : trigger + (is_buy ? 1 : -1);
+            command = OrderCommand::stop(i, -1, is_buy, trigger, limit, 1 + (int)(rng() % 10));
+        }
+
+        commands.push_back(command);
+        sequential_results.push_back(sequential.apply(command));
+        if (sequential_results.back().status == OrderResult::Status::RESTING || sequential_results.back().status == OrderResult::Status::PENDING) {
+            resting_ids.push_back(sequential_results.back().orderId);
+        }
+    }
+
+    Metrics metrics_batched;
+    OrderBook batched(metrics_batched);
+    long long id_offset = (IdGenerator::getNext() + 1) - sequential_results.front().orderId;
+
+    std::vector<OrderCommand> shifted_commands = commands;
+    for (OrderCommand& command : shifted_commands) {
+        if (command.type == OrderCommand::Type::CANCEL || command.type == OrderCommand::Type::MODIFY) {
+            command.orderId += id_offset;
+        }
+    }
+
+    std::vector<OrderResult> batched_results(NUM_COMMANDS);
+    std::vector<Trade> trades(sequential.get_trade_log().get_trades().size());
+    std::size_t num_trades = 0;
+    for (int start = 0; start < NUM_COMMANDS; start += 64) {
+        std::size_t count = std::min(64, NUM_COMMANDS - start);
+        num_trades += batched.apply_batch(&shifted_commands[start], count, &batched_results[start], trades.data() + num_trades, trades.size() - num_trades);
+    }
+
+    for (int i = 0; i < NUM_COMMANDS; i++) {
+        const OrderResult& expected = sequential_results[i];
+        const OrderResult& result = batched_results[i];
+        ASSERT_EQ(result.status, expected.status) << "Status differs at command " << i;
+        ASSERT_EQ(result.filledQuantity, expected.filledQuantity) << "Filled quantity differs at command " << i;
+        ASSERT_EQ(result.remainingQuantity, expected.remainingQuantity) << "Remaining quantity differs at command " << i;
+        if (expected.orderId != -1) {
+            ASSERT_EQ(result.orderId, expected.orderId + id_offset) << "Order id differs at command " << i;
+        }
+    }
+
+    ASSERT_EQ(num_trades, sequential.get_trade_log().get_trades().size())
+        << "Batch should report as many trades as the sequential run printed.";
+    ASSERT_EQ(batched.get_trade_log().get_trades().size(), num_trades)
+        << "Trades copied to the buffer should still be recorded in the trade log.";
+    std::size_t index = 0;
+    for (const Trade& expected : sequential.get_trade_log().get_trades()) {
+        EXPECT_EQ(trades[index].priceTick, expected.priceTick);
+        EXPECT_EQ(trades[index].quantity, expected.quantity);
+        EXPECT_EQ(trades[index].buyOrderId, expected.buyOrderId + id_offset);
+        EXPECT_EQ(trades[index].sellOrderId, expected.sellOrderId + id_offset);
+        index++;
+    }
+
+    ASSERT_EQ(batched.get_buys().size(), sequential.get_buys().size());
+    ASSERT_EQ(batched.get_sells().size(), sequential.get_sells().size());
+    for (auto iter_level = sequential.get_buys().begin(); iter_level != sequential.get_buys().end(); ++iter_level) {
+        EXPECT_EQ(batched.get_buys().at(iter_level->first).size(), iter_level->second.size());
+    }
+    for (auto iter_level = sequential.get_sells().begin(); iter_level != sequential.get_sells().end(); ++iter_level) {
+        EXPECT_EQ(batched.get_sells().at(iter_level->first).size(), iter_level->second.size());
+    }
+}
+
+/**
+    ============================================================
+    TEST 16: ApplyBatchTradeBufferTruncation
+    ============================================================
+    PURPOSE: When the caller's trade buffer is too small, apply_batch fills it with the first trades and still reports the total count.
+    ============================================================
+ */
+TEST(OrderBookTest, ApplyBatchTradeBufferTruncation) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    OrderCommand commands[] = {
+        OrderCommand(OrderCommand::Type::ADD_LIMIT, 1, -1, false, 1000, 5),
+        OrderCommand(OrderCommand::Type::ADD_LIMIT, 2, -1, false, 1001, 5),
+        OrderCommand(OrderCommand::Type::ADD_LIMIT, 3, -1, false, 1002, 5),
+        OrderCommand(OrderCommand::Type::ADD_IOC, 4, -1, true, -1, 15)
+    };
+    OrderResult results[4];
+    Trade trades[2];
+
+    std::size_t num_trades = orderbook.apply_batch(commands, 4, results, trades, 2);
+
+    EXPECT_EQ(num_trades, 3u)
+        << "The IOC sweeps three levels, so three trades should be reported.";
+    EXPECT_EQ(results[3].status, OrderResult::Status::FILLED);
+    EXPECT_EQ(results[3].filledQuantity, 15);
+    EXPECT_EQ(trades[0].priceTick, 1000)
+        << "Trades should be copied in execution order.";
+    EXPECT_EQ(trades[1].priceTick, 1001);
+    EXPECT_EQ(orderbook.get_trade_log().get_trades().size(), 3u)
+        << "Trades beyond the buffer capacity should still be in the trade log.";
+}
+
+/**
+    ============================================================
+    TEST 17: CancelOrdersBatch
+    ============================================================
+    PURPOSE: Batched cancels remove every resting order they name through the stored level handles, erase levels that empty,
+             skip unknown or already cancelled ids and report how many orders were actually cancelled.
+    ============================================================
+ */
+TEST(OrderBookTest, CancelOrdersBatch) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    std::vector<long long> ids;
+    for (int i = 0; i < 40; i++) {
+        ids.push_back(orderbook.add_limit_order(true, 990 + i % 4, 1, i));   // 10 orders on each of 4 bid levels
+        ids.push_back(orderbook.add_limit_order(false, 1010 + i % 4, 1, i)); // 10 orders on each of 4 ask levels
+    }
+
+    // Every order of bid 990 and ask 1013 (leaving their levels empty), the first bid at 991, an unknown id and a duplicate
+    std::vector<long long> to_cancel;
+    for (int i = 0; i < 40; i++) {
+        if (i % 4 == 0) {
+            to_cancel.push_back(ids[2 * i]);
+        }
+        if (i % 4 == 3) {
+            to_cancel.push_back(ids[2 * i + 1]);
+        }
+    }
+    to_cancel.push_back(ids[2]);
+    to_cancel.push_back(-1);
+    to_cancel.push_back(ids[0]);
+
+    std::size_t num_cancelled = orderbook.cancel_orders(to_cancel.data(), to_cancel.size());
+
+    EXPECT_EQ(num_cancelled, 21u)
+        << "Twenty orders of the two emptied levels and one at bid 991 should be cancelled, the unknown and duplicate ids skipped.";
+    EXPECT_EQ(orderbook.get_order_lookup().size(), 80u - 21u);
+    EXPECT_EQ(orderbook.get_buys().count(990), 0u)
+        << "Emptied bid level should be erased.";
+    EXPECT_EQ(orderbook.get_sells().count(1013), 0u)
+        << "Emptied ask level should be erased.";
+    EXPECT_EQ(orderbook.get_buys().at(991).size(), 9u);
+    EXPECT_EQ(orderbook.get_best_bid()->first, 993);
+    EXPECT_EQ(orderbook.get_best_ask()->first, 1010);
+
+    // Level handles of the remaining orders are still valid after other levels were erased
+    EXPECT_EQ(orderbook.cancel_order(ids[3]), 0);
+    EXPECT_EQ(orderbook.get_sells().at(1011).size(), 9u);
+}
+
+/**
+    ============================================================
+    TEST 18: L2DepthAggregates
+    ============================================================
+    PURPOSE: Level aggregates follow adds, partial fills, downsizing modifies and cancels, and get_depth reports them best price first.
+    ============================================================
+ */
+TEST(OrderBookTest, L2DepthAggregates) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(false, 1001, 10, 1);
+    long long second_ask = orderbook.add_limit_order(false, 1001, 5, 2);
+    orderbook.add_limit_order(false, 1003, 7, 3);
+    orderbook.add_limit_order(true, 998, 4, 4);
+
+    orderbook.add_IOC_order(true, 6, 5);        // partially fills the first ask at 1001
+    orderbook.modify_order(second_ask, 2, 6);   // downsizes in place
+
+    L2Level asks[5];
+    ASSERT_EQ(orderbook.get_depth(false, asks, 5), 2u)
+        << "Two ask levels rest in the book.";
+    EXPECT_EQ(asks[0].priceTick, 1001);
+    EXPECT_EQ(asks[0].quantity, 4 + 2)
+        << "Best ask should aggregate the remainder of the partially filled order and the downsized one.";
+    EXPECT_EQ(asks[0].numOrders, 2);
+    EXPECT_EQ(asks[1].priceTick, 1003);
+    EXPECT_EQ(asks[1].quantity, 7);
+
+    L2Level bids[1];
+    ASSERT_EQ(orderbook.get_depth(true, bids, 1), 1u);
+    EXPECT_EQ(bids[0].priceTick, 998);
+    EXPECT_EQ(bids[0].quantity, 4);
+
+    orderbook.cancel_order(second_ask);
+    ASSERT_EQ(orderbook.get_depth(false, asks, 1), 1u)
+        << "get_depth should stop at max_levels.";
+    EXPECT_EQ(asks[0].quantity, 4);
+    EXPECT_EQ(asks[0].numOrders, 1);
+}
+
+/**
+    ============================================================
+    TEST 19: L2DeltasRebuildBook
+    ============================================================
+    PURPOSE: A subscriber applying every L2 delta to its own price -> quantity maps ends up with exactly the book's aggregated depth,
+             and that depth matches the quantities summed over the resting orders.
+    ============================================================
+ */
+TEST(OrderBookTest, L2DeltasRebuildBook) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    std::map<long long, std::pair<long long, int>> subscriber_book[2];
+    orderbook.subscribe_l2([&subscriber_book](const L2Delta& delta) {
+        auto& side = subscriber_book[delta.isBuy ? 1 : 0];
+        if (delta.quantity == 0) {
+            side.erase(delta.priceTick);
+        }
+        else {
+            side[delta.priceTick] = {delta.quantity, delta.numOrders};
+        }
+    });
+
+    std::mt19937 rng(11);
+    std::vector<long long> ids;
+    for (int i = 0; i < 3000; i++) {
+        int kind = (int)(rng() % 10);
+        bool is_buy = rng() % 2 == 0;
+
+        if (kind < 5 || ids.empty()) {
+            ids.push_back(orderbook.add_limit_order(is_buy, is_buy ? 995 + (long long)(rng() % 8) : 998 + (long long)(rng() % 8), 1 + (int)(rng() % 10), i));
+        }
+        else if (kind == 5) {
+            orderbook.add_IOC_order(is_buy, 1 + (int)(rng() % 15), i);
+        }
+        else if (kind < 9) {
+            orderbook.apply(OrderCommand(OrderCommand::Type::CANCEL, i, ids[rng() % ids.size()], false, -1, 0));
+        }
+        else {
+            long long new_id = orderbook.modify_order(ids[rng() % ids.size()], (int)(rng() % 12), i);
+            if (new_id != -1) {
+                ids.push_back(new_id);
+            }
+        }
+    }
+
+    for (bool is_buy : {true, false}) {
+        auto& side = is_buy ? orderbook.get_buys() : orderbook.get_sells();
+        std::vector<L2Level> depth(side.size() + 1);
+        std::size_t num_levels = orderbook.get_depth(is_buy, depth.data(), depth.size());
+
+        ASSERT_EQ(num_levels, side.size());
+        ASSERT_EQ(subscriber_book[is_buy ? 1 : 0].size(), side.size())
+            << "Subscriber should hold exactly the levels of the book.";
+
+        for (std::size_t i = 0; i < num_levels; i++) {
+            const PriceLevel& level = side.at(depth[i].priceTick);
+            long long summed_quantity = 0;
+            for (const Order& order : level) {
+                summed_quantity += order.quantity;
+            }
+
+            EXPECT_EQ(depth[i].quantity, summed_quantity) << "Aggregate quantity drifted at " << depth[i].priceTick;
+            EXPECT_EQ(depth[i].numOrders, (int)level.size());
+            EXPECT_EQ(subscriber_book[is_buy ? 1 : 0].at(depth[i].priceTick), std::make_pair(summed_quantity, (int)level.size()));
+        }
+    }
+}
+
+/**
+    ============================================================
+    TEST 20: BboNotifiesOnlyOnTouchChanges
+    ============================================================
+    PURPOSE: The cached BBO follows the book, listeners are called only when the touch moves, and a batch publishes at most once.
+    ============================================================
+ */
+TEST(OrderBookTest, BboNotifiesOnlyOnTouchChanges) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    std::vector<BestBidOffer> events;
+    orderbook.subscribe_bbo([&events](const BestBidOffer& bbo) { events.push_back(bbo); });
+
+    long long bid_id = orderbook.add_limit_order(true, 998, 5, 1);
+    orderbook.add_limit_order(false, 1002, 3, 2);
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_EQ(orderbook.get_bbo().bidPriceTick, 998);
+    EXPECT_EQ(orderbook.get_bbo().askPriceTick, 1002);
+    EXPECT_EQ(orderbook.get_bbo().askQuantity, 3);
+
+    orderbook.add_limit_order(true, 990, 5, 3);  // behind the touch
+    orderbook.add_limit_order(false, 1010, 5, 4);
+    EXPECT_EQ(events.size(), 2u)
+        << "Orders behind the touch should not publish a BBO event.";
+
+    long long second_bid = orderbook.add_limit_order(true, 998, 2, 5);
+    ASSERT_EQ(events.size(), 3u)
+        << "Joining the best bid changes its quantity, which is a touch change.";
+    EXPECT_EQ(events.back().bidQuantity, 7);
+
+    // Upsizing re-enters the order, the intermediate state without it must not be published
+    orderbook.modify_order(bid_id, 6, 6);
+    ASSERT_EQ(events.size(), 4u);
+    EXPECT_EQ(events.back().bidQuantity, 8);
+
+    OrderCommand batch[] = {
+        OrderCommand(OrderCommand::Type::CANCEL, 7, second_bid, false, -1, 0),
+        OrderCommand(OrderCommand::Type::ADD_LIMIT, 7, -1, false, 1001, 1),
+        OrderCommand(OrderCommand::Type::ADD_IOC, 7, -1, true, -1, 1)
+    };
+    OrderResult results[3];
+    orderbook.apply_batch(batch, 3, results, nullptr, 0);
+    ASSERT_EQ(events.size(), 5u)
+        << "A batch should publish the touch once, after its last command.";
+    EXPECT_EQ(events.back().bidQuantity, 6);
+    EXPECT_EQ(events.back().askPriceTick, 1002)
+        << "The ask added and taken inside the batch should never show up.";
+
+    EXPECT_TRUE(orderbook.load_bbo_snapshot() == orderbook.get_bbo())
+        << "The cross-thread snapshot should hold the last published BBO.";
+}
+
+/**
+    ============================================================
+    TEST 21: BboSnapshotAcrossThreads
+    ============================================================
+    PURPOSE: A reader thread polling the seqlock snapshot while the matching thread moves the touch with batches never sees a torn BBO.
+             Every batch leaves bid = p, ask = p + 1 and both quantities = p % 100 + 1.
+    ============================================================
+ */
+TEST(OrderBookTest, BboSnapshotAcrossThreads) {
+    const int NUM_BATCHES = 20000;
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    std::atomic<bool> done(false);
+    std::atomic<int> torn_reads(0);
+    std::atomic<int> reads(0);
+
+    std::thread reader([&]() {
+        while (!done.load()) {
+            BestBidOffer bbo = orderbook.load_bbo_snapshot();
+            if (bbo.bidPriceTick != 0) {
+                long long expected_quantity = bbo.bidPriceTick % 100 + 1;
+                if (bbo.askPriceTick != bbo.bidPriceTick + 1 || bbo.bidQuantity != expected_quantity || bbo.askQuantity != expected_quantity) {
+                    torn_reads++;
+                }
+            }
+            reads++;
+            std::this_thread::yield();
+        }
+    });
+
+    long long bid_id = -1;
+    long long ask_id = -1;
+    for (int i = 0; i < NUM_BATCHES; i++) {
+        long long price = 1000 + (i % 50);
+        int quantity = (int)(price % 100 + 1);
+        OrderCommand batch[] = {
+            OrderCommand(OrderCommand::Type::CANCEL, i, bid_id, false, -1, 0),
+            OrderCommand(OrderCommand::Type::CANCEL, i, ask_id, false, -1, 0),
+            OrderCommand(OrderCommand::Type::ADD_LIMIT, i, -1, true, price, quantity),
+            OrderCommand(OrderCommand::Type::ADD_LIMIT, i, -1, false, price + 1, quantity)
+        };
+        OrderResult results[4];
+        orderbook.apply_batch(batch, 4, results, nullptr, 0);
+        bid_id = results[2].orderId;
+        ask_id = results[3].orderId;
+    }
+
+    while (reads.load() < 100) {
+        std::this_thread::yield();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(torn_reads.load(), 0)
+        << "Readers should only ever see BBOs published at the end of a batch.";
+}
+
+/**
+    ============================================================
+    TEST 22: DepthSnapshotFollowsTopLevels
+    ============================================================
+    PURPOSE: The published depth snapshot always equals the book's top levels after each operation,
+             and changes deeper than the published levels do not publish a new snapshot.
+    ============================================================
+ */
+TEST(OrderBookTest, DepthSnapshotFollowsTopLevels) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    std::mt19937 rng(5);
+    std::vector<long long> ids;
+    for (int i = 0; i < 3000; i++) {
+        int kind = (int)(rng() % 10);
+        bool is_buy = rng() % 2 == 0;
+
+        if (kind < 6 || ids.empty()) {
+            ids.push_back(orderbook.add_limit_order(is_buy, is_buy ? 980 + (long long)(rng() % 25) : 996 + (long long)(rng() % 25), 1 + (int)(rng() % 10), i));
+        }
+        else if (kind == 6) {
+            orderbook.add_IOC_order(is_buy, 1 + (int)(rng() % 15), i);
+        }
+        else {
+            orderbook.apply(OrderCommand(OrderCommand::Type::CANCEL, i, ids[rng() % ids.size()], false, -1, 0));
+        }
+
+        DepthSnapshot snapshot = orderbook.load_depth_snapshot();
+        L2Level bids[DepthSnapshot::MAX_LEVELS];
+        L2Level asks[DepthSnapshot::MAX_LEVELS];
+        ASSERT_EQ(snapshot.numBids, (int)orderbook.get_depth(true, bids, DepthSnapshot::MAX_LEVELS)) << "After operation " << i;
+        ASSERT_EQ(snapshot.numAsks, (int)orderbook.get_depth(false, asks, DepthSnapshot::MAX_LEVELS)) << "After operation " << i;
+        for (int level = 0; level < snapshot.numBids; level++) {
+            ASSERT_EQ(snapshot.bids[level].priceTick, bids[level].priceTick);
+            ASSERT_EQ(snapshot.bids[level].quantity, bids[level].quantity);
+            ASSERT_EQ(snapshot.bids[level].numOrders, bids[level].numOrders);
+        }
+        for (int level = 0; level < snapshot.numAsks; level++) {
+            ASSERT_EQ(snapshot.asks[level].priceTick, asks[level].priceTick);
+            ASSERT_EQ(snapshot.asks[level].quantity, asks[level].quantity);
+            ASSERT_EQ(snapshot.asks[level].numOrders, asks[level].numOrders);
+        }
+    }
+
+    // Fill the bid side well past the published depth, then add behind it
+    for (int level = 0; level < 2 * DepthSnapshot::MAX_LEVELS; level++) {
+        orderbook.add_limit_order(true, 900 - level, 1, 4000);
+    }
+    DepthSnapshot before;
+    std::uint64_t sequence_before = 0;
+    ASSERT_TRUE(orderbook.try_load_depth_snapshot(before, sequence_before));
+
+    orderbook.add_limit_order(true, 800, 1, 4001);
+
+    DepthSnapshot after;
+    std::uint64_t sequence_after = 0;
+    ASSERT_TRUE(orderbook.try_load_depth_snapshot(after, sequence_after));
+    EXPECT_EQ(sequence_after, sequence_before)
+        << "An order far behind the published levels should not republish the snapshot.";
+
+    orderbook.clear();
+    DepthSnapshot cleared = orderbook.load_depth_snapshot();
+    EXPECT_EQ(cleared.numBids, 0)
+        << "Clearing the book should publish an empty snapshot.";
+    EXPECT_EQ(cleared.numAsks, 0);
+}
+
+/**
+    ============================================================
+    TEST 23: DepthSnapshotAcrossThreads
+    ============================================================
+    PURPOSE: A reader on another thread only ever sees complete ladders. Each batch replaces the whole book with contiguous levels around a moving mid,
+             one order per level with quantity derived from its price, so any mix of two publishes breaks the pattern.
+    ============================================================
+ */
+TEST(OrderBookTest, DepthSnapshotAcrossThreads) {
+    const int NUM_BATCHES = 3000;
+    const int LEVELS_PER_SIDE = DepthSnapshot::MAX_LEVELS + 2;
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    std::atomic<bool> done(false);
+    std::atomic<int> torn_reads(0);
+    std::atomic<int> reads(0);
+
+    std::thread reader([&]() {
+        while (!done.load()) {
+            DepthSnapshot snapshot = orderbook.load_depth_snapshot();
+            if (snapshot.numBids > 0) {
+                bool is_consistent = snapshot.numBids == DepthSnapshot::MAX_LEVELS && snapshot.numAsks == DepthSnapshot::MAX_LEVELS
+                                     && snapshot.asks[0].priceTick == snapshot.bids[0].priceTick + 1;
+                for (int level = 0; level < DepthSnapshot::MAX_LEVELS && is_consistent; level++) {
+                    is_consistent = snapshot.bids[level].priceTick == snapshot.bids[0].priceTick - level
+                                    && snapshot.asks[level].priceTick == snapshot.asks[0].priceTick + level
+                                    && snapshot.bids[level].quantity == snapshot.bids[level].priceTick % 97 + 1
+                                    && snapshot.asks[level].quantity == snapshot.asks[level].priceTick % 97 + 1;
+                }
+                if (!is_consistent) {
+                    torn_reads++;
+                }
+            }
+            reads++;
+            std::this_thread::yield();
+        }
+    });
+
+    std::vector<long long> resting_ids;
+    for (int i = 0; i < NUM_BATCHES; i++) {
+        long long best_bid = 5000 + (i % 40);
+        std::vector<OrderCommand> batch;
+
+        for (long long id : resting_ids) {
+            batch.emplace_back(OrderCommand::Type::CANCEL, i, id, false, -1, 0);
+        }
+        for (int level = 0; level < LEVELS_PER_SIDE; level++) {
+            long long bid_price = best_bid - level;
+            long long ask_price = best_bid + 1 + level;
+            batch.emplace_back(OrderCommand::Type::ADD_LIMIT, i, -1, true, bid_price, (int)(bid_price % 97 + 1));
+            batch.emplace_back(OrderCommand::Type::ADD_LIMIT, i, -1, false, ask_price, (int)(ask_price % 97 + 1));
+        }
+
+        std::vector<OrderResult> results(batch.size());
+        orderbook.apply_batch(batch.data(), batch.size(), results.data(), nullptr, 0);
+
+        resting_ids.clear();
+        for (std::size_t j = batch.size() - 2 * LEVELS_PER_SIDE; j < batch.size(); j++) {
+            resting_ids.push_back(results[j].orderId);
+        }
+    }
+
+    while (reads.load() < 100) {
+        std::this_thread::yield();
+    }
+    done = true;
+    reader.join();
+
+    EXPECT_EQ(torn_reads.load(), 0)
+        << "Readers should only ever see a ladder published at the end of a batch.";
+}
+
+/**
+    ============================================================
+    TEST 24: IcebergReplenishesAtBackOfLevel
+    ============================================================
+    PURPOSE: A resting iceberg shows only its display slice, each filled slice is replenished from the reserve and requeued behind
+             the orders already at the level, and L2 aggregates only ever count visible quantity.
+    ============================================================
+ */
+TEST(OrderBookTest, IcebergReplenishesAtBackOfLevel) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    long long iceberg_id = orderbook.add_iceberg_order(false, 1000, 25, 10, 1);
+    long long plain_id = orderbook.add_limit_order(false, 1000, 5, 2);
+
+    const PriceLevel& level = orderbook.get_sells().at(1000);
+    EXPECT_EQ(level.front().quantity, 10)
+        << "Only the display slice should rest at the level.";
+    EXPECT_EQ(level.front().hiddenQuantity, 15);
+    EXPECT_EQ(level.total_quantity, 15)
+        << "Level aggregate should count the visible slice and the plain order, not the reserve.";
+
+    orderbook.add_IOC_order(true, 10, 3);
+    ASSERT_EQ(orderbook.get_sells().at(1000).size(), 2u);
+    EXPECT_EQ(orderbook.get_sells().at(1000).front().id, plain_id)
+        << "The replenished iceberg should lose priority to the plain order that was queued behind it.";
+    EXPECT_EQ(orderbook.get_sells().at(1000).back().id, iceberg_id);
+    EXPECT_EQ(orderbook.get_sells().at(1000).back().quantity, 10);
+    EXPECT_EQ(orderbook.get_sells().at(1000).back().hiddenQuantity, 5);
+    EXPECT_EQ(orderbook.get_bbo().askQuantity, 15);
+
+    orderbook.add_IOC_order(true, 12, 4);       // plain 5, then 7 of the slice
+    EXPECT_EQ(orderbook.get_sells().at(1000).front().quantity, 3);
+
+    OrderResult result = orderbook.apply(OrderCommand(OrderCommand::Type::ADD_IOC, 5, -1, true, -1, 8));
+    EXPECT_EQ(result.filledQuantity, 8)
+        << "The IOC should take the rest of the slice and the whole last slice.";
+    EXPECT_TRUE(orderbook.get_sells().empty())
+        << "Iceberg should be gone once its reserve is exhausted.";
+    EXPECT_TRUE(orderbook.get_order_lookup().empty());
+
+    int traded_with_iceberg = 0;
+    for (const Trade& trade : orderbook.get_trade_log().get_trades()) {
+        if (trade.sellOrderId == iceberg_id) {
+            traded_with_iceberg += trade.quantity;
+        }
+    }
+    EXPECT_EQ(traded_with_iceberg, 25)
+        << "Every unit of the iceberg, visible or hidden, should have traded under its id.";
+}
+
+/**
+    ============================================================
+    TEST 25: AggressiveIcebergAndModify
+    ============================================================
+    PURPOSE: An incoming iceberg matches with its full quantity before resting a slice, modifies take reserve before visible quantity
+             (keeping priority) and an upsize re-enters it as an iceberg with the same display size.
+    ============================================================
+ */
+TEST(OrderBookTest, AggressiveIcebergAndModify) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(false, 999, 10, 1);
+    OrderResult result = orderbook.apply(OrderCommand(OrderCommand::Type::ADD_ICEBERG, 2, -1, true, 1000, 30, 5));
+
+    EXPECT_EQ(result.status, OrderResult::Status::RESTING);
+    EXPECT_EQ(result.filledQuantity, 10)
+        << "The iceberg should cross with its full size, not only the display slice.";
+    EXPECT_EQ(result.remainingQuantity, 20)
+        << "Remaining quantity should include the hidden reserve.";
+    EXPECT_EQ(orderbook.get_best_bid()->second.total_quantity, 5);
+
+    long long behind_id = orderbook.add_limit_order(true, 1000, 1, 3);
+
+    orderbook.modify_order(result.orderId, 12, 4);
+    const Order& iceberg = orderbook.get_best_bid()->second.front();
+    EXPECT_EQ(iceberg.id, result.orderId)
+        << "Reducing the total should keep the iceberg's priority.";
+    EXPECT_EQ(iceberg.quantity, 5);
+    EXPECT_EQ(iceberg.hiddenQuantity, 7)
+        << "Reduction should come out of the reserve first.";
+
+    orderbook.modify_order(result.orderId, 3, 5);
+    EXPECT_EQ(iceberg.quantity, 3);
+    EXPECT_EQ(iceberg.hiddenQuantity, 0);
+    EXPECT_EQ(orderbook.get_best_bid()->second.total_quantity, 4);
+
+    long long new_id = orderbook.modify_order(result.orderId, 40, 6);
+    EXPECT_NE(new_id, result.orderId);
+    EXPECT_EQ(orderbook.get_best_bid()->second.front().id, behind_id)
+        << "Upsizing should re-enter the iceberg at the back.";
+    EXPECT_EQ(orderbook.get_best_bid()->second.back().quantity, 5);
+    EXPECT_EQ(orderbook.get_best_bid()->second.back().hiddenQuantity, 35);
+}
+
+/**
+    ============================================================
+    TEST 26: StopOrdersTriggerOnTradedPrice
+    ============================================================
+    PURPOSE: Stops stay out of the book until a trade prints at or through their trigger, a stop market order then executes as an IOC
+             and a stop-limit rests at its limit, both under the id the stop was given. A stop already crossed by the last trade enters at once.
+    ============================================================
+ */
+TEST(OrderBookTest, StopOrdersTriggerOnTradedPrice) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(false, 1000, 5, 1);
+    orderbook.add_limit_order(false, 1001, 5, 2);
+    orderbook.add_limit_order(false, 1002, 5, 3);
+
+    long long stop_market_id = orderbook.add_stop_order(true, 1001, -1, 3, 4);
+    OrderResult stop_limit = orderbook.apply(OrderCommand::stop(5, -1, true, 1002, 1003, 20));
+    EXPECT_EQ(stop_limit.status, OrderResult::Status::PENDING);
+    EXPECT_EQ(stop_limit.remainingQuantity, 20);
+    EXPECT_EQ(orderbook.get_buy_stops().size(), 2u);
+    EXPECT_TRUE(orderbook.get_buys().empty())
+        << "Pending stops should not show in the book.";
+
+    orderbook.add_IOC_order(true, 5, 6);        // trades at 1000, below both triggers
+    EXPECT_EQ(orderbook.get_buy_stops().size(), 2u);
+    EXPECT_EQ(orderbook.get_last_trade_price(), 1000);
+
+    orderbook.add_IOC_order(true, 1, 7);        // trades at 1001, releases the stop market order
+    EXPECT_EQ(orderbook.get_buy_stops().size(), 1u);
+    EXPECT_EQ(orderbook.get_sells().at(1001).total_quantity, 1)
+        << "The released stop should have bought 3 more at 1001.";
+    const Trade& stop_trade = orderbook.get_trade_log().get_trades().back();
+    EXPECT_EQ(stop_trade.buyOrderId, stop_market_id)
+        << "A released stop should trade under the id it was parked with.";
+    EXPECT_EQ(stop_trade.quantity, 3);
+
+    orderbook.add_IOC_order(true, 2, 8);        // 1 at 1001, 1 at 1002, releases the stop-limit
+    EXPECT_TRUE(orderbook.get_buy_stops().empty());
+    EXPECT_TRUE(orderbook.get_sells().empty())
+        << "The stop-limit should have taken the 4 left at 1002.";
+    ASSERT_EQ(orderbook.get_buys().size(), 1u);
+    EXPECT_EQ(orderbook.get_best_bid()->first, 1003);
+    EXPECT_EQ(orderbook.get_best_bid()->second.front().id, stop_limit.orderId);
+    EXPECT_EQ(orderbook.get_best_bid()->second.front().quantity, 16);
+    EXPECT_EQ(orderbook.get_bbo().bidPriceTick, 1003)
+        << "The touch should include the released stop once the operation that triggered it is done.";
+
+    orderbook.add_limit_order(false, 1010, 5, 9);
+    long long immediate_id = orderbook.add_stop_order(false, 1005, -1, 2, 10);
+    EXPECT_TRUE(orderbook.get_sell_stops().empty())
+        << "A sell stop above the last traded price should not be parked.";
+    EXPECT_EQ(orderbook.get_trade_log().get_trades().back().sellOrderId, immediate_id);
+    EXPECT_EQ(orderbook.get_best_bid()->second.front().quantity, 14);
+}
+
+/**
+    ============================================================
+    TEST 27: StopCascadeReleasesInPriceOrder
+    ============================================================
+    PURPOSE: Trades of released stops release further stops in the same operation, in trigger order and in arrival order within a trigger,
+             and a pending stop can be cancelled through cancel_order and CANCEL commands.
+    ============================================================
+ */
+TEST(OrderBookTest, StopCascadeReleasesInPriceOrder) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(true, 1000, 5, 1);
+    orderbook.add_limit_order(true, 999, 5, 2);
+    orderbook.add_limit_order(true, 998, 5, 3);
+    orderbook.add_limit_order(true, 997, 5, 4);
+
+    long long first_at_999 = orderbook.add_stop_order(false, 999, -1, 3, 5);
+    long long second_at_999 = orderbook.add_stop_order(false, 999, -1, 2, 6);
+    long long at_998 = orderbook.add_stop_order(false, 998, -1, 5, 7);
+    long long stop_limit_at_997 = orderbook.add_stop_order(false, 997, 996, 6, 8);
+    long long cancelled_at_995 = orderbook.add_stop_order(false, 995, -1, 1, 9);
+
+    EXPECT_EQ(orderbook.cancel_order(cancelled_at_995), 0);
+    EXPECT_EQ(orderbook.apply(OrderCommand(OrderCommand::Type::CANCEL, 10, cancelled_at_995, false, -1, 0)).status, OrderResult::Status::REJECTED)
+        << "A cancelled stop should be gone.";
+
+    std::size_t num_trades_before = orderbook.get_trade_log().get_trades().size();
+    orderbook.add_IOC_order(false, 6, 11);      // 5 at 1000, 1 at 999
+
+    std::vector<long long> sellers;
+    for (auto iter = std::next(orderbook.get_trade_log().get_trades().begin(), num_trades_before); iter != orderbook.get_trade_log().get_trades().end(); ++iter) {
+        sellers.push_back(iter->sellOrderId);
+    }
+    // 999 stops in arrival order (4 left at 999, then 1 at 998), the 998 stop (4 at 998, 1 at 997), then the stop-limit (4 at 997)
+    ASSERT_EQ(sellers.size(), 8u);
+    EXPECT_EQ(sellers[2], first_at_999);
+    EXPECT_EQ(sellers[3], second_at_999);
+    EXPECT_EQ(sellers[4], second_at_999);
+    EXPECT_EQ(sellers[5], at_998);
+    EXPECT_EQ(sellers[6], at_998);
+    EXPECT_EQ(sellers[7], stop_limit_at_997);
+
+    EXPECT_TRUE(orderbook.get_sell_stops().empty());
+    EXPECT_TRUE(orderbook.get_buys().empty());
+    ASSERT_EQ(orderbook.get_sells().size(), 1u);
+    EXPECT_EQ(orderbook.get_best_ask()->first, 996);
+    EXPECT_EQ(orderbook.get_best_ask()->second.front().id, stop_limit_at_997);
+    EXPECT_EQ(orderbook.get_best_ask()->second.total_quantity, 2);
+    EXPECT_EQ(orderbook.get_last_trade_price(), 997);
+}
+
+/**
+    ============================================================
+    TEST 28: FillOrKillAndPostOnly
+    ============================================================
+    PURPOSE: A FOK executes completely or not at all and a post-only order is rejected when it would cross. Neither leaves any trace in the
+             book, the trade log or the L2 feed when it is refused.
+    ============================================================
+ */
+TEST(OrderBookTest, FillOrKillAndPostOnly) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(false, 1000, 5, 1);
+    orderbook.add_limit_order(false, 1001, 5, 2);
+    orderbook.add_limit_order(false, 1003, 5, 3);
+
+    int num_deltas = 0;
+    orderbook.subscribe_l2([&num_deltas](const L2Delta&) { num_deltas++; });
+
+    OrderResult killed = orderbook.apply(OrderCommand(OrderCommand::Type::ADD_FOK, 4, 40, true, 1001, 11));
+    EXPECT_EQ(killed.status, OrderResult::Status::CANCELLED)
+        << "Only 10 are offered at 1001 or better, the FOK should be killed.";
+    EXPECT_EQ(killed.orderId, -1);
+    EXPECT_EQ(killed.filledQuantity, 0);
+    EXPECT_TRUE(orderbook.get_trade_log().get_trades().empty());
+    EXPECT_EQ(num_deltas, 0)
+        << "A killed FOK should not touch any level.";
+
+    OrderResult filled = orderbook.apply(OrderCommand(OrderCommand::Type::ADD_FOK, 5, 41, true, 1001, 8));
+    EXPECT_EQ(filled.status, OrderResult::Status::FILLED);
+    EXPECT_EQ(filled.filledQuantity, 8);
+    EXPECT_EQ(orderbook.get_best_ask()->first, 1001);
+    EXPECT_EQ(orderbook.get_best_ask()->second.total_quantity, 2);
+
+    long long bid_id = orderbook.add_post_only_order(true, 999, 3, 6);
+    EXPECT_NE(bid_id, -1)
+        << "A post-only buy below the best ask should rest.";
+    EXPECT_EQ(orderbook.get_best_bid()->second.front().id, bid_id);
+
+    num_deltas = 0;
+    std::size_t num_trades = orderbook.get_trade_log().get_trades().size();
+    EXPECT_EQ(orderbook.add_post_only_order(true, 1001, 3, 7), -1)
+        << "A post-only buy at the best ask should be rejected.";
+    OrderResult rejected = orderbook.apply(OrderCommand(OrderCommand::Type::ADD_POST_ONLY, 8, 43, false, 999, 3));
+    EXPECT_EQ(rejected.status, OrderResult::Status::REJECTED)
+        << "A post-only sell at the best bid should be rejected.";
+    EXPECT_EQ(rejected.orderId, -1);
+    EXPECT_EQ(num_deltas, 0);
+    EXPECT_EQ(orderbook.get_trade_log().get_trades().size(), num_trades);
+    EXPECT_EQ(orderbook.get_order_lookup().size(), 3u);
+}
+
+/**
+    ============================================================
+    TEST 29: AllOrNoneWaitsForFullQuantity
+    ============================================================
+    PURPOSE: An AON order that can't be filled completely waits off the levels (not displayed, not partially filled by incoming orders),
+             executes in one go as soon as an operation leaves enough quantity at its price, and can be modified or cancelled while waiting.
+    ============================================================
+ */
+TEST(OrderBookTest, AllOrNoneWaitsForFullQuantity) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(false, 1000, 4, 1);
+
+    OrderResult waiting = orderbook.apply(OrderCommand(OrderCommand::Type::ADD_AON, 2, 50, true, 1001, 10));
+    EXPECT_EQ(waiting.status, OrderResult::Status::RESTING);
+    EXPECT_EQ(waiting.filledQuantity, 0)
+        << "An AON order should not take the 4 offered, that would be a partial fill.";
+    EXPECT_EQ(waiting.remainingQuantity, 10);
+    EXPECT_TRUE(orderbook.get_buys().empty())
+        << "A waiting AON order should not be displayed.";
+    EXPECT_EQ(orderbook.get_bbo().bidPriceTick, 0);
+    EXPECT_TRUE(orderbook.get_trade_log().get_trades().empty());
+
+    long long other_id = orderbook.add_AON_order(true, 1001, 20, 3);
+    orderbook.add_limit_order(false, 1002, 50, 4); // above both prices, fills nothing
+
+    orderbook.add_limit_order(false, 1001, 5, 5);   // 9 offered at 1001 or better, still short
+    EXPECT_EQ(orderbook.get_aon_buys().at(1001).size(), 2u);
+
+    orderbook.add_limit_order(false, 1001, 3, 6);   // 12 offered: the first AON fills, the second (20) still can't
+    ASSERT_EQ(orderbook.get_aon_buys().size(), 1u);
+    EXPECT_EQ(orderbook.get_aon_buys().at(1001).front().id, other_id);
+    int traded = 0;
+    for (const Trade& trade : orderbook.get_trade_log().get_trades()) {
+        EXPECT_EQ(trade.buyOrderId, waiting.orderId)
+            << "Only the first AON order should have traded, under its own id.";
+        traded += trade.quantity;
+    }
+    EXPECT_EQ(traded, 10);
+    EXPECT_EQ(orderbook.get_best_ask()->first, 1001);
+    EXPECT_EQ(orderbook.get_best_ask()->second.total_quantity, 2);
+
+    OrderResult modified = orderbook.apply(OrderCommand(OrderCommand::Type::MODIFY, 7, other_id, false, -1, 2));
+    EXPECT_EQ(modified.status, OrderResult::Status::RESTING);
+    EXPECT_TRUE(orderbook.get_aon_buys().empty())
+        << "Shrunk to 2, the AON order should have filled against the 2 left at 1001.";
+    EXPECT_EQ(orderbook.get_best_ask()->first, 1002);
+
+    long long cancelled_id = orderbook.add_AON_order(false, 990, 5, 8);
+    EXPECT_TRUE(orderbook.is_live(cancelled_id));
+    EXPECT_EQ(orderbook.cancel_order(cancelled_id), 0);
+    EXPECT_FALSE(orderbook.is_live(cancelled_id));
+    EXPECT_TRUE(orderbook.get_aon_sells().empty());
+}
+
+/**
+    ============================================================
+    TEST 30: SelfTradePreventionModes
+    ============================================================
+    PURPOSE: With prevention on, an incoming order never trades with a resting order of its own owner: each mode cancels the newest,
+             the oldest or both, or decrements both without a trade. Orders of other owners (or without one) keep matching normally,
+             and with prevention off owners are ignored.
+    ============================================================
+ */
+TEST(OrderBookTest, SelfTradePreventionModes) {
+    using Mode = OrderBook::SelfTradePrevention;
+    const long long OWNER = 7;
+
+    // Resting at 1000, front to back: own 5, other owner 5. Incoming: own buy of 8 at 1000
+    struct Outcome { int traded; int incoming_resting; std::size_t orders_left_at_1000; long long ask_quantity; };
+    auto run = [OWNER](Mode mode, long long incoming_owner) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        orderbook.set_self_trade_prevention(mode);
+        long long own_id = orderbook.add_limit_order(false, 1000, 5, 1, OWNER);
+        orderbook.add_limit_order(false, 1000, 5, 2, 99);
+
+        OrderResult result = orderbook.apply([&]() {
+            OrderCommand command(OrderCommand::Type::ADD_LIMIT, 3, -1, true, 1000, 8);
+            command.ownerId = incoming_owner;
+            return command;
+        }());
+
+        Outcome outcome = {result.filledQuantity, result.remainingQuantity,
+                           orderbook.get_sells().count(1000) ? orderbook.get_sells().at(1000).size() : 0, orderbook.get_bbo().askQuantity};
+        if (mode != Mode::NONE && incoming_owner == OWNER) {
+            for (const Trade& trade : orderbook.get_trade_log().get_trades()) {
+                EXPECT_NE(trade.sellOrderId, own_id)
+                    << "No trade should print against the incoming order's own resting order.";
+            }
+        }
+        return outcome;
+    };
+
+    Outcome off = run(Mode::NONE, OWNER);
+    EXPECT_EQ(off.traded, 8)
+        << "With prevention off the incoming order should trade with its own resting order.";
+
+    Outcome cancel_newest = run(Mode::CANCEL_NEWEST, OWNER);
+    EXPECT_EQ(cancel_newest.traded, 0);
+    EXPECT_EQ(cancel_newest.incoming_resting, 0)
+        << "CANCEL_NEWEST should drop the incoming order.";
+    EXPECT_EQ(cancel_newest.orders_left_at_1000, 2u);
+    EXPECT_EQ(cancel_newest.ask_quantity, 10);
+
+    Outcome cancel_oldest = run(Mode::CANCEL_OLDEST, OWNER);
+    EXPECT_EQ(cancel_oldest.traded, 5)
+        << "CANCEL_OLDEST should cancel the own order and go on matching the other owner's.";
+    EXPECT_EQ(cancel_oldest.incoming_resting, 3);
+    EXPECT_EQ(cancel_oldest.orders_left_at_1000, 0u);
+
+    Outcome cancel_both = run(Mode::CANCEL_BOTH, OWNER);
+    EXPECT_EQ(cancel_both.traded, 0);
+    EXPECT_EQ(cancel_both.incoming_resting, 0);
+    EXPECT_EQ(cancel_both.orders_left_at_1000, 1u)
+        << "CANCEL_BOTH should remove the own resting order too.";
+    EXPECT_EQ(cancel_both.ask_quantity, 5);
+
+    Outcome decrement = run(Mode::DECREMENT, OWNER);
+    EXPECT_EQ(decrement.traded, 3)
+        << "DECREMENT should net 5 against the own order without a trade, then trade the last 3.";
+    EXPECT_EQ(decrement.incoming_resting, 0);
+    EXPECT_EQ(decrement.orders_left_at_1000, 1u);
+    EXPECT_EQ(decrement.ask_quantity, 2);
+
+    Outcome no_owner = run(Mode::CANCEL_NEWEST, 0);
+    EXPECT_EQ(no_owner.traded, 8)
+        << "An incoming order without owner should never be stopped.";
+}
+
+/**
+    ============================================================
+    TEST 31: ProRataAllocation
+    ============================================================
+    PURPOSE: On a PRO_RATA book an incoming order takes from every resting order of a level in proportion to its quantity.
+             Units lost to rounding go to the oldest orders first, so the same input always gives the same fills,
+             and trades still print in time priority.
+    ============================================================
+ */
+TEST(OrderBookTest, ProRataAllocation) {
+    // Shares on their own: exact, then truncated with the remainder handed out oldest first
+    int quantities[] = {10, 30, 60};
+    int shares[3];
+    allocate_pro_rata(quantities, shares, 3, 100, 50);
+    EXPECT_EQ(shares[0], 5);
+    EXPECT_EQ(shares[1], 15);
+    EXPECT_EQ(shares[2], 30);
+
+    int equal_quantities[] = {1, 1, 1, 1};
+    int equal_shares[4];
+    allocate_pro_rata(equal_quantities, equal_shares, 4, 4, 2);
+    EXPECT_EQ(equal_shares[0], 1)
+        << "Units lost to truncation should go to the oldest orders first.";
+    EXPECT_EQ(equal_shares[1], 1);
+    EXPECT_EQ(equal_shares[2], 0);
+    EXPECT_EQ(equal_shares[3], 0);
+
+    Metrics metrics;
+    OrderBook orderbook(metrics, OrderBook::MatchingAlgorithm::PRO_RATA);
+    long long small_id = orderbook.add_limit_order(false, 1000, 10, 1);
+    long long medium_id = orderbook.add_limit_order(false, 1000, 30, 2);
+    long long large_id = orderbook.add_limit_order(false, 1000, 60, 3);
+
+    orderbook.add_IOC_order(true, 50, 4);
+
+    std::vector<Trade> trades(orderbook.get_trade_log().get_trades().begin(), orderbook.get_trade_log().get_trades().end());
+    ASSERT_EQ(trades.size(), 3u)
+        << "Every order of the level should get a share.";
+    EXPECT_EQ(trades[0].sellOrderId, small_id);
+    EXPECT_EQ(trades[0].quantity, 5);
+    EXPECT_EQ(trades[1].sellOrderId, medium_id);
+    EXPECT_EQ(trades[1].quantity, 15);
+    EXPECT_EQ(trades[2].sellOrderId, large_id);
+    EXPECT_EQ(trades[2].quantity, 30);
+    EXPECT_EQ(orderbook.get_sells().at(1000).total_quantity, 50);
+    EXPECT_EQ(orderbook.get_bbo().askQuantity, 50);
+
+    // Rounding: 7 out of three orders of 5, the oldest gets the extra unit
+    Metrics rounding_metrics;
+    OrderBook rounding_book(rounding_metrics, OrderBook::MatchingAlgorithm::PRO_RATA);
+    long long first_id = rounding_book.add_limit_order(true, 900, 5, 1);
+    rounding_book.add_limit_order(true, 900, 5, 2);
+    rounding_book.add_limit_order(true, 900, 5, 3);
+    rounding_book.add_limit_order(false, 900, 7, 4);
+
+    std::vector<Trade> rounding_trades(rounding_book.get_trade_log().get_trades().begin(), rounding_book.get_trade_log().get_trades().end());
+    ASSERT_EQ(rounding_trades.size(), 3u);
+    EXPECT_EQ(rounding_trades[0].buyOrderId, first_id);
+    EXPECT_EQ(rounding_trades[0].quantity, 3);
+    EXPECT_EQ(rounding_trades[1].quantity, 2);
+    EXPECT_EQ(rounding_trades[2].quantity, 2);
+
+    // A sweep through the level empties it and goes on at the next price, the rest of the limit order rests
+    Metrics sweep_metrics;
+    OrderBook sweep_book(sweep_metrics, OrderBook::MatchingAlgorithm::PRO_RATA);
+    sweep_book.add_limit_order(false, 1000, 10, 1);
+    sweep_book.add_limit_order(false, 1000, 20, 2);
+    sweep_book.add_limit_order(false, 1001, 10, 3);
+    long long sweep_id = sweep_book.add_limit_order(true, 1001, 45, 4);
+
+    EXPECT_EQ(sweep_book.get_sells().count(1000), 0u)
+        << "A fully taken level should be erased.";
+    EXPECT_EQ(sweep_book.get_sells().count(1001), 0u);
+    ASSERT_EQ(sweep_book.get_buys().count(1001), 1u);
+    EXPECT_EQ(sweep_book.get_buys().at(1001).front().id, sweep_id);
+    EXPECT_EQ(sweep_book.get_buys().at(1001).total_quantity, 5);
+}
+
+/**
+    ============================================================
+    TEST 32: HybridFifoProRataAllocation
+    ============================================================
+    PURPOSE: On a FIFO_PRO_RATA book the first HYBRID_FIFO_PERCENT of what is taken from a level goes in time priority,
+             the rest is shared pro-rata over what the orders have left.
+    ============================================================
+ */
+TEST(OrderBookTest, HybridFifoProRataAllocation) {
+    static_assert(OrderBook::HYBRID_FIFO_PERCENT == 40, "Expectations below assume a 40% FIFO share.");
+
+    Metrics metrics;
+    OrderBook orderbook(metrics, OrderBook::MatchingAlgorithm::FIFO_PRO_RATA);
+    long long first_id = orderbook.add_limit_order(false, 1000, 10, 1);
+    long long second_id = orderbook.add_limit_order(false, 1000, 30, 2);
+    long long third_id = orderbook.add_limit_order(false, 1000, 60, 3);
+
+    orderbook.add_IOC_order(true, 50, 4);
+
+    // FIFO 20: 10 + 10. Pro-rata 30 over 0, 20, 60: 0, 7.5, 22.5 -> 0, 8, 22 with the rounding unit going to the oldest order with room
+    std::vector<Trade> trades(orderbook.get_trade_log().get_trades().begin(), orderbook.get_trade_log().get_trades().end());
+    ASSERT_EQ(trades.size(), 3u);
+    EXPECT_EQ(trades[0].sellOrderId, first_id);
+    EXPECT_EQ(trades[0].quantity, 10)
+        << "The oldest order should be filled completely by the FIFO share.";
+    EXPECT_EQ(trades[1].sellOrderId, second_id);
+    EXPECT_EQ(trades[1].quantity, 18);
+    EXPECT_EQ(trades[2].sellOrderId, third_id);
+    EXPECT_EQ(trades[2].quantity, 22);
+
+    const PriceLevel& level = orderbook.get_sells().at(1000);
+    EXPECT_EQ(level.size(), 2u);
+    EXPECT_EQ(level.total_quantity, 50);
+    EXPECT_EQ(orderbook.get_order_lookup().count(first_id), 0u);
+}
+
+/**
+    ============================================================
+    TEST 33: AllocationRulesKeepBookConsistent
+    ============================================================
+    PURPOSE: A random stream of limits, icebergs, IOCs and cancels spread over a few owners, with self-trade prevention on,
+             leaves every book consistent under each allocation rule: level totals match their orders, the lookup holds exactly
+             the resting orders, the book never stays crossed and no trade is between two orders of the same owner.
+    ============================================================
+ */
+TEST(OrderBookTest, AllocationRulesKeepBookConsistent) {
+    using Algorithm = OrderBook::MatchingAlgorithm;
+
+    for (Algorithm algorithm : {Algorithm::FIFO, Algorithm::PRO_RATA, Algorithm::FIFO_PRO_RATA}) {
+        Metrics metrics;
+        OrderBook orderbook(metrics, algorithm);
+        orderbook.set_self_trade_prevention(OrderBook::SelfTradePrevention::DECREMENT);
+        std::mt19937 rng(5);
+        std::vector<long long> ids;
+        std::unordered_map<long long, long long> owners;
+
+        for (int i = 0; i < 3000; i++) {
+            int kind = (int)(rng() % 10);
+            bool is_buy = rng() % 2 == 0;
+            long long owner = 1 + (long long)(rng() % 3);
+            long long price = 1000 + (long long)(rng() % 10);
+            int quantity = 1 + (int)(rng() % 40);
+            long long id = -1;
+
+            if (kind < 5) {
+                id = orderbook.add_limit_order(is_buy, price, quantity, i, owner);
+            }
+            else if (kind < 7) {
+                id = orderbook.add_iceberg_order(is_buy, price, quantity + 20, 5, i, owner);
+            }
+            else if (kind < 9) {
+                id = orderbook.add_IOC_order(is_buy, quantity, i, owner);
+            }
+            else if (!ids.empty()) {
+                long long target = ids[rng() % ids.size()];
+                if (orderbook.is_live(target)) {
+                    orderbook.cancel_order(target);
+                }
+            }
+            if (id != -1) {
+                ids.push_back(id);
+                owners[id] = owner;
+            }
+
+            if (!orderbook.get_buys().empty() && !orderbook.get_sells().empty()) {
+                ASSERT_LT(orderbook.get_buys().rbegin()->first, orderbook.get_sells().begin()->first)
+                    << "The book should never stay crossed.";
+            }
+        }
+
+        std::size_t num_orders = 0;
+        for (const auto* side : {&orderbook.get_buys(), &orderbook.get_sells()}) {
+            for (const auto& [price, level] : *side) {
+                long long total = 0;
+                for (const Order& order : level) {
+                    EXPECT_GT(order.quantity, 0);
+                    EXPECT_EQ(orderbook.get_order_lookup().count(order.id), 1u);
+                    total += order.quantity;
+                    num_orders++;
+                }
+                EXPECT_EQ(level.total_quantity, total)
+                    << "Level total should match its orders at price " << price << ".";
+            }
+        }
+        EXPECT_EQ(orderbook.get_order_lookup().size(), num_orders);
+
+        for (const Trade& trade : orderbook.get_trade_log().get_trades()) {
+            EXPECT_GT(trade.quantity, 0);
+            EXPECT_NE(owners[trade.buyOrderId], owners[trade.sellOrderId])
+                << "No trade should be between two orders of the same owner.";
+        }
+    }
+}
+
+/**
+    ============================================================
+    TEST 34: CallAuctionUncross
+    ============================================================
+    PURPOSE: While an auction is open orders rest without matching and the book may cross, IOCs and FOKs execute nothing.
+             The uncross executes at the price that maximises volume, every trade at that price, best bids against best asks in time priority,
+             then continuous matching resumes on the uncrossed remainder.
+    ============================================================
+ */
+TEST(OrderBookTest, CallAuctionUncross) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    orderbook.open_auction();
+    EXPECT_TRUE(orderbook.is_auction_open());
+
+    long long bid_105 = orderbook.add_limit_order(true, 105, 10, 1);
+    long long bid_104 = orderbook.add_limit_order(true, 104, 20, 2);
+    long long bid_102 = orderbook.add_limit_order(true, 102, 15, 3);
+    long long ask_101 = orderbook.add_limit_order(false, 101, 5, 4);
+    long long ask_103 = orderbook.add_limit_order(false, 103, 20, 5);
+    long long ask_104 = orderbook.add_limit_order(false, 104, 10, 6);
+    orderbook.add_limit_order(false, 106, 10, 7);
+    orderbook.add_IOC_order(true, 50, 8);
+    EXPECT_EQ(orderbook.add_FOK_order(true, 110, 5, 9), -1)
+        << "A FOK can't execute during the auction and should be killed.";
+
+    EXPECT_TRUE(orderbook.get_trade_log().get_trades().empty())
+        << "Nothing should trade while the auction is open.";
+    EXPECT_EQ(orderbook.get_bbo().bidPriceTick, 105);
+    EXPECT_EQ(orderbook.get_bbo().askPriceTick, 101)
+        << "The book should be allowed to cross during the auction.";
+
+    // Bids at or above / asks at or below: 101: 45/5, 102: 45/5, 103: 30/25, 104: 30/35, 105: 10/35 -> 30 at 104
+    OrderBook::UncrossResult result = orderbook.uncross(10);
+    EXPECT_EQ(result.priceTick, 104);
+    EXPECT_EQ(result.volume, 30);
+    EXPECT_EQ(result.imbalance, -5);
+    EXPECT_FALSE(orderbook.is_auction_open());
+
+    std::vector<Trade> trades(orderbook.get_trade_log().get_trades().begin(), orderbook.get_trade_log().get_trades().end());
+    ASSERT_EQ(trades.size(), 4u);
+    long long expected[4][3] = {{bid_105, ask_101, 5}, {bid_105, ask_103, 5}, {bid_104, ask_103, 15}, {bid_104, ask_104, 5}};
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(trades[i].buyOrderId, expected[i][0]) << "Trade " << i;
+        EXPECT_EQ(trades[i].sellOrderId, expected[i][1]) << "Trade " << i;
+        EXPECT_EQ(trades[i].quantity, expected[i][2]) << "Trade " << i;
+        EXPECT_EQ(trades[i].priceTick, 104)
+            << "Every auction trade should print at the clearing price.";
+    }
+
+    EXPECT_EQ(orderbook.get_bbo().bidPriceTick, 102);
+    EXPECT_EQ(orderbook.get_bbo().askPriceTick, 104);
+    EXPECT_EQ(orderbook.get_bbo().askQuantity, 5);
+    EXPECT_EQ(orderbook.get_order_lookup().count(bid_102), 1u);
+    EXPECT_EQ(orderbook.get_last_trade_price(), 104);
+
+    // Back to continuous matching
+    orderbook.add_IOC_order(true, 5, 11);
+    EXPECT_EQ(orderbook.get_trade_log().get_trades().size(), 5u);
+    EXPECT_EQ(orderbook.get_sells().count(104), 0u);
+
+    // An uncross of a book that doesn't cross executes nothing
+    orderbook.open_auction();
+    OrderBook::UncrossResult empty_result = orderbook.uncross(12);
+    EXPECT_EQ(empty_result.priceTick, -1);
+    EXPECT_EQ(empty_result.volume, 0);
+}
+
+/**
+    ============================================================
+    TEST 35: UncrossMatchesBruteForce
+    ============================================================
+    PURPOSE: On random crossed books with icebergs, the clearing volume equals the best min(bids at or above, asks at or below)
+             over every price, counting iceberg reserve, the trades add up to it and the book is no longer crossed afterwards.
+    ============================================================
+ */
+TEST(OrderBookTest, UncrossMatchesBruteForce) {
+    std::mt19937 rng(23);
+
+    for (int round = 0; round < 20; round++) {
+        Metrics metrics;
+        OrderBook orderbook(metrics);
+        orderbook.open_auction();
+        std::vector<std::pair<long long, long long>> bids; // price, full quantity
+        std::vector<std::pair<long long, long long>> asks;
+
+        for (int i = 0; i < 200; i++) {
+            bool is_buy = rng() % 2 == 0;
+            long long price = 990 + (long long)(rng() % 20);
+            int quantity = 1 + (int)(rng() % 30);
+            if (rng() % 4 == 0) {
+                orderbook.add_iceberg_order(is_buy, price, quantity + 20, 5, i);
+                quantity += 20;
+            }
+            else {
+                orderbook.add_limit_order(is_buy, price, quantity, i);
+            }
+            (is_buy ? bids : asks).push_back({price, quantity});
+        }
+
+        long long best_volume = 0;
+        for (long long price = 990; price < 1010; price++) {
+            long long bid_quantity = 0;
+            long long ask_quantity = 0;
+            for (const auto& [bid_price, quantity] : bids) {
+                bid_quantity += bid_price >= price ? quantity : 0;
+            }
+            for (const auto& [ask_price, quantity] : asks) {
+                ask_quantity += ask_price <= price ? quantity : 0;
+            }
+            best_volume = std::max(best_volume, std::min(bid_quantity, ask_quantity));
+        }
+
+        OrderBook::UncrossResult result = orderbook.uncross(1000);
+        EXPECT_EQ(result.volume, best_volume)
+            << "Clearing volume should be the maximum executable volume in round " << round << ".";
+
+        long long traded = 0;
+        for (const Trade& trade : orderbook.get_trade_log().get_trades()) {
+            EXPECT_EQ(trade.priceTick, result.priceTick);
+            traded += trade.quantity;
+        }
+        EXPECT_EQ(traded, result.volume);
+
+        if (!orderbook.get_buys().empty() && !orderbook.get_sells().empty()) {
+            EXPECT_LT(orderbook.get_buys().rbegin()->first, orderbook.get_sells().begin()->first)
+                << "The book should not be crossed after the uncross in round " << round << ".";
+        }
+        for (const auto* side : {&orderbook.get_buys(), &orderbook.get_sells()}) {
+            for (const auto& [price, level] : *side) {
+                long long hidden = 0;
+                for (const Order& order : level) {
+                    hidden += order.hiddenQuantity;
+                }
+                EXPECT_EQ(level.hidden_quantity, hidden)
+                    << "Level reserve total should match its icebergs at price " << price << ".";
+            }
+        }
+    }
+}
+
+/**
+    ============================================================
+    TEST 36: StopsIgnoreTradesBeforeThem
+    ============================================================
+    PURPOSE: A stop is triggered only by trades printed after it was parked. Prices traded earlier, while no stop or only an uncrossed
+             stop on the other side was waiting, must not release it.
+    ============================================================
+ */
+TEST(OrderBookTest, StopsIgnoreTradesBeforeThem) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+
+    orderbook.add_limit_order(false, 105, 1, 1);
+    orderbook.add_IOC_order(true, 1, 2);         // trades at 105, above the trigger below
+    orderbook.add_limit_order(true, 95, 1, 3);
+    orderbook.add_IOC_order(false, 1, 4);        // trades back at 95
+    orderbook.add_limit_order(false, 120, 5, 5);
+
+    long long buy_stop_id = orderbook.add_stop_order(true, 100, 130, 2, 6);
+    EXPECT_EQ(orderbook.get_buy_stops().size(), 1u)
+        << "The 105 printed before the stop was parked should not trigger it.";
+    EXPECT_EQ(orderbook.get_best_ask()->second.total_quantity, 5);
+
+    orderbook.cancel_order(buy_stop_id);
+    orderbook.add_stop_order(false, 50, -1, 1, 7);  // a sell stop far below keeps the stop book non-empty
+    orderbook.add_limit_order(true, 110, 1, 8);
+    orderbook.add_IOC_order(false, 1, 9);        // trades at 110 while only the sell stop waits
+    orderbook.add_limit_order(true, 90, 1, 10);
+    orderbook.add_IOC_order(false, 1, 11);       // trades back at 90
+
+    orderbook.add_stop_order(true, 100, 130, 2, 12);
+    EXPECT_EQ(orderbook.get_buy_stops().size(), 1u)
+        << "Trades printed while only a stop on the other side waited should not trigger a later stop.";
+    EXPECT_EQ(orderbook.get_sell_stops().size(), 1u);
+    EXPECT_EQ(orderbook.get_best_ask()->second.total_quantity, 5);
+
+    orderbook.add_limit_order(false, 101, 1, 13);
+    orderbook.add_IOC_order(true, 1, 14);        // trades at 101, through the trigger
+    EXPECT_TRUE(orderbook.get_buy_stops().empty())
+        << "A trade after the stop was parked should still trigger it.";
+    EXPECT_EQ(orderbook.get_best_ask()->second.total_quantity, 3);
+}
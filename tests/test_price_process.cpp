@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+#include "../include/PriceProcess.h"
+
+namespace {
+    // Log returns of a generated path, the first one from start_price
+    std::vector<double> log_returns(const std::vector<double>& prices, double start_price) {
+        std::vector<double> returns(prices.size());
+        double previous = start_price;
+        for (std::size_t i = 0; i < prices.size(); i++) {
+            returns[i] = std::log(prices[i] / previous);
+            previous = prices[i];
+        }
+        return returns;
+    }
+
+    double mean(const std::vector<double>& values) {
+        double sum = 0;
+        for (double value : values) {
+            sum += value;
+        }
+        return sum / values.size();
+    }
+
+    double variance(const std::vector<double>& values) {
+        double average = mean(values);
+        double sum = 0;
+        for (double value : values) {
+            sum += (value - average) * (value - average);
+        }
+        return sum / values.size();
+    }
+}
+
+/**
+    ============================================================
+    TEST 1: BlocksDoNotChangeThePath
+    ============================================================
+    PURPOSE: Verify a path only depends on the seed: generating it in one block or in blocks of uneven sizes gives the same prices and
+             volatilities, jumps falling across block boundaries included
+    ============================================================
+*/
+TEST(PriceProcessTest, BlocksDoNotChangeThePath) {
+    const std::size_t num_steps = 5000;
+    const std::size_t block_sizes[] = {1, 7, 256, 1000};
+
+    GbmProcess whole_gbm(10000, 0, 1e-3, 5);
+    JumpDiffusionProcess whole_jumps(10000, 0, 1e-3, 0.05, 0, 0.01, 5);
+    std::vector<double> gbm_prices(num_steps), gbm_volatilities(num_steps), jump_prices(num_steps), jump_volatilities(num_steps);
+    whole_gbm.generate(gbm_prices.data(), gbm_volatilities.data(), num_steps);
+    whole_jumps.generate(jump_prices.data(), jump_volatilities.data(), num_steps);
+
+    GbmProcess blocked_gbm(10000, 0, 1e-3, 5);
+    JumpDiffusionProcess blocked_jumps(10000, 0, 1e-3, 0.05, 0, 0.01, 5);
+    std::vector<double> prices(num_steps), volatilities(num_steps);
+    std::size_t step = 0;
+    for (std::size_t block = 0; step < num_steps; block++) {
+        std::size_t block_size = std::min(block_sizes[block % 4], num_steps - step);
+        blocked_gbm.generate(prices.data() + step, volatilities.data() + step, block_size);
+        for (std::size_t i = step; i < step + block_size; i++) {
+            ASSERT_EQ(prices[i], gbm_prices[i]) << "GBM price of step " << i << " should not depend on the blocks." << std::endl;
+            ASSERT_EQ(volatilities[i], gbm_volatilities[i]) << "GBM volatility of step " << i << " should not depend on the blocks." << std::endl;
+        }
+        blocked_jumps.generate(prices.data() + step, volatilities.data() + step, block_size);
+        for (std::size_t i = step; i < step + block_size; i++) {
+            ASSERT_EQ(prices[i], jump_prices[i]) << "Jump-diffusion price of step " << i << " should not depend on the blocks." << std::endl;
+        }
+        step += block_size;
+    }
+}
+
+/**
+    ============================================================
+    TEST 2: GbmLogReturnsMatchItsParameters
+    ============================================================
+    PURPOSE: Verify GBM log returns have the Ito corrected drift and the volatility per step, and that the reported volatility is in ticks
+    ============================================================
+*/
+TEST(PriceProcessTest, GbmLogReturnsMatchItsParameters) {
+    const std::size_t num_steps = 200000;
+    const double drift = 1e-4, sigma = 2e-3;
+    GbmProcess process(10000, drift, sigma);
+
+    std::vector<double> prices(num_steps), volatilities(num_steps);
+    process.generate(prices.data(), volatilities.data(), num_steps);
+    std::vector<double> returns = log_returns(prices, 10000);
+
+    // Standard error of the mean is sigma / sqrt(200000) = 4.5e-6
+    EXPECT_NEAR(mean(returns), drift - 0.5 * sigma * sigma, 2.5e-5) << "Mean log return should be the Ito corrected drift." << std::endl;
+    EXPECT_NEAR(std::sqrt(variance(returns)), sigma, 0.02 * sigma) << "Log returns should have the volatility per step." << std::endl;
+    for (std::size_t i = 0; i < num_steps; i += 1000) {
+        ASSERT_DOUBLE_EQ(volatilities[i], sigma * prices[i]) << "Volatility should be sigma times the price in ticks." << std::endl;
+        ASSERT_GT(prices[i], 0) << "GBM prices should stay positive." << std::endl;
+    }
+}
+
+/**
+    ============================================================
+    TEST 3: OrnsteinUhlenbeckRevertsToTheMean
+    ============================================================
+    PURPOSE: Verify an Ornstein-Uhlenbeck price started away from its mean comes back to it at the reversion speed, then stays around it
+             with the stationary variance volatility^2 / (2 reversion)
+    ============================================================
+*/
+TEST(PriceProcessTest, OrnsteinUhlenbeckRevertsToTheMean) {
+    const double reversion = 0.01, sigma = 2.0;
+    OrnsteinUhlenbeckProcess process(11000, 10000, reversion, sigma);
+
+    // 1000 away, exp(-0.01 * 300) of it left after 300 steps: about 50, give or take the stationary deviation of 14
+    std::vector<double> prices(300), volatilities(300);
+    process.generate(prices.data(), volatilities.data(), prices.size());
+    EXPECT_NEAR(prices.back(), 10000 + 1000 * std::exp(-reversion * 300), 60) << "Price should have reverted most of the way to the mean." << std::endl;
+
+    prices.resize(400000);
+    volatilities.resize(400000);
+    process.generate(prices.data(), volatilities.data(), prices.size());
+    EXPECT_NEAR(mean(prices), 10000, 1.5) << "Price should hover around the mean." << std::endl;
+    EXPECT_NEAR(variance(prices), sigma * sigma / (2 * reversion), 0.1 * sigma * sigma / (2 * reversion)) << "Stationary variance should be sigma^2 / (2 reversion)." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 4: GarchClustersVolatility
+    ============================================================
+    PURPOSE: Verify GARCH(1,1) returns have the long run variance on average, and that large returns cluster: squared returns are positively
+             autocorrelated and the returns have fat tails
+    ============================================================
+*/
+TEST(PriceProcessTest, GarchClustersVolatility) {
+    const std::size_t num_steps = 400000;
+    GarchProcess process(10000, 1e-7, 0.1, 0.85);
+
+    std::vector<double> prices(num_steps), volatilities(num_steps);
+    process.generate(prices.data(), volatilities.data(), num_steps);
+    std::vector<double> returns = log_returns(prices, 10000);
+
+    double long_run = process.get_long_run_variance();
+    EXPECT_NEAR(variance(returns), long_run, 0.1 * long_run) << "Returns should have the long run variance omega / (1 - alpha - beta)." << std::endl;
+
+    std::vector<double> squared(num_steps);
+    for (std::size_t i = 0; i < num_steps; i++) {
+        squared[i] = returns[i] * returns[i];
+    }
+    double squared_mean = mean(squared), squared_variance = variance(squared);
+    double covariance = 0;
+    for (std::size_t i = 1; i < num_steps; i++) {
+        covariance += (squared[i] - squared_mean) * (squared[i - 1] - squared_mean);
+    }
+    double autocorrelation = covariance / (num_steps - 1) / squared_variance;
+    double kurtosis = squared_variance / (squared_mean * squared_mean) + 1;
+
+    EXPECT_GT(autocorrelation, 0.1) << "Squared returns should be autocorrelated. Autocorrelation: " << autocorrelation << "." << std::endl;
+    EXPECT_GT(kurtosis, 3.5) << "Returns should have fatter tails than a normal. Kurtosis: " << kurtosis << "." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 5: JumpDiffusionJumpsAtItsRate
+    ============================================================
+    PURPOSE: Verify jumps happen with the jump probability per step and have the jump size. Without diffusion every step moves the log
+             price by the compensated drift, so the jumps are exactly the steps that move more
+    ============================================================
+*/
+TEST(PriceProcessTest, JumpDiffusionJumpsAtItsRate) {
+    const std::size_t num_steps = 100000;
+    const double jump_probability = 0.01, jump = 0.01;
+    JumpDiffusionProcess process(10000, 0, 0, jump_probability, jump, 0);
+
+    std::vector<double> prices(num_steps), volatilities(num_steps);
+    process.generate(prices.data(), volatilities.data(), num_steps);
+    std::vector<double> returns = log_returns(prices, 10000);
+
+    double drift = -jump_probability * (std::exp(jump) - 1);
+    std::size_t num_jumps = 0;
+    for (double log_return : returns) {
+        if (log_return > drift + jump / 2) {
+            EXPECT_NEAR(log_return, drift + jump, 1e-9) << "A jump should move the log price by the jump size." << std::endl;
+            num_jumps++;
+        }
+        else {
+            EXPECT_NEAR(log_return, drift, 1e-9) << "Steps without a jump should only move by the drift." << std::endl;
+        }
+    }
+    // 1000 expected, the standard deviation is 31.5
+    EXPECT_NEAR((double)num_jumps, 1000, 120) << "Jumps should come with the jump probability per step." << std::endl;
+    EXPECT_NEAR(volatilities[0] / prices[0], std::sqrt(jump_probability * (1 - jump_probability)) * jump, 1e-12)
+        << "Volatility should account for the jumps." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 6: RejectsInvalidParameters
+    ============================================================
+    PURPOSE: Verify processes refuse parameters they cannot simulate: non positive prices, negative volatilities, no mean reversion,
+             a non stationary GARCH and jump probabilities outside [0, 1]
+    ============================================================
+*/
+TEST(PriceProcessTest, RejectsInvalidParameters) {
+    EXPECT_THROW(GbmProcess(0, 0, 1e-3), std::runtime_error);
+    EXPECT_THROW(GbmProcess(10000, 0, -1e-3), std::runtime_error);
+    EXPECT_THROW(OrnsteinUhlenbeckProcess(10000, 10000, 0, 1), std::runtime_error);
+    EXPECT_THROW(GarchProcess(10000, 1e-7, 0.2, 0.8), std::runtime_error);
+    EXPECT_THROW(GarchProcess(10000, 0, 0.1, 0.8), std::runtime_error);
+    EXPECT_THROW(JumpDiffusionProcess(10000, 0, 1e-3, 1.5, 0, 0.01), std::runtime_error);
+    EXPECT_NO_THROW(GarchProcess(10000, 1e-7, 0.1, 0.85));
+}
@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "../include/QueuePositionModel.h"
+
+namespace {
+    struct RecordedFill {
+        long long orderId;
+        bool isBuy;
+        long long priceTick;
+        int quantity;
+    };
+}
+
+/**
+    ============================================================
+    TEST 1: FillsOnlyOnceQueueAheadIsTraded
+    ============================================================
+    PURPOSE: Verify trades at the order's price first consume the volume ahead of it, and only the part of a trade reaching past that volume fills it
+    ============================================================
+*/
+TEST(QueuePositionTest, FillsOnlyOnceQueueAheadIsTraded) {
+    std::vector<RecordedFill> fills;
+    QueuePositionModel model([&fills](long long order_id, bool isBuy, long long priceTick, int quantity) {
+        fills.push_back({order_id, isBuy, priceTick, quantity});
+    });
+
+    model.track(1, true, 100, 50, 300);
+
+    model.on_trade(true, 100, 200);
+    EXPECT_TRUE(fills.empty())
+        << "200 traded out of the 300 ahead should not reach the order.";
+    ASSERT_NE(model.find(1), nullptr);
+    EXPECT_EQ(model.find(1)->volumeAhead, 100)
+        << "The volume ahead should be down to 100. Current volume ahead: " << model.find(1)->volumeAhead << ".";
+
+    model.on_trade(false, 100, 500);
+    model.on_trade(true, 101, 500);
+    EXPECT_TRUE(fills.empty())
+        << "Trades on the other side, or at another price without trading through, should not fill the order.";
+
+    model.on_trade(true, 100, 130);
+    ASSERT_EQ(fills.size(), 1);
+    EXPECT_EQ(fills[0].orderId, 1);
+    EXPECT_TRUE(fills[0].isBuy);
+    EXPECT_EQ(fills[0].priceTick, 100);
+    EXPECT_EQ(fills[0].quantity, 30)
+        << "Only the 30 traded past the queue ahead should fill the order. Filled: " << fills[0].quantity << ".";
+    EXPECT_EQ(model.find(1)->quantity, 20);
+    EXPECT_EQ(model.find(1)->volumeAhead, 0);
+
+    model.on_trade(true, 100, 40);
+    ASSERT_EQ(fills.size(), 2);
+    EXPECT_EQ(fills[1].quantity, 20)
+        << "The rest of the order should fill. Filled: " << fills[1].quantity << ".";
+    EXPECT_EQ(model.find(1), nullptr)
+        << "A fully filled order should no longer be tracked.";
+    EXPECT_EQ(model.size(), 0);
+}
+
+/**
+    ============================================================
+    TEST 2: TradeThroughFillsCompletely
+    ============================================================
+    PURPOSE: Verify a trade at a worse price fills every tracked order at a better price on that side completely, whatever their queue
+    ============================================================
+*/
+TEST(QueuePositionTest, TradeThroughFillsCompletely) {
+    std::vector<RecordedFill> fills;
+    QueuePositionModel model([&fills](long long order_id, bool isBuy, long long priceTick, int quantity) {
+        fills.push_back({order_id, isBuy, priceTick, quantity});
+    });
+
+    model.track(1, false, 101, 10, 1000);
+    model.track(2, false, 102, 20, 1000);
+    model.track(3, false, 104, 30, 1000);
+    model.track(4, true, 99, 40, 0);
+
+    model.on_trade(false, 103, 1);
+    ASSERT_EQ(fills.size(), 2)
+        << "The asks at 101 and 102 should have been traded through by a trade at 103.";
+    EXPECT_EQ(fills[0].orderId, 1);
+    EXPECT_EQ(fills[0].quantity, 10);
+    EXPECT_EQ(fills[0].priceTick, 101)
+        << "A traded through order fills at its own price.";
+    EXPECT_EQ(fills[1].orderId, 2);
+    EXPECT_EQ(fills[1].quantity, 20);
+    EXPECT_NE(model.find(3), nullptr)
+        << "The ask behind the trade price should still be resting.";
+    EXPECT_NE(model.find(4), nullptr)
+        << "The bid should be untouched by a trade against the asks.";
+    EXPECT_EQ(model.size(), 2);
+}
+
+/**
+    ============================================================
+    TEST 3: UntrackMovesOrdersBehindForward
+    ============================================================
+    PURPOSE: Verify that when a tracked order leaves, the tracked orders behind it at its price gain its remaining quantity, and the ones ahead of it do not
+    ============================================================
+*/
+TEST(QueuePositionTest, UntrackMovesOrdersBehindForward) {
+    QueuePositionModel model([](long long, bool, long long, int) {});
+
+    model.track(1, true, 100, 50, 100);
+    model.track(2, true, 100, 50, 150);
+    model.track(3, true, 100, 50, 200);
+    model.track(4, true, 99, 50, 200);
+
+    EXPECT_TRUE(model.untrack(2));
+    EXPECT_FALSE(model.untrack(2))
+        << "An order can only be untracked once.";
+
+    EXPECT_EQ(model.find(1)->volumeAhead, 100)
+        << "The order ahead should keep its position.";
+    EXPECT_EQ(model.find(3)->volumeAhead, 150)
+        << "The order behind should move up by 50. Current volume ahead: " << model.find(3)->volumeAhead << ".";
+    EXPECT_EQ(model.find(4)->volumeAhead, 200)
+        << "An order at another price should keep its position.";
+}
+
+/**
+    ============================================================
+    TEST 4: CancelsReduceQueueProportionally
+    ============================================================
+    PURPOSE: Verify a cancel at the order's price removes its proportional share of the volume ahead of each tracked order
+    ============================================================
+*/
+TEST(QueuePositionTest, CancelsReduceQueueProportionally) {
+    QueuePositionModel model([](long long, bool, long long, int) {});
+
+    model.track(1, false, 105, 10, 100);
+    model.track(2, false, 105, 10, 300);
+
+    model.on_cancel(false, 105, 200, 400);
+    EXPECT_EQ(model.find(1)->volumeAhead, 50)
+        << "Half the level was cancelled, half of the 100 ahead should be gone. Current volume ahead: " << model.find(1)->volumeAhead << ".";
+    EXPECT_EQ(model.find(2)->volumeAhead, 150)
+        << "Half the level was cancelled, half of the 300 ahead should be gone. Current volume ahead: " << model.find(2)->volumeAhead << ".";
+
+    model.on_cancel(false, 105, 1000, 200);
+    EXPECT_EQ(model.find(1)->volumeAhead, 0)
+        << "Cancelling the whole level should clear the queue ahead.";
+    EXPECT_EQ(model.find(2)->volumeAhead, 0);
+
+    model.on_cancel(true, 105, 10, 10);
+    model.on_cancel(false, 106, 10, 10);
+    EXPECT_EQ(model.size(), 2)
+        << "Cancels elsewhere should change nothing.";
+}
@@ -0,0 +1,392 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+#include "../include/ReplayEngine.h"
+#include "../include/ReplayLog.h"
+
+namespace {
+    OrderCommand owned_by(OrderCommand command, long long owner_id) {
+        command.ownerId = owner_id;
+        return command;
+    }
+
+    // Builds a deterministic day of random flow around a mid of 10000 ticks: mostly limit adds (some of them icebergs or all-or-none), with cancels, modifies, IOC sweeps and stops mixed in.
+    // Orders other than all-or-none belong to one of three owners.
+    ReplayLog make_random_replay_log(int num_events, long long step_us, unsigned int seed) {
+        ReplayLog replay_log;
+        std::mt19937 engine(seed);
+        std::uniform_int_distribution<int> action(0, 9);
+        std::uniform_int_distribution<int> side(0, 1);
+        std::uniform_int_distribution<int> offset(1, 6);
+        std::uniform_int_distribution<int> quantity(1, 20);
+
+        std::vector<long long> added_ids;
+        long long next_recorded_id = 1;
+
+        for (int i = 0; i < num_events; i++) {
+            long long timestamp_us = (i + 1) * step_us;
+            int roll = action(engine);
+            bool is_buy = side(engine) == 1;
+
+            if (roll < 6 || added_ids.empty()) {
+                long long price = is_buy ? 10000 - offset(engine) + 2 : 10000 + offset(engine) - 2;
+                int order_quantity = quantity(engine);
+                if (roll == 4 && side(engine) == 1) {
+                    replay_log.append(OrderCommand(OrderCommand::Type::ADD_AON, timestamp_us, next_recorded_id, is_buy, price + (is_buy ? 2 : -2), 2 * order_quantity));
+                }
+                else if (roll == 5) {
+                    replay_log.append(owned_by(OrderCommand(OrderCommand::Type::ADD_ICEBERG, timestamp_us, next_recorded_id, is_buy, price, 3 * order_quantity, 1 + order_quantity / 4), 1 + next_recorded_id % 3));
+                }
+                else {
+                    replay_log.append(owned_by(OrderCommand(OrderCommand::Type::ADD_LIMIT, timestamp_us, next_recorded_id, is_buy, price, order_quantity), 1 + next_recorded_id % 3));
+                }
+                added_ids.push_back(next_recorded_id++);
+            }
+            else if (roll < 8) {
+                std::uniform_int_distribution<std::size_t> pick(0, added_ids.size() - 1);
+                replay_log.append(OrderCommand(OrderCommand::Type::CANCEL, timestamp_us, added_ids[pick(engine)], false, -1, 0));
+            }
+            else if (roll < 9) {
+                std::uniform_int_distribution<std::size_t> pick(0, added_ids.size() - 1);
+                replay_log.append(OrderCommand(OrderCommand::Type::MODIFY, timestamp_us, added_ids[pick(engine)], false, -1, quantity(engine)));
+            }
+            else if (side(engine) == 1) {
+                long long trigger = is_buy ? 10000 + offset(engine) : 10000 - offset(engine);
+                long long limit = side(engine) == 1 ? -1 : trigger + (is_buy ? 2 : -2);
+                replay_log.append(owned_by(OrderCommand::stop(timestamp_us, next_recorded_id, is_buy, trigger, limit, quantity(engine)), 1 + next_recorded_id % 3));
+                added_ids.push_back(next_recorded_id++);
+            }
+            else {
+                replay_log.append(owned_by(OrderCommand(OrderCommand::Type::ADD_IOC, timestamp_us, next_recorded_id, is_buy, -1, quantity(engine)), 1 + next_recorded_id % 3));
+                next_recorded_id++;
+            }
+        }
+
+        return replay_log;
+    }
+
+    // Resting orders as (side, price, visible quantity, hidden quantity) in priority order, ids differ between books so they are left out.
+    std::vector<std::tuple<bool, long long, int, int, long long>> book_state(OrderBook& orderbook) {
+        std::vector<std::tuple<bool, long long, int, int, long long>> state;
+        for (auto iter = orderbook.get_buys().rbegin(); iter != orderbook.get_buys().rend(); ++iter) {
+            for (const Order& order : iter->second) {
+                state.emplace_back(true, order.priceTick, order.quantity, order.hiddenQuantity, order.ownerId);
+            }
+        }
+        for (auto iter = orderbook.get_sells().begin(); iter != orderbook.get_sells().end(); ++iter) {
+            for (const Order& order : iter->second) {
+                state.emplace_back(false, order.priceTick, order.quantity, order.hiddenQuantity, order.ownerId);
+            }
+        }
+        return state;
+    }
+
+    // Waiting all-or-none orders as (side, price, quantity) in priority order
+    std::vector<std::tuple<bool, long long, int>> aon_state(OrderBook& orderbook) {
+        std::vector<std::tuple<bool, long long, int>> state;
+        for (auto iter = orderbook.get_aon_buys().rbegin(); iter != orderbook.get_aon_buys().rend(); ++iter) {
+            for (const Order& order : iter->second) {
+                state.emplace_back(true, order.priceTick, order.quantity);
+            }
+        }
+        for (auto iter = orderbook.get_aon_sells().begin(); iter != orderbook.get_aon_sells().end(); ++iter) {
+            for (const Order& order : iter->second) {
+                state.emplace_back(false, order.priceTick, order.quantity);
+            }
+        }
+        return state;
+    }
+
+    // Pending stops as (side, trigger, limit, quantity) in release order
+    std::vector<std::tuple<bool, long long, long long, int, long long>> stop_state(OrderBook& orderbook) {
+        std::vector<std::tuple<bool, long long, long long, int, long long>> state;
+        for (const auto& trigger : orderbook.get_buy_stops()) {
+            for (const StopOrder& stop : trigger.second) {
+                state.emplace_back(true, stop.triggerTick, stop.limitTick, stop.quantity, stop.ownerId);
+            }
+        }
+        for (auto iter = orderbook.get_sell_stops().rbegin(); iter != orderbook.get_sell_stops().rend(); ++iter) {
+            for (const StopOrder& stop : iter->second) {
+                state.emplace_back(false, stop.triggerTick, stop.limitTick, stop.quantity, stop.ownerId);
+            }
+        }
+        return state;
+    }
+}
+
+/**
+    ============================================================
+    TEST 1: CheckpointsAreBuiltAtInterval
+    ============================================================
+    PURPOSE: Verify checkpoints are taken once per interval, in time order, and hold the book exactly as a sequential replay sees it
+    ============================================================
+*/
+TEST(ReplayTest, CheckpointsAreBuiltAtInterval) {
+    ReplayLog replay_log = make_random_replay_log(5000, 100, 7);
+    replay_log.build_checkpoints(50000);
+
+    // Events span 100us..500000us, so there is a checkpoint at every 50000us boundary after the first event
+    EXPECT_EQ(replay_log.get_checkpoints().size(), 9)
+        << "Unexpected number of checkpoints. Result: " << replay_log.get_checkpoints().size() << ", expected: 9";
+
+    ReplayEngine sequential_engine(replay_log);
+    for (const ReplayLog::Checkpoint& checkpoint : replay_log.get_checkpoints()) {
+        sequential_engine.run_until(checkpoint.timestamp_us);
+
+        EXPECT_EQ(sequential_engine.get_next_event_index(), checkpoint.event_index)
+            << "Checkpoint at " << checkpoint.timestamp_us << "us does not point at the first event after it.";
+        EXPECT_EQ(sequential_engine.get_orderbook().get_order_lookup().size(), checkpoint.orders.size())
+            << "Checkpoint at " << checkpoint.timestamp_us << "us does not hold every resting order.";
+        EXPECT_EQ(aon_state(sequential_engine.get_orderbook()).size(), checkpoint.aon_orders.size())
+            << "Checkpoint at " << checkpoint.timestamp_us << "us does not hold every all-or-none order.";
+        EXPECT_EQ(stop_state(sequential_engine.get_orderbook()).size(), checkpoint.stops.size())
+            << "Checkpoint at " << checkpoint.timestamp_us << "us does not hold every pending stop.";
+    }
+}
+
+/**
+    ============================================================
+    TEST 2: SeekMatchesSequentialReplay
+    ============================================================
+    PURPOSE: Seeking through a checkpoint must produce the same book as replaying from the start, including time priority inside levels
+    ============================================================
+*/
+TEST(ReplayTest, SeekMatchesSequentialReplay) {
+    ReplayLog replay_log = make_random_replay_log(5000, 100, 11);
+    replay_log.build_checkpoints(40000);
+
+    for (long long target_us : {1000LL, 123456LL, 250000LL, 499999LL}) {
+        ReplayEngine sequential_engine(replay_log);
+        sequential_engine.run_until(target_us);
+
+        ReplayEngine seeking_engine(replay_log);
+        seeking_engine.seek(target_us);
+
+        EXPECT_EQ(seeking_engine.get_next_event_index(), sequential_engine.get_next_event_index())
+            << "Seek to " << target_us << "us stopped at a different event than the sequential replay.";
+        EXPECT_EQ(book_state(seeking_engine.get_orderbook()), book_state(sequential_engine.get_orderbook()))
+            << "Book after seeking to " << target_us << "us differs from the sequentially replayed book.";
+        EXPECT_EQ(aon_state(seeking_engine.get_orderbook()), aon_state(sequential_engine.get_orderbook()))
+            << "All-or-none orders after seeking to " << target_us << "us differ from the sequential replay.";
+        EXPECT_EQ(stop_state(seeking_engine.get_orderbook()), stop_state(sequential_engine.get_orderbook()))
+            << "Pending stops after seeking to " << target_us << "us differ from the sequential replay.";
+        EXPECT_EQ(seeking_engine.get_orderbook().get_last_trade_price(), sequential_engine.get_orderbook().get_last_trade_price());
+    }
+
+    // Seeking backwards rebuilds the book instead of replaying forward
+    ReplayEngine engine(replay_log);
+    engine.seek(400000);
+    engine.seek(100000);
+
+    ReplayEngine reference_engine(replay_log);
+    reference_engine.run_until(100000);
+    EXPECT_EQ(book_state(engine.get_orderbook()), book_state(reference_engine.get_orderbook()))
+        << "Book after seeking backwards differs from the sequentially replayed book.";
+}
+
+/**
+    ============================================================
+    TEST 3: SaveAndLoadRoundTrip
+    ============================================================
+    PURPOSE: Verify the binary replay file keeps every event and checkpoint
+    ============================================================
+*/
+TEST(ReplayTest, SaveAndLoadRoundTrip) {
+    ReplayLog replay_log = make_random_replay_log(2000, 250, 3);
+    replay_log.build_checkpoints(100000);
+
+    std::string path = testing::TempDir() + "replay_round_trip.bin";
+    replay_log.save(path);
+
+    ReplayLog loaded_log;
+    loaded_log.load(path);
+    std::remove(path.c_str());
+
+    ASSERT_EQ(loaded_log.get_events().size(), replay_log.get_events().size())
+        << "Loaded replay has a different number of events.";
+    ASSERT_EQ(loaded_log.get_checkpoints().size(), replay_log.get_checkpoints().size())
+        << "Loaded replay has a different number of checkpoints.";
+    EXPECT_EQ(loaded_log.get_checkpoint_interval_us(), 100000)
+        << "Checkpoint interval is not kept in the replay file.";
+
+    for (std::size_t i = 0; i < replay_log.get_events().size(); i++) {
+        const OrderCommand& original = replay_log.get_events()[i];
+        const OrderCommand& loaded = loaded_log.get_events()[i];
+        ASSERT_TRUE(original.timestampUs == loaded.timestampUs && original.orderId == loaded.orderId && original.priceTick == loaded.priceTick
+                    && original.quantity == loaded.quantity && original.displayQuantity == loaded.displayQuantity
+                    && original.triggerTick == loaded.triggerTick && original.ownerId == loaded.ownerId && original.type == loaded.type && original.isBuy == loaded.isBuy)
+            << "Event " << i << " changed after the save/load round trip.";
+    }
+
+    const ReplayLog::Checkpoint& original_checkpoint = replay_log.get_checkpoints().back();
+    const ReplayLog::Checkpoint& loaded_checkpoint = loaded_log.get_checkpoints().back();
+    EXPECT_EQ(loaded_checkpoint.timestamp_us, original_checkpoint.timestamp_us);
+    EXPECT_EQ(loaded_checkpoint.event_index, original_checkpoint.event_index);
+    ASSERT_EQ(loaded_checkpoint.orders.size(), original_checkpoint.orders.size());
+    for (std::size_t i = 0; i < original_checkpoint.orders.size(); i++) {
+        EXPECT_EQ(loaded_checkpoint.orders[i].quantity, original_checkpoint.orders[i].quantity);
+        EXPECT_EQ(loaded_checkpoint.orders[i].hiddenQuantity, original_checkpoint.orders[i].hiddenQuantity);
+        EXPECT_EQ(loaded_checkpoint.orders[i].displayQuantity, original_checkpoint.orders[i].displayQuantity);
+        EXPECT_EQ(loaded_checkpoint.orders[i].ownerId, original_checkpoint.orders[i].ownerId);
+    }
+    ASSERT_EQ(loaded_checkpoint.aon_orders.size(), original_checkpoint.aon_orders.size());
+    for (std::size_t i = 0; i < original_checkpoint.aon_orders.size(); i++) {
+        EXPECT_EQ(loaded_checkpoint.aon_orders[i].orderId, original_checkpoint.aon_orders[i].orderId);
+        EXPECT_EQ(loaded_checkpoint.aon_orders[i].priceTick, original_checkpoint.aon_orders[i].priceTick);
+        EXPECT_EQ(loaded_checkpoint.aon_orders[i].quantity, original_checkpoint.aon_orders[i].quantity);
+    }
+    EXPECT_EQ(loaded_checkpoint.last_trade_price, original_checkpoint.last_trade_price);
+    ASSERT_EQ(loaded_checkpoint.stops.size(), original_checkpoint.stops.size());
+    for (std::size_t i = 0; i < original_checkpoint.stops.size(); i++) {
+        EXPECT_EQ(loaded_checkpoint.stops[i].orderId, original_checkpoint.stops[i].orderId);
+        EXPECT_EQ(loaded_checkpoint.stops[i].triggerTick, original_checkpoint.stops[i].triggerTick);
+        EXPECT_EQ(loaded_checkpoint.stops[i].limitTick, original_checkpoint.stops[i].limitTick);
+        EXPECT_EQ(loaded_checkpoint.stops[i].quantity, original_checkpoint.stops[i].quantity);
+        EXPECT_EQ(loaded_checkpoint.stops[i].ownerId, original_checkpoint.stops[i].ownerId);
+    }
+
+    ReplayLog not_a_replay;
+    EXPECT_THROW(not_a_replay.load(testing::TempDir() + "does_not_exist.bin"), std::runtime_error)
+        << "Loading a missing replay file should throw.";
+}
+
+/**
+    ============================================================
+    TEST 4: SelfTradePreventionIsReplayed
+    ============================================================
+    PURPOSE: Verify owners and the self-trade prevention mode survive the replay file and the checkpoints, so a loaded log seeks
+             to the same book as the recorded one replays sequentially, also when the mode is changed after the checkpoints were built
+    ============================================================
+*/
+TEST(ReplayTest, SelfTradePreventionIsReplayed) {
+    ReplayLog replay_log = make_random_replay_log(5000, 100, 13);
+    replay_log.set_self_trade_prevention(OrderBook::SelfTradePrevention::CANCEL_OLDEST);
+    replay_log.build_checkpoints(40000);
+
+    std::string path = testing::TempDir() + "replay_self_trade_prevention.bin";
+    replay_log.save(path);
+    ReplayLog loaded_log;
+    loaded_log.load(path);
+    std::remove(path.c_str());
+    EXPECT_EQ(loaded_log.get_self_trade_prevention(), OrderBook::SelfTradePrevention::CANCEL_OLDEST)
+        << "Self-trade prevention mode is not kept in the replay file.";
+
+    ReplayLog unprevented_log = make_random_replay_log(5000, 100, 13);
+    ReplayLog late_mode_log = make_random_replay_log(5000, 100, 13);
+    late_mode_log.build_checkpoints(40000);
+    late_mode_log.set_self_trade_prevention(OrderBook::SelfTradePrevention::CANCEL_OLDEST);
+    for (long long target_us : {123456LL, 499999LL}) {
+        ReplayEngine sequential_engine(replay_log);
+        sequential_engine.run_until(target_us);
+
+        ReplayEngine seeking_engine(loaded_log);
+        seeking_engine.seek(target_us);
+
+        EXPECT_EQ(book_state(seeking_engine.get_orderbook()), book_state(sequential_engine.get_orderbook()))
+            << "Book after seeking to " << target_us << "us through the loaded log differs from the recorded replay.";
+        EXPECT_EQ(stop_state(seeking_engine.get_orderbook()), stop_state(sequential_engine.get_orderbook()))
+            << "Pending stops after seeking to " << target_us << "us through the loaded log differ from the recorded replay.";
+
+        ReplayEngine late_mode_engine(late_mode_log);
+        late_mode_engine.seek(target_us);
+        EXPECT_EQ(book_state(late_mode_engine.get_orderbook()), book_state(sequential_engine.get_orderbook()))
+            << "Changing the mode should rebuild the checkpoints, seeking to " << target_us << "us restored another book.";
+
+        ReplayEngine unprevented_engine(unprevented_log);
+        unprevented_engine.run_until(target_us);
+        EXPECT_NE(book_state(unprevented_engine.get_orderbook()), book_state(sequential_engine.get_orderbook()))
+            << "Prevention should have changed the book for the test to mean something.";
+    }
+}
+
+/**
+    ============================================================
+    TEST 5: PartitionedReplayCoversEveryEvent
+    ============================================================
+    PURPOSE: Windows replayed in parallel must apply every event exactly once and end in the same book as a sequential replay
+    ============================================================
+*/
+TEST(ReplayTest, PartitionedReplayCoversEveryEvent) {
+    ReplayLog replay_log = make_random_replay_log(8000, 100, 5);
+    replay_log.build_checkpoints(20000);
+
+    std::vector<ReplayEngine::WindowResult> windows = ReplayEngine::run_partitioned(replay_log, 0, 800001, 4, 10000);
+    ASSERT_EQ(windows.size(), 4);
+
+    std::size_t total_events_applied = 0;
+    for (std::size_t i = 0; i < windows.size(); i++) {
+        total_events_applied += windows[i].events_applied;
+        if (i > 0) {
+            EXPECT_EQ(windows[i].start_us, windows[i - 1].end_us)
+                << "Window " << i << " does not start where the previous window ends.";
+        }
+    }
+    EXPECT_EQ(total_events_applied, replay_log.get_events().size())
+        << "Windows should apply every event exactly once.";
+
+    ReplayEngine sequential_engine(replay_log);
+    sequential_engine.run_until(800001);
+    sequential_engine.finalize(800001);
+
+    std::vector<Metrics> window_metrics;
+    for (const ReplayEngine::WindowResult& window : windows) {
+        window_metrics.push_back(window.metrics);
+    }
+    Metrics stitched = Metrics::stitch(window_metrics);
+
+    EXPECT_EQ(stitched.current_best_bid_price_ticks, sequential_engine.get_metrics().current_best_bid_price_ticks)
+        << "Last window should end on the same best bid as the sequential replay.";
+    EXPECT_EQ(stitched.current_best_ask_price_ticks, sequential_engine.get_metrics().current_best_ask_price_ticks)
+        << "Last window should end on the same best ask as the sequential replay.";
+    EXPECT_TRUE(std::is_sorted(stitched.timestamp_series.begin(), stitched.timestamp_series.end()))
+        << "Stitched timestamp series should stay in time order.";
+}
+
+/**
+    ============================================================
+    TEST 6: MetricsStitchOffsetsPnl
+    ============================================================
+    PURPOSE: Verify the stitching rule: later windows are shifted by the PnL earlier windows ended with and counters are summed
+    ============================================================
+*/
+TEST(ReplayTest, MetricsStitchOffsetsPnl) {
+    Metrics first_window;
+    first_window.set_config(0.001, 0, 0, Metrics::MarkingMethod::MID, 1000);
+    first_window.timestamp_series = {0, 1000};
+    first_window.realized_pnl_ticks_series = {0, 50};
+    first_window.unrealized_pnl_ticks_series = {0, 0};
+    first_window.total_pnl_ticks_series = {0, 50};
+    first_window.realized_pnl_ticks = 50;
+    first_window.total_pnl_ticks = 50;
+    first_window.gross_traded_qty = 10;
+
+    Metrics second_window;
+    second_window.set_config(0.001, 0, 0, Metrics::MarkingMethod::MID, 1000);
+    second_window.timestamp_series = {2000, 3000};
+    second_window.realized_pnl_ticks_series = {0, -80};
+    second_window.unrealized_pnl_ticks_series = {0, 20};
+    second_window.total_pnl_ticks_series = {0, -60};
+    second_window.realized_pnl_ticks = -80;
+    second_window.unrealized_pnl_ticks = 20;
+    second_window.total_pnl_ticks = -60;
+    second_window.position = 2;
+    second_window.gross_traded_qty = 5;
+
+    Metrics stitched = Metrics::stitch({first_window, second_window});
+
+    EXPECT_EQ(stitched.total_pnl_ticks_series, std::vector<long long>({0, 50, 50, -10}))
+        << "Second window's total PnL should be shifted by the first window's final PnL.";
+    EXPECT_EQ(stitched.realized_pnl_ticks_series, std::vector<long long>({0, 50, 50, -30}))
+        << "Second window's realized PnL should be shifted by the first window's final PnL.";
+    EXPECT_EQ(stitched.get_total_pnl_ticks(), -10);
+    EXPECT_EQ(stitched.get_realized_pnl_ticks(), -30);
+    EXPECT_EQ(stitched.get_unrealized_pnl_ticks(), 20);
+    EXPECT_EQ(stitched.get_position(), 2)
+        << "Position should be taken from the last window.";
+    EXPECT_EQ(stitched.get_gross_traded_qty(), 15)
+        << "Traded quantity should be summed over windows.";
+    EXPECT_EQ(stitched.get_max_drawdown_ticks(), -60)
+        << "Drawdown should be recomputed over the joined total PnL series (peak 50, trough -10).";
+}
\ No newline at end of file
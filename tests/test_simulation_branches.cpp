@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "../include/IdGenerator.h"
+#include "../include/SimulationEngine.h"
+
+namespace {
+    // A simulation with a book full of background flow, warmed up to warm_up_us
+    std::unique_ptr<SimulationEngine> make_warm_simulation(long long warm_up_us) {
+        auto simulation = std::make_unique<SimulationEngine>(1, 1000001, 100, 5, 1, 50, 1, 1000);
+        MarketEngine& engine = simulation->get_market_engine();
+        engine.set_fill_model(MarketEngine::FillModel::ORDER_BOOK);
+        engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::noise_traders(5000));
+        engine.get_background_flow().add_population(BackgroundFlow::AgentPopulation::market_makers(1000));
+        simulation->run_until(warm_up_us);
+        return simulation;
+    }
+
+    void expect_same_metrics(const Metrics& expected, const Metrics& actual, const char* what) {
+        EXPECT_EQ(actual.timestamp_series, expected.timestamp_series) << what << " should record the same timestamps." << std::endl;
+        EXPECT_EQ(actual.total_pnl_ticks_series, expected.total_pnl_ticks_series) << what << " should make the same PnL." << std::endl;
+        EXPECT_EQ(actual.market_price_ticks_series, expected.market_price_ticks_series) << what << " should see the same prices." << std::endl;
+        EXPECT_EQ(actual.gross_traded_qty, expected.gross_traded_qty) << what << " should trade the same quantity." << std::endl;
+        EXPECT_EQ(actual.position, expected.position) << what << " should end with the same position." << std::endl;
+    }
+}
+
+/**
+    ============================================================
+    TEST 1: UnchangedBranchContinuesTheRun
+    ============================================================
+    PURPOSE: Verify a branch without changes ends exactly where the simulation itself ends when it runs on from the fork point,
+             whether it is run by run_branches or forked by hand, and that running branches leaves the simulation untouched
+    ============================================================
+*/
+TEST(SimulationBranchesTest, UnchangedBranchContinuesTheRun) {
+    std::unique_ptr<SimulationEngine> simulation = make_warm_simulation(100001);
+    std::vector<SimulationEngine::BranchResult> results = simulation->run_branches({nullptr}, 200001, 1);
+    EXPECT_EQ(simulation->get_current_timestamp_us(), 100001) << "Running branches should not move the simulation." << std::endl;
+
+    std::unique_ptr<SimulationEngine> forked;
+    {
+        IdGenerator::Scope ids(IdGenerator::peekNext(), IdGenerator::peekNextTrade());
+        forked = simulation->fork();
+        forked->run_until(200001);
+        forked->finalize(200001);
+    }
+    {
+        IdGenerator::Scope ids(IdGenerator::peekNext(), IdGenerator::peekNextTrade());
+        simulation->run_until(200001);
+        simulation->finalize(200001);
+    }
+
+    ASSERT_EQ(results.size(), 1) << "There should be one result per variant." << std::endl;
+    EXPECT_EQ(results[0].end_us, 200001) << "Branch should have run up to the end asked for." << std::endl;
+    expect_same_metrics(simulation->get_market_engine().get_metrics(), results[0].metrics, "Unchanged branch");
+    expect_same_metrics(simulation->get_market_engine().get_metrics(), forked->get_market_engine().get_metrics(), "Fork");
+    EXPECT_GT(results[0].metrics.gross_traded_qty, 0) << "The strategy should have traded for the test to mean something." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 2: BranchesDoNotDependOnTheThreads
+    ============================================================
+    PURPOSE: Verify each variant gets its own result, in the order of the variants, and that results are the same whether the branches
+             run one after the other or side by side on several threads
+    ============================================================
+*/
+TEST(SimulationBranchesTest, BranchesDoNotDependOnTheThreads) {
+    std::unique_ptr<SimulationEngine> simulation = make_warm_simulation(100001);
+    std::vector<SimulationEngine::BranchVariant> variants = {
+        nullptr,
+        [](SimulationEngine& branch) { branch.get_market_engine().get_strategy().set_quote_size(20); },
+        [](SimulationEngine& branch) { branch.get_market_engine().get_strategy().set_tick_offset_from_mid(3); },
+        [](SimulationEngine& branch) { branch.get_market_engine().get_strategy().set_max_inventory(0); }
+    };
+
+    std::vector<SimulationEngine::BranchResult> sequential = simulation->run_branches(variants, 200001, 1);
+    std::vector<SimulationEngine::BranchResult> parallel = simulation->run_branches(variants, 200001, 4);
+
+    ASSERT_EQ(parallel.size(), variants.size()) << "There should be one result per variant." << std::endl;
+    for (std::size_t i = 0; i < variants.size(); i++) {
+        EXPECT_EQ(parallel[i].variant, i) << "Results should come in the order of the variants." << std::endl;
+        expect_same_metrics(sequential[i].metrics, parallel[i].metrics, "Branch run on another thread");
+    }
+    EXPECT_LE(parallel[3].metrics.resting_attempted_qty, parallel[0].metrics.resting_attempted_qty) << "Without inventory room the strategy should quote less." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 3: FailingBranchIsReported
+    ============================================================
+    PURPOSE: Verify an exception thrown in a branch reaches the caller once every branch is done, and branches cannot run backwards
+    ============================================================
+*/
+TEST(SimulationBranchesTest, FailingBranchIsReported) {
+    SimulationEngine simulation(1, 100001, 100);
+    simulation.run_until(5001);
+
+    std::vector<SimulationEngine::BranchVariant> variants = {
+        nullptr,
+        [](SimulationEngine&) { throw std::runtime_error("Variant could not be applied!"); }
+    };
+    EXPECT_THROW(simulation.run_branches(variants, 10001, 2), std::runtime_error);
+    EXPECT_THROW(simulation.run_branches({nullptr}, 1001), std::runtime_error);
+}
@@ -1,8 +1,46 @@
 #include <gtest/gtest.h>
+#include <memory>
+#include <stdexcept>
+#include "../include/MarketEngine.h"
 #include "../include/Strategy.h"
 #include "LatencyQueue.h"
 #include "OrderBook.h"
 
+namespace {
+    // Joins the bid far above the market on the first update and counts every hook the engine calls
+    class JoinBidStrategy : public StrategyBase<JoinBidStrategy> {
+        private:
+            long long bid_order_id;
+        public:
+            int num_market_updates;
+            int num_timers;
+            int acknowledged_qty;
+
+            JoinBidStrategy(Metrics& metrics, OrderBook& order_book, int = 0, long long = 0, long long = 0, long long = 0, long long = 0)
+                    : StrategyBase(metrics, order_book), bid_order_id(-1), num_market_updates(0), num_timers(0), acknowledged_qty(0) {}
+
+            void on_market_update(long long timestamp_us, long long market_price_ticks) {
+                if (num_market_updates++ == 0) {
+                    bid_order_id = order_book.add_limit_order(true, market_price_ticks + 20, 10, timestamp_us);
+                    metrics.on_order_placed(bid_order_id, Metrics::Side::BUYS, market_price_ticks + 20, timestamp_us, 10, false);
+                }
+            }
+            void on_fill(const Trade& trade) {
+                latency_queue.schedule_event(trade.timestampUs, LatencyQueue::AcknowledgeFill{true, false, false, trade.quantity, trade.buyOrderId, trade.priceTick});
+            }
+            void on_ack(const LatencyQueue::AcknowledgeFill& fill, long long exec_time) {
+                metrics.on_fill(fill.orderId, fill.priceTick, exec_time, fill.quantity, false);
+                acknowledged_qty += fill.quantity;
+            }
+            void on_timer(long long timestamp_us) {
+                num_timers++;
+                StrategyBase::on_timer(timestamp_us);
+            }
+
+            long long get_active_buy_order_id() const { return bid_order_id; }
+    };
+}
+
 // Below are the default values of strategy parameters for this test suite
 // quote_size = 100,
 // tick_offset = 2,
@@ -613,4 +651,134 @@ TEST(StrategyTest, PongOnPingBuyFill) {
         << "Pong order is NOT the active buy order, meaning active_buy_order_id should stay -1." << std::endl;
     
     // There should be no orders left since pong buy and pong sell automatically filled each other.
-}
\ No newline at end of file
+}
+
+/**
+    ============================================================
+    TEST 9: FillsBeforeACancelAreBooked
+    ============================================================
+    PURPOSE: Verify a ping requested while another is in flight on its side does not queue a second order, and that a requote cancel
+             only takes off what the book still has of a ping: fills that happened before it still reach position when acknowledged
+    ============================================================
+*/
+TEST(StrategyTest, FillsBeforeACancelAreBooked) {
+    Metrics metrics;
+    OrderBook orderbook(metrics);
+    Strategy strategy(metrics, orderbook, 100, 2, 1000, 3, 0);
+    strategy.set_latency_config(10, 10, 10, 10, 10, 10, 5000, 5000, 10, 10); // fills are acknowledged long after the requote
+
+    strategy.observe_the_market(1000, 1000);
+    strategy.place_ping_buy(1500);
+    strategy.place_ping_buy(1505);
+    EXPECT_EQ(strategy.get_latency_queue().get_num_pending(LatencyQueue::ORDER_SEND), 1)
+        << "Only one ping buy should be in flight." << std::endl;
+    strategy.execute_latency_queue(2000);
+    EXPECT_EQ(orderbook.get_buys().size(), 1) << "One ping buy should rest in the orderbook." << std::endl;
+
+    // Partial fill at the exchange, its acknowledgement still in flight when the market moves past the cancel threshold
+    long long ping_id = strategy.get_active_buy_order_id();
+    Trade trade;
+    trade.buyOrderId = ping_id;
+    trade.sellOrderId = -2;
+    trade.priceTick = 1000 - 2;
+    trade.quantity = 40;
+    trade.timestampUs = 2001;
+    trade.was_instant = false;
+    orderbook.modify_order(ping_id, 60, 2001);
+    strategy.on_fill(trade);
+
+    strategy.observe_the_market(2001, 1010);
+    strategy.execute_latency_queue(2500);
+    strategy.cancel_mechanism(2500);
+    strategy.execute_latency_queue(2600);
+
+    EXPECT_EQ(strategy.get_active_buy_order_id(), -1) << "Ping buy should have been cancelled by the requote." << std::endl;
+    EXPECT_FALSE(orderbook.is_live(ping_id)) << "What was left of the ping should be off the book." << std::endl;
+    EXPECT_EQ(metrics.resting_cancelled_qty, 60) << "Only the quantity still resting should count as cancelled." << std::endl;
+    EXPECT_EQ(metrics.position, 0) << "The fill is not booked before it is acknowledged." << std::endl;
+
+    strategy.execute_latency_queue(10000);
+
+    EXPECT_EQ(strategy.get_latency_queue().get_num_fired(LatencyQueue::ACKNOWLEDGE_FILL), 1)
+        << "The fill acknowledgement should fire after the cancel." << std::endl;
+    EXPECT_EQ(metrics.position, 40) << "The 40 lots bought at the exchange should be in the position." << std::endl;
+    EXPECT_EQ(metrics.resting_filled_qty, 40) << "The fill should count as a resting fill." << std::endl;
+    EXPECT_FALSE(metrics.is_tracking(ping_id)) << "The ping should leave the cache once its last fill is booked." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 10: StaticStrategyRunsInTheEngine
+    ============================================================
+    PURPOSE: Verify a strategy written against StrategyBase gets every hook from BasicMarketEngine: market updates and timers each
+             update, fills of its quote and their acknowledgements through on_ack, and no ping pong behaviour it did not ask for
+    ============================================================
+*/
+TEST(StrategyTest, StaticStrategyRunsInTheEngine) {
+    BasicMarketEngine<JoinBidStrategy> engine;
+    for (long long timestamp_us = 100; timestamp_us <= 100000; timestamp_us += 100) {
+        engine.update(timestamp_us);
+    }
+
+    JoinBidStrategy& strategy = engine.get_strategy();
+    EXPECT_EQ(strategy.num_market_updates, 1000) << "Every update should reach on_market_update." << std::endl;
+    EXPECT_EQ(strategy.num_timers, 1000) << "Every update should reach on_timer." << std::endl;
+    EXPECT_EQ(strategy.acknowledged_qty, 10) << "The whole bid should have been filled and acknowledged." << std::endl;
+    EXPECT_EQ(engine.get_metrics().position, 10) << "Acknowledged fills should be booked." << std::endl;
+    EXPECT_GT(engine.get_metrics().time_in_flight[Metrics::ACKNOWLEDGEMENTS].num_events, 0) << "Acknowledgements should be timed in flight." << std::endl;
+    EXPECT_EQ(engine.get_orderbook().get_sells().size(), 0) << "Nothing should have been quoted but the bid." << std::endl;
+}
+
+/**
+    ============================================================
+    TEST 11: DynamicStrategyCallsThroughTheInterface
+    ============================================================
+    PURPOSE: Verify BasicMarketEngine<DynamicStrategy> runs the ping pong strategy by default, runs any strategy set through
+             StrategyAdapter with the same hooks as the static engine, and refuses to run none
+    ============================================================
+*/
+TEST(StrategyTest, DynamicStrategyCallsThroughTheInterface) {
+    BasicMarketEngine<DynamicStrategy> ping_pong(100, 2, 1000, 3, 1000);
+    for (long long timestamp_us = 100; timestamp_us <= 10000; timestamp_us += 100) {
+        ping_pong.update(timestamp_us);
+    }
+    auto* adapter = dynamic_cast<StrategyAdapter<PingPongStrategy>*>(&ping_pong.get_strategy().get_strategy());
+    ASSERT_NE(adapter, nullptr) << "The default strategy should be ping pong." << std::endl;
+    EXPECT_EQ(adapter->get().get_quote_size(), 100) << "Ping pong should be built from the engine's parameters." << std::endl;
+    EXPECT_GT(ping_pong.get_metrics().resting_attempted_qty, 0) << "Ping pong should have quoted." << std::endl;
+
+    BasicMarketEngine<DynamicStrategy> engine;
+    DynamicStrategy& dynamic = engine.get_strategy();
+    auto join_bid = std::make_unique<StrategyAdapter<JoinBidStrategy>>(dynamic.get_metrics(), dynamic.get_order_book());
+    JoinBidStrategy& strategy = join_bid->get();
+    dynamic.set_strategy(std::move(join_bid));
+    for (long long timestamp_us = 100; timestamp_us <= 100000; timestamp_us += 100) {
+        engine.update(timestamp_us);
+    }
+
+    EXPECT_EQ(strategy.num_market_updates, 1000) << "Every update should reach on_market_update through the interface." << std::endl;
+    EXPECT_EQ(strategy.num_timers, 1000) << "Every update should reach on_timer through the interface." << std::endl;
+    EXPECT_EQ(strategy.acknowledged_qty, 10) << "Fills should reach the strategy through the interface." << std::endl;
+    EXPECT_THROW(dynamic.set_strategy(nullptr), std::runtime_error);
+}
+/**
+    ============================================================
+    TEST 12: OneCancelCheckInFlight
+    ============================================================
+    PURPOSE: Verify market updates arriving faster than the cancel latency keep a single cancel check in flight instead of queueing one
+             per update, and that stale quotes are still cancelled
+    ============================================================
+*/
+TEST(StrategyTest, OneCancelCheckInFlight) {
+    MarketEngine marketengine(10, 1, 1000, 2, 1000, 10000, 2, 3.0, 0.3);
+    Strategy& strategy = marketengine.get_strategy();
+    strategy.set_latency_config(100, 200, 2000, 3000, 100, 200, 100, 200, 100, 200); // cancels take 20 to 30 updates to get there
+
+    for (long long timestamp_us = 100; timestamp_us <= 200000; timestamp_us += 100) {
+        marketengine.update(timestamp_us);
+        ASSERT_LE(strategy.get_latency_queue().get_num_pending(LatencyQueue::CANCEL), 1u)
+            << "Only one cancel check should be in flight at " << timestamp_us << "us." << std::endl;
+    }
+    EXPECT_GT(strategy.get_latency_queue().get_num_fired(LatencyQueue::CANCEL), 0u) << "Cancel checks should have run." << std::endl;
+    EXPECT_GT(marketengine.get_metrics().resting_cancelled_qty, 0) << "Stale quotes should still be cancelled." << std::endl;
+}